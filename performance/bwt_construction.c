@@ -1,4 +1,7 @@
 #include <bwt.h>
+#include <rl_bwt.h>
+#include <serialise.h>
+#include <parallel.h>
 #include <string_utils.h>
 
 #include <stdlib.h>
@@ -49,6 +52,15 @@ static char *build_random_large(uint32_t size)
 }
 */
 
+// Wall-clock time in microseconds; with threads,
+// clock() would add up the time of all of them.
+static uint64_t now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
 static void get_performance(uint32_t size)
 {
     uint8_t *s, *rs, *revrs;
@@ -58,69 +70,199 @@ static void get_performance(uint32_t size)
     struct remap_table remap_table;
     struct bwt_table bwt_table;
     
-    clock_t sa_begin, sa_end;
-    clock_t bwt_begin, bwt_end;
+    uint64_t sa_begin, sa_end;
+    uint64_t bwt_begin, bwt_end;
 
     s = build_random(size);
     init_remap_table(&remap_table, s);
     rs = malloc(size + 1);
     remap(rs, s, &remap_table);
 
-    printf("BWT-no-D %u %lu %lu\n", size,
-           sa_end - sa_begin, bwt_end - bwt_begin);
-    
-    free_suffix_array(sa);
-    dealloc_remap_table(&remap_table);
-    dealloc_bwt_table(&bwt_table);
-
-    
     // Without D table
     
-    sa_begin = clock();
-    sa = qsort_sa_construction(rs);
-    bwt_begin = sa_end = clock();
+    sa_begin = now();
+    sa = sa_is_construction(rs, remap_table.alphabet_size);
+    bwt_begin = sa_end = now();
     init_bwt_table(&bwt_table, sa, 0, &remap_table);
-    bwt_end = clock();
+    bwt_end = now();
     
     printf("BWT-no-D %u %lu %lu\n", size,
-           sa_end - sa_begin, bwt_end - bwt_begin);
+           (unsigned long)(sa_end - sa_begin),
+           (unsigned long)(bwt_end - bwt_begin));
     
     free_suffix_array(sa);
-    dealloc_remap_table(&remap_table);
     dealloc_bwt_table(&bwt_table);
 
-    sa_begin = clock();
-    sa = qsort_sa_construction(rs);
-    
     // With D table
     
+    sa_begin = now();
+    sa = sa_is_construction(rs, remap_table.alphabet_size);
     revrs = str_copy(rs);
     str_inplace_rev(revrs);
-    rsa = qsort_sa_construction(revrs);
-    
-    bwt_begin = sa_end = clock();
-    
-    init_bwt_table(&bwt_table, sa, 0, &remap_table);
-    bwt_end = clock();
+    rsa = sa_is_construction(revrs, remap_table.alphabet_size);
+    bwt_begin = sa_end = now();
+    init_bwt_table(&bwt_table, sa, rsa, &remap_table);
+    bwt_end = now();
     
     printf("BWT-with-D %u %lu %lu\n", size,
-           sa_end - sa_begin, bwt_end - bwt_begin);
+           (unsigned long)(sa_end - sa_begin),
+           (unsigned long)(bwt_end - bwt_begin));
     
     free_suffix_array(rsa);
     free_suffix_array(sa);
-    dealloc_remap_table(&remap_table);
     dealloc_bwt_table(&bwt_table);
+    dealloc_remap_table(&remap_table);
 
     free(revrs);
     free(rs);
     free(s);
 }
 
+// Time building the forward and reverse O tables
+// with different numbers of threads.
+static void thread_scaling(void)
+{
+    for (uint32_t size = 1 << 20; size <= 1 << 24; size <<= 2) {
+        uint8_t *s = build_random(size);
+        struct remap_table remap_table;
+        init_remap_table(&remap_table, s);
+        uint8_t *rs = malloc(size + 1);
+        remap(rs, s, &remap_table);
+        uint8_t *revrs = str_copy(rs);
+        str_inplace_rev(revrs);
+        struct suffix_array *sa = sa_is_construction(rs, remap_table.alphabet_size);
+        struct suffix_array *rsa = sa_is_construction(revrs, remap_table.alphabet_size);
+        
+        for (uint32_t no_threads = 1; no_threads <= 8; no_threads *= 2) {
+            set_stralg_threads(no_threads);
+            struct bwt_table bwt_table;
+            uint64_t begin = now();
+            init_bwt_table(&bwt_table, sa, rsa, &remap_table);
+            uint64_t end = now();
+            printf("threads %u %u %lu\n", size, no_threads,
+                   (unsigned long)(end - begin));
+            dealloc_bwt_table(&bwt_table);
+        }
+        set_stralg_threads(0);
+        
+        free_suffix_array(rsa);
+        free_suffix_array(sa);
+        dealloc_remap_table(&remap_table);
+        free(revrs);
+        free(rs);
+        free(s);
+    }
+}
+
+
+// Copies of a random string, each with a few mutations.
+static uint8_t *build_repetitive(uint32_t base_size, uint32_t copies)
+{
+    uint8_t *s = build_random(base_size * copies);
+    for (uint32_t c = 1; c < copies; ++c) {
+        memcpy(s + c * base_size, s, base_size);
+        for (uint32_t k = 0; k < base_size / 1000; ++k) {
+            s[c * base_size + rand() % base_size] = "ACGT"[rand() % 4];
+        }
+    }
+    return s;
+}
+
+static long serialised_size(void (*write)(FILE *, const void *), const void *table)
+{
+    FILE *f = tmpfile();
+    write(f, table);
+    long size = ftell(f);
+    fclose(f);
+    return size;
+}
+
+static void write_bwt(FILE *f, const void *table)
+{
+    write_complete_bwt_info(f, table);
+}
+
+static void write_rl_bwt(FILE *f, const void *table)
+{
+    write_complete_rl_bwt_info(f, table);
+}
+
+// Compare the BWT table, with a sampled suffix array, to the
+// run-length table on collections of near-identical strings:
+// the size of the serialised tables and the time it takes to
+// count and to locate patterns from the string.
+static void compare_run_length(void)
+{
+    uint32_t base_size = 1 << 16;
+    for (uint32_t copies = 1; copies <= 256; copies *= 4) {
+        uint32_t size = base_size * copies;
+        uint8_t *s = build_repetitive(base_size, copies);
+        struct bwt_table *bwt_table = build_complete_table_sampled(s, false, 32);
+        struct rl_bwt_table *rl_table = build_rl_bwt_table(s);
+
+        uint32_t no_patterns = 10000, m = 20;
+        uint8_t **patterns = malloc(no_patterns * sizeof(uint8_t *));
+        for (uint32_t j = 0; j < no_patterns; ++j) {
+            uint8_t *p = str_copy_n(s + rand() % (size - m), m);
+            patterns[j] = malloc(m + 1);
+            remap(patterns[j], p, bwt_table->remap_table);
+            free(p);
+        }
+
+        uint64_t begin = now();
+        index_t total = 0;
+        for (uint32_t j = 0; j < no_patterns; ++j) {
+            struct bwt_exact_match_iter iter;
+            struct bwt_exact_match match;
+            init_bwt_exact_match_iter(&iter, bwt_table, patterns[j]);
+            while (next_bwt_exact_match_iter(&iter, &match)) total++;
+            dealloc_bwt_exact_match_iter(&iter);
+        }
+        uint64_t bwt_time = now() - begin;
+        begin = now();
+        index_t rl_total = 0;
+        for (uint32_t j = 0; j < no_patterns; ++j) {
+            struct rl_bwt_exact_match_iter iter;
+            struct bwt_exact_match match;
+            init_rl_bwt_exact_match_iter(&iter, rl_table, patterns[j]);
+            while (next_rl_bwt_exact_match_iter(&iter, &match)) rl_total++;
+            dealloc_rl_bwt_exact_match_iter(&iter);
+        }
+        uint64_t rl_time = now() - begin;
+        assert(total == rl_total);
+
+        // The string is part of the BWT table's file, but not needed
+        // for the search, so we do not count it.
+        long bwt_size = serialised_size(write_bwt, bwt_table) - size;
+        long rl_size = serialised_size(write_rl_bwt, rl_table);
+        printf("BWT %u %u %ld %lu\n", size, copies, bwt_size,
+               (unsigned long)bwt_time);
+        printf("RLBWT %u %u %ld %lu %" PRIindex "\n", size, copies, rl_size,
+               (unsigned long)rl_time, rl_table->no_runs);
+
+        for (uint32_t j = 0; j < no_patterns; ++j) {
+            free(patterns[j]);
+        }
+        free(patterns);
+        completely_free_rl_bwt_table(rl_table);
+        completely_free_bwt_table(bwt_table);
+        free(s);
+    }
+}
 
 int main(int argc, const char **argv)
 {
     srand(time(NULL));
     
+    if (argc == 2 && strcmp(argv[1], "threads") == 0) {
+        thread_scaling();
+        return EXIT_SUCCESS;
+    }
+    if (argc == 2 && strcmp(argv[1], "runs") == 0) {
+        compare_run_length();
+        return EXIT_SUCCESS;
+    }
+    
 #if 0 // for comparison
     for (uint32_t n = 0; n < 10000; n += 500) {
         for (int rep = 0; rep < 5; ++rep) {
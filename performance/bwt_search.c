@@ -9,9 +9,9 @@
 #include <string.h>
 #include <assert.h>
 
-static uint8_t *build_random(uint32_t size)
+static uint8_t *build_random_alphabet(uint32_t size, const char *letters)
 {
-    const uint8_t *alphabet = (uint8_t *)"ACGT";
+    const uint8_t *alphabet = (uint8_t *)letters;
     int n = strlen((char *)alphabet);
     uint8_t *s = malloc(sizeof(uint8_t)*(size + 1));
     
@@ -23,6 +23,11 @@ static uint8_t *build_random(uint32_t size)
     return s;
 }
 
+static uint8_t *build_random(uint32_t size)
+{
+    return build_random_alphabet(size, "ACGT");
+}
+
 static uint8_t *sample_string(const uint8_t *string, uint32_t n, uint32_t m)
 {
     uint32_t offset = rand() % (n - m);
@@ -54,7 +59,7 @@ static void search(struct bwt_table *bwt_table, const uint8_t *p, int edits)
     init_bwt_approx_iter(&iter, bwt_table, p, edits);
     while (next_bwt_approx_match(&iter, &match)) {
         // do nothing
-        printf("match at %u\n", match.position);
+        printf("match at %" PRIindex "\n", match.position);
     }
     dealloc_bwt_approx_iter(&iter);
 }
@@ -166,9 +171,321 @@ static unsigned long get_st_performance(struct suffix_tree *st,
     
 }
 
+static const char *layout_names[] = {
+    "bit-vectors", "packed-dna", "interleaved-dna", "wavelet-matrix"
+};
+
+static double exact_search_time(struct bwt_table *bwt_table,
+                                uint8_t **patterns,
+                                uint32_t no_patterns)
+{
+    clock_t begin = clock();
+    // Only the backward search, we do not report the matches;
+    // the rank queries are what differs between the layouts.
+    uint32_t total = 0;
+    for (uint32_t j = 0; j < no_patterns; ++j) {
+        struct bwt_exact_match_iter iter;
+        init_bwt_exact_match_iter(&iter, bwt_table, patterns[j]);
+        total += iter.R - iter.L;
+        dealloc_bwt_exact_match_iter(&iter);
+    }
+    clock_t end = clock();
+    assert(total >= no_patterns); // all patterns are from the string
+    return (double)(end - begin) / CLOCKS_PER_SEC;
+}
+
+// Compare the occurrence table layouts on exact backward search.
+// The string must be large enough that the tables do not fit in
+// the cache, otherwise there are no cache misses to save.
+static void compare_layouts(uint32_t size, uint32_t m, uint32_t no_patterns)
+{
+    uint8_t *s = build_random(size);
+    struct remap_table remap_table;
+    init_remap_table(&remap_table, s);
+    uint8_t *rs = malloc(size + 1);
+    remap(rs, s, &remap_table);
+    struct suffix_array *sa = sa_is_construction(rs, remap_table.alphabet_size);
+    struct bwt_table bwt_table;
+    init_bwt_table(&bwt_table, sa, 0, &remap_table);
+
+    // Get the BWT string back from the default table,
+    // so we can build the other layouts from it.
+    struct occ_table *default_table = bwt_table.o_table;
+    uint8_t *bwt_string = malloc(default_table->length);
+    for (uint32_t i = 0; i < default_table->length; ++i) {
+        bwt_string[i] = occ_symbol(default_table, i);
+    }
+
+    uint8_t **patterns = malloc(no_patterns * sizeof(uint8_t *));
+    for (uint32_t j = 0; j < no_patterns; ++j) {
+        patterns[j] = sample_string(rs, size, m);
+    }
+
+    enum occ_layout layouts[] = {
+        OCC_BIT_VECTORS, OCC_PACKED_DNA, OCC_INTERLEAVED_DNA
+    };
+    for (uint32_t l = 0; l < sizeof(layouts) / sizeof(*layouts); ++l) {
+        struct occ_table table;
+        init_occ_table_layout(&table, bwt_string, default_table->length,
+                              remap_table.alphabet_size, layouts[l]);
+        bwt_table.o_table = &table;
+        for (uint32_t rep = 0; rep < 5; ++rep) {
+            double time = exact_search_time(&bwt_table, patterns, no_patterns);
+            printf("%s %u %u %u %f\n", layout_names[layouts[l]],
+                   size, m, no_patterns, time);
+        }
+        dealloc_occ_table(&table);
+    }
+    bwt_table.o_table = default_table;
+
+    for (uint32_t j = 0; j < no_patterns; ++j) {
+        free(patterns[j]);
+    }
+    free(patterns);
+    free(bwt_string);
+    dealloc_bwt_table(&bwt_table);
+    free_suffix_array(sa);
+    dealloc_remap_table(&remap_table);
+    free(rs);
+    free(s);
+}
+
+static double batch_search_time(struct bwt_table *bwt_table,
+                                uint8_t **patterns,
+                                uint32_t no_patterns)
+{
+    struct bwt_interval *intervals = malloc(no_patterns * sizeof(*intervals));
+    clock_t begin = clock();
+    bwt_exact_search_batch(bwt_table, (const uint8_t **)patterns,
+                           no_patterns, intervals);
+    clock_t end = clock();
+    uint32_t total = 0;
+    for (uint32_t j = 0; j < no_patterns; ++j) {
+        total += intervals[j].R - intervals[j].L;
+    }
+    assert(total >= no_patterns); // all patterns are from the string
+    free(intervals);
+    return (double)(end - begin) / CLOCKS_PER_SEC;
+}
+
+// Compare searching for one pattern at a time with the batched search.
+static void compare_batch(uint32_t size, uint32_t m, uint32_t no_patterns)
+{
+    uint8_t *s = build_random(size);
+    struct remap_table remap_table;
+    init_remap_table(&remap_table, s);
+    uint8_t *rs = malloc(size + 1);
+    remap(rs, s, &remap_table);
+    struct suffix_array *sa = sa_is_construction(rs, remap_table.alphabet_size);
+    struct bwt_table bwt_table;
+    init_bwt_table(&bwt_table, sa, 0, &remap_table);
+
+    uint8_t **patterns = malloc(no_patterns * sizeof(uint8_t *));
+    for (uint32_t j = 0; j < no_patterns; ++j) {
+        patterns[j] = sample_string(rs, size, m);
+    }
+
+    for (uint32_t rep = 0; rep < 5; ++rep) {
+        double time = exact_search_time(&bwt_table, patterns, no_patterns);
+        printf("single %u %u %u %f\n", size, m, no_patterns, time);
+        time = batch_search_time(&bwt_table, patterns, no_patterns);
+        printf("batch %u %u %u %f\n", size, m, no_patterns, time);
+    }
+
+    for (uint32_t j = 0; j < no_patterns; ++j) {
+        free(patterns[j]);
+    }
+    free(patterns);
+    dealloc_bwt_table(&bwt_table);
+    free_suffix_array(sa);
+    dealloc_remap_table(&remap_table);
+    free(rs);
+    free(s);
+}
+
+static const char *distance_names[] = {
+    "edit", "hamming"
+};
+static const char *algorithm_names[] = {
+    "backtrack", "bidirectional", "seed"
+};
+
+static double approx_search_time(struct bwt_table *bwt_table,
+                                 uint8_t **patterns,
+                                 uint32_t no_patterns,
+                                 int edits,
+                                 const struct bwt_approx_params *params,
+                                 uint32_t *no_matches)
+{
+    clock_t begin = clock();
+    *no_matches = 0;
+    for (uint32_t j = 0; j < no_patterns; ++j) {
+        struct bwt_approx_iter iter;
+        struct bwt_approx_match match;
+        init_bwt_approx_iter_params(&iter, bwt_table, patterns[j], edits, params);
+        while (next_bwt_approx_match(&iter, &match)) {
+            (*no_matches)++;
+        }
+        dealloc_bwt_approx_iter(&iter);
+    }
+    clock_t end = clock();
+    return (double)(end - begin) / CLOCKS_PER_SEC;
+}
+
+// Compare searching with the edit distance and with the Hamming
+// distance, for reads with edits mismatches and nothing else, so
+// both find the read's own position.
+static void compare_distances(uint32_t size, uint32_t m, uint32_t no_patterns)
+{
+    uint8_t *s = build_random(size);
+    struct bwt_table *bwt_table = build_complete_table(s, true);
+    uint32_t alphabet_size = bwt_table->remap_table->alphabet_size;
+
+    uint8_t **patterns = malloc(no_patterns * sizeof(uint8_t *));
+    for (int edits = 1; edits <= 3; ++edits) {
+        for (uint32_t j = 0; j < no_patterns; ++j) {
+            patterns[j] = sample_string(bwt_table->sa->string, size, m);
+            for (int e = 0; e < edits; ++e) {
+                patterns[j][rand() % m] = 1 + rand() % (alphabet_size - 1);
+            }
+        }
+
+        enum bwt_approx_algorithm algorithms[] = {
+            BWT_BACKTRACK, BWT_BIDIRECTIONAL, BWT_SEED_EXTEND
+        };
+        for (uint32_t a = 0; a < 3; ++a) {
+            for (uint32_t d = 0; d < 2; ++d) {
+                struct bwt_approx_params params = {
+                    .algorithm = algorithms[a],
+                    .filter = BWT_BEST_PER_POSITION,
+                    .distance = d ? BWT_HAMMING_DISTANCE : BWT_EDIT_DISTANCE
+                };
+                uint32_t no_matches;
+                double time = approx_search_time(bwt_table, patterns, no_patterns,
+                                                 edits, &params, &no_matches);
+                printf("%s %s %u %u %d %u %f\n",
+                       distance_names[d], algorithm_names[a],
+                       size, m, edits, no_matches, time);
+            }
+        }
+
+        for (uint32_t j = 0; j < no_patterns; ++j) {
+            free(patterns[j]);
+        }
+    }
+    free(patterns);
+    completely_free_bwt_table(bwt_table);
+    free(s);
+}
+
+static uint8_t *table_bwt_string(const struct occ_table *table)
+{
+    uint8_t *bwt_string = malloc(table->length);
+    for (index_t i = 0; i < table->length; ++i) {
+        bwt_string[i] = occ_symbol(table, i);
+    }
+    return bwt_string;
+}
+
+static size_t occ_table_bytes(const struct occ_table *table)
+{
+    index_t no_blocks, no_checkpoints, no_words;
+    occ_table_sizes(table->layout, table->alphabet_size, table->length,
+                    &no_blocks, &no_checkpoints, &no_words);
+    return no_checkpoints * sizeof(index_t) + no_words * sizeof(uint64_t);
+}
+
+// Compare the bit vectors and the wavelet matrix for a protein
+// alphabet: the size of the tables, exact search, and approximative
+// search, where we need the symbols in each interval.
+static void compare_large_alphabet(uint32_t size, uint32_t m, uint32_t no_patterns)
+{
+    uint8_t *s = build_random_alphabet(size, "ACDEFGHIKLMNPQRSTVWY");
+    struct bwt_table *bwt_table = build_complete_table(s, true);
+    uint32_t alphabet_size = bwt_table->remap_table->alphabet_size;
+    struct occ_table *default_o = bwt_table->o_table;
+    struct occ_table *default_ro = bwt_table->ro_table;
+    uint8_t *bwt_string = table_bwt_string(default_o);
+    uint8_t *rbwt_string = table_bwt_string(default_ro);
+
+    uint8_t **patterns = malloc(no_patterns * sizeof(uint8_t *));
+    uint8_t **edited = malloc(no_patterns * sizeof(uint8_t *));
+    for (uint32_t j = 0; j < no_patterns; ++j) {
+        patterns[j] = sample_string(bwt_table->sa->string, size, m);
+        edited[j] = str_copy_n(patterns[j], m);
+        edited[j][rand() % m] = 1 + rand() % (alphabet_size - 1);
+    }
+
+    enum occ_layout layouts[] = { OCC_BIT_VECTORS, OCC_WAVELET_MATRIX };
+    for (uint32_t l = 0; l < 2; ++l) {
+        struct occ_table o_table, ro_table;
+        init_occ_table_layout(&o_table, bwt_string, default_o->length,
+                              alphabet_size, layouts[l]);
+        init_occ_table_layout(&ro_table, rbwt_string, default_ro->length,
+                              alphabet_size, layouts[l]);
+        bwt_table->o_table = &o_table;
+        bwt_table->ro_table = &ro_table;
+
+        double exact = exact_search_time(bwt_table, patterns, no_patterns);
+        struct bwt_approx_params params = {
+            .algorithm = BWT_BACKTRACK, .filter = BWT_BEST_PER_POSITION
+        };
+        uint32_t no_matches;
+        double backtrack = approx_search_time(bwt_table, edited, no_patterns,
+                                              1, &params, &no_matches);
+        params.algorithm = BWT_BIDIRECTIONAL;
+        double bidirectional = approx_search_time(bwt_table, edited, no_patterns,
+                                                  1, &params, &no_matches);
+        printf("%s %u %u %u %zu %f %f %f\n", layout_names[layouts[l]],
+               size, m, no_patterns, occ_table_bytes(&o_table),
+               exact, backtrack, bidirectional);
+
+        dealloc_occ_table(&o_table);
+        dealloc_occ_table(&ro_table);
+    }
+    bwt_table->o_table = default_o;
+    bwt_table->ro_table = default_ro;
+
+    for (uint32_t j = 0; j < no_patterns; ++j) {
+        free(patterns[j]);
+        free(edited[j]);
+    }
+    free(patterns);
+    free(edited);
+    free(bwt_string);
+    free(rbwt_string);
+    completely_free_bwt_table(bwt_table);
+    free(s);
+}
+
 int main(int argc, const char **argv)
 {
     srand(time(NULL));
+
+    if (argc > 1 && strcmp(argv[1], "layouts") == 0) {
+        for (uint32_t size = 1 << 16; size <= 1 << 26; size <<= 5) {
+            compare_layouts(size, 20, 1000000);
+        }
+        return EXIT_SUCCESS;
+    }
+    if (argc > 1 && strcmp(argv[1], "batch") == 0) {
+        for (uint32_t size = 1 << 16; size <= 1 << 26; size <<= 5) {
+            compare_batch(size, 20, 1000000);
+        }
+        return EXIT_SUCCESS;
+    }
+    if (argc > 1 && strcmp(argv[1], "proteins") == 0) {
+        for (uint32_t size = 1 << 16; size <= 1 << 22; size <<= 3) {
+            compare_large_alphabet(size, 30, 10000);
+        }
+        return EXIT_SUCCESS;
+    }
+    if (argc > 1 && strcmp(argv[1], "distances") == 0) {
+        for (uint32_t size = 1 << 16; size <= 1 << 22; size <<= 3) {
+            compare_distances(size, 100, 1000);
+        }
+        return EXIT_SUCCESS;
+    }
     
     uint8_t *s, *rs, *revrs;
     
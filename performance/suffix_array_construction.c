@@ -3,6 +3,7 @@
 #include <vectors.h>
 #include <remap.h>
 #include <suffix_tree.h>
+#include <parallel.h>
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -183,9 +184,136 @@ static void get_performance(uint32_t size)
 
 }
 
+// Wall-clock time in microseconds; with threads,
+// clock() would add up the time of all of them.
+static uint64_t now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+// Time parallel SA-IS with different numbers of threads
+// against the sequential construction.
+static void thread_scaling(void)
+{
+    for (uint32_t size = 1 << 20; size <= 1 << 24; size <<= 2) {
+        uint8_t *strings[] = {
+            build_equal(size), build_random(size), build_random_large(size)
+        };
+        const char *names[] = { "Equal", "DNA", "ASCII" };
+        for (int k = 0; k < 3; ++k) {
+            uint8_t *remapped_string = malloc(size + 1);
+            uint32_t alphabet_size = remap_string(remapped_string, strings[k]);
+
+            set_stralg_threads(1);
+            uint64_t begin = now();
+            struct suffix_array *expected =
+                sa_is_construction(remapped_string, alphabet_size);
+            uint64_t end = now();
+            printf("SA-IS %s %u 1 %lu\n", names[k], size,
+                   (unsigned long)(end - begin));
+
+            for (uint32_t no_threads = 1; no_threads <= 8; no_threads *= 2) {
+                begin = now();
+                struct suffix_array *sa = sa_is_construction_parallel(
+                    remapped_string, alphabet_size, no_threads);
+                end = now();
+                printf("SA-IS-parallel %s %u %u %lu\n", names[k], size,
+                       no_threads, (unsigned long)(end - begin));
+                assert(memcmp(sa->array, expected->array,
+                              sa->length * sizeof(index_t)) == 0);
+                free_suffix_array(sa);
+            }
+            set_stralg_threads(0);
+
+            free_suffix_array(expected);
+            free(remapped_string);
+            free(strings[k]);
+        }
+    }
+}
+
+// Kasai et al.'s construction, through the inverse suffix
+// array, as compute_lcp() used to do it.
+static index_t *kasai_lcp(const struct suffix_array *sa)
+{
+    index_t n = sa->length;
+    index_t *inverse = malloc(n * sizeof(*inverse));
+    index_t *lcp = malloc(n * sizeof(*lcp));
+    for (index_t i = 0; i < n; ++i)
+        inverse[sa->array[i]] = i;
+    lcp[0] = 0;
+    index_t l = 0;
+    for (index_t i = 0; i < n; ++i) {
+        index_t j = inverse[i];
+        if (j == 0) continue;
+        index_t k = sa->array[j - 1];
+        while (sa->string[k + l] == sa->string[i + l])
+            ++l;
+        lcp[j] = l;
+        l = l > 0 ? l - 1 : 0;
+    }
+    free(inverse);
+    return lcp;
+}
+
+// Time the LCP construction with different numbers of
+// threads against Kasai's algorithm.
+static void lcp_performance(void)
+{
+    for (uint32_t size = 1 << 20; size <= 1 << 24; size <<= 2) {
+        uint8_t *strings[] = {
+            build_equal(size), build_random(size), build_random_large(size)
+        };
+        const char *names[] = { "Equal", "DNA", "ASCII" };
+        for (int k = 0; k < 3; ++k) {
+            uint8_t *remapped_string = malloc(size + 1);
+            uint32_t alphabet_size = remap_string(remapped_string, strings[k]);
+            struct suffix_array *sa =
+                sa_is_construction(remapped_string, alphabet_size);
+
+            uint64_t begin = now();
+            index_t *expected = kasai_lcp(sa);
+            uint64_t end = now();
+            printf("Kasai %s %u 1 %lu\n", names[k], size,
+                   (unsigned long)(end - begin));
+
+            for (uint32_t no_threads = 1; no_threads <= 8; no_threads *= 2) {
+                struct suffix_array *lcp_sa =
+                    sa_is_construction(remapped_string, alphabet_size);
+                set_stralg_threads(no_threads);
+                begin = now();
+                compute_lcp(lcp_sa);
+                end = now();
+                set_stralg_threads(0);
+                printf("PLCP %s %u %u %lu\n", names[k], size,
+                       no_threads, (unsigned long)(end - begin));
+                for (index_t i = 0; i < sa->length; ++i)
+                    assert(sa_lcp(lcp_sa, i) == expected[i]);
+                free_suffix_array(lcp_sa);
+            }
+
+            free(expected);
+            free_suffix_array(sa);
+            free(remapped_string);
+            free(strings[k]);
+        }
+    }
+}
+
 int main(int argc, const char **argv)
 {
     srand(time(NULL));
+
+    if (argc == 2 && strcmp(argv[1], "threads") == 0) {
+        thread_scaling();
+        return EXIT_SUCCESS;
+    }
+    if (argc == 2 && strcmp(argv[1], "lcp") == 0) {
+        lcp_performance();
+        return EXIT_SUCCESS;
+    }
     
     for (uint32_t n = 1000; n < 6000; n += 1000) {
         for (int rep = 0; rep < 5; ++rep) {
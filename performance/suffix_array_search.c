@@ -65,7 +65,8 @@ static double st_performance(uint8_t *s, uint32_t n,
 }
 
 static double sa_performance(uint8_t *s, uint32_t n,
-                             uint32_t no_patterns, uint32_t m)
+                             uint32_t no_patterns, uint32_t m,
+                             bool lcp_lr, bool buckets, bool tree)
 {
     clock_t search_begin, search_end;
     struct remap_table remap_table;
@@ -78,6 +79,9 @@ static double sa_performance(uint8_t *s, uint32_t n,
     remap(rs, s, &remap_table);
     
     struct suffix_array *sa = sa_is_construction(rs, remap_table.alphabet_size);
+    if (lcp_lr) compute_lcp_lr(sa);
+    if (buckets) compute_prefix_buckets(sa, remap_table.alphabet_size, 0);
+    if (tree) compute_search_tree(sa, 0);
     
     search_begin = clock();
 
@@ -149,16 +153,90 @@ static double bwt_performance(uint8_t *s, uint32_t n,
     return (double)(search_end - search_begin);
 }
 
+// Wall-clock time in nanoseconds
+static uint64_t now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+// Time per query with the different search structures, in
+// the tiny, small, medium and large configurations from the
+// plots. We sample the patterns before we start the clock.
+static void search_latency(void)
+{
+    struct { const char *name; uint32_t n, m; } configs[] = {
+        { "tiny", 1000, 30 },
+        { "small", 20000, 300 },
+        { "medium", 250000, 300 },
+        { "large", 4000000, 300 },
+        { "large", 4000000, 30 }
+    };
+    const char *algs[] = { "SA", "SA-LCP", "SA-Q", "SA-T", "SA-QT" };
+    uint32_t no_queries = 100000;
+    
+    for (uint32_t c = 0; c < sizeof(configs) / sizeof(*configs); ++c) {
+        uint32_t n = configs[c].n, m = configs[c].m;
+        uint8_t *s = build_random(n);
+        struct remap_table remap_table;
+        init_remap_table(&remap_table, s);
+        uint8_t *rs = malloc(n + 1);
+        remap(rs, s, &remap_table);
+        uint8_t *patterns = malloc((size_t)no_queries * (m + 1));
+        for (uint32_t i = 0; i < no_queries; ++i) {
+            uint8_t *p = sample_string(rs, n, m);
+            memcpy(patterns + (size_t)i * (m + 1), p, m + 1);
+            free(p);
+        }
+        
+        for (uint32_t a = 0; a < sizeof(algs) / sizeof(*algs); ++a) {
+            struct suffix_array *sa =
+                sa_is_construction(rs, remap_table.alphabet_size);
+            if (a == 1) compute_lcp_lr(sa);
+            if (a == 2 || a == 4)
+                compute_prefix_buckets(sa, remap_table.alphabet_size, 0);
+            if (a == 3 || a == 4) compute_search_tree(sa, 0);
+            
+            struct sa_match_iter iter;
+            struct sa_match match;
+            uint64_t matches = 0;
+            uint64_t begin = now();
+            for (uint32_t i = 0; i < no_queries; ++i) {
+                init_sa_match_iter(&iter, patterns + (size_t)i * (m + 1), sa);
+                while (next_sa_match(&iter, &match)) matches++;
+                dealloc_sa_match_iter(&iter);
+            }
+            uint64_t end = now();
+            printf("%s %s %u %u %.1f\n", configs[c].name, algs[a], n, m,
+                   (double)(end - begin) / no_queries);
+            // Every pattern is in the string
+            if (matches < no_queries) printf("missing matches!\n");
+            free_suffix_array(sa);
+        }
+        
+        free(patterns);
+        dealloc_remap_table(&remap_table);
+        free(rs);
+        free(s);
+    }
+}
+
 int main(int argc, char **argv)
 {
     uint32_t no_patterns = 200;
     
+    if (argc == 2 && strcmp(argv[1], "latency") == 0) {
+        search_latency();
+        return EXIT_SUCCESS;
+    }
+    
     /*
     for (uint32_t n = 2000; n <= 20000; n += 1000) {
         for (uint32_t m = 100; m <= 500; m += 100) {
             for (uint32_t rep = 0; rep < 10; ++rep) {
                 uint8_t *s = build_random(n);
-                double time = sa_performance(s, n, no_patterns, m);
+                double time = sa_performance(s, n, no_patterns, m, false, false, false);
                 printf("SA %u %u %f\n", n, m, time / CLOCKS_PER_SEC);
                 time = bwt_performance(s, n, no_patterns, m);
                 printf("BWT %u %u %f\n", n, m, time / CLOCKS_PER_SEC);
@@ -175,7 +253,7 @@ int main(int argc, char **argv)
         for (uint32_t m = 100; m <= 500; m += 100) {
             for (uint32_t rep = 0; rep < 10; ++rep) {
                 uint8_t *s = build_random(n);
-                double time = sa_performance(s, n, no_patterns, m);
+                double time = sa_performance(s, n, no_patterns, m, false, false, false);
                 printf("SA %u %u %f\n", n, m, time / CLOCKS_PER_SEC);
                 time = bwt_performance(s, n, no_patterns, m);
                 printf("BWT %u %u %f\n", n, m, time / CLOCKS_PER_SEC);
@@ -201,8 +279,20 @@ int main(int argc, char **argv)
         uint8_t *s = build_random(n);
         double time;
         if (strcmp(alg, "SA") == 0) {
-            time = sa_performance(s, n, no_patterns, m);
+            time = sa_performance(s, n, no_patterns, m, false, false, false);
             printf("SA %u %u %f\n", n, m, time / CLOCKS_PER_SEC);
+        } else if (strcmp(alg, "SA-LCP") == 0) {
+            time = sa_performance(s, n, no_patterns, m, true, false, false);
+            printf("SA-LCP %u %u %f\n", n, m, time / CLOCKS_PER_SEC);
+        } else if (strcmp(alg, "SA-Q") == 0) {
+            time = sa_performance(s, n, no_patterns, m, false, true, false);
+            printf("SA-Q %u %u %f\n", n, m, time / CLOCKS_PER_SEC);
+        } else if (strcmp(alg, "SA-T") == 0) {
+            time = sa_performance(s, n, no_patterns, m, false, false, true);
+            printf("SA-T %u %u %f\n", n, m, time / CLOCKS_PER_SEC);
+        } else if (strcmp(alg, "SA-QT") == 0) {
+            time = sa_performance(s, n, no_patterns, m, false, true, true);
+            printf("SA-QT %u %u %f\n", n, m, time / CLOCKS_PER_SEC);
         } else if (strcmp(alg, "BWT") == 0) {
             time = bwt_performance(s, n, no_patterns, m);
             printf("BWT %u %u %f\n", n, m, time / CLOCKS_PER_SEC);
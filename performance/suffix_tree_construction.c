@@ -70,10 +70,11 @@ static void get_performance(uint32_t size)
     clock_t begin, end;
 
     struct suffix_array *sa;
+    index_t *lcp;
     
     // remove
-    /*uint32_t sa[size+1];
-    uint32_t lcp[size+1];*/
+    /*index_t sa[size+1];
+    index_t lcp[size+1];*/
 
 #if EQUAL
     s = build_equal(size);
@@ -89,27 +90,29 @@ static void get_performance(uint32_t size)
     free_suffix_tree(st);
 
     sa = skew_sa_construction(s);
-    compute_lcp(sa);
+    lcp = lcp_array(sa);
     
     begin = clock();
-    st = lcp_suffix_tree(s, sa->array, sa->lcp);
+    st = lcp_suffix_tree(s, sa->array, lcp);
     end = clock();
     printf("LCP equal %u %f %ld\n",
            size, (double)(end - begin) / CLOCKS_PER_SEC,
            st->pool.next_node - st->pool.nodes);
     free_suffix_tree(st);
     free_suffix_array(sa);
+    free(lcp);
     
     begin = clock();
     sa = skew_sa_construction(s);
-    compute_lcp(sa);
-    st2 = lcp_suffix_tree(s, sa->array, sa->lcp);
+    lcp = lcp_array(sa);
+    st2 = lcp_suffix_tree(s, sa->array, lcp);
     end = clock();
     printf("LCP-build equal %u %f %ld\n",
            size, (double)(end - begin) / CLOCKS_PER_SEC,
            st2->pool.next_node - st2->pool.nodes);
     
     free_suffix_array(sa);
+    free(lcp);
     free_suffix_tree(st2);
     
     // --- Edge arrays ---
@@ -132,8 +135,8 @@ static void get_performance(uint32_t size)
     begin = clock();
     //ea_st_compute_sa_and_lcp(east, sa, lcp);
     sa = skew_sa_construction(s);
-    compute_lcp(sa);
-    east2 = lcp_ea_suffix_tree(2, s, sa->array, sa->lcp);
+    lcp = lcp_array(sa);
+    east2 = lcp_ea_suffix_tree(2, s, sa->array, lcp);
     end = clock();
     printf("EA-LCP-build equal %u %f %ld\n",
            size, (double)(end - begin) / CLOCKS_PER_SEC,
@@ -141,13 +144,14 @@ static void get_performance(uint32_t size)
     free_ea_suffix_tree(east2);
 
     begin = clock();
-    east = lcp_ea_suffix_tree(2, s, sa->array, sa->lcp);
+    east = lcp_ea_suffix_tree(2, s, sa->array, lcp);
     end = clock();
     printf("EA-LCP equal %u %f %ld\n",
            size, (double)(end - begin) / CLOCKS_PER_SEC,
            east->node_pool.next_node - east->node_pool.nodes);
     free_ea_suffix_tree(east);
     free_suffix_array(sa);
+    free(lcp);
 
 
     
@@ -169,20 +173,21 @@ static void get_performance(uint32_t size)
 
     begin = clock();
     sa = skew_sa_construction(s);
-    compute_lcp(sa);
-    st2 = lcp_suffix_tree(s, sa->array, sa->lcp);
+    lcp = lcp_array(sa);
+    st2 = lcp_suffix_tree(s, sa->array, lcp);
     end = clock();
     printf("LCP-build random %u %f %ld\n",
            size, (double)(end - begin) / CLOCKS_PER_SEC,
            st2->pool.next_node - st2->pool.nodes);
 
     begin = clock();
-    st = lcp_suffix_tree(s, sa->array, sa->lcp);
+    st = lcp_suffix_tree(s, sa->array, lcp);
     end = clock();
     printf("LCP random %u %f %ld\n",
            size, (double)(end - begin) / CLOCKS_PER_SEC,
            st->pool.next_node - st->pool.nodes);
     free_suffix_array(sa);
+    free(lcp);
     free_suffix_tree(st);
     free_suffix_tree(st2);
 
@@ -201,8 +206,8 @@ static void get_performance(uint32_t size)
     
     begin = clock();
     sa = skew_sa_construction(s);
-    compute_lcp(sa);
-    east = lcp_ea_suffix_tree(5, s, sa->array, sa->lcp);
+    lcp = lcp_array(sa);
+    east = lcp_ea_suffix_tree(5, s, sa->array, lcp);
     end = clock();
     printf("EA-LCP-build random %u %f %ld\n",
            size, (double)(end - begin) / CLOCKS_PER_SEC,
@@ -210,13 +215,14 @@ static void get_performance(uint32_t size)
     free_ea_suffix_tree(east);
 
     begin = clock();
-    east = lcp_ea_suffix_tree(5, s, sa->array, sa->lcp);
+    east = lcp_ea_suffix_tree(5, s, sa->array, lcp);
     end = clock();
     printf("EA-LCP random %u %f %ld\n",
            size, (double)(end - begin) / CLOCKS_PER_SEC,
            east->node_pool.next_node - east->node_pool.nodes);
     free_ea_suffix_tree(east);
     free_suffix_array(sa);
+    free(lcp);
 
         
 
@@ -241,21 +247,22 @@ static void get_performance(uint32_t size)
     
     begin = clock();
     sa = skew_sa_construction(s);
-    compute_lcp(sa);
-    st2 = lcp_suffix_tree(s, sa->array, sa->lcp);
+    lcp = lcp_array(sa);
+    st2 = lcp_suffix_tree(s, sa->array, lcp);
     end = clock();
     printf("LCP-build random_large %u %f %ld\n",
            size, (double)(end - begin) / CLOCKS_PER_SEC,
            st2->pool.next_node - st2->pool.nodes);
 
     begin = clock();
-    st = lcp_suffix_tree(s, sa->array, sa->lcp);
+    st = lcp_suffix_tree(s, sa->array, lcp);
     end = clock();
     printf("LCP random_large %u %f %ld\n",
     size, (double)(end - begin) / CLOCKS_PER_SEC,
     st->pool.next_node - st->pool.nodes);
 
     free_suffix_array(sa);
+    free(lcp);
     free_suffix_tree(st);
     free_suffix_tree(st2);
     
@@ -273,21 +280,22 @@ static void get_performance(uint32_t size)
        
     begin = clock();
     sa = skew_sa_construction(s);
-    compute_lcp(sa);
-    east2 = lcp_ea_suffix_tree(256, s, sa->array, sa->lcp);
+    lcp = lcp_array(sa);
+    east2 = lcp_ea_suffix_tree(256, s, sa->array, lcp);
     end = clock();
     printf("EA-LCP-build random_large %u %f %ld\n",
            size, (double)(end - begin) / CLOCKS_PER_SEC,
            east2->node_pool.next_node - east2->node_pool.nodes);
 
     begin = clock();
-    east = lcp_ea_suffix_tree(256, s, sa->array, sa->lcp);
+    east = lcp_ea_suffix_tree(256, s, sa->array, lcp);
     end = clock();
     printf("EA-LCP random_large %u %f %ld\n",
            size, (double)(end - begin) / CLOCKS_PER_SEC,
            east->node_pool.next_node - east->node_pool.nodes);
 
     free_suffix_array(sa);
+    free(lcp);
     free_ea_suffix_tree(east);
     free_ea_suffix_tree(east2);
 
@@ -307,8 +315,8 @@ static void get_performance(uint32_t size)
     // NAIVE
     east = naive_ea_suffix_tree(5, s);
 
-    uint32_t sa[east->length];
-    uint32_t lcp[east->length];
+    index_t sa[east->length];
+    index_t lcp[east->length];
     ea_st_compute_sa_and_lcp(east, sa, lcp);
     free_ea_suffix_tree(east);
 
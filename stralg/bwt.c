@@ -2,6 +2,9 @@
 #include "string_utils.h"
 #include "cigar.h"
 #include "bwt.h"
+#include "bwt_internal.h"
+#include "parallel.h"
+#include "suffix_array_internal.h"
 
 #include <stdio.h>
 #include <string.h>
@@ -9,16 +12,119 @@
 
 #define PRINT_STACK 0
 
+// We only use threads to build tables at least this long
+#define BWT_PARALLEL_THRESHOLD (1 << 20)
+
 
 static inline unsigned char bwt(
     const struct suffix_array *sa,
-    uint32_t i
+    index_t i
 )
 {
-    uint32_t suf = sa->array[i];
+    index_t suf = sa->array[i];
     return (suf == 0) ? '\0' : sa->string[suf - 1];
 }
 
+struct bwt_string_job {
+    const struct suffix_array *sa;
+    uint8_t *bwt_string;
+};
+
+static void fill_bwt_string(
+    void *data,
+    uint32_t thread_no,
+    uint32_t no_threads
+) {
+    struct bwt_string_job *job = data;
+    const struct suffix_array *sa = job->sa;
+    index_t start = chunk_start(sa->length, thread_no, no_threads, 1);
+    index_t end = chunk_start(sa->length, thread_no + 1, no_threads, 1);
+    for (index_t i = start; i < end; ++i) {
+        job->bwt_string[i] = bwt(sa, i);
+    }
+}
+
+static uint8_t *build_bwt_string(
+    const struct suffix_array *sa,
+    uint32_t no_threads
+) {
+    struct bwt_string_job job = {
+        .sa = sa,
+        .bwt_string = malloc(sa->length)
+    };
+    run_in_parallel(no_threads, fill_bwt_string, &job);
+    return job.bwt_string;
+}
+
+static struct occ_table *occ_table_from_bwt(
+    const uint8_t *bwt_string,
+    index_t length,
+    uint32_t alphabet_size,
+    uint32_t no_threads
+) {
+    struct occ_table *table = malloc(sizeof(struct occ_table));
+    init_occ_table_parallel(table, bwt_string, length, alphabet_size,
+                            default_occ_layout(alphabet_size), no_threads);
+    return table;
+}
+
+// We extract the BWT string once and build the rank
+// structure from it. The string itself is not needed
+// once we have the rank structure.
+static struct occ_table *build_occ_table(
+    const struct suffix_array *sa,
+    uint32_t alphabet_size,
+    uint32_t no_threads
+) {
+    uint8_t *bwt_string = build_bwt_string(sa, no_threads);
+    struct occ_table *table =
+        occ_table_from_bwt(bwt_string, sa->length, alphabet_size, no_threads);
+    free(bwt_string);
+    return table;
+}
+
+// Building the forward and the reverse table in parallel
+struct occ_tables_job {
+    const struct suffix_array *sas[2];
+    struct occ_table *tables[2];
+    uint32_t alphabet_size;
+    uint32_t no_threads; // shared by the tables we build at once
+};
+
+// Here the threads are the tables we build at the same time,
+// and they split the job's threads between them.
+static void build_occ_tables(
+    void *data,
+    uint32_t thread_no,
+    uint32_t no_threads
+) {
+    struct occ_tables_job *job = data;
+    uint32_t share = job->no_threads / no_threads;
+    if (thread_no == no_threads - 1)
+        share = job->no_threads - (no_threads - 1) * share;
+    job->tables[thread_no] = build_occ_table(job->sas[thread_no],
+                                             job->alphabet_size,
+                                             share);
+}
+
+static void build_c_table(
+    struct bwt_table *bwt_table,
+    const uint8_t *string,
+    index_t length // including the sentinel
+) {
+    uint32_t alphabet_size = bwt_table->remap_table->alphabet_size;
+    index_t char_counts[alphabet_size];
+    memset(char_counts, 0, alphabet_size * sizeof(index_t));
+    for (index_t i = 0; i < length; ++i) {
+        char_counts[string[i]]++;
+    }
+    
+    bwt_table->c_table = calloc(alphabet_size, sizeof(*bwt_table->c_table));
+    for (uint32_t i = 1; i < alphabet_size; ++i) {
+        C(i) = C(i-1) + char_counts[i - 1];
+    }
+}
+
 void init_bwt_table(
     struct bwt_table    *bwt_table,
     struct suffix_array *sa,
@@ -30,72 +136,59 @@ void init_bwt_table(
     uint32_t alphabet_size = remap_table->alphabet_size;
     bwt_table->remap_table = remap_table;
     bwt_table->sa = sa;
+    bwt_table->sa_samples = 0;
+    bwt_table->kmer_table = 0;
     
     
     // ---- COMPUTE C TABLE -----------------------------------
-    uint32_t char_counts[remap_table->alphabet_size];
-    memset(char_counts, 0, remap_table->alphabet_size * sizeof(uint32_t));
-    for (uint32_t i = 0; i < sa->length; ++i) {
-        char_counts[sa->string[i]]++;
-    }
+    build_c_table(bwt_table, sa->string, sa->length);
     
-    bwt_table->c_table = calloc(remap_table->alphabet_size, sizeof(*bwt_table->c_table));
-    for (uint32_t i = 1; i < remap_table->alphabet_size; ++i) {
-        C(i) = C(i-1) + char_counts[i - 1];
-    }
-    
-    // ---- COMPUTE O TABLE -----------------------------------
-    // The table has indices from zero to n, so it must have size
-    // Sigma x (n + 1)
-    uint32_t o_size = remap_table->alphabet_size * (sa->length + 1) *
-                        sizeof(*bwt_table->o_table);
-    bwt_table->o_table = malloc(o_size);
-    bwt_table->o_indices = malloc((sa->length + 1) * sizeof(*bwt_table->o_indices));
-    for (uint32_t i = 0; i < sa->length + 1; ++i) {
-        uint32_t *ptr = bwt_table->o_table + alphabet_size * i;
-        bwt_table->o_indices[i] = ptr;
-    }
-    for (uint8_t a = 0; a < remap_table->alphabet_size; ++a) {
-        O(a, 0) = 0;
-    }
-    for (uint8_t a = 0; a < remap_table->alphabet_size; ++a) {
-        for (uint32_t i = 1; i <= sa->length; ++i) {
-            O(a, i) = O(a, i - 1) + (bwt(sa, i - 1) == a);
-        }
+    // ---- COMPUTE O TABLES ----------------------------------
+    // If we have threads to spare, we build the forward and the
+    // reverse table at the same time, with half the threads each.
+    uint32_t no_threads =
+        (sa->length >= BWT_PARALLEL_THRESHOLD) ? stralg_threads() : 1;
+    struct occ_tables_job job = {
+        .sas = { sa, rsa },
+        .tables = { 0, 0 },
+        .alphabet_size = alphabet_size,
+        .no_threads = no_threads
+    };
+    if (rsa && no_threads > 1) {
+        run_in_parallel(2, build_occ_tables, &job);
+    } else {
+        build_occ_tables(&job, 0, 1);
+        if (rsa) build_occ_tables(&job, 1, 1);
     }
-    
-    if (rsa) {
-        
-        bwt_table->ro_table = malloc(o_size);
-        bwt_table->ro_indices = malloc((sa->length + 1) * sizeof(bwt_table->ro_indices));
-        for (uint32_t i = 0; i < sa->length + 1; ++i) {
-            bwt_table->ro_indices[i] = bwt_table->ro_table + alphabet_size * i;
-        }
+    bwt_table->o_table = job.tables[0];
+    bwt_table->ro_table = job.tables[1];
+}
 
-        for (uint8_t a = 0; a < remap_table->alphabet_size; ++a) {
-            RO(a, 0) = 0;
-        }
-        
-        for (uint8_t a = 0; a < remap_table->alphabet_size; ++a) {
-            for (uint32_t i = 1; i <= rsa->length; ++i) {
-                RO(a, i) = RO(a, i - 1) + (bwt(rsa, i - 1) == a);
-            }
-        }
+static void free_sa_samples(
+    struct bwt_sa_samples *samples
+) {
+    free(samples->samples);
+    free(samples->marked);
+    free(samples->marked_rank);
+    free(samples->isa_samples);
+    free(samples);
+}
 
-    } else {
-        bwt_table->ro_table = 0;
-        bwt_table->ro_indices = 0;
-    }
+static void free_kmer_table(
+    struct bwt_kmer_table *kmer_table
+) {
+    free(kmer_table->intervals);
+    free(kmer_table);
 }
 
 void dealloc_bwt_table(
     struct bwt_table *bwt_table
 ) {
     free(bwt_table->c_table);
-    free(bwt_table->o_table);
-    free(bwt_table->o_indices);
-    if (bwt_table->ro_table) free(bwt_table->ro_table);
-    if (bwt_table->ro_indices) free(bwt_table->ro_indices);
+    free_occ_table(bwt_table->o_table);
+    if (bwt_table->ro_table) free_occ_table(bwt_table->ro_table);
+    if (bwt_table->sa_samples) free_sa_samples(bwt_table->sa_samples);
+    if (bwt_table->kmer_table) free_kmer_table(bwt_table->kmer_table);
 }
 
 void completely_dealloc_bwt_table(
@@ -131,48 +224,384 @@ void completely_free_bwt_table(
     free(bwt_table);
 }
 
-struct bwt_table *build_complete_table(
+index_t bwt_no_marked_words_(index_t length)
+{
+    return length / 64 + 1;
+}
+
+void sample_bwt_suffix_array(
+    struct bwt_table *bwt_table,
+    uint32_t rate
+) {
+    const struct suffix_array *sa = bwt_table->sa;
+    assert(sa && sa->array);
+    assert(rate > 0);
+    
+    if (bwt_table->sa_samples) free_sa_samples(bwt_table->sa_samples);
+    
+    struct bwt_sa_samples *samples = malloc(sizeof(struct bwt_sa_samples));
+    index_t no_words = bwt_no_marked_words_(sa->length);
+    samples->rate = rate;
+    samples->marked = calloc(no_words, sizeof(*samples->marked));
+    samples->marked_rank = malloc(no_words * sizeof(*samples->marked_rank));
+    samples->samples = malloc((sa->length / rate + 1) * sizeof(*samples->samples));
+    samples->isa_samples = malloc((sa->length / rate + 1) * sizeof(*samples->isa_samples));
+    
+    index_t no_samples = 0;
+    for (index_t i = 0; i < sa->length; ++i) {
+        if (i % 64 == 0) samples->marked_rank[i / 64] = no_samples;
+        if (sa->array[i] % rate == 0) {
+            samples->marked[i / 64] |= (uint64_t)1 << (i % 64);
+            samples->samples[no_samples++] = sa->array[i];
+            samples->isa_samples[sa->array[i] / rate] = i;
+        }
+    }
+    if (sa->length % 64 == 0) samples->marked_rank[sa->length / 64] = no_samples;
+    samples->no_samples = no_samples;
+    
+    bwt_table->sa_samples = samples;
+}
+
+static inline bool is_marked(
+    const struct bwt_sa_samples *samples,
+    index_t i
+) {
+    return (samples->marked[i / 64] >> (i % 64)) & 1;
+}
+
+static inline index_t marked_rank(
+    const struct bwt_sa_samples *samples,
+    index_t i
+) {
+    uint64_t mask = ((uint64_t)1 << (i % 64)) - 1;
+    return samples->marked_rank[i / 64] +
+        (index_t)__builtin_popcountll(samples->marked[i / 64] & mask);
+}
+
+index_t bwt_locate(
+    const struct bwt_table *bwt_table,
+    index_t row
+) {
+    const struct bwt_sa_samples *samples = bwt_table->sa_samples;
+    if (!samples) return bwt_table->sa->array[row];
+    
+    // Walk backwards in the string until we hit a sampled
+    // position. Position zero is always sampled, so we never
+    // need to LF-map the sentinel.
+    uint32_t steps = 0;
+    while (!is_marked(samples, row)) {
+        uint8_t a = occ_symbol(bwt_table->o_table, row);
+        row = C(a) + O(a, row);
+        steps++;
+    }
+    return samples->samples[marked_rank(samples, row)] + steps;
+}
+
+void bwt_extract(
+    const struct bwt_table *bwt_table,
+    index_t pos,
+    index_t len,
+    uint8_t *buffer
+) {
+    index_t n = bwt_table->o_table->length - 1;
+    assert(pos <= n && len <= n - pos);
+    buffer[len] = '\0';
+    if (bwt_table->sa->string) {
+        memcpy(buffer, bwt_table->sa->string + pos, len);
+        return;
+    }
+    
+    const struct bwt_sa_samples *samples = bwt_table->sa_samples;
+    assert(samples);
+    
+    // Start from the first sampled position at or after the end
+    // of the substring, or from the sentinel, which is in row zero.
+    index_t end = pos + len;
+    index_t k = end / samples->rate + (end % samples->rate != 0);
+    index_t q = n, row = 0;
+    if (k < samples->no_samples) {
+        q = k * samples->rate;
+        row = samples->isa_samples[k];
+    }
+    
+    // Row row is the suffix at q, so its BWT symbol is at q - 1.
+    while (q > pos) {
+        uint8_t a = occ_symbol(bwt_table->o_table, row);
+        row = C(a) + O(a, row);
+        if (--q < end) buffer[q - pos] = a;
+    }
+}
+
+// Collects the BWT string, and the rows of the sampled positions,
+// from the rows SA-IS reports.
+struct bwt_rows {
+    const uint8_t *string;
+    uint8_t *bwt_string;
+    uint32_t rate;        // zero if we do not sample
+    index_t *sample_rows; // the row of position k * rate
+};
+
+static void collect_row(
+    void *data,
+    index_t row,
+    index_t value
+) {
+    struct bwt_rows *rows = data;
+    rows->bwt_string[row] = (value == 0) ? 0 : rows->string[value - 1];
+    if (rows->rate && value % rows->rate == 0)
+        rows->sample_rows[value / rows->rate] = row;
+}
+
+// The samples take over sample_rows as their inverse samples.
+static struct bwt_sa_samples *samples_from_rows(
+    index_t length,
+    uint32_t rate,
+    index_t *sample_rows
+) {
+    struct bwt_sa_samples *samples = malloc(sizeof(struct bwt_sa_samples));
+    index_t no_words = bwt_no_marked_words_(length);
+    index_t no_samples = (length - 1) / rate + 1;
+    samples->rate = rate;
+    samples->no_samples = no_samples;
+    samples->marked = calloc(no_words, sizeof(*samples->marked));
+    samples->marked_rank = malloc(no_words * sizeof(*samples->marked_rank));
+    samples->samples = malloc((length / rate + 1) * sizeof(*samples->samples));
+    samples->isa_samples = sample_rows;
+    
+    for (index_t k = 0; k < no_samples; ++k) {
+        index_t row = sample_rows[k];
+        samples->marked[row / 64] |= (uint64_t)1 << (row % 64);
+    }
+    index_t rank = 0;
+    for (index_t w = 0; w < no_words; ++w) {
+        samples->marked_rank[w] = rank;
+        rank += (index_t)__builtin_popcountll(samples->marked[w]);
+    }
+    for (index_t k = 0; k < no_samples; ++k) {
+        samples->samples[marked_rank(samples, sample_rows[k])] = k * rate;
+    }
+    
+    return samples;
+}
+
+// The BWT string of a remapped string, and optionally the rows
+// of the sampled positions, straight from the induced sorting.
+static uint8_t *bwt_from_sa_is(
+    const uint8_t *remapped_str,
+    index_t length, // including the sentinel
+    uint32_t alphabet_size,
+    uint32_t rate,
+    index_t **sample_rows
+) {
+    struct bwt_rows rows = {
+        .string = remapped_str,
+        .bwt_string = malloc(length),
+        .rate = rate,
+        .sample_rows = rate ?
+            malloc(((length - 1) / rate + 1) * sizeof(index_t)) : 0
+    };
+    struct sa_row_output_ out = { .f = collect_row, .data = &rows };
+    sa_is_mem_rows_(remapped_str, alphabet_size, &out);
+    if (sample_rows) *sample_rows = rows.sample_rows;
+    return rows.bwt_string;
+}
+
+struct bwt_table *build_complete_table_sampled(
     const uint8_t *string,
-    bool include_reverse
+    bool include_reverse,
+    uint32_t sa_sample_rate
 ) {
-    uint32_t n = (uint32_t)strlen((char *)string);
+    index_t n = (index_t)strlen((char *)string);
     uint8_t *remapped_str = malloc(sizeof(uint8_t) * (n + 1));
     struct remap_table  *remap_table = alloc_remap_table(string);
     remap(remapped_str, string, remap_table);
-
-    struct suffix_array *sa = sa_is_construction(remapped_str, remap_table->alphabet_size);
-
-    struct suffix_array *rsa = 0;
+    uint32_t alphabet_size = remap_table->alphabet_size;
+    uint32_t no_threads = (n >= BWT_PARALLEL_THRESHOLD) ? stralg_threads() : 1;
+    
+    struct bwt_table *table = malloc(sizeof(struct bwt_table));
+    table->remap_table = remap_table;
+    table->sa_samples = 0;
+    table->kmer_table = 0;
+    build_c_table(table, remapped_str, n + 1);
+    
+    // We only need the reverse string for its BWT, so we never
+    // have its suffix array, and we finish it before we start on
+    // the forward string, so we only sort one string at a time.
+    table->ro_table = 0;
     if (include_reverse) {
         uint8_t *rev_remapped_str = str_copy_n(remapped_str, n);
         str_inplace_rev_n(rev_remapped_str, n);
-        
-        // also here use the fastest algorithm here
-        rsa = sa_is_construction(rev_remapped_str, remap_table->alphabet_size);
+        uint8_t *bwt_string = bwt_from_sa_is(rev_remapped_str, n + 1,
+                                             alphabet_size, 0, 0);
+        free(rev_remapped_str);
+        table->ro_table = occ_table_from_bwt(bwt_string, n + 1,
+                                             alphabet_size, no_threads);
+        free(bwt_string);
     }
-    struct bwt_table *table = malloc(sizeof(struct bwt_table));
-    init_bwt_table(table, sa, rsa, remap_table);
     
-    // we do not use rsa after we have constructed the suffix
-    // array and we need to free it and the reversed string.
-    if (rsa) free_complete_suffix_array(rsa);
+    if (sa_sample_rate == 0) {
+        // We need the full suffix array for the forward string.
+        struct suffix_array *sa = sa_is_construction(remapped_str, alphabet_size);
+        table->sa = sa;
+        table->o_table = build_occ_table(sa, alphabet_size, no_threads);
+    } else {
+        index_t *sample_rows;
+        uint8_t *bwt_string = bwt_from_sa_is(remapped_str, n + 1, alphabet_size,
+                                             sa_sample_rate, &sample_rows);
+        table->sa = allocate_sa_without_array_(remapped_str);
+        table->sa_samples = samples_from_rows(n + 1, sa_sample_rate, sample_rows);
+        table->o_table = occ_table_from_bwt(bwt_string, n + 1,
+                                            alphabet_size, no_threads);
+        free(bwt_string);
+    }
     
     return table;
 }
 
+struct bwt_table *build_complete_table(
+    const uint8_t *string,
+    bool include_reverse
+) {
+    return build_complete_table_sampled(string, include_reverse, 0);
+}
 
-void init_bwt_exact_match_iter(
-    struct bwt_exact_match_iter *iter,
+struct bwt_table *build_self_index_table(
+    const uint8_t *string,
+    bool include_reverse,
+    uint32_t sa_sample_rate
+) {
+    assert(sa_sample_rate > 0);
+    struct bwt_table *table =
+        build_complete_table_sampled(string, include_reverse, sa_sample_rate);
+    // The suffix array only holds the length now.
+    free(table->sa->string);
+    table->sa->string = 0;
+    return table;
+}
+
+
+uint32_t max_bwt_kmer_length(
+    uint32_t alphabet_size
+) {
+    // b^k only grows if b > 1
+    uint64_t b = alphabet_size > 1 ? alphabet_size - 1 : 0;
+    if (b < 2) return BWT_MAX_KMER_LENGTH;
+    uint32_t k = 0;
+    uint64_t no_kmers = 1;
+    while (k < BWT_MAX_KMER_LENGTH && no_kmers * b <= BWT_MAX_KMERS) {
+        k++;
+        no_kmers *= b;
+    }
+    return k;
+}
+
+uint32_t default_bwt_kmer_length(
+    const struct bwt_table *bwt_table
+) {
+    uint32_t alphabet_size = bwt_table->remap_table->alphabet_size;
+    uint32_t b = alphabet_size - 1;
+    index_t n = bwt_table->o_table->length;
+    if (b < 2) return 0;
+    uint32_t max_k = max_bwt_kmer_length(alphabet_size);
+    uint32_t k = 0;
+    uint64_t no_kmers = b;
+    while (k < max_k && no_kmers <= n) {
+        k++;
+        no_kmers *= b;
+    }
+    return k;
+}
+
+bool set_bwt_kmer_powers_(
+    struct bwt_kmer_table *kmer_table,
+    uint32_t b
+) {
+    // This is max_bwt_kmer_length(), but we check as we go, so
+    // we do not trust b + 1 to be a sensible alphabet size. The
+    // powers stay below BWT_MAX_KMERS, so the products fit.
+    kmer_table->no_kmers = 0;
+    if (kmer_table->k > BWT_MAX_KMER_LENGTH) return false;
+    uint64_t power = 1;
+    kmer_table->powers[0] = 1;
+    for (uint32_t j = 1; j <= kmer_table->k; ++j) {
+        power *= b;
+        if (power > BWT_MAX_KMERS) return false;
+        kmer_table->powers[j] = (uint32_t)power;
+    }
+    kmer_table->no_kmers = kmer_table->powers[kmer_table->k];
+    return true;
+}
+
+static void rec_build_kmer_table(
+    const struct bwt_table *bwt_table,
+    struct bwt_kmer_table *kmer_table,
+    index_t L, index_t R,
+    uint32_t depth, uint32_t kmer
+) {
+    if (depth == kmer_table->k) {
+        kmer_table->intervals[kmer].L = L;
+        kmer_table->intervals[kmer].R = R;
+        return;
+    }
+    uint32_t alphabet_size = bwt_table->remap_table->alphabet_size;
+    for (uint8_t a = 1; a < alphabet_size; ++a) {
+        index_t new_L = C(a) + O(a, L);
+        index_t new_R = C(a) + O(a, R);
+        // the table is zero-initialised, so empty
+        // intervals are already there.
+        if (new_L >= new_R) continue;
+        rec_build_kmer_table(bwt_table, kmer_table, new_L, new_R, depth + 1,
+                             kmer + (a - 1) * kmer_table->powers[depth]);
+    }
+}
+
+void build_bwt_kmer_table(
     struct bwt_table *bwt_table,
-    const uint8_t *remapped_pattern
+    uint32_t k
+) {
+    if (bwt_table->kmer_table) free_kmer_table(bwt_table->kmer_table);
+    bwt_table->kmer_table = 0;
+    uint32_t max_k = max_bwt_kmer_length(bwt_table->remap_table->alphabet_size);
+    if (k > max_k) k = max_k;
+    if (k == 0) return;
+    
+    uint32_t b = bwt_table->remap_table->alphabet_size - 1;
+    struct bwt_kmer_table *kmer_table = malloc(sizeof(struct bwt_kmer_table));
+    kmer_table->k = k;
+    set_bwt_kmer_powers_(kmer_table, b);
+    kmer_table->intervals =
+        calloc(kmer_table->no_kmers, sizeof(*kmer_table->intervals));
+    rec_build_kmer_table(bwt_table, kmer_table, 0, bwt_table->o_table->length, 0, 0);
+    
+    bwt_table->kmer_table = kmer_table;
+}
+
+// The index of the last k symbols of a pattern of length m >= k.
+static inline uint32_t pattern_kmer(
+    const struct bwt_kmer_table *kmer_table,
+    const uint8_t *pattern,
+    uint32_t m
+) {
+    uint32_t kmer = 0;
+    for (uint32_t j = 0; j < kmer_table->k; ++j) {
+        kmer += (pattern[m - 1 - j] - 1) * kmer_table->powers[j];
+    }
+    return kmer;
+}
+
+// The interval of an exact search. We only need the rank
+// structure for the search; the suffix array is only used
+// when we report matches.
+static void exact_interval(
+    const struct bwt_table *bwt_table,
+    const uint8_t *remapped_pattern,
+    index_t *L_out, index_t *R_out
 ) {
-    const struct suffix_array *sa = iter->sa = bwt_table->sa;
-    //FIXME uint32_t alphabet_size = bwt_table->remap_table->alphabet_size;
-    uint32_t n = sa->length;
+    index_t n = bwt_table->o_table->length;
     uint32_t m = (uint32_t)strlen((char *)remapped_pattern);
     
-    uint32_t L = 0;
-    uint32_t R = n;
+    index_t L = 0;
+    index_t R = n;
 
     // if the pattern is longer than the string then
     // there won't be a match
@@ -181,9 +610,20 @@ void init_bwt_exact_match_iter(
     }
     // We need i to be signed, so we use int64_t.
     // This gives us a signed integer that can
-    // easily index all of uint32_t
+    // easily index all of index_t
     int64_t i = m - 1;
     
+    // If we have the interval of the last k symbols, we
+    // can skip the first k steps.
+    const struct bwt_kmer_table *kmer_table = bwt_table->kmer_table;
+    if (kmer_table && m >= kmer_table->k && m <= n) {
+        struct bwt_interval interval =
+            kmer_table->intervals[pattern_kmer(kmer_table, remapped_pattern, m)];
+        L = interval.L;
+        R = interval.R;
+        i = (int64_t)m - 1 - kmer_table->k;
+    }
+    
     while (i >= 0 && L < R) {
         uint8_t a = remapped_pattern[i];
         assert(a > 0); // only the sentinel is null
@@ -193,9 +633,27 @@ void init_bwt_exact_match_iter(
         R = C(a) + O(a, R);
         i--;
     }
-    iter->L = L;
-    iter->R = R;
-    iter->i = L;
+    *L_out = L;
+    *R_out = R;
+}
+
+void init_bwt_exact_match_iter(
+    struct bwt_exact_match_iter *iter,
+    struct bwt_table *bwt_table,
+    const uint8_t *remapped_pattern
+) {
+    iter->bwt_table = bwt_table;
+    exact_interval(bwt_table, remapped_pattern, &iter->L, &iter->R);
+    iter->i = iter->L;
+}
+
+index_t bwt_exact_count(
+    const struct bwt_table *bwt_table,
+    const uint8_t *remapped_pattern
+) {
+    index_t L, R;
+    exact_interval(bwt_table, remapped_pattern, &L, &R);
+    return (L < R) ? R - L : 0;
 }
 
 bool next_bwt_exact_match_iter(
@@ -210,7 +668,7 @@ bool next_bwt_exact_match_iter(
     // we still have a match.
     // report it and update the position
     // to the next match (if any)
-    match->pos = iter->sa->array[iter->i];
+    match->pos = bwt_locate(iter->bwt_table, (index_t)iter->i);
     iter->i++;
     
     return true;
@@ -222,203 +680,871 @@ void dealloc_bwt_exact_match_iter(
     // nothing to free
 }
 
+// How many patterns we keep in flight in the batched search.
+// It should be large enough that we have time for the
+// prefetches to complete before we get back to a pattern.
+#define BATCH_SIZE 16
 
-static void rec_approx_matching(
-    struct bwt_approx_iter *iter,
-    uint32_t L, uint32_t R, int i,
-    uint32_t match_length,
-    int edits_left,
-    char *edits
+struct batch_slot {
+    uint32_t pattern; // index of the pattern in the slot
+    index_t L, R;
+    int64_t i;
+};
+
+static void prefetch_step(
+    const struct bwt_table *bwt_table,
+    const uint8_t *pattern,
+    const struct batch_slot *slot
 ) {
-    //FIXME uint32_t alphabet_size = iter->bwt_table->remap_table->alphabet_size;
-    struct bwt_table *bwt_table = iter->bwt_table;
-    struct remap_table *remap_table = bwt_table->remap_table;
-    
-    int lower_limit = (i >= 0 && iter->D_table) ? iter->D_table[i] : 0;
-    if (edits_left  < lower_limit) {
-         return; // we can never get a match from here
+    if (slot->i < 0 || slot->L >= slot->R) return;
+    uint8_t a = pattern[slot->i];
+    occ_prefetch(bwt_table->o_table, a, slot->L);
+    occ_prefetch(bwt_table->o_table, a, slot->R);
+}
+
+static void start_search(
+    const struct bwt_table *bwt_table,
+    const uint8_t **remapped_patterns,
+    uint32_t pattern,
+    struct batch_slot *slot
+) {
+    index_t n = bwt_table->o_table->length;
+    uint32_t m = (uint32_t)strlen((char *)remapped_patterns[pattern]);
+    slot->pattern = pattern;
+    slot->L = 0;
+    slot->R = n;
+    slot->i = (int64_t)m - 1;
+    // if the pattern is longer than the string then
+    // there won't be a match
+    if (m > n) {
+        slot->R = 0; slot->L = 1;
+    }
+    const struct bwt_kmer_table *kmer_table = bwt_table->kmer_table;
+    if (kmer_table && m >= kmer_table->k && m <= n) {
+        struct bwt_interval interval =
+            kmer_table->intervals[pattern_kmer(kmer_table, remapped_patterns[pattern], m)];
+        slot->L = interval.L;
+        slot->R = interval.R;
+        slot->i = (int64_t)m - 1 - kmer_table->k;
     }
+    prefetch_step(bwt_table, remapped_patterns[pattern], slot);
+}
 
-    assert(L < R);
+// The batched search; it reports either the intervals
+// or their sizes, whichever output is not null.
+static void exact_batch(
+    const struct bwt_table *bwt_table,
+    const uint8_t **remapped_patterns,
+    uint32_t no_patterns,
+    struct bwt_interval *intervals,
+    index_t *counts
+) {
+    struct batch_slot slots[BATCH_SIZE];
+    uint32_t no_slots = 0;
+    uint32_t next_pattern = 0;
+    while (no_slots < BATCH_SIZE && next_pattern < no_patterns) {
+        start_search(bwt_table, remapped_patterns, next_pattern++, &slots[no_slots++]);
+    }
     
-    if (i < 0) { // We have a match
-        index_vector_append(&iter->Ls, L);
-        index_vector_append(&iter->Rs, R);
-        index_vector_append(&iter->match_lengths, match_length);
+    // We take one step in each slot in turn. When a search
+    // is done, we put its interval in the output and the next
+    // pattern in the slot.
+    while (no_slots > 0) {
+        for (uint32_t s = 0; s < no_slots; ) {
+            struct batch_slot *slot = &slots[s];
+            const uint8_t *pattern = remapped_patterns[slot->pattern];
+            
+            if (slot->i < 0 || slot->L >= slot->R) {
+                if (intervals) {
+                    intervals[slot->pattern].L = slot->L;
+                    intervals[slot->pattern].R = slot->R;
+                }
+                if (counts) {
+                    counts[slot->pattern] =
+                        (slot->L < slot->R) ? slot->R - slot->L : 0;
+                }
+                if (next_pattern < no_patterns) {
+                    start_search(bwt_table, remapped_patterns, next_pattern++, slot);
+                    s++;
+                } else {
+                    // move the last slot here and look at it next
+                    *slot = slots[--no_slots];
+                }
+                continue;
+            }
+            
+            uint8_t a = pattern[slot->i];
+            assert(a > 0); // only the sentinel is null
+            assert(a < bwt_table->remap_table->alphabet_size);
+            slot->L = C(a) + O(a, slot->L);
+            slot->R = C(a) + O(a, slot->R);
+            slot->i--;
+            prefetch_step(bwt_table, pattern, slot);
+            s++;
+        }
+    }
+}
 
-        // Extract the edits and reverse them.
-        *edits = '\0';
-        char *rev_edits = (char *)str_copy((uint8_t *)iter->edits_buf);
-        str_inplace_rev((uint8_t*)rev_edits);
-        // Build the cigar from the edits
-        char *cigar = malloc(2 * iter->m);
-        edits_to_cigar(cigar, rev_edits);
-        // Free the reversed edits; we do not need them now
-        free(rev_edits);
-        
-        string_vector_append(&iter->cigars, (uint8_t *)cigar);
-        
-        return; // done down this path of matching...
+void bwt_exact_search_batch(
+    const struct bwt_table *bwt_table,
+    const uint8_t **remapped_patterns,
+    uint32_t no_patterns,
+    struct bwt_interval *intervals
+) {
+    exact_batch(bwt_table, remapped_patterns, no_patterns, intervals, 0);
+}
+
+void bwt_exact_count_batch(
+    const struct bwt_table *bwt_table,
+    const uint8_t **remapped_patterns,
+    uint32_t no_patterns,
+    index_t *counts
+) {
+    exact_batch(bwt_table, remapped_patterns, no_patterns, 0, counts);
+}
+
+
+void init_bwt_approx_workspace(
+    struct bwt_approx_workspace *workspace
+) {
+    memset(workspace, 0, sizeof(*workspace));
+}
+
+void dealloc_bwt_approx_workspace(
+    struct bwt_approx_workspace *workspace
+) {
+    free(workspace->frames);
+    free(workspace->path);
+    free(workspace->hits);
+    free(workspace->scripts);
+    free(workspace->cigars);
+    free(workspace->D_table);
+    free(workspace->part_of);
+    free(workspace->candidates);
+    free(workspace->band);
+    free(workspace->window);
+    free(workspace->kept_hits);
+    free(workspace->open_hits);
+}
+
+// Edit scripts are packed, 32 operations to a word.
+static inline void append_script_op(
+    struct bwt_approx_workspace *ws,
+    uint8_t op
+) {
+    uint32_t pos = ws->no_script_ops++;
+    ws->scripts = bwt_grow_(ws->scripts, &ws->scripts_size,
+                            pos / 32 + 1, sizeof(*ws->scripts));
+    uint64_t *word = ws->scripts + pos / 32;
+    if (pos % 32 == 0) *word = 0;
+    *word |= (uint64_t)op << (2 * (pos % 32));
+}
+
+static inline uint8_t script_op(
+    const struct bwt_approx_workspace *ws,
+    uint32_t pos
+) {
+    return (ws->scripts[pos / 32] >> (2 * (pos % 32))) & 3;
+}
+
+static void add_hit(
+    struct bwt_approx_workspace *ws,
+    index_t L, index_t R,
+    uint32_t match_length, uint32_t edits,
+    uint32_t script_start
+) {
+    ws->hits = bwt_grow_(ws->hits, &ws->hits_size,
+                         ws->no_hits + 1, sizeof(*ws->hits));
+    struct bwt_approx_hit_ *hit = ws->hits + ws->no_hits++;
+    hit->L = L;
+    hit->R = R;
+    hit->match_length = match_length;
+    hit->edits = edits;
+    hit->script_start = script_start;
+    hit->script_length = ws->no_script_ops - script_start;
+}
+
+void append_approx_match_(
+    struct bwt_approx_iter *iter,
+    index_t L, index_t R,
+    uint32_t match_length, uint32_t edits,
+    const uint8_t *ops, uint32_t no_ops
+) {
+    struct bwt_approx_workspace *ws = iter->workspace;
+    uint32_t script_start = ws->no_script_ops;
+    for (uint32_t j = 0; !iter->count_only && j < no_ops; ++j) {
+        append_script_op(ws, ops[j]);
     }
+    add_hit(ws, L, R, match_length, edits, script_start);
+}
 
-    uint32_t new_L;
-    uint32_t new_R;
+// Make room for the cigars of all the hits, so a cigar stays
+// where it is while the iterator builds the others. A run of
+// length r takes at most r + 1 <= 2r characters.
+static void reserve_cigars(
+    struct bwt_approx_workspace *ws
+) {
+    uint32_t total = 0;
+    for (uint32_t i = 0; i < ws->no_hits; ++i) {
+        ws->hits[i].cigar_start = total;
+        total += 2 * ws->hits[i].script_length + 1;
+    }
+    ws->cigars = bwt_grow_(ws->cigars, &ws->cigars_size,
+                           total, sizeof(*ws->cigars));
+}
+
+// Write the cigar for a hit into its place in the
+// workspace's cigar buffer.
+static void build_cigar(
+    struct bwt_approx_workspace *ws,
+    const struct bwt_approx_hit_ *hit
+) {
+    static const char op_symbols[] = { 'M', 'I', 'D' };
+    char *cigar = ws->cigars + hit->cigar_start;
+    uint32_t end = hit->script_start + hit->script_length;
+    uint32_t pos = hit->script_start;
+    while (pos < end) {
+        uint8_t op = script_op(ws, pos);
+        uint32_t run_end = pos + 1;
+        while (run_end < end && script_op(ws, run_end) == op)
+            run_end++;
+        cigar += sprintf(cigar, "%d%c", (int)(run_end - pos), op_symbols[op]);
+        pos = run_end;
+    }
+    *cigar = '\0';
+}
+
+// While we have matched fewer than k symbols in the text, and we have
+// a k-mer table, we do not compute intervals. We only keep track of
+// the index of the k-mer we are building, and when it is complete
+// we look up its interval. This function extends the interval, or
+// the k-mer, with a and returns false if we know the result is empty.
+static inline bool extend_interval(
+    const struct bwt_approx_iter *iter,
+    index_t L, index_t R,
+    uint32_t match_length, uint32_t kmer,
+    uint8_t a,
+    index_t *new_L, index_t *new_R, uint32_t *new_kmer
+) {
+    const struct bwt_table *bwt_table = iter->bwt_table;
+    const struct bwt_kmer_table *kmer_table = bwt_table->kmer_table;
+    *new_kmer = kmer;
+    if (kmer_table && match_length < kmer_table->k) {
+        *new_kmer = kmer + (a - 1) * kmer_table->powers[match_length];
+        *new_L = L; *new_R = R;
+        if (match_length + 1 < kmer_table->k) return true;
+        struct bwt_interval interval = kmer_table->intervals[*new_kmer];
+        *new_L = interval.L;
+        *new_R = interval.R;
+    } else {
+        *new_L = C(a) + O(a, L);
+        *new_R = C(a) + O(a, R);
+    }
+    return *new_L < *new_R;
+}
+
+// If we get to the end of the pattern before we have matched k
+// symbols, we need the interval for the symbols in the k-mer index.
+static bool short_kmer_interval(
+    const struct bwt_approx_iter *iter,
+    uint32_t match_length, uint32_t kmer,
+    index_t *L, index_t *R
+) {
+    const struct bwt_table *bwt_table = iter->bwt_table;
+    const struct bwt_kmer_table *kmer_table = bwt_table->kmer_table;
+    uint32_t b = bwt_table->remap_table->alphabet_size - 1;
+    *L = 0; *R = bwt_table->o_table->length;
+    for (uint32_t j = 0; j < match_length && *L < *R; ++j) {
+        uint8_t a = 1 + (kmer / kmer_table->powers[j]) % b;
+        *L = C(a) + O(a, *L);
+        *R = C(a) + O(a, *R);
+    }
+    return *L < *R;
+}
+
+static inline void push_frame(
+    struct bwt_approx_workspace *ws,
+    uint32_t *top,
+    const struct bwt_approx_frame_ *parent,
+    index_t L, index_t R, uint32_t kmer,
+    int32_t i, uint32_t match_length,
+    int32_t edits_left, uint8_t op
+) {
+    struct bwt_approx_frame_ *frame = ws->frames + (*top)++;
+    frame->L = L;
+    frame->R = R;
+    frame->kmer = kmer;
+    frame->i = i;
+    frame->match_length = match_length;
+    frame->edits_left = edits_left;
+    frame->depth = parent->depth + 1;
+    frame->op = op;
+}
+
+// Push the nodes we can reach from frame with one operation. They
+// go on the stack in reverse order, so we pop them in the order
+// M (by symbol), I, D (by symbol), which is the order a recursive
+// search would explore them in.
+static void push_children(
+    struct bwt_approx_iter *iter,
+    const struct bwt_approx_frame_ *frame,
+    uint32_t *top,
+    bool allow_deletions
+) {
+    struct bwt_approx_workspace *ws = iter->workspace;
+    uint32_t alphabet_size = iter->bwt_table->remap_table->alphabet_size;
+    ws->frames = bwt_grow_(ws->frames, &ws->frames_size,
+                           *top + 2 * alphabet_size, sizeof(*ws->frames));
+
+    // We compute each extension once and use it for both
+    // the M- and the D-operation.
+    index_t new_L[alphabet_size], new_R[alphabet_size];
+    uint32_t new_kmer[alphabet_size];
+    bool non_empty[alphabet_size];
+    uint8_t match_a = iter->remapped_pattern[frame->i];
+    bool indels = !iter->hamming && frame->edits_left > 0;
+    bool deletions = allow_deletions && indels;
+    const struct bwt_kmer_table *kmer_table = iter->bwt_table->kmer_table;
+    bool kmer_phase = kmer_table && frame->match_length < kmer_table->k;
+    if (!kmer_phase && (deletions || frame->edits_left > 0)) {
+        // We try all symbols, so we only need the ones in
+        // the interval, and the O table can find those for
+        // us with fewer rank queries.
+        const struct bwt_table *bwt_table = iter->bwt_table;
+        uint8_t symbols[alphabet_size];
+        index_t ranks_L[alphabet_size], ranks_R[alphabet_size];
+        uint32_t no_symbols = occ_interval_symbols(bwt_table->o_table,
+                                                   frame->L, frame->R,
+                                                   symbols, ranks_L, ranks_R);
+        memset(non_empty, 0, sizeof(non_empty));
+        for (uint32_t k = 0; k < no_symbols; ++k) {
+            uint8_t a = symbols[k];
+            if (a == 0) continue; // the sentinel
+            non_empty[a] = true;
+            new_L[a] = C(a) + ranks_L[k];
+            new_R[a] = C(a) + ranks_R[k];
+            new_kmer[a] = frame->kmer;
+        }
+    } else {
+        // Iterating alphabet from 1 so I don't include the sentinel.
+        for (uint8_t a = 1; a < alphabet_size; ++a) {
+            int edit_cost = (a == match_a) ? 0 : 1;
+            non_empty[a] = false;
+            if (!deletions && frame->edits_left - edit_cost < 0) continue;
+            non_empty[a] = extend_interval(iter, frame->L, frame->R,
+                                           frame->match_length, frame->kmer, a,
+                                           &new_L[a], &new_R[a], &new_kmer[a]);
+        }
+    }
+
+    // D-operations
+    if (deletions) {
+        for (uint8_t a = alphabet_size - 1; a > 0; --a) {
+            if (!non_empty[a]) continue;
+            push_frame(ws, top, frame, new_L[a], new_R[a], new_kmer[a],
+                       frame->i, frame->match_length + 1,
+                       frame->edits_left - 1, BWT_EDIT_D_);
+        }
+    }
+
+    // I-operation
+    if (indels) {
+        push_frame(ws, top, frame, frame->L, frame->R, frame->kmer,
+                   frame->i - 1, frame->match_length,
+                   frame->edits_left - 1, BWT_EDIT_I_);
+    }
 
     // M-operations
-    unsigned char match_a = iter->remapped_pattern[i];
-    // Iterating alphabet from 1 so I don't include the sentinel.
-    for (unsigned char a = 1; a < remap_table->alphabet_size; ++a) {
-        
-        new_L = C(a) + O(a, L);
-        new_R = C(a) + O(a, R);
-                
+    for (uint8_t a = alphabet_size - 1; a > 0; --a) {
         int edit_cost = (a == match_a) ? 0 : 1;
-        if (edits_left - edit_cost < 0) continue;
-        if (new_L >= new_R) continue;
-        
-        *edits = 'M';
-        rec_approx_matching(iter, new_L, new_R, i - 1,
-                            match_length + 1, edits_left - edit_cost,
-                            edits + 1);
+        if (frame->edits_left - edit_cost < 0) continue;
+        if (!non_empty[a]) continue;
+        push_frame(ws, top, frame, new_L[a], new_R[a], new_kmer[a],
+                   frame->i - 1, frame->match_length + 1,
+                   frame->edits_left - edit_cost, BWT_EDIT_M_);
     }
-    
-    // I-operation
-    *edits = 'I';
-    rec_approx_matching(iter, L, R, i - 1, match_length, edits_left - 1, edits + 1);
-    
-    // D-operation
-    *edits = 'D';
-    for (unsigned char a = 1; a < remap_table->alphabet_size; ++a) {
-        new_L = C(a) + O(a, L);
-        new_R = C(a) + O(a, R);
-        if (new_L >= new_R) continue;
-        
-        rec_approx_matching(iter, new_L, new_R, i, match_length + 1,
-                            edits_left - 1, edits + 1);
+}
+
+static int *build_D_table(
+    struct bwt_approx_iter *iter
+) {
+    struct bwt_table *bwt_table = iter->bwt_table;
+    if (!bwt_table->ro_table) return 0;
+
+    struct bwt_approx_workspace *ws = iter->workspace;
+    const uint8_t *remapped_pattern = iter->remapped_pattern;
+    uint32_t m = iter->m;
+    ws->D_table = bwt_grow_(ws->D_table, &ws->D_table_size,
+                            m, sizeof(*ws->D_table));
+
+    int min_edits = 0;
+    index_t n = bwt_table->ro_table->length;
+    index_t L = 0, R = n;
+    for (uint32_t i = 0; i < m; ++i) {
+        uint8_t a = remapped_pattern[i];
+        L = C(a) + RO(a, L);
+        R = C(a) + RO(a, R);
+        if (L >= R) {
+            min_edits++;
+            L = 0;
+            R = n;
+        }
+        ws->D_table[i] = min_edits;
     }
+    return ws->D_table;
 }
 
+// With only mismatches, pattern[0,i] matches a string of length
+// i + 1, but it still needs a mismatch in every substring that does
+// not occur in the text, so the greedy count in build_D_table() is
+// a bound here as well. We get a second bound by splitting the
+// pattern greedily from the right, with the forward O table, and
+// counting the pieces that lie within pattern[0,i]. Neither split
+// dominates the other, so we use the larger of the two counts.
+static int *build_hamming_table(
+    struct bwt_approx_iter *iter
+) {
+    struct bwt_table *bwt_table = iter->bwt_table;
+    struct bwt_approx_workspace *ws = iter->workspace;
+    const uint8_t *remapped_pattern = iter->remapped_pattern;
+    uint32_t m = iter->m;
+    ws->D_table = bwt_grow_(ws->D_table, &ws->D_table_size,
+                            m, sizeof(*ws->D_table));
+    int *table = ws->D_table;
 
-void init_bwt_approx_iter(
+    // Mark the last index of each piece, then count the
+    // pieces that end at or before each index.
+    for (uint32_t i = 0; i < m; ++i) table[i] = 0;
+    index_t n = bwt_table->o_table->length;
+    index_t L = 0, R = n;
+    uint32_t end = m - 1;
+    for (uint32_t i = m; i > 0; --i) {
+        uint8_t a = remapped_pattern[i - 1];
+        L = C(a) + O(a, L);
+        R = C(a) + O(a, R);
+        if (L >= R) {
+            table[end]++;
+            end = i - 2; // wraps at i = 1, but then we are done
+            L = 0;
+            R = n;
+        }
+    }
+    for (uint32_t i = 1; i < m; ++i) table[i] += table[i - 1];
+
+    if (!bwt_table->ro_table) return table;
+
+    int min_edits = 0;
+    L = 0; R = n;
+    for (uint32_t i = 0; i < m; ++i) {
+        uint8_t a = remapped_pattern[i];
+        L = C(a) + RO(a, L);
+        R = C(a) + RO(a, R);
+        if (L >= R) {
+            min_edits++;
+            L = 0;
+            R = n;
+        }
+        if (table[i] < min_edits) table[i] = min_edits;
+    }
+    return table;
+}
+
+// Depth-first search through all ways of placing edits, matching
+// the pattern from right to left. We keep the nodes we still have
+// to explore on an explicit stack in the workspace, and the
+// operations on the path to the current node in the path buffer.
+static void backtrack_approx_search(
     struct bwt_approx_iter *iter,
-    struct bwt_table       *bwt_table,
-    const uint8_t          *remapped_pattern,
     int                     max_edits)
 {
-    //uint32_t alphabet_size = bwt_table->remap_table->alphabet_size;
-    
-    // Initialise resources for the recursive search
-    iter->bwt_table = bwt_table;
-    iter->remapped_pattern = remapped_pattern;
-    init_index_vector(&iter->Ls, 10);
-    init_index_vector(&iter->Rs, 10);
-    init_string_vector(&iter->cigars, 10);
-    init_index_vector(&iter->match_lengths, 10);
-    
-    if (bwt_table->ro_table) {
-        // Build D table
-        uint32_t m = (uint32_t)strlen((char *)remapped_pattern);
-        iter->D_table = malloc(m * sizeof(int));
-        
-        int min_edits = 0;
-        uint32_t L = 0, R = bwt_table->sa->length;
-        for (uint32_t i = 0; i < m; ++i) {
-            uint8_t a = remapped_pattern[i];
-            L = C(a) + RO(a, L);
-            R = C(a) + RO(a, R);
-            if (L >= R) {
-                min_edits++;
-                L = 0;
-                R = bwt_table->sa->length;
+    struct bwt_table *bwt_table = iter->bwt_table;
+    struct bwt_approx_workspace *ws = iter->workspace;
+    const struct bwt_kmer_table *kmer_table = bwt_table->kmer_table;
+    uint32_t m = iter->m;
+
+    const int *D_table = iter->hamming ?
+        build_hamming_table(iter) : build_D_table(iter);
+
+    // A path has an M or I for each pattern symbol
+    // and a D for at most each edit.
+    ws->path = bwt_grow_(ws->path, &ws->path_size,
+                         m + (uint32_t)max_edits + 1, sizeof(*ws->path));
+
+    // We never start with a deletion
+    struct bwt_approx_frame_ root = {
+        .L = 0, .R = bwt_table->o_table->length,
+        .match_length = 0, .kmer = 0,
+        .i = (int32_t)m - 1, .edits_left = max_edits,
+        .depth = 0
+    };
+    uint32_t top = 0;
+    push_children(iter, &root, &top, false);
+
+    while (top > 0) {
+        struct bwt_approx_frame_ frame = ws->frames[--top];
+        ws->path[frame.depth - 1] = frame.op;
+
+        int lower_limit = (frame.i >= 0 && D_table) ? D_table[frame.i] : 0;
+        if (frame.edits_left < lower_limit)
+            continue; // we can never get a match from here
+
+        if (frame.i < 0) { // We have a match
+            bool before_kmer = kmer_table && frame.match_length < kmer_table->k;
+            index_t L = frame.L, R = frame.R;
+            if (before_kmer &&
+                !short_kmer_interval(iter, frame.match_length, frame.kmer, &L, &R))
+                continue; // ...we didn't after all
+
+            // The path has the edits in reverse order
+            uint32_t script_start = ws->no_script_ops;
+            for (uint32_t d = frame.depth; !iter->count_only && d > 0; --d) {
+                append_script_op(ws, ws->path[d - 1]);
             }
-            iter->D_table[i] = min_edits;
+            add_hit(ws, L, R, frame.match_length,
+                    (uint32_t)(max_edits - frame.edits_left), script_start);
+            continue;
         }
+
+        push_children(iter, &frame, &top, true);
+    }
+}
+
+// Sort by interval, with an interval before the intervals nested
+// in it, and then by match length and edits.
+static int compare_hits(const void *a, const void *b)
+{
+    const struct bwt_approx_hit_ *x = a, *y = b;
+    if (x->L != y->L) return (x->L < y->L) ? -1 : 1;
+    if (x->R != y->R) return (x->R > y->R) ? -1 : 1;
+    if (x->match_length != y->match_length)
+        return (x->match_length < y->match_length) ? -1 : 1;
+    if (x->edits != y->edits) return (x->edits < y->edits) ? -1 : 1;
+    return (x->script_start < y->script_start) ? -1 : 1;
+}
+
+static int compare_scripts(
+    const struct bwt_approx_workspace *ws,
+    const struct bwt_approx_hit_ *x,
+    const struct bwt_approx_hit_ *y
+) {
+    uint32_t n = (x->script_length < y->script_length) ?
+        x->script_length : y->script_length;
+    for (uint32_t j = 0; j < n; ++j) {
+        uint8_t x_op = script_op(ws, x->script_start + j);
+        uint8_t y_op = script_op(ws, y->script_start + j);
+        if (x_op != y_op) return (x_op < y_op) ? -1 : 1;
+    }
+    if (x->script_length == y->script_length) return 0;
+    return (x->script_length < y->script_length) ? -1 : 1;
+}
+
+// Is x a better match than y: fewer edits, then shorter, then the
+// first script. This is what picks a single match when we filter.
+static bool better_hit(
+    const struct bwt_approx_workspace *ws,
+    const struct bwt_approx_hit_ *x,
+    const struct bwt_approx_hit_ *y
+) {
+    if (x->edits != y->edits) return x->edits < y->edits;
+    if (x->match_length != y->match_length)
+        return x->match_length < y->match_length;
+    return compare_scripts(ws, x, y) < 0;
+}
+
+static void keep_hit(
+    struct bwt_approx_workspace *ws,
+    uint32_t *no_kept,
+    const struct bwt_approx_hit_ *hit,
+    index_t L, index_t R
+) {
+    if (L >= R) return;
+    ws->kept_hits = bwt_grow_(ws->kept_hits, &ws->kept_hits_size,
+                              *no_kept + 1, sizeof(*ws->kept_hits));
+    struct bwt_approx_hit_ *kept = ws->kept_hits + (*no_kept)++;
+    *kept = *hit;
+    kept->L = L;
+    kept->R = R;
+}
+
+// The kept hits become the hits.
+static void use_kept_hits(
+    struct bwt_approx_workspace *ws,
+    uint32_t no_kept
+) {
+    struct bwt_approx_hit_ *tmp_hits = ws->hits;
+    uint32_t tmp_size = ws->hits_size;
+    ws->hits = ws->kept_hits;
+    ws->hits_size = ws->kept_hits_size;
+    ws->kept_hits = tmp_hits;
+    ws->kept_hits_size = tmp_size;
+    ws->no_hits = no_kept;
+}
+
+// The hits are suffix array intervals, or, from the seed-and-extend
+// search, text positions that we treat as intervals of length one.
+// Two intervals are either disjoint or nested, and a row is in a
+// chain of nested intervals. We sweep through the sorted hits with
+// a stack of the intervals that contain the current one; a hit is
+// only kept if it is better than the innermost of those, and then
+// it takes its rows from it, so every row gets the best hit of its
+// chain. Only the rows that survive are ever given to bwt_locate.
+static void filter_hits(
+    struct bwt_approx_workspace *ws,
+    enum bwt_approx_filter filter
+) {
+    if (ws->no_hits == 0) return; // and hits might be null
+    struct bwt_approx_hit_ *hits = ws->hits;
+    qsort(hits, ws->no_hits, sizeof(*hits), compare_hits);
+
+    // Hits for the same interval are next to each other, and for the
+    // same interval and match length, the one with fewest edits
+    // comes first; we might still need to break ties on the script.
+    bool per_position = filter == BWT_BEST_PER_POSITION;
+    uint32_t no_best = 0;
+    for (uint32_t i = 0; i < ws->no_hits; ++i) {
+        struct bwt_approx_hit_ *last = hits + no_best - 1;
+        bool same = no_best > 0 && last->L == hits[i].L && last->R == hits[i].R &&
+            (per_position || last->match_length == hits[i].match_length);
+        if (!same) {
+            hits[no_best++] = hits[i];
+        } else if (better_hit(ws, &hits[i], last)) {
+            *last = hits[i];
+        }
+    }
+    ws->no_hits = no_best;
+    if (!per_position) return;
+
+    // The stack entries have their L moved past the rows
+    // that nested hits have taken.
+    uint32_t no_open = 0, no_kept = 0;
+    ws->open_hits = bwt_grow_(ws->open_hits, &ws->open_hits_size,
+                              no_best, sizeof(*ws->open_hits));
+    for (uint32_t i = 0; i <= no_best; ++i) {
+        while (no_open > 0 &&
+               (i == no_best || ws->open_hits[no_open - 1].R <= hits[i].L)) {
+            const struct bwt_approx_hit_ *open = &ws->open_hits[--no_open];
+            keep_hit(ws, &no_kept, open, open->L, open->R);
+        }
+        if (i == no_best) break;
+
+        const struct bwt_approx_hit_ *hit = &hits[i];
+        if (no_open > 0) {
+            struct bwt_approx_hit_ *outer = &ws->open_hits[no_open - 1];
+            if (!better_hit(ws, hit, outer)) continue; // dominated
+            keep_hit(ws, &no_kept, outer, outer->L, hit->L);
+            outer->L = hit->R;
+        }
+        ws->open_hits[no_open++] = *hit;
+    }
+
+    use_kept_hits(ws, no_kept);
+}
+
+// Does a match at position run past the end of its sequence? Its
+// sequence is the last one that starts at or before the position;
+// looking for the last skips the empty sequences.
+static bool spans_seqs(
+    const struct bwt_approx_params *params,
+    index_t position,
+    uint32_t match_length
+) {
+    const index_t *starts = params->seq_starts;
+    uint32_t low = 0, high = params->no_seqs;
+    while (high - low > 1) {
+        uint32_t mid = low + (high - low) / 2;
+        if (starts[mid] <= position) {
+            low = mid;
+        } else {
+            high = mid;
+        }
+    }
+    return position + match_length > starts[low + 1];
+}
+
+// Replace the hits by one hit per text position, leaving out those
+// that span two sequences. After this, the hits are text positions.
+static void drop_spanning_hits(
+    struct bwt_approx_iter *iter,
+    const struct bwt_approx_params *params
+) {
+    struct bwt_approx_workspace *ws = iter->workspace;
+    uint32_t no_kept = 0;
+    for (uint32_t i = 0; i < ws->no_hits; ++i) {
+        const struct bwt_approx_hit_ *hit = &ws->hits[i];
+        for (index_t row = hit->L; row < hit->R; ++row) {
+            index_t position = iter->text_positions ?
+                row : bwt_locate(iter->bwt_table, row);
+            if (!spans_seqs(params, position, hit->match_length))
+                keep_hit(ws, &no_kept, hit, position, position + 1);
+        }
+    }
+    use_kept_hits(ws, no_kept);
+    iter->text_positions = true;
+}
+
+// The iterator and the counting share this. When we only count,
+// the hits get no edit scripts and we make no room for cigars;
+// the filters only use the scripts to break ties between hits
+// of the same size, so that doesn't change the count.
+static void init_approx_search(
+    struct bwt_approx_iter         *iter,
+    struct bwt_table               *bwt_table,
+    const uint8_t                  *remapped_pattern,
+    int                             max_edits,
+    const struct bwt_approx_params *params,
+    bool                            count_only
+) {
+    // Initialise resources for the search
+    iter->bwt_table = bwt_table;
+    iter->remapped_pattern = remapped_pattern;
+    if (params->workspace) {
+        iter->workspace = params->workspace;
     } else {
-        iter->D_table = 0;
+        init_bwt_approx_workspace(&iter->own_workspace);
+        iter->workspace = &iter->own_workspace;
     }
+    iter->workspace->no_hits = 0;
+    iter->workspace->no_script_ops = 0;
     
-    // Set up the edits buffer
     assert(remapped_pattern);
     uint32_t m = (uint32_t)strlen((char *)remapped_pattern);
     assert(m > 0);
-    uint32_t buf_size = 2 * m + 1;
     iter->m = m;
-    iter->edits_buf = malloc(buf_size + 1);
-    iter->edits_buf[0] = '\0';
-    
-    // Start searching
-    uint32_t L = 0, R = bwt_table->sa->length; int i = m - 1;
+    iter->hamming = params->distance == BWT_HAMMING_DISTANCE;
+    iter->count_only = count_only;
     
-    struct remap_table *remap_table = bwt_table->remap_table;
-    char *edits = iter->edits_buf;
-    
-    // M-operations
-    unsigned char match_a = remapped_pattern[i];
-    // Iterating alphabet from 1 so I don't include the sentinel.
-    for (unsigned char a = 1; a < remap_table->alphabet_size; ++a) {
-        
-        uint32_t new_L = C(a) + O(a, L);
-        uint32_t new_R = C(a) + O(a, R);
-        
-        int edit_cost = (a == match_a) ? 0 : 1;
-        if (max_edits - edit_cost < 0) continue;
-        if (new_L >= new_R) continue;
-
-        *edits = 'M';
-        rec_approx_matching(iter, new_L, new_R, i - 1,
-                            1, max_edits - edit_cost,
-                            edits + 1);
-        
+    bool splits = m > (uint32_t)max_edits;
+    bool bidirectional = params->algorithm == BWT_BIDIRECTIONAL &&
+        bwt_table->ro_table && splits;
+    // Seed-and-extend needs the text, or samples to extract it with.
+    bool seed_extend = params->algorithm == BWT_SEED_EXTEND &&
+        bwt_table->sa && (bwt_table->sa->string || bwt_table->sa_samples) &&
+        splits;
+    iter->text_positions = seed_extend;
+    if (bidirectional) {
+        bidirectional_approx_search_(iter, max_edits);
+    } else if (seed_extend) {
+        seed_extend_approx_search_(iter, max_edits);
+    } else {
+        backtrack_approx_search(iter, max_edits);
     }
-    
-
-    // I-operation
-    *edits = 'I';
-    rec_approx_matching(iter, L, R, i - 1, 0, max_edits - 1, edits + 1);
+    if (params->seq_starts) {
+        drop_spanning_hits(iter, params);
+    }
+    if (params->filter != BWT_REPORT_ALL) {
+        filter_hits(iter->workspace, params->filter);
+    }
+    if (!count_only) reserve_cigars(iter->workspace);
     
     // make sure we start at the first interval
     iter->L = m; iter->R = 0;
-    iter->next_interval = 0;
+    iter->next_hit = 0;
+}
+
+void init_bwt_approx_iter_params(
+    struct bwt_approx_iter         *iter,
+    struct bwt_table               *bwt_table,
+    const uint8_t                  *remapped_pattern,
+    int                             max_edits,
+    const struct bwt_approx_params *params
+) {
+    init_approx_search(iter, bwt_table, remapped_pattern,
+                       max_edits, params, false);
+}
+
+void init_bwt_approx_iter(
+    struct bwt_approx_iter *iter,
+    struct bwt_table       *bwt_table,
+    const uint8_t          *remapped_pattern,
+    int                     max_edits
+) {
+    struct bwt_approx_params params = {
+        .algorithm = BWT_BACKTRACK,
+        .workspace = 0
+    };
+    init_bwt_approx_iter_params(iter, bwt_table, remapped_pattern,
+                                max_edits, &params);
 }
 
 bool next_bwt_approx_match(
     struct bwt_approx_iter  *iter,
     struct bwt_approx_match *match
 ) {
+    struct bwt_approx_workspace *ws = iter->workspace;
     if (iter->L >= iter->R) { // done with current interval
-        if (iter->next_interval >= iter->Ls.used)
+        if (iter->next_hit >= ws->no_hits)
             return false; // no more intervals
         // start the next interval
-        iter->L = iter->Ls.data[iter->next_interval];
-        iter->R = iter->Rs.data[iter->next_interval];
-        iter->next_interval++;
+        const struct bwt_approx_hit_ *hit = ws->hits + iter->next_hit;
+        iter->L = hit->L;
+        iter->R = hit->R;
+        build_cigar(ws, hit);
+        iter->next_hit++;
     }
-    match->cigar = (char *)iter->cigars.data[iter->next_interval - 1];
-    match->match_length = iter->match_lengths.data[iter->next_interval - 1];
-    match->position = iter->bwt_table->sa->array[iter->L];
+    const struct bwt_approx_hit_ *hit = ws->hits + iter->next_hit - 1;
+    match->cigar = ws->cigars + hit->cigar_start;
+    match->match_length = hit->match_length;
+    match->position = iter->text_positions ?
+        iter->L : bwt_locate(iter->bwt_table, iter->L);
     iter->L++;
     
     return true;
 }
 
-static void free_strings(
-    struct string_vector *vec
+void dealloc_bwt_approx_iter(
+    struct bwt_approx_iter *iter
+) {
+    if (iter->workspace == &iter->own_workspace)
+        dealloc_bwt_approx_workspace(&iter->own_workspace);
+}
+
+index_t bwt_approx_count(
+    struct bwt_table               *bwt_table,
+    const uint8_t                  *remapped_pattern,
+    int                             edits,
+    const struct bwt_approx_params *params
 ) {
-    for (int i = 0; i < vec->used; i++) {
-        free(string_vector_get(vec, i));
+    // Seed-and-extend needs the positions of the seeds, so we
+    // use the bidirectional search, or, without a reverse table,
+    // backtracking, which only use the rank structure.
+    struct bwt_approx_params count_params = *params;
+    if (count_params.algorithm == BWT_SEED_EXTEND)
+        count_params.algorithm = BWT_BIDIRECTIONAL;
+
+    struct bwt_approx_iter iter;
+    init_approx_search(&iter, bwt_table, remapped_pattern,
+                       edits, &count_params, true);
+    const struct bwt_approx_workspace *ws = iter.workspace;
+    index_t count = 0;
+    for (uint32_t i = 0; i < ws->no_hits; ++i) {
+        count += ws->hits[i].R - ws->hits[i].L;
     }
+    dealloc_bwt_approx_iter(&iter);
+    return count;
 }
 
-void dealloc_bwt_approx_iter(
-    struct bwt_approx_iter *iter
+void bwt_approx_count_batch(
+    struct bwt_table               *bwt_table,
+    const uint8_t                 **remapped_patterns,
+    uint32_t                        no_patterns,
+    int                             edits,
+    const struct bwt_approx_params *params,
+    index_t                        *counts
 ) {
-    dealloc_index_vector(&iter->Ls);
-    dealloc_index_vector(&iter->Rs);
-    free_strings(&iter->cigars);
-    dealloc_string_vector(&iter->cigars);
-    dealloc_index_vector(&iter->match_lengths);
-    free(iter->edits_buf);
-    if (iter->D_table) free(iter->D_table);
+    // All the searches share a workspace, so we only
+    // allocate while the first ones grow it.
+    struct bwt_approx_params batch_params = *params;
+    struct bwt_approx_workspace own_workspace;
+    if (!batch_params.workspace) {
+        init_bwt_approx_workspace(&own_workspace);
+        batch_params.workspace = &own_workspace;
+    }
+    for (uint32_t i = 0; i < no_patterns; ++i) {
+        counts[i] = bwt_approx_count(bwt_table, remapped_patterns[i],
+                                     edits, &batch_params);
+    }
+    if (!params->workspace)
+        dealloc_bwt_approx_workspace(&own_workspace);
 }
 
 
@@ -427,15 +1553,34 @@ void write_bwt_table(
     const struct bwt_table *bwt_table
 ) {
     uint32_t c_table_length = bwt_table->remap_table->alphabet_size;
-    uint32_t o_table_length = bwt_table->remap_table->alphabet_size * (bwt_table->sa->length + 1);
     fwrite(bwt_table->c_table, sizeof(*bwt_table->c_table), c_table_length, f);
-    fwrite(bwt_table->o_table, sizeof(*bwt_table->o_table), o_table_length, f);
+    write_occ_table(f, bwt_table->o_table);
     bool has_ro_table = bwt_table->ro_table;
     fwrite(&has_ro_table, sizeof(bool), 1, f);
     if (bwt_table->ro_table) {
-        fwrite(bwt_table->ro_table,
-               sizeof(*bwt_table->ro_table),
-               o_table_length, f);
+        write_occ_table(f, bwt_table->ro_table);
+    }
+    
+    const struct bwt_sa_samples *samples = bwt_table->sa_samples;
+    bool has_sa_samples = samples;
+    fwrite(&has_sa_samples, sizeof(bool), 1, f);
+    if (samples) {
+        index_t no_words = bwt_no_marked_words_(bwt_table->o_table->length);
+        fwrite(&samples->rate, sizeof(samples->rate), 1, f);
+        fwrite(&samples->no_samples, sizeof(samples->no_samples), 1, f);
+        fwrite(samples->samples, sizeof(*samples->samples), samples->no_samples, f);
+        fwrite(samples->marked, sizeof(*samples->marked), no_words, f);
+        fwrite(samples->marked_rank, sizeof(*samples->marked_rank), no_words, f);
+        fwrite(samples->isa_samples, sizeof(*samples->isa_samples), samples->no_samples, f);
+    }
+    
+    const struct bwt_kmer_table *kmer_table = bwt_table->kmer_table;
+    bool has_kmer_table = kmer_table;
+    fwrite(&has_kmer_table, sizeof(bool), 1, f);
+    if (kmer_table) {
+        fwrite(&kmer_table->k, sizeof(kmer_table->k), 1, f);
+        fwrite(kmer_table->intervals, sizeof(*kmer_table->intervals),
+               kmer_table->no_kmers, f);
     }
 }
 
@@ -458,33 +1603,54 @@ struct bwt_table *read_bwt_table(
     bwt_table->remap_table = remap_table;
     bwt_table->sa = sa;   // shouldn't store these
     uint32_t c_table_length = remap_table->alphabet_size;
-    uint32_t o_table_length = remap_table->alphabet_size * (sa->length + 1);
     
     bwt_table->c_table = malloc(sizeof(*bwt_table->c_table) * c_table_length);
-    bwt_table->o_table = malloc(sizeof(*bwt_table->o_table) * o_table_length);
     fread(bwt_table->c_table, sizeof(*bwt_table->c_table), c_table_length, f);
-    fread(bwt_table->o_table, sizeof(*bwt_table->o_table), o_table_length, f);
-    
-    bwt_table->o_indices = malloc(sizeof(*bwt_table->o_indices) * (sa->length + 1));
-    for (uint32_t i = 0; i < sa->length + 1; i++) {
-        bwt_table->o_indices[i] = bwt_table->o_table + i * remap_table->alphabet_size;
-    }
+    bwt_table->o_table = read_occ_table(f);
     
     bwt_table->ro_table = 0;
-    bwt_table->ro_indices = 0;
     bool has_ro_table;
     fread(&has_ro_table, sizeof(bool), 1, f);
-
     if (has_ro_table) {
-            bwt_table->ro_table = malloc(sizeof(*bwt_table->ro_table) * o_table_length);
-            fread(bwt_table->ro_table,
-              sizeof(*bwt_table->ro_table),
-              o_table_length, f);
-        bwt_table->ro_indices = malloc(sizeof(bwt_table->ro_indices) * (sa->length + 1));
-        for (uint32_t i = 0; i < sa->length + 1; i++) {
-            bwt_table->ro_indices[i] = bwt_table->ro_table + i * remap_table->alphabet_size;
+        bwt_table->ro_table = read_occ_table(f);
+    }
+    
+    bwt_table->sa_samples = 0;
+    bool has_sa_samples;
+    fread(&has_sa_samples, sizeof(bool), 1, f);
+    if (has_sa_samples) {
+        struct bwt_sa_samples *samples = malloc(sizeof(struct bwt_sa_samples));
+        index_t no_words = bwt_no_marked_words_(bwt_table->o_table->length);
+        fread(&samples->rate, sizeof(samples->rate), 1, f);
+        fread(&samples->no_samples, sizeof(samples->no_samples), 1, f);
+        samples->samples = malloc(samples->no_samples * sizeof(*samples->samples));
+        samples->marked = malloc(no_words * sizeof(*samples->marked));
+        samples->marked_rank = malloc(no_words * sizeof(*samples->marked_rank));
+        fread(samples->samples, sizeof(*samples->samples), samples->no_samples, f);
+        fread(samples->marked, sizeof(*samples->marked), no_words, f);
+        fread(samples->marked_rank, sizeof(*samples->marked_rank), no_words, f);
+        samples->isa_samples = malloc(samples->no_samples * sizeof(*samples->isa_samples));
+        fread(samples->isa_samples, sizeof(*samples->isa_samples), samples->no_samples, f);
+        bwt_table->sa_samples = samples;
+    }
+    
+    bwt_table->kmer_table = 0;
+    bool has_kmer_table;
+    fread(&has_kmer_table, sizeof(bool), 1, f);
+    if (has_kmer_table) {
+        struct bwt_kmer_table *kmer_table = malloc(sizeof(struct bwt_kmer_table));
+        fread(&kmer_table->k, sizeof(kmer_table->k), 1, f);
+        // The table is the last thing in the file, so if
+        // k does not make sense, we can just leave it out.
+        if (!set_bwt_kmer_powers_(kmer_table, remap_table->alphabet_size - 1)) {
+            free(kmer_table);
+            return bwt_table;
         }
-
+        kmer_table->intervals =
+            malloc(kmer_table->no_kmers * sizeof(*kmer_table->intervals));
+        fread(kmer_table->intervals, sizeof(*kmer_table->intervals),
+              kmer_table->no_kmers, f);
+        bwt_table->kmer_table = kmer_table;
     }
     
     return bwt_table;
@@ -510,7 +1676,7 @@ void print_c_table(
     const struct remap_table *remap_table = bwt_table->remap_table;
     printf("C: ");
     for (uint32_t i = 0; i < remap_table->alphabet_size; ++i) {
-        printf("%u ", C(i));
+        printf("%" PRIindex " ", C(i));
     }
     printf("\n");
 }
@@ -523,8 +1689,8 @@ void print_o_table(
     const struct suffix_array *sa = bwt_table->sa;
     for (uint32_t i = 0; i < remap_table->alphabet_size; ++i) {
         printf("O(%c,) = ", remap_table->rev_table[i]);
-        for (uint32_t j = 0; j <= sa->length; ++j) {
-            printf("%u ", O(i, j));
+        for (index_t j = 0; j <= sa->length; ++j) {
+            printf("%" PRIindex " ", O(i, j));
         }
         printf("\n");
     }
@@ -539,8 +1705,8 @@ void print_ro_table(
     const struct suffix_array *sa = bwt_table->sa;
     for (uint32_t i = 0; i < remap_table->alphabet_size; ++i) {
         printf("RO(%c,) = ", remap_table->rev_table[i]);
-        for (uint32_t j = 0; j <= sa->length; ++j) {
-            printf("%u ", RO(i, j));
+        for (index_t j = 0; j <= sa->length; ++j) {
+            printf("%" PRIindex " ", RO(i, j));
         }
         printf("\n");
     }
@@ -576,17 +1742,39 @@ bool equivalent_bwt_tables(
         if (table1->c_table[i] != table2->c_table[i])
             return false;
     }
-    uint32_t o_table_size = table1->remap_table->alphabet_size * table1->sa->length;
-    for (uint32_t i = 0; i < o_table_size; ++i) {
-        if (table1->o_table[i] != table2->o_table[i])
-            return false;
-    }
+    if (!identical_occ_tables(table1->o_table, table2->o_table))
+        return false;
 
     if (table1->ro_table && !table2->ro_table) return false;
     if (table2->ro_table && !table1->ro_table) return false;
-    if (table1->ro_table) {
-        for (uint32_t i = 0; i < o_table_size; ++i) {
-            if (table1->ro_table[i] != table2->ro_table[i])
+    if (table1->ro_table &&
+        !identical_occ_tables(table1->ro_table, table2->ro_table))
+        return false;
+
+    const struct bwt_sa_samples *samples1 = table1->sa_samples;
+    const struct bwt_sa_samples *samples2 = table2->sa_samples;
+    if (samples1 && !samples2) return false;
+    if (samples2 && !samples1) return false;
+    if (samples1) {
+        if (samples1->rate != samples2->rate) return false;
+        if (samples1->no_samples != samples2->no_samples) return false;
+        for (index_t i = 0; i < samples1->no_samples; ++i) {
+            if (samples1->samples[i] != samples2->samples[i])
+                return false;
+            if (samples1->isa_samples[i] != samples2->isa_samples[i])
+                return false;
+        }
+    }
+    
+    const struct bwt_kmer_table *kmers1 = table1->kmer_table;
+    const struct bwt_kmer_table *kmers2 = table2->kmer_table;
+    if (kmers1 && !kmers2) return false;
+    if (kmers2 && !kmers1) return false;
+    if (kmers1) {
+        if (kmers1->k != kmers2->k) return false;
+        for (uint32_t i = 0; i < kmers1->no_kmers; ++i) {
+            if (kmers1->intervals[i].L != kmers2->intervals[i].L ||
+                kmers1->intervals[i].R != kmers2->intervals[i].R)
                 return false;
         }
     }
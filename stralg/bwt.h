@@ -4,6 +4,7 @@
 
 #include <remap.h>
 #include <suffix_array.h>
+#include <occ_table.h>
 #include <vectors.h>
 
 #include <stdbool.h>
@@ -32,22 +33,91 @@
  
  If the former, use free_bwt_table() to dealloce the BWT table,
  if the latter, use complete_free_bwt_table().
+ 
+ To report where matches are, we need the suffix array. If you
+ sample it, see sample_bwt_suffix_array(), the table can locate
+ matches without the full suffix array, so you do not need to keep
+ it in memory when you load the table back from a file.
+
+ With the samples, the table does not need the string either: the
+ BWT holds the same information, and bwt_extract() gets a substring
+ back with LF-mapping from the nearest sampled position after it.
+ A self-index, see build_self_index_table(), is such a table without
+ the string; its suffix array has the length of the string but
+ neither the string nor the array.
  */
 struct bwt_table {
     struct remap_table  *remap_table;
     struct suffix_array *sa;
-    uint32_t *c_table;
-    uint32_t *o_table;
-    uint32_t **o_indices;
-    uint32_t *ro_table;
-    uint32_t **ro_indices;
+    index_t *c_table;
+    struct occ_table *o_table;
+    struct occ_table *ro_table;
+    struct bwt_sa_samples *sa_samples;
+    struct bwt_kmer_table *kmer_table;
+};
+
+/**
+ A suffix array sampled at every rate'th text position.
+ 
+ The rows whose suffix starts at a position divisible by the rate
+ are marked in a bit vector, and their suffix array values are
+ stored in row order. To get the suffix array value of an unmarked
+ row we LF-map until we hit a marked row; that takes fewer than
+ rate steps.
+
+ We also keep the inverse: the row of each sampled position, in
+ text order. From the row of the first sampled position after a
+ substring, LF-mapping gives us the substring backwards.
+ */
+struct bwt_sa_samples {
+    uint32_t rate;
+    index_t no_samples;
+    index_t *samples;
+    uint64_t *marked;      // one bit per row in the BWT
+    index_t *marked_rank; // number of marked rows before each word
+    index_t *isa_samples; // the row of position k * rate, for each k
+};
+
+/**
+ A suffix array interval, [L,R). It is empty if L >= R.
+ */
+struct bwt_interval {
+    index_t L;
+    index_t R;
+};
+
+// We do not build k-mer tables for k larger than this.
+#define BWT_MAX_KMER_LENGTH 12
+// The most k-mers we make a table for, enough for all DNA 12-mers.
+// With a larger alphabet, this, rather than BWT_MAX_KMER_LENGTH,
+// limits k; see max_bwt_kmer_length().
+#define BWT_MAX_KMERS (1u << 24)
+
+/**
+ The suffix array intervals of all k-mers.
+ 
+ Every backward search starts with the interval [0,n) and spends
+ its first steps on huge intervals, where every rank query is a
+ cache miss. With this table, a search can look up the interval
+ of the last k symbols of a pattern and continue from there.
+ 
+ The k-mers are over the symbols 1 to alphabet_size - 1 (we never
+ search for the sentinel). A k-mer x[0..k-1] has index
+ sum (x[j] - 1) * b^(k-1-j), with b = alphabet_size - 1, so
+ the symbol we meet first in backward search has weight one.
+ */
+struct bwt_kmer_table {
+    uint32_t k;
+    uint32_t no_kmers;
+    uint32_t powers[BWT_MAX_KMER_LENGTH + 1]; // b^j; not serialised
+    struct bwt_interval *intervals;
 };
 
 // these macros just make the notation nicer, but they do require
 // that the table is called bwt_table.
-#define C(a)    (bwt_table->c_table[(a)])
-#define O(a,i)  (bwt_table->o_indices[i][a])
-#define RO(a,i)  (bwt_table->ro_indices[i][a])
+#define C(a)     (bwt_table->c_table[(a)])
+#define O(a,i)   occ_rank(bwt_table->o_table, (a), (i))
+#define RO(a,i)  occ_rank(bwt_table->ro_table, (a), (i))
 
 /**
  Initialising a table.
@@ -139,6 +209,97 @@ void completely_dealloc_bwt_table(struct bwt_table *bwt_table);
 void completely_free_bwt_table(struct bwt_table *bwt_table);
 
 
+/**
+ Sample the suffix array.
+ 
+ Builds a sampled suffix array from the suffix array the
+ table holds. After this, bwt_locate() uses the samples and
+ the serialisation functions no longer need the full suffix array.
+ 
+ @param bwt_table The table. Its suffix array must be present.
+ @param rate Keep the suffix array values divisible by rate.
+ */
+void sample_bwt_suffix_array(
+    struct bwt_table *bwt_table,
+    uint32_t rate
+);
+
+/**
+ Find the position in the string of a row in the BWT.
+ 
+ If the table has a sampled suffix array, this uses LF-mapping
+ to find the position. Otherwise, it uses the suffix array.
+ 
+ @param bwt_table The table.
+ @param row The row, an index into the (conceptual) suffix array.
+ @return The suffix array value at row.
+ */
+index_t bwt_locate(
+    const struct bwt_table *bwt_table,
+    index_t row
+);
+
+/**
+ Get a substring of the (remapped) string.
+
+ If the table has the string, we copy from it. Otherwise, the
+ table must have a sampled suffix array, and we LF-map from the
+ first sampled position at or after pos + len, which takes fewer
+ than len + rate steps.
+
+ @param bwt_table The table.
+ @param pos The start of the substring.
+ @param len The length of the substring; pos + len must be at
+ most the length of the string, without the sentinel.
+ @param buffer Output: the substring, remapped, followed by a
+ zero. It must have room for len + 1 symbols.
+ */
+void bwt_extract(
+    const struct bwt_table *bwt_table,
+    index_t pos,
+    index_t len,
+    uint8_t *buffer
+);
+
+/**
+ The longest k-mers we can build a table for.
+ 
+ The largest k, at most BWT_MAX_KMER_LENGTH, such that there are
+ at most BWT_MAX_KMERS k-mers over the alphabet (not counting the
+ sentinel). For DNA it is BWT_MAX_KMER_LENGTH; for proteins it is
+ five.
+ */
+uint32_t max_bwt_kmer_length(
+    uint32_t alphabet_size
+);
+
+/**
+ A k-mer length that suits the table.
+ 
+ The largest k such that there are no more k-mers than
+ positions in the string, but at most max_bwt_kmer_length().
+ */
+uint32_t default_bwt_kmer_length(
+    const struct bwt_table *bwt_table
+);
+
+/**
+ Build the k-mer table.
+ 
+ After this, exact and approximative search start from the
+ interval of the pattern's last k symbols instead of from [0,n).
+ The table is serialised with the rest of the BWT table.
+ 
+ @param bwt_table The table.
+ @param k The k-mer length. If it is more than max_bwt_kmer_length()
+ for the table's alphabet, we use that instead. If it is zero, the
+ table is removed.
+ */
+void build_bwt_kmer_table(
+    struct bwt_table *bwt_table,
+    uint32_t k
+);
+
 /** Build BWT table from a string.
  
  This function builds all the structures needed to work
@@ -159,6 +320,57 @@ build_complete_table(
     bool include_reverse
 );
 
+/**
+ Build a BWT table with a sampled suffix array from a string.
+ 
+ Works as build_complete_table() followed by
+ sample_bwt_suffix_array(), but it never holds the full suffix
+ array. The BWT and the samples come straight out of the last
+ induced-sorting pass of SA-IS, and the reverse string is sorted
+ only for its BWT, before we start on the forward string, so
+ there is only ever one suffix array under construction.
+ 
+ @param string The string to build the tables over.
+ @param include_reverse If true, the O table for the reverse table
+ is also built.
+ @param sa_sample_rate Keep the suffix array values divisible by
+ this rate. If it is zero, the table gets the full suffix array,
+ as with build_complete_table().
+ 
+ @return A BWT table. Free it with completely_free_bwt_table().
+ */
+struct bwt_table *
+build_complete_table_sampled(
+    const uint8_t *string,
+    bool include_reverse,
+    uint32_t sa_sample_rate
+);
+
+/**
+ Build a self-index from a string.
+
+ Works as build_complete_table_sampled(), but the table does not
+ keep the string, so it only holds the C and O tables and the
+ suffix array samples. Use bwt_extract() to get substrings back.
+ The search functions work as with the string, and seed-and-extend
+ extracts the text around the seeds to verify them.
+
+ @param string The string to build the tables over.
+ @param include_reverse If true, the O table for the reverse table
+ is also built.
+ @param sa_sample_rate Keep the suffix array values divisible by
+ this rate, and the rows of the positions divisible by it. It must
+ be positive.
+
+ @return A BWT table. Free it with completely_free_bwt_table().
+ */
+struct bwt_table *
+build_self_index_table(
+    const uint8_t *string,
+    bool include_reverse,
+    uint32_t sa_sample_rate
+);
+
 /**
  Iterator for exact search with BWT.
  
@@ -166,10 +378,10 @@ build_complete_table(
  the header to allow stack allocated iterators.
  */
 struct bwt_exact_match_iter {
-    const struct suffix_array *sa;
-    uint32_t L;
+    const struct bwt_table *bwt_table;
+    index_t L;
     int64_t i;
-    uint32_t R;
+    index_t R;
 };
 /**
  Struct holding information about the location of a match.
@@ -178,7 +390,7 @@ struct bwt_exact_match_iter {
  You do not need to initialise it nor deallocate it.
  */
 struct bwt_exact_match {
-    uint32_t pos;
+    index_t pos;
 };
 
 /**
@@ -233,6 +445,128 @@ void dealloc_bwt_exact_match_iter(
     struct bwt_exact_match_iter *iter
 );
 
+/**
+ Count the occurrences of a pattern.
+
+ This is the size of the interval that the exact search finds, so
+ it only uses the C and O tables (and the k-mer table if there is
+ one). It never looks up positions, so it is as fast with a
+ sampled suffix array as with the full one.
+
+ @param bwt_table The BWT table to search in.
+ @param remapped_pattern The pattern. It must be remapped with
+ the remap table that the bwt_table holds.
+
+ @return The number of occurrences of the pattern.
+ */
+index_t bwt_exact_count(
+    const struct bwt_table *bwt_table,
+    const uint8_t *remapped_pattern
+);
+
+/**
+ Exact search for many patterns at once.
+ 
+ Searching for one pattern at a time, every step in the backward
+ search waits for a cache miss into the O table. This function
+ keeps a batch of patterns in flight, advances them in turn, and
+ prefetches the rank blocks each pattern needs for its next step,
+ so the memory latency of one pattern is hidden behind the work
+ on the others.
+ 
+ @param bwt_table The BWT table to search in.
+ @param remapped_patterns The patterns. They must be remapped with
+ the remap table that the bwt_table holds.
+ @param no_patterns The number of patterns.
+ @param intervals Output: the suffix array interval of the matches
+ for each pattern. It must have room for no_patterns intervals. Use
+ bwt_locate() to get the positions of the matches.
+ */
+void bwt_exact_search_batch(
+    const struct bwt_table *bwt_table,
+    const uint8_t **remapped_patterns,
+    uint32_t no_patterns,
+    struct bwt_interval *intervals
+);
+/**
+ Count the occurrences of many patterns at once.
+
+ Works as bwt_exact_search_batch(), but puts the number of
+ occurrences of pattern i in counts[i], which must have room
+ for no_patterns counts.
+ */
+void bwt_exact_count_batch(
+    const struct bwt_table *bwt_table,
+    const uint8_t **remapped_patterns,
+    uint32_t no_patterns,
+    index_t *counts
+);
+
+struct bwt_approx_frame_;
+struct bwt_approx_hit_;
+
+/**
+ Reusable buffers for approximative search.
+
+ An approximative search needs a stack for the backtracking, room
+ for the edit scripts of the matches, and a few tables of the
+ pattern's length. If you give the iterator a workspace (through
+ struct bwt_approx_params), it takes all of these from the workspace,
+ and after the first few searches have grown the buffers, a search
+ does not allocate any memory at all. Use one workspace per thread,
+ and only for one iterator at a time.
+
+ You should consider this an opaque structure. Initialise it with
+ init_bwt_approx_workspace and deallocate it with
+ dealloc_bwt_approx_workspace.
+ */
+struct bwt_approx_workspace {
+    // Stack for the backtracking search
+    struct bwt_approx_frame_ *frames;
+    uint32_t frames_size;
+    // Edit operations on the current search path
+    uint8_t *path;
+    uint32_t path_size;
+    // Match intervals
+    struct bwt_approx_hit_ *hits;
+    uint32_t no_hits, hits_size;
+    // Edit scripts for the hits, two bits per operation
+    uint64_t *scripts;
+    uint32_t no_script_ops, scripts_size;
+    // The cigars of the hits, each built when the
+    // iterator reaches its hit
+    char *cigars;
+    uint32_t cigars_size;
+    // D table for the backtracking search
+    int *D_table;
+    uint32_t D_table_size;
+    // Pattern parts for the bidirectional search
+    uint32_t *part_of;
+    uint32_t part_of_size;
+    // Candidate start positions and the band of edit
+    // costs for the seed-and-extend search
+    index_t *candidates;
+    uint32_t no_candidates, candidates_size;
+    int *band;
+    uint32_t band_size;
+    // The text around the candidates, for a table without the string
+    uint8_t *window;
+    uint32_t window_size;
+    // The hits we keep, and the intervals that contain
+    // the current one, when we filter the hits
+    struct bwt_approx_hit_ *kept_hits;
+    uint32_t kept_hits_size;
+    struct bwt_approx_hit_ *open_hits;
+    uint32_t open_hits_size;
+};
+
+void init_bwt_approx_workspace(
+    struct bwt_approx_workspace *workspace
+);
+void dealloc_bwt_approx_workspace(
+    struct bwt_approx_workspace *workspace
+);
+
 /**
  Iterator for approximative search.
  
@@ -246,16 +580,20 @@ void dealloc_bwt_exact_match_iter(
 struct bwt_approx_iter {
     struct bwt_table *bwt_table;
     const uint8_t *remapped_pattern;
+    uint32_t m;
     
-    uint32_t L, R, next_interval;
-    struct index_vector  Ls;
-    struct index_vector  Rs;
-    struct string_vector cigars;
-    struct index_vector  match_lengths;
+    index_t L, R;
+    uint32_t next_hit;
+    // The hits are text positions rather than rows
+    bool text_positions;
+    // Only mismatches, no insertions or deletions
+    bool hamming;
+    // Only the intervals, for counting; no edit scripts or cigars
+    bool count_only;
     
-    uint32_t m;
-    char *edits_buf;
-    int *D_table;
+    // Either the user's workspace or own_workspace
+    struct bwt_approx_workspace *workspace;
+    struct bwt_approx_workspace own_workspace;
 };
 
 /**
@@ -263,8 +601,9 @@ struct bwt_approx_iter {
  
  The structure will be filled in by next_bwt_approx_match.
  
- It contains a cigar string (it will be freed by the iterator
- so copy it if you need to keep it).
+ It contains a cigar string. It lives in the iterator's buffers
+ and is valid until you deallocate the iterator or start another
+ search with its workspace.
  
  Then it contains the position in the string that the key matches.
  
@@ -276,7 +615,7 @@ struct bwt_approx_iter {
  */
 struct bwt_approx_match {
     const char *cigar;
-    uint32_t position;
+    index_t position;
     uint32_t match_length;
 };
 /**
@@ -296,6 +635,136 @@ void init_bwt_approx_iter(
     const uint8_t          *remapped_pattern,
     int                     edits
 );
+/**
+ Algorithms for approximative search.
+ 
+ BWT_BACKTRACK extends the match from right to left and explores
+ every way of placing edits, using the D table to prune if
+ the table has the reverse O table.
+ 
+ BWT_BIDIRECTIONAL uses both the forward and the reverse O table
+ (so the table must have ro_table) to keep synchronised intervals
+ for the string matched so far, so it can extend the match in
+ both directions. It splits the pattern into edits + 1 parts; at
+ least one of them must match exactly. Search number j starts with
+ an exact match of part j, extends it to the right and then to the
+ left, and requires at least one edit in each part to the left of
+ part j, so every match is found by exactly one search. Starting
+ from an exact match of a part means that we do not explore edits
+ in short, and therefore frequent, strings.
+ 
+ BWT_SEED_EXTEND also splits the pattern into edits + 1 parts, but
+ uses them as seeds: it finds the exact occurrences of each part,
+ and then checks the text around them with a banded edit-distance
+ computation against the string in the table's suffix array. Its
+ cost grows with the number of seed occurrences rather than
+ exponentially in the number of edits, so it is the one to use for
+ long patterns and many edits, as long as the seeds are not so
+ short that they occur everywhere.
+ 
+ All algorithms find the same matches, but they report them in
+ different orders. If the pattern is too short to split, or the
+ table lacks what the algorithm needs (the reverse table for
+ BWT_BIDIRECTIONAL, the string for BWT_SEED_EXTEND), they fall
+ back to BWT_BACKTRACK.
+ */
+enum bwt_approx_algorithm {
+    BWT_BACKTRACK,
+    BWT_BIDIRECTIONAL,
+    BWT_SEED_EXTEND
+};
+
+/**
+ Which of the matches an approximative search reports.
+
+ The searches find every way of placing the edits, so the same
+ string can be matched through several edit scripts, for example
+ a deletion and an insertion instead of two mismatches, and then
+ all the positions where it occurs are reported once per script.
+
+ BWT_REPORT_ALL reports them all; this is the default.
+
+ BWT_BEST_PER_MATCH reports each position and match length once,
+ with the script with the fewest edits.
+
+ BWT_BEST_PER_POSITION reports each position once, with the match
+ with the fewest edits and of those the shortest. A match that
+ extends a no-worse match at the same position is dominated by it,
+ and since its suffix array interval is nested in that of the
+ shorter match, we remove it before we look up any positions.
+
+ When two scripts tie, we pick the one that comes first when we
+ order M < I < D, so all the algorithms report the same matches.
+ Filtering sorts the matches by suffix array row, so they are
+ not reported in the order the search found them.
+ */
+enum bwt_approx_filter {
+    BWT_REPORT_ALL,
+    BWT_BEST_PER_MATCH,
+    BWT_BEST_PER_POSITION
+};
+
+/**
+ The distance an approximative search counts edits with.
+
+ BWT_EDIT_DISTANCE allows mismatches, insertions and deletions;
+ this is the default.
+
+ BWT_HAMMING_DISTANCE only allows mismatches, so a match is as long
+ as the pattern and its cigar is a single M. The searches then
+ only branch on the alphabet, and the backtracking search prunes
+ with its own lower bound on the number of mismatches, which is
+ never smaller than the bound it uses for edits, so the search is
+ much faster than one that also considers indels.
+ */
+enum bwt_approx_distance {
+    BWT_EDIT_DISTANCE,
+    BWT_HAMMING_DISTANCE
+};
+
+/**
+ Options for an approximative search.
+ */
+struct bwt_approx_params {
+    // bwt_approx_count() searches with BWT_BIDIRECTIONAL
+    // when this is BWT_SEED_EXTEND.
+    enum bwt_approx_algorithm algorithm;
+    // If not null, the search uses the buffers in this
+    // workspace instead of allocating its own.
+    struct bwt_approx_workspace *workspace;
+    enum bwt_approx_filter filter;
+    enum bwt_approx_distance distance;
+    // If not null, the text is no_seqs sequences, one after the
+    // other; sequence i starts at seq_starts[i], and
+    // seq_starts[no_seqs] is the text length. The search then
+    // leaves out matches that run from one sequence into the
+    // next before it filters, so they cannot hide the matches
+    // inside a sequence. It must locate every match for this.
+    const index_t *seq_starts;
+    uint32_t no_seqs;
+};
+
+/**
+ Initialise an approximative iterator with options.
+ 
+ Works as init_bwt_approx_iter, which uses BWT_BACKTRACK,
+ but lets you choose how to search.
+ 
+ @param iter             The iterator
+ @param bwt_table        The BWT table that contains the text
+ @param remapped_pattern The search key. It must be remapped
+ with the remap table from the BWT table.
+ @param edits            The maximum number of edits allowed
+ @param params           The search options.
+ */
+void init_bwt_approx_iter_params(
+    struct bwt_approx_iter         *iter,
+    struct bwt_table               *bwt_table,
+    const uint8_t                  *remapped_pattern,
+    int                             edits,
+    const struct bwt_approx_params *params
+);
+
 /**
  Report an approximative match.
  
@@ -332,6 +801,50 @@ void dealloc_bwt_approx_iter(
     struct bwt_approx_iter *iter
 );
 
+/**
+ Count approximative matches.
+
+ Runs the search as init_bwt_approx_iter_params() does and adds up
+ the sizes of the intervals it finds, without recording edit
+ scripts, building cigars or looking up positions. The count is the number of matches the
+ iterator would report with the same params, so with the default
+ BWT_REPORT_ALL a position counts once per edit script that matches
+ there; use BWT_BEST_PER_POSITION to count the positions where the
+ pattern matches with at most edits edits.
+
+ BWT_SEED_EXTEND needs the positions of its seeds, so here we
+ search with BWT_BIDIRECTIONAL instead, or with BWT_BACKTRACK if
+ the table has no reverse table. The count is the same.
+
+ @param bwt_table        The BWT table that contains the text
+ @param remapped_pattern The search key, remapped with the remap
+ table from the BWT table.
+ @param edits            The maximum number of edits allowed
+ @param params           The search options.
+
+ @return The number of matches.
+ */
+index_t bwt_approx_count(
+    struct bwt_table               *bwt_table,
+    const uint8_t                  *remapped_pattern,
+    int                             edits,
+    const struct bwt_approx_params *params
+);
+/**
+ Count approximative matches for many patterns.
+
+ Puts bwt_approx_count() for pattern i in counts[i]. If params
+ has no workspace, the searches share one we allocate here.
+ */
+void bwt_approx_count_batch(
+    struct bwt_table               *bwt_table,
+    const uint8_t                 **remapped_patterns,
+    uint32_t                        no_patterns,
+    int                             edits,
+    const struct bwt_approx_params *params,
+    index_t                        *counts
+);
+
 
 // Serialisation
 void write_bwt_table(
@@ -0,0 +1,292 @@
+#include "bwt.h"
+#include "bwt_internal.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+/*
+ Bidirectional search.
+
+ We keep two intervals for the string W we have matched so far:
+ [L,R) in the suffix array of the text and [rL,rR) in the suffix
+ array of the reversed text, where it is the interval of W
+ reversed. Extending W to the left with a is an ordinary backward
+ search step in the forward index. In the reverse index, the rows
+ for W reversed followed by a are the sub-interval that starts
+ after the rows followed by symbols smaller than a, and those
+ we can count in the forward BWT. Extending to the right is
+ the same with the roles of the indices swapped.
+
+ The pattern is split into max_edits + 1 parts. Search j matches
+ part j exactly, extends the match to the right to the end of
+ the pattern, and then to the left to the beginning. We assign an
+ insertion or a mismatch to the part of its pattern symbol, and a
+ deletion to the part of the next pattern symbol to its right in
+ the text. A match then has a first part without edits, and search
+ j reports exactly the matches whose first part without edits is
+ j, i.e., those with at least one edit in each part to the left of j.
+
+ Like the backtracking search, we never start or end a match with
+ a deletion. With the Hamming distance we never insert or delete,
+ and the parts work the same with mismatches only.
+ */
+
+struct bidir_interval {
+    index_t L, R;   // forward index
+    index_t rL, rR; // reverse index
+};
+
+struct bidir_search {
+    struct bwt_approx_iter *iter;
+    const uint8_t *pattern;
+    uint32_t m;
+    int max_edits;
+    uint32_t no_parts;
+    bool hamming;         // only M-operations
+    uint32_t start_part;  // the part we match exactly
+    uint32_t *part_start; // no_parts + 1 entries
+    uint32_t *part_of;    // the part each pattern index is in
+    // The edits for the match so far, in text order, are
+    // edits[left, right). It is large enough that we can
+    // add a full path of edits in either direction.
+    uint8_t *edits;
+};
+
+// Extend the match with a to the left. We get the new intervals
+// for all a in one go, because we need the counts of the smaller
+// symbols for the reverse interval anyway. We only get the ranks
+// of the symbols that are in the interval, which with a wavelet
+// matrix is less work than asking for all of them; the others get
+// empty intervals.
+static inline uint32_t extend_left(
+    const struct bwt_table *bwt_table,
+    const struct bidir_interval *iv,
+    struct bidir_interval *new_ivs
+) {
+    uint32_t alphabet_size = bwt_table->remap_table->alphabet_size;
+    memset(new_ivs, 0, alphabet_size * sizeof(*new_ivs));
+    uint8_t symbols[alphabet_size];
+    index_t ranks_L[alphabet_size], ranks_R[alphabet_size];
+    uint32_t no_symbols = occ_interval_symbols(bwt_table->o_table,
+                                               iv->L, iv->R,
+                                               symbols, ranks_L, ranks_R);
+    index_t smaller = 0;
+    for (uint32_t k = 0; k < no_symbols; ++k) {
+        uint8_t a = symbols[k];
+        if (a > 0) {
+            struct bidir_interval *new_iv = &new_ivs[a];
+            new_iv->L = C(a) + ranks_L[k];
+            new_iv->R = C(a) + ranks_R[k];
+            new_iv->rL = iv->rL + smaller;
+            new_iv->rR = new_iv->rL + (new_iv->R - new_iv->L);
+        }
+        smaller += ranks_R[k] - ranks_L[k];
+    }
+    return alphabet_size;
+}
+
+static inline uint32_t extend_right(
+    const struct bwt_table *bwt_table,
+    const struct bidir_interval *iv,
+    struct bidir_interval *new_ivs
+) {
+    uint32_t alphabet_size = bwt_table->remap_table->alphabet_size;
+    memset(new_ivs, 0, alphabet_size * sizeof(*new_ivs));
+    uint8_t symbols[alphabet_size];
+    index_t ranks_L[alphabet_size], ranks_R[alphabet_size];
+    uint32_t no_symbols = occ_interval_symbols(bwt_table->ro_table,
+                                               iv->rL, iv->rR,
+                                               symbols, ranks_L, ranks_R);
+    index_t smaller = 0;
+    for (uint32_t k = 0; k < no_symbols; ++k) {
+        uint8_t a = symbols[k];
+        if (a > 0) {
+            struct bidir_interval *new_iv = &new_ivs[a];
+            new_iv->rL = C(a) + ranks_L[k];
+            new_iv->rR = C(a) + ranks_R[k];
+            new_iv->L = iv->L + smaller;
+            new_iv->R = new_iv->L + (new_iv->rR - new_iv->rL);
+        }
+        smaller += ranks_R[k] - ranks_L[k];
+    }
+    return alphabet_size;
+}
+
+static void report(
+    struct bidir_search *search,
+    const struct bidir_interval *iv,
+    int edits,
+    uint32_t left, uint32_t right
+) {
+    uint32_t match_length = 0;
+    for (uint32_t e = left; e < right; ++e) {
+        if (search->edits[e] != BWT_EDIT_I_) match_length++;
+    }
+    append_approx_match_(search->iter, iv->L, iv->R, match_length,
+                         (uint32_t)edits, search->edits + left, right - left);
+}
+
+// Extend to the left. The next pattern symbol is x, and cur_edits
+// is the number of edits in the part of x + 1, the part that
+// deletions go to.
+static void search_left(
+    struct bidir_search *search,
+    const struct bidir_interval *iv,
+    int64_t x, int cur_edits, int edits,
+    uint32_t left, uint32_t right
+) {
+    const struct bwt_table *bwt_table = search->iter->bwt_table;
+    uint32_t start_part = search->start_part;
+    uint32_t cur_part = search->part_of[x + 1];
+
+    // Each part left of the start part needs an edit.
+    int needed = (int)cur_part + ((cur_part < start_part && cur_edits == 0) ? 1 : 0);
+    if (edits + needed > search->max_edits) return;
+
+    if (x < 0) {
+        if (cur_part < start_part && cur_edits == 0) return;
+        report(search, iv, edits, left, right);
+        return;
+    }
+
+    struct bidir_interval new_ivs[bwt_table->remap_table->alphabet_size];
+    uint32_t alphabet_size = extend_left(bwt_table, iv, new_ivs);
+
+    // Matches and insertions consume x. If x is in the next part,
+    // we can only move on if the current part has its edit.
+    uint32_t part = search->part_of[x];
+    bool can_leave = cur_part == start_part || cur_edits > 0;
+    if (part == cur_part || can_leave) {
+        int part_edits = (part == cur_part) ? cur_edits : 0;
+
+        // M-operations
+        uint8_t match_a = search->pattern[x];
+        for (uint8_t a = 1; a < alphabet_size; ++a) {
+            int cost = (a == match_a) ? 0 : 1;
+            if (edits + cost > search->max_edits) continue;
+            if (new_ivs[a].L >= new_ivs[a].R) continue;
+            search->edits[left - 1] = BWT_EDIT_M_;
+            search_left(search, &new_ivs[a], x - 1, part_edits + cost,
+                        edits + cost, left - 1, right);
+        }
+
+        if (search->hamming) return;
+
+        // I-operation
+        search->edits[left - 1] = BWT_EDIT_I_;
+        search_left(search, iv, x - 1, part_edits + 1, edits + 1,
+                    left - 1, right);
+    }
+
+    // D-operations; never in the exact part.
+    if (search->hamming || cur_part == start_part) return;
+    for (uint8_t a = 1; a < alphabet_size; ++a) {
+        if (new_ivs[a].L >= new_ivs[a].R) continue;
+        search->edits[left - 1] = BWT_EDIT_D_;
+        search_left(search, &new_ivs[a], x, cur_edits + 1, edits + 1,
+                    left - 1, right);
+    }
+}
+
+// Extend to the right. The next pattern symbol is x.
+static void search_right(
+    struct bidir_search *search,
+    const struct bidir_interval *iv,
+    uint32_t x, int edits,
+    uint32_t left, uint32_t right
+) {
+    const struct bwt_table *bwt_table = search->iter->bwt_table;
+    uint32_t start_part = search->start_part;
+
+    // Each part left of the start part needs an edit.
+    if (edits + (int)start_part > search->max_edits) return;
+
+    if (x == search->m) {
+        int64_t next = (int64_t)search->part_start[start_part] - 1;
+        search_left(search, iv, next, 0, edits, left, right);
+        return;
+    }
+
+    bool exact = search->part_of[x] == start_part;
+    struct bidir_interval new_ivs[bwt_table->remap_table->alphabet_size];
+    uint32_t alphabet_size = extend_right(bwt_table, iv, new_ivs);
+
+    // M-operations
+    uint8_t match_a = search->pattern[x];
+    for (uint8_t a = 1; a < alphabet_size; ++a) {
+        int cost = (a == match_a) ? 0 : 1;
+        if (exact && cost) continue;
+        if (edits + cost > search->max_edits) continue;
+        if (new_ivs[a].L >= new_ivs[a].R) continue;
+        search->edits[right] = BWT_EDIT_M_;
+        search_right(search, &new_ivs[a], x + 1, edits + cost, left, right + 1);
+    }
+
+    if (exact || search->hamming) return;
+
+    // I-operation
+    search->edits[right] = BWT_EDIT_I_;
+    search_right(search, iv, x + 1, edits + 1, left, right + 1);
+
+    // D-operations
+    for (uint8_t a = 1; a < alphabet_size; ++a) {
+        if (new_ivs[a].L >= new_ivs[a].R) continue;
+        search->edits[right] = BWT_EDIT_D_;
+        search_right(search, &new_ivs[a], x, edits + 1, left, right + 1);
+    }
+}
+
+void bidirectional_approx_search_(
+    struct bwt_approx_iter *iter,
+    int max_edits
+) {
+    const struct bwt_table *bwt_table = iter->bwt_table;
+    assert(bwt_table->ro_table);
+    assert(max_edits >= 0);
+
+    uint32_t m = iter->m;
+    uint32_t no_parts = (uint32_t)max_edits + 1;
+    assert(m >= no_parts);
+
+    uint32_t part_start[no_parts + 1];
+    for (uint32_t p = 0; p <= no_parts; ++p) {
+        part_start[p] = (uint32_t)(((uint64_t)p * m) / no_parts);
+    }
+    // The search recurses, but only to the length of a path, and
+    // takes all its buffers from the workspace.
+    struct bwt_approx_workspace *ws = iter->workspace;
+    ws->part_of = bwt_grow_(ws->part_of, &ws->part_of_size,
+                            m, sizeof(*ws->part_of));
+    uint32_t *part_of = ws->part_of;
+    for (uint32_t p = 0; p < no_parts; ++p) {
+        for (uint32_t x = part_start[p]; x < part_start[p + 1]; ++x) {
+            part_of[x] = p;
+        }
+    }
+
+    // A path has an M or I for each pattern symbol
+    // and a D for at most each edit.
+    uint32_t max_ops = m + (uint32_t)max_edits + 1;
+    ws->path = bwt_grow_(ws->path, &ws->path_size,
+                         2 * max_ops + 1, sizeof(*ws->path));
+
+    struct bidir_search search = {
+        .iter = iter,
+        .pattern = iter->remapped_pattern,
+        .m = m,
+        .max_edits = max_edits,
+        .no_parts = no_parts,
+        .hamming = iter->hamming,
+        .part_start = part_start,
+        .part_of = part_of,
+        .edits = ws->path
+    };
+
+    index_t n = bwt_table->o_table->length;
+    struct bidir_interval all = { 0, n, 0, n };
+    for (uint32_t j = 0; j < no_parts; ++j) {
+        search.start_part = j;
+        search_right(&search, &all, part_start[j], 0, max_ops, max_ops);
+    }
+}
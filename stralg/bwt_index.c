@@ -0,0 +1,650 @@
+#include "bwt_index.h"
+#include "bwt_internal.h"
+#include "occ_table.h"
+#include "remap.h"
+#include "suffix_array.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/*
+ The file layout. All offsets are from the start of the file, and
+ all sections start at a multiple of BWT_INDEX_ALIGNMENT, so the
+ interleaved O table blocks are cache-line aligned when we map the
+ file (mappings start at a page boundary).
+
+   file header
+   record 1: record header, then its sections
+   ...
+   record n: record header, then its sections
+   directory: the offsets of the n record headers
+
+ Numbers are stored in the byte order of the machine that wrote the
+ file; we check it with a known constant in the header. The arrays of
+ positions are stored with the width of index_t, which we also store
+ in the header, so we can only map a file written by a build with the
+ same width. The lengths in the headers are always 64 bits.
+ */
+static const char index_magic[8] = { 'S', 'T', 'R', 'A', 'L', 'G', 'I', 'X' };
+#define BYTE_ORDER_MARK 0x01020304
+
+struct file_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t no_records;
+    uint32_t index_size;    // sizeof(index_t) in the writer
+    uint64_t directory;
+};
+
+enum section_id {
+    NAME,
+    STRING,         // the remapped string, with its sentinel
+    SA,
+    REMAP,
+    C_TABLE,
+    O_BLOCKS,
+    O_CHECKPOINTS,
+    O_BITS,
+    RO_BLOCKS,
+    RO_CHECKPOINTS,
+    RO_BITS,
+    SAMPLES,
+    MARKED,
+    MARKED_RANK,
+    ISA_SAMPLES,
+    KMER_INTERVALS,
+    SEQ_STARTS,
+    SEQ_NAMES,      // the names, one after another, each with its '\0'
+    NO_SECTIONS
+};
+
+struct section {
+    uint64_t offset;
+    uint64_t size;
+};
+
+enum record_flags {
+    HAS_SA      = 1 << 0,
+    HAS_RO      = 1 << 1,
+    HAS_SAMPLES = 1 << 2,
+    HAS_KMERS   = 1 << 3,
+    HAS_SEQS    = 1 << 4,
+    HAS_STRING  = 1 << 5
+};
+
+struct occ_info {
+    uint32_t layout;
+    uint32_t alphabet_size;
+    uint64_t length;
+    uint64_t sentinel_pos;
+};
+
+struct record_header {
+    uint32_t flags;
+    uint32_t alphabet_size;
+    uint32_t sample_rate;
+    uint32_t kmer_length;
+    uint32_t no_seqs;
+    uint32_t reserved;
+    uint64_t length;          // of the string, including the sentinel
+    uint64_t no_samples;
+    struct occ_info o_info;
+    struct occ_info ro_info;
+    struct section sections[NO_SECTIONS];
+};
+
+// MARK: Writing
+
+static void pad_to_alignment(FILE *f)
+{
+    static const uint8_t zeros[BWT_INDEX_ALIGNMENT] = { 0 };
+    long pos = ftell(f);
+    long padding = (BWT_INDEX_ALIGNMENT - pos % BWT_INDEX_ALIGNMENT) % BWT_INDEX_ALIGNMENT;
+    fwrite(zeros, 1, padding, f);
+}
+
+static void write_section(
+    FILE *f,
+    struct section *section,
+    const void *data,
+    uint64_t size
+) {
+    pad_to_alignment(f);
+    section->offset = (uint64_t)ftell(f);
+    section->size = size;
+    if (size > 0) fwrite(data, 1, size, f);
+}
+
+static void write_occ_sections(
+    FILE *f,
+    struct record_header *header,
+    struct occ_info *info,
+    enum section_id first_section,
+    const struct occ_table *table
+) {
+    info->layout = table->layout;
+    info->length = table->length;
+    info->alphabet_size = table->alphabet_size;
+    info->sentinel_pos = table->sentinel_pos;
+
+    index_t no_blocks, no_checkpoints, no_words;
+    occ_table_sizes(table->layout, table->alphabet_size, table->length,
+                    &no_blocks, &no_checkpoints, &no_words);
+    uint64_t blocks_size = table->blocks ?
+        (uint64_t)no_blocks * sizeof(*table->blocks) : 0;
+    write_section(f, &header->sections[first_section],
+                  table->blocks, blocks_size);
+    write_section(f, &header->sections[first_section + 1],
+                  table->checkpoints,
+                  (uint64_t)no_checkpoints * sizeof(*table->checkpoints));
+    write_section(f, &header->sections[first_section + 2],
+                  table->bits, (uint64_t)no_words * sizeof(*table->bits));
+}
+
+enum error_codes init_bwt_index_writer(
+    struct bwt_index_writer *writer,
+    const char *fname,
+    uint32_t no_records
+) {
+    writer->f = fopen(fname, "wb");
+    if (!writer->f) return CANNOT_OPEN_FILE;
+    writer->no_records = no_records;
+    writer->next_record = 0;
+    writer->record_offsets = malloc((no_records + 1) * sizeof(*writer->record_offsets));
+
+    // We write the real header when we know where the directory is.
+    struct file_header header = { { 0 } };
+    fwrite(&header, sizeof(header), 1, writer->f);
+    return NO_ERROR;
+}
+
+void add_bwt_index_record(
+    struct bwt_index_writer *writer,
+    const char *name,
+    const struct bwt_table *bwt_table
+) {
+    add_bwt_index_record_seqs(writer, name, bwt_table, 0, 0, 0);
+}
+
+void add_bwt_index_record_seqs(
+    struct bwt_index_writer *writer,
+    const char *name,
+    const struct bwt_table *bwt_table,
+    uint32_t no_seqs,
+    const char **seq_names,
+    const index_t *seq_starts
+) {
+    assert(writer->next_record < writer->no_records);
+    FILE *f = writer->f;
+    const struct suffix_array *sa = bwt_table->sa;
+    const struct bwt_sa_samples *samples = bwt_table->sa_samples;
+    const struct bwt_kmer_table *kmer_table = bwt_table->kmer_table;
+    uint32_t alphabet_size = bwt_table->remap_table->alphabet_size;
+
+    struct record_header header;
+    memset(&header, 0, sizeof(header));
+    header.length = sa->length;
+    header.alphabet_size = alphabet_size;
+
+    pad_to_alignment(f);
+    uint64_t header_offset = (uint64_t)ftell(f);
+    writer->record_offsets[writer->next_record++] = header_offset;
+    fwrite(&header, sizeof(header), 1, f);
+
+    write_section(f, &header.sections[NAME], name, strlen(name) + 1);
+    // A self-index has no string.
+    if (sa->string) {
+        header.flags |= HAS_STRING;
+        write_section(f, &header.sections[STRING], sa->string, sa->length);
+    }
+    // With a sampled suffix array, we do not need the full
+    // suffix array to locate matches, so we leave it out.
+    if (!samples) {
+        assert(sa->array);
+        header.flags |= HAS_SA;
+        write_section(f, &header.sections[SA], sa->array,
+                      (uint64_t)sa->length * sizeof(*sa->array));
+    }
+    write_section(f, &header.sections[REMAP], bwt_table->remap_table,
+                  sizeof(*bwt_table->remap_table));
+    write_section(f, &header.sections[C_TABLE], bwt_table->c_table,
+                  (uint64_t)alphabet_size * sizeof(*bwt_table->c_table));
+    write_occ_sections(f, &header, &header.o_info, O_BLOCKS, bwt_table->o_table);
+    if (bwt_table->ro_table) {
+        header.flags |= HAS_RO;
+        write_occ_sections(f, &header, &header.ro_info, RO_BLOCKS,
+                           bwt_table->ro_table);
+    }
+    if (samples) {
+        header.flags |= HAS_SAMPLES;
+        header.sample_rate = samples->rate;
+        header.no_samples = samples->no_samples;
+        index_t no_words = bwt_no_marked_words_(sa->length);
+        write_section(f, &header.sections[SAMPLES], samples->samples,
+                      (uint64_t)samples->no_samples * sizeof(*samples->samples));
+        write_section(f, &header.sections[MARKED], samples->marked,
+                      (uint64_t)no_words * sizeof(*samples->marked));
+        write_section(f, &header.sections[MARKED_RANK], samples->marked_rank,
+                      (uint64_t)no_words * sizeof(*samples->marked_rank));
+        write_section(f, &header.sections[ISA_SAMPLES], samples->isa_samples,
+                      (uint64_t)samples->no_samples * sizeof(*samples->isa_samples));
+    }
+    if (kmer_table) {
+        header.flags |= HAS_KMERS;
+        header.kmer_length = kmer_table->k;
+        write_section(f, &header.sections[KMER_INTERVALS], kmer_table->intervals,
+                      (uint64_t)kmer_table->no_kmers * sizeof(*kmer_table->intervals));
+    }
+    if (no_seqs > 0) {
+        assert(seq_starts[0] == 0 && seq_starts[no_seqs] == sa->length - 1);
+        header.flags |= HAS_SEQS;
+        header.no_seqs = no_seqs;
+        write_section(f, &header.sections[SEQ_STARTS], seq_starts,
+                      (uint64_t)(no_seqs + 1) * sizeof(*seq_starts));
+        pad_to_alignment(f);
+        header.sections[SEQ_NAMES].offset = (uint64_t)ftell(f);
+        for (uint32_t i = 0; i < no_seqs; ++i) {
+            uint64_t size = strlen(seq_names[i]) + 1;
+            fwrite(seq_names[i], 1, size, f);
+            header.sections[SEQ_NAMES].size += size;
+        }
+    }
+
+    // Now we know where the sections are, so we can write the header.
+    long end = ftell(f);
+    fseek(f, (long)header_offset, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, f);
+    fseek(f, end, SEEK_SET);
+}
+
+void finish_bwt_index_writer(
+    struct bwt_index_writer *writer
+) {
+    assert(writer->next_record == writer->no_records);
+    FILE *f = writer->f;
+
+    struct file_header header;
+    memcpy(header.magic, index_magic, sizeof(header.magic));
+    header.version = BWT_INDEX_VERSION;
+    header.byte_order = BYTE_ORDER_MARK;
+    header.no_records = writer->no_records;
+    header.index_size = sizeof(index_t);
+
+    pad_to_alignment(f);
+    header.directory = (uint64_t)ftell(f);
+    fwrite(writer->record_offsets, sizeof(*writer->record_offsets),
+           writer->no_records, f);
+
+    fseek(f, 0, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, f);
+    fclose(f);
+    free(writer->record_offsets);
+    writer->f = 0;
+    writer->record_offsets = 0;
+}
+
+enum error_codes write_bwt_index_fname(
+    const char *fname,
+    uint32_t no_records,
+    const char **names,
+    struct bwt_table **tables
+) {
+    struct bwt_index_writer writer;
+    enum error_codes err = init_bwt_index_writer(&writer, fname, no_records);
+    if (err != NO_ERROR) return err;
+    for (uint32_t i = 0; i < no_records; ++i) {
+        add_bwt_index_record(&writer, names[i], tables[i]);
+    }
+    finish_bwt_index_writer(&writer);
+    return NO_ERROR;
+}
+
+// MARK: Reading
+
+// The structures we point into the mapping, one per record.
+struct mapped_tables {
+    struct bwt_table bwt_table;
+    struct suffix_array sa;
+    struct occ_table o_table;
+    struct occ_table ro_table;
+    struct bwt_sa_samples sa_samples;
+    struct bwt_kmer_table kmer_table;
+    // A record without sequences is its own only sequence.
+    index_t single_seq_starts[2];
+    const char *single_seq_name;
+    const char **seq_names; // allocated if the record has sequences
+};
+
+// Get a pointer to the data of a section if it is inside the
+// file, aligned, and has the size we expect. Otherwise, null.
+static void *section_data(
+    const struct bwt_index *index,
+    const struct section *section,
+    uint64_t expected_size
+) {
+    if (section->size != expected_size) return 0;
+    if (section->offset % BWT_INDEX_ALIGNMENT != 0) return 0;
+    if (section->offset > index->size) return 0;
+    if (section->size > index->size - section->offset) return 0;
+    return (uint8_t *)index->data + section->offset;
+}
+
+static bool map_occ_table(
+    const struct bwt_index *index,
+    const struct record_header *header,
+    const struct occ_info *info,
+    enum section_id first_section,
+    struct occ_table *table
+) {
+    if (info->layout > OCC_WAVELET_MATRIX) return false;
+    if (info->length != header->length) return false;
+    if (info->alphabet_size != header->alphabet_size) return false;
+    table->layout = info->layout;
+    table->length = (index_t)info->length;
+    table->alphabet_size = info->alphabet_size;
+    table->sentinel_pos = (index_t)info->sentinel_pos;
+
+    index_t no_checkpoints, no_words;
+    occ_table_sizes(table->layout, table->alphabet_size, table->length,
+                    &table->no_blocks, &no_checkpoints, &no_words);
+    uint64_t blocks_size = (table->layout == OCC_INTERLEAVED_DNA) ?
+        (uint64_t)table->no_blocks * sizeof(*table->blocks) : 0;
+    const struct section *sections = header->sections + first_section;
+    table->blocks = section_data(index, &sections[0], blocks_size);
+    table->checkpoints = section_data(
+        index, &sections[1], (uint64_t)no_checkpoints * sizeof(*table->checkpoints));
+    table->bits = section_data(
+        index, &sections[2], (uint64_t)no_words * sizeof(*table->bits));
+    if (blocks_size > 0 && !table->blocks) return false;
+    if (no_checkpoints > 0 && !table->checkpoints) return false;
+    if (no_words > 0 && !table->bits) return false;
+    // The arrays the layout does not use are null, as in
+    // a table we build.
+    if (blocks_size == 0) table->blocks = 0;
+    if (no_checkpoints == 0) table->checkpoints = 0;
+    if (no_words == 0) table->bits = 0;
+    return true;
+}
+
+static bool map_seqs(
+    const struct bwt_index *index,
+    const struct record_header *header,
+    struct bwt_index_record *record,
+    struct mapped_tables *tables
+) {
+    index_t n = (index_t)header->length - 1;
+    if (!(header->flags & HAS_SEQS)) {
+        tables->single_seq_starts[0] = 0;
+        tables->single_seq_starts[1] = n;
+        tables->single_seq_name = record->name;
+        record->no_seqs = 1;
+        record->seq_starts = tables->single_seq_starts;
+        record->seq_names = &tables->single_seq_name;
+        return true;
+    }
+
+    uint32_t no_seqs = header->no_seqs;
+    if (no_seqs == 0) return false;
+    const index_t *starts = section_data(
+        index, &header->sections[SEQ_STARTS],
+        (uint64_t)(no_seqs + 1) * sizeof(*starts));
+    if (!starts || starts[0] != 0 || starts[no_seqs] != n) return false;
+    for (uint32_t i = 0; i < no_seqs; ++i) {
+        if (starts[i] > starts[i + 1]) return false;
+    }
+
+    const struct section *names_section = &header->sections[SEQ_NAMES];
+    const char *names = section_data(index, names_section, names_section->size);
+    if (!names) return false;
+    const char *end = names + names_section->size;
+    tables->seq_names = malloc(no_seqs * sizeof(*tables->seq_names));
+    for (uint32_t i = 0; i < no_seqs; ++i) {
+        const char *name_end = memchr(names, '\0', (size_t)(end - names));
+        if (!name_end) return false;
+        tables->seq_names[i] = names;
+        names = name_end + 1;
+    }
+
+    record->no_seqs = no_seqs;
+    record->seq_starts = starts;
+    record->seq_names = tables->seq_names;
+    return true;
+}
+
+static bool map_record(
+    const struct bwt_index *index,
+    uint64_t offset,
+    struct bwt_index_record *record,
+    struct mapped_tables *tables
+) {
+    struct section header_section = { offset, sizeof(struct record_header) };
+    const struct record_header *header =
+        section_data(index, &header_section, sizeof(struct record_header));
+    if (!header) return false;
+    if (header->length == 0 || header->length > INDEX_MAX) return false;
+    if (header->alphabet_size == 0 || header->alphabet_size > 128) return false;
+
+    const struct section *name_section = &header->sections[NAME];
+    const char *name = section_data(index, name_section, name_section->size);
+    if (!name || name_section->size == 0 || name[name_section->size - 1] != '\0')
+        return false;
+    record->name = name;
+
+    struct suffix_array *sa = &tables->sa;
+    sa->length = (index_t)header->length;
+    sa->string = 0;
+    if (header->flags & HAS_STRING) {
+        sa->string = section_data(index, &header->sections[STRING], header->length);
+        if (!sa->string || sa->string[sa->length - 1] != '\0') return false;
+    } else if (!(header->flags & HAS_SAMPLES)) {
+        return false; // we need the samples to extract the string
+    }
+    sa->array = 0;
+    sa->inverse = 0;
+    sa->lcp.values = 0;
+    sa->lcp_lr = 0;
+    sa->buckets.starts = 0;
+    sa->search_tree.prefixes = 0;
+    sa->search_tree.rows = 0;
+    if (header->flags & HAS_SA) {
+        sa->array = section_data(index, &header->sections[SA],
+                                 (uint64_t)sa->length * sizeof(*sa->array));
+        if (!sa->array) return false;
+    }
+
+    struct remap_table *remap_table =
+        section_data(index, &header->sections[REMAP], sizeof(struct remap_table));
+    if (!remap_table) return false;
+    if (remap_table->alphabet_size != header->alphabet_size) return false;
+
+    struct bwt_table *bwt_table = &tables->bwt_table;
+    bwt_table->remap_table = remap_table;
+    bwt_table->sa = sa;
+    bwt_table->c_table = section_data(
+        index, &header->sections[C_TABLE],
+        (uint64_t)header->alphabet_size * sizeof(*bwt_table->c_table));
+    if (!bwt_table->c_table) return false;
+
+    if (!map_occ_table(index, header, &header->o_info, O_BLOCKS, &tables->o_table))
+        return false;
+    bwt_table->o_table = &tables->o_table;
+
+    bwt_table->ro_table = 0;
+    if (header->flags & HAS_RO) {
+        if (!map_occ_table(index, header, &header->ro_info, RO_BLOCKS,
+                           &tables->ro_table))
+            return false;
+        bwt_table->ro_table = &tables->ro_table;
+    }
+
+    bwt_table->sa_samples = 0;
+    if (header->flags & HAS_SAMPLES) {
+        struct bwt_sa_samples *samples = &tables->sa_samples;
+        index_t no_words = bwt_no_marked_words_(sa->length);
+        samples->rate = header->sample_rate;
+        if (header->no_samples > header->length) return false;
+        samples->no_samples = (index_t)header->no_samples;
+        samples->samples = section_data(
+            index, &header->sections[SAMPLES],
+            (uint64_t)samples->no_samples * sizeof(*samples->samples));
+        samples->marked = section_data(
+            index, &header->sections[MARKED],
+            (uint64_t)no_words * sizeof(*samples->marked));
+        samples->marked_rank = section_data(
+            index, &header->sections[MARKED_RANK],
+            (uint64_t)no_words * sizeof(*samples->marked_rank));
+        samples->isa_samples = section_data(
+            index, &header->sections[ISA_SAMPLES],
+            (uint64_t)samples->no_samples * sizeof(*samples->isa_samples));
+        if (samples->rate == 0 || !samples->marked || !samples->marked_rank)
+            return false;
+        if (samples->no_samples > 0 &&
+            (!samples->samples || !samples->isa_samples))
+            return false;
+        bwt_table->sa_samples = samples;
+    }
+
+    bwt_table->kmer_table = 0;
+    if (header->flags & HAS_KMERS) {
+        struct bwt_kmer_table *kmer_table = &tables->kmer_table;
+        kmer_table->k = header->kmer_length;
+        if (!set_bwt_kmer_powers_(kmer_table, header->alphabet_size - 1))
+            return false;
+        kmer_table->intervals = section_data(
+            index, &header->sections[KMER_INTERVALS],
+            (uint64_t)kmer_table->no_kmers * sizeof(*kmer_table->intervals));
+        if (kmer_table->no_kmers > 0 && !kmer_table->intervals) return false;
+        bwt_table->kmer_table = kmer_table;
+    }
+
+    record->bwt_table = bwt_table;
+    return map_seqs(index, header, record, tables);
+}
+
+static enum error_codes map_records(struct bwt_index *index)
+{
+    if (index->size < sizeof(struct file_header)) return MALFORMED_FILE;
+    const struct file_header *header = index->data;
+    if (memcmp(header->magic, index_magic, sizeof(index_magic)) != 0)
+        return MALFORMED_FILE;
+    if (header->byte_order != BYTE_ORDER_MARK) return MALFORMED_FILE;
+    if (header->version != BWT_INDEX_VERSION) return UNSUPPORTED_VERSION;
+    if (header->index_size != sizeof(index_t)) return UNSUPPORTED_VERSION;
+
+    struct section directory_section = {
+        header->directory,
+        (uint64_t)header->no_records * sizeof(uint64_t)
+    };
+    const uint64_t *directory =
+        section_data(index, &directory_section, directory_section.size);
+    if (!directory) return MALFORMED_FILE;
+
+    index->no_records = header->no_records;
+    index->records = calloc(index->no_records + 1, sizeof(*index->records));
+    struct mapped_tables *tables =
+        calloc(index->no_records + 1, sizeof(struct mapped_tables));
+    index->tables_ = tables;
+    for (uint32_t i = 0; i < index->no_records; ++i) {
+        if (!map_record(index, directory[i], &index->records[i], &tables[i]))
+            return MALFORMED_FILE;
+    }
+    return NO_ERROR;
+}
+
+struct bwt_index *open_bwt_index(
+    const char *fname,
+    int flags,
+    enum error_codes *err
+) {
+    int fd = open(fname, O_RDONLY);
+    if (fd < 0) {
+        if (err) *err = CANNOT_OPEN_FILE;
+        return 0;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        if (err) *err = CANNOT_OPEN_FILE;
+        return 0;
+    }
+    if ((size_t)st.st_size < sizeof(struct file_header)) {
+        close(fd);
+        if (err) *err = MALFORMED_FILE;
+        return 0;
+    }
+
+    int mmap_flags = MAP_SHARED;
+#ifdef MAP_POPULATE
+    if (flags & BWT_INDEX_POPULATE) mmap_flags |= MAP_POPULATE;
+#endif
+    void *data = mmap(0, (size_t)st.st_size, PROT_READ, mmap_flags, fd, 0);
+    // The mapping keeps the file open.
+    close(fd);
+    if (data == MAP_FAILED) {
+        if (err) *err = CANNOT_OPEN_FILE;
+        return 0;
+    }
+#ifdef MADV_HUGEPAGE
+    if (flags & BWT_INDEX_HUGEPAGES)
+        madvise(data, (size_t)st.st_size, MADV_HUGEPAGE);
+#endif
+#ifndef MAP_POPULATE
+    if (flags & BWT_INDEX_POPULATE)
+        madvise(data, (size_t)st.st_size, MADV_WILLNEED);
+#endif
+
+    struct bwt_index *index = malloc(sizeof(struct bwt_index));
+    index->data = data;
+    index->size = (size_t)st.st_size;
+    index->no_records = 0;
+    index->records = 0;
+    index->tables_ = 0;
+
+    enum error_codes res = map_records(index);
+    if (res != NO_ERROR) {
+        close_bwt_index(index);
+        index = 0;
+    }
+    if (err) *err = res;
+    return index;
+}
+
+void close_bwt_index(
+    struct bwt_index *index
+) {
+    struct mapped_tables *tables = index->tables_;
+    if (tables) {
+        for (uint32_t i = 0; i < index->no_records; ++i) {
+            free(tables[i].seq_names);
+        }
+    }
+    free(index->records);
+    free(index->tables_);
+    munmap(index->data, index->size);
+    free(index);
+}
+
+uint32_t find_bwt_index_seq(
+    const struct bwt_index_record *record,
+    index_t position
+) {
+    // The sequence is the last one that starts at or before the
+    // position; looking for the last skips empty sequences.
+    const index_t *starts = record->seq_starts;
+    uint32_t low = 0, high = record->no_seqs;
+    while (high - low > 1) {
+        uint32_t mid = low + (high - low) / 2;
+        if (starts[mid] <= position) {
+            low = mid;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
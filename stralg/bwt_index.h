@@ -0,0 +1,163 @@
+#ifndef BWT_INDEX_H
+#define BWT_INDEX_H
+
+#include "bwt.h"
+#include "error.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ Memory-mapped index files.
+
+ The functions in serialise.h read a table into freshly allocated
+ memory, so loading an index takes time proportional to its size.
+ An index file instead stores the arrays of the tables exactly as
+ they are in memory, each in its own section that starts at a
+ 64-byte boundary, and with a header that gives the version of
+ the format and the offset and size of every section. To open the
+ file, we map it read-only into memory and point the tables at
+ the sections, so we do not read anything until the searches touch
+ it, and all processes that map the same file share the pages in
+ the operating system's page cache.
+
+ A file holds a sequence of named records, each a complete BWT
+ table with string, remap table, C and O tables and, when they were
+ built, reverse O table, suffix array samples and k-mer table. If
+ the table has suffix array samples we leave out the full suffix
+ array, as write_complete_bwt_info() does, and a self-index (see
+ build_self_index_table()) has no string either.
+
+ A record can also hold several sequences, for example all the
+ chromosomes or contigs of a genome, concatenated into one string,
+ so a single search covers all of them. The record then stores the
+ names of the sequences and where each of them starts in the
+ string, and find_bwt_index_seq() maps a position in the string
+ back to the sequence it is in. We do not put a separator between
+ the sequences, since an extra letter would take a DNA alphabet
+ out of the packed O table layouts, so a match can span the end of
+ one sequence and the start of the next; check the end of the
+ match against the end of the sequence before you report it.
+
+ The tables in a mapped file are read-only. Do not free them or
+ change them; close the index with close_bwt_index() when you are
+ done with them.
+ */
+#define BWT_INDEX_VERSION 3
+#define BWT_INDEX_ALIGNMENT 64
+
+/**
+ Writing an index file, one record at a time, so we only need to
+ hold one table in memory at a time. The file is not valid before
+ finish_bwt_index_writer() has written its header.
+ */
+struct bwt_index_writer {
+    FILE *f;
+    uint32_t no_records;
+    uint32_t next_record;
+    uint64_t *record_offsets;
+};
+
+enum error_codes init_bwt_index_writer(
+    struct bwt_index_writer *writer,
+    const char *fname,
+    uint32_t no_records
+);
+void add_bwt_index_record(
+    struct bwt_index_writer *writer,
+    const char *name,
+    const struct bwt_table *bwt_table
+);
+/**
+ Add a record whose string is no_seqs sequences concatenated.
+ Sequence i has name seq_names[i] and is the string from
+ seq_starts[i] up to seq_starts[i + 1], so there are no_seqs + 1
+ starts, the first is zero, and the last is the length of the
+ string (without the sentinel).
+ */
+void add_bwt_index_record_seqs(
+    struct bwt_index_writer *writer,
+    const char *name,
+    const struct bwt_table *bwt_table,
+    uint32_t no_seqs,
+    const char **seq_names,
+    const index_t *seq_starts
+);
+void finish_bwt_index_writer(
+    struct bwt_index_writer *writer
+);
+
+/**
+ Write all the tables in one go.
+ */
+enum error_codes write_bwt_index_fname(
+    const char *fname,
+    uint32_t no_records,
+    const char **names,
+    struct bwt_table **tables
+);
+
+/**
+ Options for open_bwt_index(). By default we only map the file,
+ and pages are read in when a search first touches them. With
+ BWT_INDEX_POPULATE we fault in the whole file when we map it,
+ so the first searches do not wait for the disk. With
+ BWT_INDEX_HUGEPAGES we ask the kernel to back the mapping with
+ huge pages, which means fewer TLB misses for the random accesses
+ in a search. Both are hints; where the system does not support
+ them, they do nothing.
+ */
+enum bwt_index_flags {
+    BWT_INDEX_POPULATE  = 1 << 0,
+    BWT_INDEX_HUGEPAGES = 1 << 1
+};
+
+/**
+ The sequences of a record are laid out as for
+ add_bwt_index_record_seqs(). A record written without sequences
+ is a single sequence with the name of the record, so you can
+ always use the sequences to report matches.
+ */
+struct bwt_index_record {
+    const char *name;
+    struct bwt_table *bwt_table;
+    uint32_t no_seqs;
+    const char **seq_names;
+    const index_t *seq_starts;
+};
+
+struct bwt_index {
+    void *data;   // The mapped file
+    size_t size;
+    uint32_t no_records;
+    struct bwt_index_record *records;
+    // The table structures that point into the mapping
+    void *tables_;
+};
+
+/**
+ Map an index file into memory. If it fails, it returns null and
+ sets err to CANNOT_OPEN_FILE, MALFORMED_FILE, or, for a file
+ written by another version of the format or by a build with another
+ width of index_t (see index_type.h), UNSUPPORTED_VERSION.
+ */
+struct bwt_index *open_bwt_index(
+    const char *fname,
+    int flags,
+    enum error_codes *err
+);
+void close_bwt_index(
+    struct bwt_index *index
+);
+
+/**
+ The sequence that contains a position in the string of a record,
+ found by binary search over the starts of the sequences.
+ */
+uint32_t find_bwt_index_seq(
+    const struct bwt_index_record *record,
+    index_t position
+);
+
+#endif
@@ -0,0 +1,109 @@
+#ifndef BWT_INTERNAL_H
+#define BWT_INTERNAL_H
+
+#include "bwt.h"
+
+#include <stdlib.h>
+
+// This is not a public interface. It might change
+// at any time, so don't use it. All the names
+// end in an underscore to minimise the risk
+// of name clashes with a user's code.
+
+// Edit operations, as we store them in the workspace
+// buffers and, packed two bits per operation, in the
+// edit scripts of the hits.
+enum bwt_edit_op_ {
+    BWT_EDIT_M_ = 0,
+    BWT_EDIT_I_ = 1,
+    BWT_EDIT_D_ = 2
+};
+
+// A node we still have to explore in the backtracking search.
+// The operation is the one that led to the node, and depth is
+// the number of operations on the path, including that one.
+struct bwt_approx_frame_ {
+    index_t L, R;
+    uint32_t match_length, kmer;
+    int32_t i;
+    int32_t edits_left;
+    uint32_t depth;
+    uint8_t op;
+};
+
+// A match interval. Its edit script is operations
+// [script_start, script_start + script_length) in
+// the workspace's scripts, and it has edits edits.
+struct bwt_approx_hit_ {
+    index_t L, R;
+    uint32_t match_length;
+    uint32_t edits;
+    uint32_t script_start;
+    uint32_t script_length;
+    // Where its cigar goes in the workspace's cigar buffer
+    uint32_t cigar_start;
+};
+
+// Make sure that buf has room for at least needed elements
+// of size elem_size, and return the (possibly moved) buffer.
+// It only grows, doubling the size, so once the buffers in a
+// workspace are large enough we do not allocate any more.
+static inline void *bwt_grow_(
+    void *buf, uint32_t *size,
+    uint32_t needed, size_t elem_size
+) {
+    if (needed <= *size) return buf;
+    uint32_t new_size = *size ? *size : 16;
+    while (new_size < needed) new_size *= 2;
+    *size = new_size;
+    return realloc(buf, (size_t)new_size * elem_size);
+}
+
+// Add the match interval [L,R) to the iterator. The edit script
+// is no_ops operations in the order they have in the text, and
+// edits is its cost, counting mismatches as well as indels.
+void append_approx_match_(
+    struct bwt_approx_iter *iter,
+    index_t L, index_t R,
+    uint32_t match_length, uint32_t edits,
+    const uint8_t *ops, uint32_t no_ops
+);
+
+// The number of words in the bit vector of marked rows for
+// suffix array samples over a BWT of the given length.
+index_t bwt_no_marked_words_(index_t length);
+
+// Set the powers of b, and the number of k-mers, in a k-mer
+// table whose k is already set. We do not store the powers
+// when we serialise the table. Returns false if k is too long
+// for the alphabet (see max_bwt_kmer_length()), e.g. in a
+// corrupt file, and then the table is not usable.
+bool set_bwt_kmer_powers_(
+    struct bwt_kmer_table *kmer_table,
+    uint32_t b
+);
+
+// Search with BWT_BIDIRECTIONAL; bwt_bidir.c. The table must have
+// the reverse O table and the pattern must be at least
+// max_edits + 1 long.
+//
+// Unlike the backtracking search, it recurses. Each call adds one
+// operation to the path, a path has at most one M or I per pattern
+// symbol and one D per edit, and there is one more call where the
+// search turns from right to left. So it goes at most
+// m + max_edits + 1 calls deep, and each call keeps alphabet size
+// intervals on the stack.
+void bidirectional_approx_search_(
+    struct bwt_approx_iter *iter,
+    int max_edits
+);
+
+// Search with BWT_SEED_EXTEND; bwt_seed.c. The table must have the
+// string in its suffix array and the pattern must be at least
+// max_edits + 1 long. The hits are text positions, not rows.
+void seed_extend_approx_search_(
+    struct bwt_approx_iter *iter,
+    int max_edits
+);
+
+#endif
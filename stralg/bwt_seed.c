@@ -0,0 +1,308 @@
+#include "bwt.h"
+#include "bwt_internal.h"
+
+#include <stdlib.h>
+#include <assert.h>
+
+/*
+ Seed-and-extend search.
+
+ We split the pattern into max_edits + 1 seeds. An alignment with
+ at most max_edits edits must leave at least one of them without
+ edits, so that seed occurs exactly in the text. If it starts at
+ text position q, and starts at offset o in the pattern, the
+ alignment starts in [q - o - max_edits, q - o + max_edits], since
+ the insertions and deletions before the seed can only move it that
+ far. We find the exact occurrences of the seeds with the FM-index,
+ collect the candidate start positions, and verify each candidate
+ directly against the text.
+
+ To verify a start position, we compute, in a band of width
+ 2 * max_edits + 1 around the diagonal, the minimal cost of aligning
+ the rest of the pattern against the text from each cell. If the
+ cost from the start is more than max_edits there is no match.
+ Otherwise, we enumerate the edit scripts with a depth-first search
+ that uses the table to only go where there is a match, so we get
+ exactly the scripts the other search algorithms report.
+
+ With the Hamming distance, the alignment cannot move, so a seed
+ occurrence gives us exactly one start, and we verify it by
+ counting mismatches.
+
+ If the table does not have the string, we extract the text around
+ each group of nearby candidates with bwt_extract() and verify
+ against that.
+ */
+
+struct seed_search {
+    struct bwt_approx_iter *iter;
+    const uint8_t *pattern;
+    uint32_t m;
+    const uint8_t *text;
+    index_t text_start;  // The text position text[0] is
+    index_t n;           // Length of the text, without the sentinel
+    int max_edits;
+    uint32_t band_width;  // 2 * max_edits + 1
+    int *cost;            // (m + 1) x band_width, row i is pattern index i
+    uint8_t *edits;       // The operations on the current path
+    index_t start;       // The text position we are verifying
+    bool hamming;         // only mismatches, no band
+};
+
+// Entry k in row i is the cell for text offset j = i + k - max_edits.
+static inline int *band_cell(
+    const struct seed_search *search,
+    uint32_t i, uint32_t k
+) {
+    return search->cost + i * search->band_width + k;
+}
+
+static inline int min_cost(int a, int b)
+{
+    return a < b ? a : b;
+}
+
+// The minimal number of edits to align pattern[i,m) against text
+// from start + j, for all cells in the band. Deletions at the end
+// are never useful, and we do not allow them at the start of the
+// alignment (we handle that when we start the search).
+static void fill_band(struct seed_search *search)
+{
+    int d = search->max_edits;
+    int infinity = d + 1;
+    uint32_t w = search->band_width;
+    uint32_t m = search->m;
+    const uint8_t *text = search->text + (search->start - search->text_start);
+    index_t text_left = search->n - search->start;
+
+    for (uint32_t i = m + 1; i-- > 0; ) {
+        for (uint32_t k = w; k-- > 0; ) {
+            int64_t j = (int64_t)i + k - d;
+            int *cell = band_cell(search, i, k);
+            if (j < 0 || j > text_left) {
+                *cell = infinity;
+                continue;
+            }
+            if (i == m) {
+                *cell = 0;
+                continue;
+            }
+            int cost = infinity;
+            bool more_text = j < text_left;
+            if (more_text) {
+                int mismatch = text[j] != search->pattern[i];
+                cost = min_cost(cost, mismatch + *band_cell(search, i + 1, k));
+            }
+            if (k > 0)
+                cost = min_cost(cost, 1 + *band_cell(search, i + 1, k - 1));
+            if (more_text && k + 1 < w)
+                cost = min_cost(cost, 1 + *band_cell(search, i, k + 1));
+            *cell = min_cost(cost, infinity);
+        }
+    }
+}
+
+static void enumerate_scripts(
+    struct seed_search *search,
+    uint32_t i, uint32_t j,
+    int edits, uint32_t depth
+) {
+    if (i == search->m) {
+        append_approx_match_(search->iter, search->start, search->start + 1,
+                             j, (uint32_t)edits, search->edits, depth);
+        return;
+    }
+
+    int d = search->max_edits;
+    uint32_t k = j + d - i;
+    bool more_text = search->start + j < search->n;
+
+    // M-operation
+    if (more_text) {
+        const uint8_t *text = search->text + (search->start - search->text_start);
+        int cost = text[j] != search->pattern[i];
+        if (edits + cost + *band_cell(search, i + 1, k) <= d) {
+            search->edits[depth] = BWT_EDIT_M_;
+            enumerate_scripts(search, i + 1, j + 1, edits + cost, depth + 1);
+        }
+    }
+
+    // I-operation
+    if (k > 0 && edits + 1 + *band_cell(search, i + 1, k - 1) <= d) {
+        search->edits[depth] = BWT_EDIT_I_;
+        enumerate_scripts(search, i + 1, j, edits + 1, depth + 1);
+    }
+
+    // D-operation; never at the start of the match
+    if (depth > 0 && more_text && k + 1 < search->band_width &&
+        edits + 1 + *band_cell(search, i, k + 1) <= d) {
+        search->edits[depth] = BWT_EDIT_D_;
+        enumerate_scripts(search, i, j + 1, edits + 1, depth + 1);
+    }
+}
+
+// The path buffer is all M-operations for the Hamming distance.
+static void verify_hamming(struct seed_search *search, index_t start)
+{
+    uint32_t m = search->m;
+    if (search->n - start < m) return;
+
+    const uint8_t *text = search->text + (start - search->text_start);
+    int mismatches = 0;
+    for (uint32_t i = 0; i < m; ++i) {
+        mismatches += text[i] != search->pattern[i];
+        if (mismatches > search->max_edits) return;
+    }
+    append_approx_match_(search->iter, start, start + 1, m,
+                         (uint32_t)mismatches, search->edits, m);
+}
+
+static void verify_start(struct seed_search *search, index_t start)
+{
+    if (search->hamming) {
+        verify_hamming(search, start);
+        return;
+    }
+    search->start = start;
+    fill_band(search);
+
+    // The first operation cannot be a deletion, so the cost
+    // from the start is over M and I only.
+    uint32_t k = (uint32_t)search->max_edits;
+    int cost = search->max_edits + 1;
+    if (start < search->n) {
+        int mismatch = search->text[start - search->text_start] != search->pattern[0];
+        cost = min_cost(cost, mismatch + *band_cell(search, 1, k));
+    }
+    if (k > 0)
+        cost = min_cost(cost, 1 + *band_cell(search, 1, k - 1));
+    if (cost > search->max_edits) return;
+
+    enumerate_scripts(search, 0, 0, 0, 0);
+}
+
+static int compare_positions(const void *a, const void *b)
+{
+    index_t x = *(const index_t *)a;
+    index_t y = *(const index_t *)b;
+    return (x > y) - (x < y);
+}
+
+// Collect the start positions the exact occurrences of
+// pattern[from,to) put in reach of an alignment. The alignment
+// can start up to shift positions to either side of the seed's.
+static void add_seed_candidates(
+    struct bwt_approx_iter *iter,
+    uint32_t from, uint32_t to,
+    int shift
+) {
+    const struct bwt_table *bwt_table = iter->bwt_table;
+    struct bwt_approx_workspace *ws = iter->workspace;
+    index_t n = bwt_table->sa->length - 1;
+
+    index_t L = 0, R = bwt_table->o_table->length;
+    for (uint32_t i = to; i > from && L < R; --i) {
+        uint8_t a = iter->remapped_pattern[i - 1];
+        L = C(a) + O(a, L);
+        R = C(a) + O(a, R);
+    }
+
+    for (index_t row = L; row < R; ++row) {
+        int64_t centre = (int64_t)bwt_locate(bwt_table, row) - from;
+        int64_t first = centre - shift;
+        int64_t last = centre + shift;
+        if (first < 0) first = 0;
+        if (last >= n) last = (int64_t)n - 1;
+        if (first > last) continue;
+        uint32_t needed = ws->no_candidates + (uint32_t)(last - first + 1);
+        ws->candidates = bwt_grow_(ws->candidates, &ws->candidates_size,
+                                   needed, sizeof(*ws->candidates));
+        for (int64_t s = first; s <= last; ++s) {
+            ws->candidates[ws->no_candidates++] = (index_t)s;
+        }
+    }
+}
+
+void seed_extend_approx_search_(
+    struct bwt_approx_iter *iter,
+    int max_edits
+) {
+    const struct bwt_table *bwt_table = iter->bwt_table;
+    assert(bwt_table->sa && (bwt_table->sa->string || bwt_table->sa_samples));
+    assert(max_edits >= 0);
+
+    struct bwt_approx_workspace *ws = iter->workspace;
+    uint32_t m = iter->m;
+    uint32_t no_seeds = (uint32_t)max_edits + 1;
+    assert(m >= no_seeds);
+
+    ws->no_candidates = 0;
+    for (uint32_t s = 0; s < no_seeds; ++s) {
+        uint32_t from = (uint32_t)(((uint64_t)s * m) / no_seeds);
+        uint32_t to = (uint32_t)(((uint64_t)(s + 1) * m) / no_seeds);
+        add_seed_candidates(iter, from, to, iter->hamming ? 0 : max_edits);
+    }
+    if (ws->no_candidates == 0) return;
+
+    // Several seeds, or nearby occurrences of one seed, can
+    // give us the same start; we verify each start once.
+    qsort(ws->candidates, ws->no_candidates,
+          sizeof(*ws->candidates), compare_positions);
+
+    uint32_t band_width = 2 * (uint32_t)max_edits + 1;
+    ws->path = bwt_grow_(ws->path, &ws->path_size,
+                         m + (uint32_t)max_edits + 1, sizeof(*ws->path));
+    if (iter->hamming) {
+        for (uint32_t i = 0; i < m; ++i) ws->path[i] = BWT_EDIT_M_;
+    } else {
+        ws->band = bwt_grow_(ws->band, &ws->band_size,
+                             (m + 1) * band_width, sizeof(*ws->band));
+    }
+
+    struct seed_search search = {
+        .iter = iter,
+        .pattern = iter->remapped_pattern,
+        .m = m,
+        .text = bwt_table->sa->string,
+        .text_start = 0,
+        .n = bwt_table->sa->length - 1,
+        .max_edits = max_edits,
+        .band_width = band_width,
+        .cost = ws->band,
+        .edits = ws->path,
+        .hamming = iter->hamming
+    };
+    if (search.text) {
+        for (uint32_t c = 0; c < ws->no_candidates; ++c) {
+            if (c > 0 && ws->candidates[c] == ws->candidates[c - 1]) continue;
+            verify_start(&search, ws->candidates[c]);
+        }
+        return;
+    }
+
+    // Without the string, we extract one window for each group of
+    // candidates that are close enough to share one. An alignment
+    // from start never reads beyond start + m + max_edits.
+    index_t span = m + (index_t)max_edits;
+    uint32_t c = 0;
+    while (c < ws->no_candidates) {
+        index_t first = ws->candidates[c];
+        uint32_t last = c;
+        while (last + 1 < ws->no_candidates &&
+               ws->candidates[last + 1] - first <= span) {
+            last++;
+        }
+        index_t end = ws->candidates[last] + span;
+        if (end > search.n) end = search.n;
+        ws->window = bwt_grow_(ws->window, &ws->window_size,
+                               (uint32_t)(end - first) + 1, sizeof(*ws->window));
+        bwt_extract(bwt_table, first, end - first, ws->window);
+        search.text = ws->window;
+        search.text_start = first;
+        for (; c <= last; ++c) {
+            if (c > 0 && ws->candidates[c] == ws->candidates[c - 1]) continue;
+            verify_start(&search, ws->candidates[c]);
+        }
+        search.text = 0;
+    }
+}
@@ -159,7 +159,7 @@ alloc_suffix_tree(
 ) {
     struct ea_suffix_tree *st = malloc(sizeof(struct ea_suffix_tree));
     st->string = string;
-    uint32_t slen = (uint32_t)strlen((char *)string);
+    index_t slen = (index_t)strlen((char *)string);
     st->length = slen + 1; // I am using '\0' as sentinel
     
     // this is the max number of nodes in a tree where all
@@ -167,7 +167,7 @@ alloc_suffix_tree(
     // when the string is empty -- it should really only happen
     // in testing, but never the less. In that case, there should be
     // two and not one node (the root and a single child.
-    uint32_t pool_size = st->length == 1 ? 2 : (2 * st->length - 1);
+    index_t pool_size = st->length == 1 ? 2 : (2 * st->length - 1);
     
     st->node_pool.nodes = malloc(pool_size * sizeof(struct ea_suffix_tree_node));
     st->node_pool.next_node = st->node_pool.nodes;
@@ -209,7 +209,7 @@ struct ea_suffix_tree *naive_ea_suffix_tree(
     first->parent = st->root;
     first->leaf_label = 0;
     const uint8_t *xend = st->string + st->length;
-    for (uint32_t i = 1; i < st->length; ++i) {
+    for (index_t i = 1; i < st->length; ++i) {
         struct ea_suffix_tree_node *leaf =
             naive_insert(st, st->root, string + i, xend);
         assert(is_inner_node(leaf));
@@ -222,9 +222,9 @@ struct ea_suffix_tree *naive_ea_suffix_tree(
 static struct ea_suffix_tree_node *
 lcp_insert(
     struct ea_suffix_tree *st,
-    uint32_t i,
-    uint32_t *sa,
-    uint32_t *lcp,
+    index_t i,
+    index_t *sa,
+    index_t *lcp,
     struct ea_suffix_tree_node *v
 ) {
     struct ea_suffix_tree_node *new_leaf =
@@ -233,8 +233,8 @@ lcp_insert(
                  st->string + st->length);
     
     new_leaf->leaf_label = sa[i];
-    uint32_t length_up = st->length - sa[i-1] - lcp[i];
-    uint32_t v_edge_len = ea_edge_length(v);
+    index_t length_up = st->length - sa[i-1] - lcp[i];
+    index_t v_edge_len = ea_edge_length(v);
     
     while ((length_up >= v_edge_len)
            && (length_up != 0)) {
@@ -261,19 +261,19 @@ struct ea_suffix_tree *
 lcp_ea_suffix_tree(
     uint32_t alphabet_size,
     const uint8_t *string,
-    uint32_t *sa,
-    uint32_t *lcp
+    index_t *sa,
+    index_t *lcp
 ) {
     struct ea_suffix_tree *st = alloc_suffix_tree(alphabet_size, string);
     
-    uint32_t first_label = sa[0];
+    index_t first_label = sa[0];
     struct ea_suffix_tree_node *v =
         new_node(st, st->string + sa[0],
                  st->string + st->length);
     v->leaf_label = first_label;
     insert_child(st->root, v);
     
-    for (uint32_t i = 1; i < st->length; ++i) {
+    for (index_t i = 1; i < st->length; ++i) {
         v = lcp_insert(st, i, sa, lcp, v);
     }
 
@@ -292,7 +292,7 @@ fast_scan(
     assert(w); // must be here when we search for a suffix
     
     // Jump down the edge
-    uint32_t n = ea_edge_length(w);
+    index_t n = ea_edge_length(w);
     const uint8_t *z = x + n;
     
     if (z == y) {
@@ -312,7 +312,7 @@ fast_scan(
         //           y
         //       |-k-|
         //
-        uint32_t k = (uint32_t)(y - x);
+        index_t k = (index_t)(y - x);
         assert(k > 0);
         const uint8_t *s = w->range.from;
         const uint8_t *split_point = s + k;
@@ -382,14 +382,14 @@ mccreight_ea_suffix_tree(
     const uint8_t *x
 ) {
     struct ea_suffix_tree *st = alloc_suffix_tree(alphabet_size, x);
-    uint32_t n = st->length;
+    index_t n = st->length;
     
     struct ea_suffix_tree_node *leaf = new_node(st, x, x + st->length);
     leaf->parent = st->root;
     insert_child(st->root, leaf);
     leaf->leaf_label = 0;
     
-    for (uint32_t i = 1; i < st->length; ++i) {
+    for (index_t i = 1; i < st->length; ++i) {
         
         // Get the suffix of v
         struct ea_suffix_tree_node *v = leaf->parent;
@@ -439,12 +439,12 @@ void get_ea_edge_label(
     struct ea_suffix_tree_node *node,
     uint8_t *buffer
 ) {
-    uint32_t n = range_length(node->range);
+    index_t n = range_length(node->range);
     strncpy((char *)buffer, (char *)node->range.from, n);
     buffer[n] = '\0';
 }
 
-uint32_t get_ea_string_depth(struct ea_suffix_tree *st,
+index_t get_ea_string_depth(struct ea_suffix_tree *st,
                              struct ea_suffix_tree_node *v)
 {
     if (v->parent != v) { // not the root
@@ -455,7 +455,7 @@ uint32_t get_ea_string_depth(struct ea_suffix_tree *st,
         assert(v->range.to > v->range.from);
     }
 
-    uint32_t depth = 0;
+    index_t depth = 0;
     while (v->parent != v) {
         depth += range_length(v->range);
         v = v->parent;
@@ -469,7 +469,7 @@ void get_ea_path_string(
     struct ea_suffix_tree_node *v,
     uint8_t *buffer
 ) {
-    uint32_t offset = get_ea_string_depth(st, v);
+    index_t offset = get_ea_string_depth(st, v);
 
     uint8_t edge_buffer[st->length + 1];
     uint8_t *s = buffer + offset; *s = 0;
@@ -479,7 +479,7 @@ void get_ea_path_string(
     // that do not end in a leaf, we do.
     
     while (v->parent != v) {
-        uint32_t n = range_length(v->range);
+        index_t n = range_length(v->range);
         s -= n;
         strncpy((char *)s, (char *)v->range.from, n);
         get_ea_edge_label(st, v, edge_buffer);
@@ -640,7 +640,7 @@ static void push_frame(
     struct ea_suffix_tree_node *v,
     bool leading,
     const uint8_t *x, const uint8_t *end,
-    uint32_t match_depth,
+    index_t match_depth,
     const uint8_t *p,
     char cigar_op, char *cigar,
     int edit
@@ -664,7 +664,7 @@ static void pop_frame(
     struct ea_suffix_tree_node **v,
     bool *leading,
     const uint8_t **x, const uint8_t **end,
-    uint32_t *match_depth,
+    index_t *match_depth,
     const uint8_t **p,
     char *cigar_op,
     char **cigar,
@@ -691,7 +691,7 @@ static void push_children(
     struct ea_suffix_tree *st,
     struct ea_suffix_tree_node *v,
     bool leading,
-    uint32_t match_depth,
+    index_t match_depth,
     char *cigar,
     const uint8_t *p,
     int edits
@@ -715,7 +715,7 @@ void init_internal_ea_st_approx_iter(
     int edits
 ) {
     // one edit can max cost four characters
-    uint32_t m = (uint32_t)(strlen((char *)p) + 4*edits + 1);
+    index_t m = (index_t)(strlen((char *)p) + 4*edits + 1);
     iter->st = st;
     iter->sentinel.next = 0;
     iter->full_cigar_buf = malloc(m + 1);
@@ -746,7 +746,7 @@ bool next_internal_ea_st_approx_match(
     const uint8_t *p;
     char *cigar;
     int edit;
-    uint32_t match_depth;
+    index_t match_depth;
     char cigar_op;
     
     // we need to know this one so we never move past the end
@@ -880,14 +880,14 @@ void dealloc_ea_st_approx_iter(
 // Build suffix array and LCP
 struct sa_lcp_frame {
     struct ea_suffix_tree_node *v;
-    uint32_t left_depth;
-    uint32_t node_depth;
+    index_t left_depth;
+    index_t node_depth;
     struct sa_lcp_frame *next;
 };
 static struct sa_lcp_frame *new_lcp_frame(
     struct ea_suffix_tree_node *v,
-    uint32_t left_depth,
-    uint32_t node_depth,
+    index_t left_depth,
+    index_t node_depth,
     struct sa_lcp_frame *next
 ) {
     struct sa_lcp_frame *new = malloc(sizeof(struct sa_lcp_frame));
@@ -900,11 +900,11 @@ static struct sa_lcp_frame *new_lcp_frame(
 
 static void lcp_traverse(
     struct ea_suffix_tree *st,
-    uint32_t *sa,
-    uint32_t *lcp
+    index_t *sa,
+    index_t *lcp
 ) {
     struct sa_lcp_frame *stack = new_lcp_frame(st->root, 0, 0, 0);
-    uint32_t idx = 0;
+    index_t idx = 0;
 
     while (stack) {
 
@@ -924,7 +924,7 @@ static void lcp_traverse(
             // the LCP is relative to the last node in the previous
             // leaf in v's previous sibling.
             
-            uint32_t this_depth = frame->node_depth + ea_edge_length(frame->v);
+            index_t this_depth = frame->node_depth + ea_edge_length(frame->v);
             
             uint32_t i = 0;
             struct ea_suffix_tree_node *first_child = 0;
@@ -947,8 +947,8 @@ static void lcp_traverse(
 
 void ea_st_compute_sa_and_lcp(
     struct ea_suffix_tree *st,
-    uint32_t *sa,
-    uint32_t *lcp
+    index_t *sa,
+    index_t *lcp
 ) {
     lcp_traverse(st, sa, lcp);
 }
@@ -965,7 +965,7 @@ static void print_out_edges(
     
     if (is_leaf(from)) {
         // this is a leaf
-        fprintf(f, "\"%p\" [label=\"%u\"];\n", from, from->leaf_label);
+        fprintf(f, "\"%p\" [label=\"%" PRIindex "\"];\n", from, from->leaf_label);
         return;
     }
     
@@ -979,9 +979,9 @@ static void print_out_edges(
         struct ea_suffix_tree_node *child = from->children[i];
         if (!child) continue;
         get_ea_edge_label(st, child, (uint8_t *)label_buffer);
-        uint32_t from_idx = (uint32_t)(child->range.from - st->string);
-        uint32_t to_idx = (uint32_t)(child->range.to - st->string);
-        fprintf(f, "\"%p\" -> \"%p\" [label=\"%s (%u,%u)\"];\n",
+        index_t from_idx = (index_t)(child->range.from - st->string);
+        index_t to_idx = (index_t)(child->range.to - st->string);
+        fprintf(f, "\"%p\" -> \"%p\" [label=\"%s (%" PRIindex ",%" PRIindex ")\"];\n",
                 from, child, label_buffer, from_idx, to_idx);
         fprintf(f, "\"%p\" -> \"%p\" [style=\"dashed\"];\n",
                 child, child->parent);
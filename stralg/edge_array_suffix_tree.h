@@ -10,13 +10,13 @@
 #include <suffix_tree.h> // we get range from here...
 
 struct ea_suffix_tree_node {
-    uint32_t leaf_label;
+    index_t leaf_label;
     struct range range;
     struct ea_suffix_tree_node *parent;
     struct ea_suffix_tree_node **children;
     struct ea_suffix_tree_node *suffix_link;
 };
-static inline uint32_t ea_edge_length(
+static inline index_t ea_edge_length(
     struct ea_suffix_tree_node *n
 ) {
     return range_length(n->range);
@@ -32,7 +32,7 @@ struct ea_suffix_tree_children_pool {
 };
 struct ea_suffix_tree {
     const uint8_t *string;
-    uint32_t length;
+    index_t length;
     uint32_t alphabet_size;
     struct ea_suffix_tree_node *root;
     struct ea_suffix_tree_node_pool node_pool;
@@ -53,8 +53,8 @@ struct ea_suffix_tree *
 lcp_ea_suffix_tree(
     uint32_t alphabet_size,
     const uint8_t *string,
-    uint32_t *sa,
-    uint32_t *lcp
+    index_t *sa,
+    index_t *lcp
 );
 
 void annotate_ea_suffix_links(
@@ -69,8 +69,8 @@ void free_ea_suffix_tree(
 // Suffix array and LCP
 void ea_st_compute_sa_and_lcp(
     struct ea_suffix_tree *st,
-    uint32_t *sa,
-    uint32_t *lcp
+    index_t *sa,
+    index_t *lcp
 );
 
 // Iteration
@@ -107,7 +107,7 @@ struct ea_st_search_iter {
     struct ea_st_leaf_iter leaf_iter;
 };
 struct ea_st_search_match {
-    uint32_t pos;
+    index_t pos;
 };
 void init_ea_st_search_iter(
     struct ea_st_search_iter *iter,
@@ -130,7 +130,7 @@ struct ea_st_approx_frame {
     bool leading; // for avoiding leading deletions
     const uint8_t *x;
     const uint8_t *end;
-    uint32_t match_depth;
+    index_t match_depth;
     const uint8_t *p;
     char cigar_op;
     char *cigar;
@@ -146,7 +146,7 @@ struct internal_ea_st_approx_iter {
 struct internal_ea_st_approx_match {
     const char *cigar;
     struct ea_suffix_tree_node *match_root;
-    uint32_t match_depth;
+    index_t match_depth;
 };
 
 
@@ -173,9 +173,9 @@ struct ea_st_approx_match_iter {
 };
 struct ea_st_approx_match {
     struct ea_suffix_tree_node *root;
-    uint32_t match_length;
-    uint32_t match_depth;
-    uint32_t match_label;
+    index_t match_length;
+    index_t match_depth;
+    index_t match_label;
     const char *cigar;
 };
 void init_ea_st_approx_iter(
@@ -193,7 +193,7 @@ void dealloc_ea_st_approx_iter(
 );
 
 
-uint32_t get_ea_string_depth(
+index_t get_ea_string_depth(
     struct ea_suffix_tree *st,
     struct ea_suffix_tree_node *v
 );
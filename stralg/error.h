@@ -11,6 +11,7 @@ enum error_codes {
     // I/O
     CANNOT_OPEN_FILE,
     MALFORMED_FILE,
+    UNSUPPORTED_VERSION,
     
     // Comparisons
     SUFFIX_ARRAYS_DIFFER,
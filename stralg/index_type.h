@@ -0,0 +1,34 @@
+#ifndef INDEX_TYPE_H
+#define INDEX_TYPE_H
+
+#include <stdint.h>
+#include <inttypes.h>
+
+/**
+ The integer type we use for positions in, and lengths of, the
+ strings in the index structures: suffix arrays, suffix trees and
+ BWT tables, and the construction algorithms for them.
+
+ By default it is 32 bits, which limits the strings to fewer than
+ 2^32 - 1 symbols, but keeps the arrays at four bytes per entry.
+ For larger strings, e.g. concatenations of many genomes, configure
+ the build with -DSTRALG_64BIT_INDEX=ON. Then positions are 64 bits
+ and the arrays take twice the memory. The choice is made when the
+ library is compiled, and code that uses it must be compiled with the
+ same setting (the CMake target exports it).
+
+ INDEX_MAX is the largest value of the type, which some algorithms
+ use as a marker for undefined entries, and PRIindex is the printf
+ conversion for it, as the PRIu32 family in inttypes.h.
+ */
+#ifdef STRALG_64BIT_INDEX
+typedef uint64_t index_t;
+#define INDEX_MAX UINT64_MAX
+#define PRIindex PRIu64
+#else
+typedef uint32_t index_t;
+#define INDEX_MAX UINT32_MAX
+#define PRIindex PRIu32
+#endif
+
+#endif
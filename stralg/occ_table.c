@@ -0,0 +1,595 @@
+#include "occ_table.h"
+#include "parallel.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+// Symbols per word in the packed layout
+#define PACKED_SYMBOLS_PER_WORD 32
+
+// Size of a cache line and of an interleaved block
+#define CACHE_LINE_SIZE 64
+
+// We only use threads for tables at least this long
+#define OCC_PARALLEL_THRESHOLD (1 << 20)
+
+_Static_assert(sizeof(struct occ_interleaved_block) == CACHE_LINE_SIZE,
+               "interleaved blocks must fill a cache line");
+
+#define ZERO_MASK_(k) 0,
+#define LOW_MASK_(k) (((uint64_t)1 << (k)) - 1),
+#define FULL_MASK_(k) ~(uint64_t)0,
+#define REP4_(F, k) F(k) F(k + 1) F(k + 2) F(k + 3)
+#define REP16_(F, k) REP4_(F, k) REP4_(F, k + 4) REP4_(F, k + 8) REP4_(F, k + 12)
+#define REP64_(F, k) REP16_(F, k) REP16_(F, k + 16) REP16_(F, k + 32) REP16_(F, k + 48)
+
+const uint64_t occ_interleaved_masks_[320] = {
+    REP64_(ZERO_MASK_, 0) REP64_(ZERO_MASK_, 64)
+    REP64_(LOW_MASK_, 0)
+    REP64_(FULL_MASK_, 0) REP64_(FULL_MASK_, 64)
+};
+
+static uint32_t checkpoints_per_block(
+    enum occ_layout layout,
+    uint32_t alphabet_size
+) {
+    switch (layout) {
+        case OCC_BIT_VECTORS: return alphabet_size;
+        case OCC_PACKED_DNA: return alphabet_size - 1;
+        case OCC_INTERLEAVED_DNA: return 0; // they are in the blocks
+        case OCC_WAVELET_MATRIX: return occ_wavelet_levels_(alphabet_size);
+    }
+    return 0;
+}
+
+static uint32_t words_per_block(
+    enum occ_layout layout,
+    uint32_t alphabet_size
+) {
+    switch (layout) {
+        case OCC_BIT_VECTORS: return alphabet_size;
+        case OCC_PACKED_DNA: return 2;
+        case OCC_INTERLEAVED_DNA: return 0; // they are in the blocks
+        case OCC_WAVELET_MATRIX: return occ_wavelet_levels_(alphabet_size);
+    }
+    return 0;
+}
+
+static index_t number_of_blocks(
+    enum occ_layout layout,
+    index_t length
+) {
+    // We need a block for index length as well, so
+    // one more than we need for the string itself.
+    if (layout == OCC_INTERLEAVED_DNA)
+        return length / OCC_INTERLEAVED_BLOCK_SIZE + 1;
+    else
+        return length / OCC_BLOCK_SIZE + 1;
+}
+
+void occ_table_sizes(
+    enum occ_layout layout,
+    uint32_t alphabet_size,
+    index_t length,
+    index_t *no_blocks,
+    index_t *no_checkpoints,
+    index_t *no_words
+) {
+    *no_blocks = number_of_blocks(layout, length);
+    *no_checkpoints = *no_blocks * checkpoints_per_block(layout, alphabet_size);
+    *no_words = *no_blocks * words_per_block(layout, alphabet_size);
+    // the zeros per level and where each symbol starts
+    if (layout == OCC_WAVELET_MATRIX)
+        *no_checkpoints += occ_wavelet_levels_(alphabet_size) + alphabet_size;
+}
+
+static void alloc_blocks(
+    struct occ_table *table
+) {
+    table->checkpoints = 0;
+    table->bits = 0;
+    table->blocks = 0;
+    if (table->layout == OCC_INTERLEAVED_DNA) {
+        size_t size = table->no_blocks * sizeof(struct occ_interleaved_block);
+        table->blocks = aligned_alloc(CACHE_LINE_SIZE, size);
+        memset(table->blocks, 0, size);
+        return;
+    }
+
+    index_t no_blocks, no_checkpoints, no_words;
+    occ_table_sizes(table->layout, table->alphabet_size, table->length,
+                    &no_blocks, &no_checkpoints, &no_words);
+    table->checkpoints = malloc(no_checkpoints * sizeof(*table->checkpoints));
+    table->bits = calloc(no_words, sizeof(*table->bits));
+}
+
+// The number of counts we keep per block, and where they are
+static uint32_t counts_per_block(
+    enum occ_layout layout,
+    uint32_t alphabet_size
+) {
+    if (layout == OCC_INTERLEAVED_DNA) return 4;
+    return checkpoints_per_block(layout, alphabet_size);
+}
+
+static index_t *block_counts(
+    struct occ_table *table,
+    index_t block
+) {
+    if (table->layout == OCC_INTERLEAVED_DNA)
+        return table->blocks[block].counts;
+    return table->checkpoints +
+        block * checkpoints_per_block(table->layout, table->alphabet_size);
+}
+
+// The fill functions fill in blocks [first_block, last_block).
+// The counts they put in the blocks start from the values in
+// counts, and when they are done, counts holds the totals.
+
+static void fill_bit_vectors(
+    struct occ_table *table,
+    const uint8_t *bwt,
+    index_t first_block, index_t last_block,
+    index_t *counts
+) {
+    uint32_t alphabet_size = table->alphabet_size;
+    for (index_t block = first_block; block < last_block; ++block) {
+        index_t *checkpoints = table->checkpoints + block * alphabet_size;
+        uint64_t *bits = table->bits + block * alphabet_size;
+        memcpy(checkpoints, counts, alphabet_size * sizeof(index_t));
+
+        index_t start = block * OCC_BLOCK_SIZE;
+        index_t end = start + OCC_BLOCK_SIZE;
+        if (end > table->length) end = table->length;
+        for (index_t i = start; i < end; ++i) {
+            uint8_t a = bwt[i];
+            assert(a < alphabet_size);
+            bits[a] |= (uint64_t)1 << (i - start);
+            counts[a]++;
+        }
+    }
+}
+
+static void fill_packed_dna(
+    struct occ_table *table,
+    const uint8_t *bwt,
+    index_t first_block, index_t last_block,
+    index_t *counts
+) {
+    uint32_t no_counts = table->alphabet_size - 1;
+    for (index_t block = first_block; block < last_block; ++block) {
+        index_t *checkpoints = table->checkpoints + block * no_counts;
+        uint64_t *words = table->bits + 2 * block;
+        memcpy(checkpoints, counts, no_counts * sizeof(index_t));
+
+        index_t start = block * OCC_BLOCK_SIZE;
+        index_t end = start + OCC_BLOCK_SIZE;
+        if (end > table->length) end = table->length;
+        for (index_t i = start; i < end; ++i) {
+            uint8_t a = bwt[i];
+            assert(a < table->alphabet_size);
+            if (a == 0) {
+                // the sentinel goes in as code zero; the rank
+                // function corrects for it.
+                table->sentinel_pos = i;
+                continue;
+            }
+            index_t j = i - start;
+            uint64_t code = a - 1;
+            words[j / PACKED_SYMBOLS_PER_WORD] |=
+                code << (2 * (j % PACKED_SYMBOLS_PER_WORD));
+            counts[a - 1]++;
+        }
+    }
+}
+
+static void fill_interleaved_dna(
+    struct occ_table *table,
+    const uint8_t *bwt,
+    index_t first_block, index_t last_block,
+    index_t *counts
+) {
+    for (index_t block_no = first_block; block_no < last_block; ++block_no) {
+        struct occ_interleaved_block *block = table->blocks + block_no;
+        memcpy(block->counts, counts, 4 * sizeof(index_t));
+
+        index_t start = block_no * OCC_INTERLEAVED_BLOCK_SIZE;
+        index_t end = start + OCC_INTERLEAVED_BLOCK_SIZE;
+        if (end > table->length) end = table->length;
+        for (index_t i = start; i < end; ++i) {
+            uint8_t a = bwt[i];
+            assert(a < table->alphabet_size);
+            if (a == 0) {
+                // As in the packed layout, the sentinel is
+                // code zero and rank corrects for it.
+                table->sentinel_pos = i;
+                continue;
+            }
+            index_t j = i - start;
+            uint64_t code = a - 1;
+            uint64_t *group = block->words + 2 * (j / 64);
+            group[0] |= (code & 1) << (j % 64);
+            group[1] |= (code >> 1) << (j % 64);
+            counts[a - 1]++;
+        }
+    }
+}
+
+// The wavelet matrix is built level by level: we write the bits of
+// the symbols in their current order, then stably move the symbols
+// with a zero bit before those with a one, which gives the order
+// for the next level.
+static void fill_wavelet_matrix(
+    struct occ_table *table,
+    const uint8_t *bwt
+) {
+    index_t n = table->length;
+    index_t no_blocks = table->no_blocks;
+    uint32_t levels = occ_wavelet_levels_(table->alphabet_size);
+    index_t *zeros = table->checkpoints + levels * no_blocks;
+
+    uint8_t *current = malloc(n + 1);
+    uint8_t *next = malloc(n + 1);
+    memcpy(current, bwt, n);
+
+    for (uint32_t l = 0; l < levels; ++l) {
+        uint32_t shift = levels - 1 - l;
+        uint64_t *bits = table->bits + l * no_blocks;
+        index_t *checkpoints = table->checkpoints + l * no_blocks;
+
+        index_t ones = 0;
+        for (index_t block = 0; block < no_blocks; ++block) {
+            checkpoints[block] = ones;
+            index_t start = block * OCC_BLOCK_SIZE;
+            index_t end = start + OCC_BLOCK_SIZE;
+            if (end > n) end = n;
+            uint64_t word = 0;
+            for (index_t i = start; i < end; ++i) {
+                uint64_t bit = (current[i] >> shift) & 1;
+                word |= bit << (i - start);
+            }
+            bits[block] = word;
+            ones += (index_t)__builtin_popcountll(word);
+        }
+        zeros[l] = n - ones;
+
+        index_t z = 0, o = zeros[l];
+        for (index_t i = 0; i < n; ++i) {
+            uint8_t a = current[i];
+            assert(a < table->alphabet_size);
+            if ((a >> shift) & 1) next[o++] = a;
+            else next[z++] = a;
+        }
+        uint8_t *tmp = current; current = next; next = tmp;
+    }
+
+    // Where each symbol's range starts at the bottom is where
+    // index zero ends up if we follow the symbol down the levels.
+    index_t *starts = zeros + levels;
+    for (uint32_t a = 0; a < table->alphabet_size; ++a) {
+        index_t i = 0;
+        for (uint32_t l = 0; l < levels; ++l) {
+            index_t ones = occ_wavelet_rank1_(table, l, i);
+            if ((a >> (levels - 1 - l)) & 1) i = zeros[l] + ones;
+            else i = i - ones;
+        }
+        starts[a] = i;
+    }
+
+    free(current);
+    free(next);
+}
+
+/*
+ Parallel construction. Each thread fills the blocks in its chunk,
+ with counts that start from zero at the beginning of the chunk.
+ Then we add up the totals of the chunks, and each thread adds the
+ counts before its chunk to its blocks. All passes over the BWT
+ string are sequential; only the fix-up touches the blocks twice.
+ */
+struct fill_job {
+    struct occ_table *table;
+    const uint8_t *bwt;
+    uint32_t no_counts;
+    index_t *chunk_counts; // no_counts per thread
+};
+
+static void fill_chunk(
+    void *data,
+    uint32_t thread_no,
+    uint32_t no_threads
+) {
+    struct fill_job *job = data;
+    struct occ_table *table = job->table;
+    index_t first_block = chunk_start(table->no_blocks, thread_no, no_threads, 1);
+    index_t last_block = chunk_start(table->no_blocks, thread_no + 1, no_threads, 1);
+    index_t *counts = job->chunk_counts + thread_no * job->no_counts;
+    memset(counts, 0, job->no_counts * sizeof(index_t));
+
+    switch (table->layout) {
+        case OCC_BIT_VECTORS:
+            fill_bit_vectors(table, job->bwt, first_block, last_block, counts);
+            break;
+        case OCC_PACKED_DNA:
+            fill_packed_dna(table, job->bwt, first_block, last_block, counts);
+            break;
+        case OCC_INTERLEAVED_DNA:
+            fill_interleaved_dna(table, job->bwt, first_block, last_block, counts);
+            break;
+        case OCC_WAVELET_MATRIX:
+            assert(false); // it is built with fill_wavelet_matrix()
+            break;
+    }
+}
+
+static void add_chunk_offsets(
+    void *data,
+    uint32_t thread_no,
+    uint32_t no_threads
+) {
+    struct fill_job *job = data;
+    struct occ_table *table = job->table;
+    if (thread_no == 0) return; // nothing comes before the first chunk
+    index_t first_block = chunk_start(table->no_blocks, thread_no, no_threads, 1);
+    index_t last_block = chunk_start(table->no_blocks, thread_no + 1, no_threads, 1);
+    const index_t *offsets = job->chunk_counts + thread_no * job->no_counts;
+    for (index_t block = first_block; block < last_block; ++block) {
+        index_t *counts = block_counts(table, block);
+        for (index_t a = 0; a < job->no_counts; ++a) {
+            counts[a] += offsets[a];
+        }
+    }
+}
+
+void init_occ_table_parallel(
+    struct occ_table *table,
+    const uint8_t *bwt,
+    index_t length,
+    uint32_t alphabet_size,
+    enum occ_layout layout,
+    uint32_t no_threads
+) {
+    assert(layout == OCC_BIT_VECTORS || layout == OCC_WAVELET_MATRIX ||
+           alphabet_size <= 5);
+    assert(layout != OCC_WAVELET_MATRIX || alphabet_size <= 256);
+
+    table->layout = layout;
+    table->length = length;
+    table->alphabet_size = alphabet_size;
+    table->sentinel_pos = length; // if there is no sentinel
+    table->no_blocks = number_of_blocks(layout, length);
+    alloc_blocks(table);
+
+    if (layout == OCC_WAVELET_MATRIX) {
+        fill_wavelet_matrix(table, bwt);
+        return;
+    }
+
+    if (no_threads == 0) no_threads = 1;
+    if (no_threads > table->no_blocks) no_threads = table->no_blocks;
+
+    uint32_t no_counts = counts_per_block(layout, alphabet_size);
+    index_t chunk_counts[no_threads * no_counts];
+    struct fill_job job = {
+        .table = table,
+        .bwt = bwt,
+        .no_counts = no_counts,
+        .chunk_counts = chunk_counts
+    };
+    run_in_parallel(no_threads, fill_chunk, &job);
+    if (no_threads == 1) return;
+
+    // Turn the chunk totals into the counts before each chunk
+    index_t running[no_counts];
+    memset(running, 0, no_counts * sizeof(index_t));
+    for (uint32_t t = 0; t < no_threads; ++t) {
+        index_t *counts = chunk_counts + t * no_counts;
+        for (index_t a = 0; a < no_counts; ++a) {
+            index_t total = counts[a];
+            counts[a] = running[a];
+            running[a] += total;
+        }
+    }
+    run_in_parallel(no_threads, add_chunk_offsets, &job);
+}
+
+void init_occ_table_layout(
+    struct occ_table *table,
+    const uint8_t *bwt,
+    index_t length,
+    uint32_t alphabet_size,
+    enum occ_layout layout
+) {
+    // Threads do not pay off for small tables
+    uint32_t no_threads =
+        (length >= OCC_PARALLEL_THRESHOLD) ? stralg_threads() : 1;
+    init_occ_table_parallel(table, bwt, length, alphabet_size,
+                            layout, no_threads);
+}
+
+void init_occ_table(
+    struct occ_table *table,
+    const uint8_t *bwt,
+    index_t length,
+    uint32_t alphabet_size
+) {
+    init_occ_table_layout(table, bwt, length, alphabet_size,
+                          default_occ_layout(alphabet_size));
+}
+
+struct occ_table *alloc_occ_table(
+    const uint8_t *bwt,
+    index_t length,
+    uint32_t alphabet_size
+) {
+    struct occ_table *table = malloc(sizeof(struct occ_table));
+    init_occ_table(table, bwt, length, alphabet_size);
+    return table;
+}
+
+void dealloc_occ_table(
+    struct occ_table *table
+) {
+    free(table->checkpoints);
+    free(table->bits);
+    free(table->blocks);
+}
+
+void free_occ_table(
+    struct occ_table *table
+) {
+    dealloc_occ_table(table);
+    free(table);
+}
+
+// Descend into the nodes of the wavelet matrix where [L,R) is
+// not empty. Going to the zeros first gives the symbols in
+// increasing order.
+static uint32_t wavelet_interval_symbols(
+    const struct occ_table *table,
+    uint32_t level, uint32_t levels,
+    uint32_t prefix,
+    index_t L, index_t R,
+    uint8_t *symbols,
+    index_t *ranks_L,
+    index_t *ranks_R
+) {
+    const index_t *zeros = table->checkpoints + levels * table->no_blocks;
+    if (level == levels) {
+        index_t start = zeros[levels + prefix];
+        symbols[0] = (uint8_t)prefix;
+        ranks_L[0] = L - start;
+        ranks_R[0] = R - start;
+        return 1;
+    }
+
+    index_t ones_L = occ_wavelet_rank1_(table, level, L);
+    index_t ones_R = occ_wavelet_rank1_(table, level, R);
+    uint32_t found = 0;
+    if (R - L > ones_R - ones_L) {
+        found += wavelet_interval_symbols(
+            table, level + 1, levels, prefix << 1,
+            L - ones_L, R - ones_R,
+            symbols + found, ranks_L + found, ranks_R + found
+        );
+    }
+    if (ones_R > ones_L) {
+        found += wavelet_interval_symbols(
+            table, level + 1, levels, (prefix << 1) | 1,
+            zeros[level] + ones_L, zeros[level] + ones_R,
+            symbols + found, ranks_L + found, ranks_R + found
+        );
+    }
+    return found;
+}
+
+uint32_t occ_interval_symbols(
+    const struct occ_table *table,
+    index_t L, index_t R,
+    uint8_t *symbols,
+    index_t *ranks_L,
+    index_t *ranks_R
+) {
+    if (L >= R) return 0;
+    if (table->layout == OCC_WAVELET_MATRIX) {
+        uint32_t levels = occ_wavelet_levels_(table->alphabet_size);
+        return wavelet_interval_symbols(table, 0, levels, 0, L, R,
+                                        symbols, ranks_L, ranks_R);
+    }
+
+    uint32_t found = 0;
+    for (uint32_t a = 0; a < table->alphabet_size; ++a) {
+        index_t rank_L = occ_rank(table, (uint8_t)a, L);
+        index_t rank_R = occ_rank(table, (uint8_t)a, R);
+        if (rank_L == rank_R) continue;
+        symbols[found] = (uint8_t)a;
+        ranks_L[found] = rank_L;
+        ranks_R[found] = rank_R;
+        found++;
+    }
+    return found;
+}
+
+
+void write_occ_table(
+    FILE *f,
+    const struct occ_table *table
+) {
+    index_t no_blocks, no_checkpoints, no_words;
+    occ_table_sizes(table->layout, table->alphabet_size, table->length,
+                    &no_blocks, &no_checkpoints, &no_words);
+    uint32_t layout = table->layout;
+    fwrite(&layout, sizeof(layout), 1, f);
+    fwrite(&table->length, sizeof(table->length), 1, f);
+    fwrite(&table->alphabet_size, sizeof(table->alphabet_size), 1, f);
+    fwrite(&table->sentinel_pos, sizeof(table->sentinel_pos), 1, f);
+    // The interleaved layout has neither checkpoints nor bits.
+    if (no_checkpoints)
+        fwrite(table->checkpoints, sizeof(*table->checkpoints), no_checkpoints, f);
+    if (no_words)
+        fwrite(table->bits, sizeof(*table->bits), no_words, f);
+    if (table->blocks)
+        fwrite(table->blocks, sizeof(*table->blocks), table->no_blocks, f);
+}
+
+struct occ_table *read_occ_table(
+    FILE *f
+) {
+    struct occ_table *table = malloc(sizeof(struct occ_table));
+    uint32_t layout;
+    fread(&layout, sizeof(layout), 1, f);
+    table->layout = layout;
+    fread(&table->length, sizeof(table->length), 1, f);
+    fread(&table->alphabet_size, sizeof(table->alphabet_size), 1, f);
+    fread(&table->sentinel_pos, sizeof(table->sentinel_pos), 1, f);
+    table->no_blocks = number_of_blocks(table->layout, table->length);
+    alloc_blocks(table);
+
+    index_t no_blocks, no_checkpoints, no_words;
+    occ_table_sizes(table->layout, table->alphabet_size, table->length,
+                    &no_blocks, &no_checkpoints, &no_words);
+    // The interleaved layout has neither checkpoints nor bits.
+    if (no_checkpoints)
+        fread(table->checkpoints, sizeof(*table->checkpoints), no_checkpoints, f);
+    if (no_words)
+        fread(table->bits, sizeof(*table->bits), no_words, f);
+    if (table->blocks)
+        fread(table->blocks, sizeof(*table->blocks), table->no_blocks, f);
+
+    return table;
+}
+
+
+bool identical_occ_tables(
+    const struct occ_table *table1,
+    const struct occ_table *table2
+) {
+    if (table1->layout != table2->layout)
+        return false;
+    if (table1->length != table2->length)
+        return false;
+    if (table1->alphabet_size != table2->alphabet_size)
+        return false;
+    if (table1->sentinel_pos != table2->sentinel_pos)
+        return false;
+
+    index_t no_blocks, no_checkpoints, no_words;
+    occ_table_sizes(table1->layout, table1->alphabet_size, table1->length,
+                    &no_blocks, &no_checkpoints, &no_words);
+    for (index_t i = 0; i < no_checkpoints; ++i) {
+        if (table1->checkpoints[i] != table2->checkpoints[i])
+            return false;
+    }
+    for (index_t i = 0; i < no_words; ++i) {
+        if (table1->bits[i] != table2->bits[i])
+            return false;
+    }
+    if (table1->blocks) {
+        size_t size = table1->no_blocks * sizeof(*table1->blocks);
+        if (memcmp(table1->blocks, table2->blocks, size) != 0)
+            return false;
+    }
+
+    return true;
+}
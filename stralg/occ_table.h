@@ -0,0 +1,474 @@
+#ifndef OCC_TABLE_H
+#define OCC_TABLE_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "index_type.h"
+
+/**
+ Rank structure over a BWT string.
+
+ The O table used in Burrows-Wheeler search, O(a,i), is the number
+ of occurrences of a in bwt[0,i). Storing it explicitly takes
+ alphabet_size * (n + 1) integers, which is far too much for
+ large strings. Instead, this structure keeps absolute counts
+ only at checkpoints, one for every OCC_BLOCK_SIZE positions,
+ and for each block a bit vector per symbol that has a one
+ where the BWT holds that symbol. A rank query is then a checkpoint
+ look-up plus a popcount of the relevant part of one word.
+
+ There are two layouts for the blocks. The general one, with a bit
+ vector per symbol, works for any alphabet and uses
+ alphabet_size * (4 + 8) / 64 bytes per position, i.e., less than
+ one byte per position for DNA. For alphabets of size at most five,
+ which is what you get from remapping DNA, the BWT string is
+ instead packed with two bits per symbol. The sentinel occurs exactly
+ once in a BWT string, so we keep its position on the side instead
+ of spending a third bit on every symbol. This layout uses half a
+ byte per position.
+
+ In both of these layouts, the checkpoints and the block data
+ live in different arrays, so a rank query touches two cache lines.
+ The interleaved DNA layout puts the four checkpoint counts and
+ 192 two-bit symbols together in one 64-byte, cache-line aligned
+ block, so a rank query costs a single cache miss. The symbols are
+ stored as bit planes, a word of low bits and a word of high bits
+ for each 64 symbols, so matching a symbol is two xors and an and.
+ It uses a third of a byte per position and is the default for DNA.
+ With 64-bit positions (see index_type.h) the counts take twice the
+ space, so a block only holds 128 symbols, and it uses half a byte.
+
+ The bit vector layout grows with the alphabet, which makes it
+ expensive for proteins or bytes. The wavelet matrix layout stores
+ the symbols as levels = ceil(log2(alphabet_size)) bit vectors, one
+ per bit of the symbol, with the most significant bit first. Level
+ l has the l'th bit of every symbol, in the order we get by stably
+ sorting the BWT on the bits before it, zeros first. A rank query
+ follows one symbol down the levels, with a binary rank at each, so
+ it costs levels cache misses instead of one, but the table uses
+ levels * (8 + 4) / 64 bytes per position, about a byte for
+ proteins. We use it by default for alphabets of at least
+ OCC_WAVELET_MIN_ALPHABET.
+
+ With the wavelet matrix, occ_interval_symbols() finds the symbols
+ that occur in a BWT interval by only descending into the parts of
+ the levels where the interval is not empty, so in a narrow
+ interval it does far fewer rank queries than trying every symbol.
+ */
+#define OCC_BLOCK_SIZE 64
+
+enum occ_layout {
+    OCC_BIT_VECTORS,     // One bit vector per symbol; any alphabet
+    OCC_PACKED_DNA,      // Two bits per symbol; alphabets of size <= 5
+    OCC_INTERLEAVED_DNA, // Two bits per symbol, in cache-line blocks; size <= 5
+    OCC_WAVELET_MATRIX   // One bit vector per bit of the symbols; any alphabet
+};
+
+// The smallest alphabet we use the wavelet matrix for by default.
+#define OCC_WAVELET_MIN_ALPHABET 17
+
+// Groups of 64 symbols, each stored as two bit planes. With
+// 64-bit counts there is only room for two groups in a cache line.
+#ifdef STRALG_64BIT_INDEX
+#define OCC_INTERLEAVED_GROUPS 2
+#else
+#define OCC_INTERLEAVED_GROUPS 3
+#endif
+#define OCC_INTERLEAVED_WORDS (2 * OCC_INTERLEAVED_GROUPS)
+#define OCC_INTERLEAVED_BLOCK_SIZE (64 * OCC_INTERLEAVED_GROUPS)
+
+// Must fill exactly one 64-byte cache line.
+struct occ_interleaved_block {
+    index_t counts[4]; // Counts for symbols 1 to 4 before the block
+    uint64_t words[OCC_INTERLEAVED_WORDS];
+};
+_Static_assert(sizeof(struct occ_interleaved_block) == 64,
+               "an interleaved block must fill a cache line");
+
+struct occ_table {
+    enum occ_layout layout;
+    index_t length;        // Length of the BWT string (n + 1 for a string of length n)
+    uint32_t alphabet_size;
+    index_t no_blocks;
+    index_t sentinel_pos;  // Only used in the packed layouts
+    // Counts per block of the number of occurrences before the
+    // block starts. There are alphabet_size counts per block in the
+    // bit vector layout and alphabet_size - 1 in the packed layout
+    // (we do not count the sentinel there).
+    index_t *checkpoints;
+    // The block data: alphabet_size words per block in the bit
+    // vector layout and two words (32 symbols each) per block
+    // in the packed layout.
+    //
+    // The wavelet matrix stores level l in words
+    // [l * no_blocks, (l + 1) * no_blocks) of bits, with the
+    // number of ones before each word in the same entries of
+    // checkpoints. After the levels, checkpoints holds the number
+    // of zeros in each level, and then, for each symbol, the row
+    // its path through the levels starts from at the bottom.
+    uint64_t *bits;
+    // Checkpoints and data together in the interleaved layout,
+    // where checkpoints and bits are not used.
+    struct occ_interleaved_block *blocks;
+};
+
+/**
+ The layout init_occ_table() uses for an alphabet.
+ */
+static inline enum occ_layout default_occ_layout(uint32_t alphabet_size)
+{
+    if (alphabet_size <= 5) return OCC_INTERLEAVED_DNA;
+    if (alphabet_size >= OCC_WAVELET_MIN_ALPHABET) return OCC_WAVELET_MATRIX;
+    return OCC_BIT_VECTORS;
+}
+
+/**
+ Initialise a rank structure.
+
+ The layout is chosen from the alphabet size; if you need
+ a specific layout use init_occ_table_layout().
+
+ @param table The table to initialise.
+ @param bwt   The BWT string. It need not be null-terminated (it
+ contains the sentinel somewhere) so you must provide the length.
+ @param length The length of the bwt string.
+ @param alphabet_size The number of symbols, including the sentinel.
+ */
+void init_occ_table(
+    struct occ_table *table,
+    const uint8_t *bwt,
+    index_t length,
+    uint32_t alphabet_size
+);
+void init_occ_table_layout(
+    struct occ_table *table,
+    const uint8_t *bwt,
+    index_t length,
+    uint32_t alphabet_size,
+    enum occ_layout layout
+);
+/**
+ Initialise a rank structure using several threads.
+
+ The threads each fill in a chunk of the table in one sequential
+ pass over their part of the BWT string and then correct the counts
+ with the totals of the chunks before them. The result is the same
+ as with a single thread. The other init functions use this one,
+ with the number of threads from stralg_threads() for large tables.
+ Each level of the wavelet matrix depends on the order of the one
+ above it, so we build that layout with a single thread.
+
+ @param no_threads The number of threads to use.
+ */
+void init_occ_table_parallel(
+    struct occ_table *table,
+    const uint8_t *bwt,
+    index_t length,
+    uint32_t alphabet_size,
+    enum occ_layout layout,
+    uint32_t no_threads
+);
+struct occ_table *alloc_occ_table(
+    const uint8_t *bwt,
+    index_t length,
+    uint32_t alphabet_size
+);
+void dealloc_occ_table(
+    struct occ_table *table
+);
+void free_occ_table(
+    struct occ_table *table
+);
+
+/**
+ The number of entries in the blocks, checkpoints and bits arrays
+ of a table with the given layout, alphabet and BWT length. It is
+ for code that keeps the arrays elsewhere, such as an index file
+ we map into memory; it can then point a table at them.
+ */
+void occ_table_sizes(
+    enum occ_layout layout,
+    uint32_t alphabet_size,
+    index_t length,
+    index_t *no_blocks,
+    index_t *no_checkpoints,
+    index_t *no_words
+);
+
+static inline uint64_t occ_low_bits_(uint32_t k)
+{
+    return (k >= 64) ? ~(uint64_t)0 : ((uint64_t)1 << k) - 1;
+}
+
+static inline index_t occ_bit_vectors_rank_(
+    const struct occ_table *table,
+    uint8_t a,
+    index_t i
+) {
+    index_t block = i / OCC_BLOCK_SIZE;
+    index_t offset = i % OCC_BLOCK_SIZE;
+    index_t idx = block * table->alphabet_size + a;
+    return table->checkpoints[idx] +
+        (index_t)__builtin_popcountll(table->bits[idx] & occ_low_bits_(offset));
+}
+
+// Count the two-bit codes in word that are equal to code. The
+// result has the low bit set in each two-bit slot that matches.
+static inline uint64_t occ_packed_matches_(uint64_t word, uint8_t code)
+{
+    uint64_t x = word ^ (code * 0x5555555555555555ull);
+    return ~(x | (x >> 1)) & 0x5555555555555555ull;
+}
+
+static inline index_t occ_packed_dna_rank_(
+    const struct occ_table *table,
+    uint8_t a,
+    index_t i
+) {
+    if (a == 0) return i > table->sentinel_pos;
+
+    index_t block = i / OCC_BLOCK_SIZE;
+    index_t offset = i % OCC_BLOCK_SIZE;
+    index_t count = table->checkpoints[block * (table->alphabet_size - 1) + a - 1];
+    const uint64_t *words = table->bits + 2 * block;
+    uint8_t code = a - 1;
+
+    // Two bits per symbol, so offset symbols span 2 * offset bits
+    // over the two words in the block.
+    uint64_t mask0 = occ_low_bits_(2 * offset);
+    uint64_t mask1 = (offset > 32) ? occ_low_bits_(2 * (offset - 32)) : 0;
+    count += (index_t)__builtin_popcountll(occ_packed_matches_(words[0], code) & mask0);
+    count += (index_t)__builtin_popcountll(occ_packed_matches_(words[1], code) & mask1);
+
+    // The sentinel is stored as code zero, so we have counted
+    // it as a 1 if it is in the range we looked at.
+    index_t block_start = block * OCC_BLOCK_SIZE;
+    if (a == 1 && block_start <= table->sentinel_pos && table->sentinel_pos < i)
+        count--;
+
+    return count;
+}
+
+static inline uint32_t occ_wavelet_levels_(uint32_t alphabet_size)
+{
+    return (alphabet_size <= 2) ? 1 : 32 - (uint32_t)__builtin_clz(alphabet_size - 1);
+}
+
+// The number of ones before index i in a level of the wavelet matrix.
+static inline index_t occ_wavelet_rank1_(
+    const struct occ_table *table,
+    uint32_t level,
+    index_t i
+) {
+    index_t idx = level * table->no_blocks + i / OCC_BLOCK_SIZE;
+    return table->checkpoints[idx] +
+        (index_t)__builtin_popcountll(table->bits[idx] &
+                                      occ_low_bits_(i % OCC_BLOCK_SIZE));
+}
+
+// We follow i down the levels, to the zeros or the ones as the bits
+// of a say. At the bottom, the occurrences of a are a contiguous
+// range, and we know where it starts, so the rank is the offset of
+// i into it.
+static inline index_t occ_wavelet_matrix_rank_(
+    const struct occ_table *table,
+    uint8_t a,
+    index_t i
+) {
+    uint32_t levels = occ_wavelet_levels_(table->alphabet_size);
+    const index_t *zeros = table->checkpoints + levels * table->no_blocks;
+    for (uint32_t l = 0; l < levels; ++l) {
+        index_t ones = occ_wavelet_rank1_(table, l, i);
+        if ((a >> (levels - 1 - l)) & 1) i = zeros[l] + ones;
+        else i = i - ones;
+    }
+    return i - zeros[levels + a];
+}
+
+// Masks for the interleaved layout; entry 128 + k has the low k
+// bits set, clamped to 0 and 64 bits, for k from -128 to 191.
+extern const uint64_t occ_interleaved_masks_[320];
+
+static inline index_t occ_interleaved_dna_rank_(
+    const struct occ_table *table,
+    uint8_t a,
+    index_t i
+) {
+    if (a == 0) return i > table->sentinel_pos;
+
+    index_t block_no = i / OCC_INTERLEAVED_BLOCK_SIZE;
+    index_t offset = i % OCC_INTERLEAVED_BLOCK_SIZE;
+    const struct occ_interleaved_block *block = table->blocks + block_no;
+    uint8_t code = a - 1;
+
+    // Each group of 64 symbols is a word of low bits and a word
+    // of high bits. Flipping the planes where code has a zero bit
+    // leaves ones exactly where the symbol is code. We mask all
+    // the groups, with masks from a table, rather than loop up to
+    // offset; that avoids unpredictable branches.
+    uint64_t flip_low = (uint64_t)(code & 1) - 1;
+    uint64_t flip_high = (uint64_t)((code >> 1) & 1) - 1;
+    const uint64_t *masks = occ_interleaved_masks_ + 128 + offset;
+    index_t count = block->counts[code];
+    for (uint32_t g = 0; g < OCC_INTERLEAVED_GROUPS; ++g) {
+        uint64_t matches = (block->words[2 * g] ^ flip_low) &
+            (block->words[2 * g + 1] ^ flip_high);
+        count += (index_t)__builtin_popcountll(matches & *(masks - 64 * g));
+    }
+
+    index_t block_start = block_no * OCC_INTERLEAVED_BLOCK_SIZE;
+    if (a == 1 && block_start <= table->sentinel_pos && table->sentinel_pos < i)
+        count--;
+
+    return count;
+}
+
+/**
+ Number of occurrences of a in bwt[0,i).
+
+ The index i can be anything from zero to the length of
+ the BWT string, both included.
+ */
+static inline index_t occ_rank(
+    const struct occ_table *table,
+    uint8_t a,
+    index_t i
+) {
+    switch (table->layout) {
+        case OCC_INTERLEAVED_DNA:
+            return occ_interleaved_dna_rank_(table, a, i);
+        case OCC_WAVELET_MATRIX:
+            return occ_wavelet_matrix_rank_(table, a, i);
+        case OCC_PACKED_DNA:
+            return occ_packed_dna_rank_(table, a, i);
+        case OCC_BIT_VECTORS:
+        default:
+            return occ_bit_vectors_rank_(table, a, i);
+    }
+}
+
+/**
+ The symbol at index i in the BWT string.
+
+ We do not store the BWT string itself, but we can
+ recover it from the rank structure.
+ */
+static inline uint8_t occ_symbol(
+    const struct occ_table *table,
+    index_t i
+) {
+    index_t block = i / OCC_BLOCK_SIZE;
+    index_t offset = i % OCC_BLOCK_SIZE;
+    switch (table->layout) {
+        case OCC_INTERLEAVED_DNA: {
+            if (i == table->sentinel_pos) return 0;
+            block = i / OCC_INTERLEAVED_BLOCK_SIZE;
+            offset = i % OCC_INTERLEAVED_BLOCK_SIZE;
+            const uint64_t *group = table->blocks[block].words + 2 * (offset / 64);
+            uint8_t low = (group[0] >> (offset % 64)) & 1;
+            uint8_t high = (group[1] >> (offset % 64)) & 1;
+            return 1 + (low | (high << 1));
+        }
+        case OCC_PACKED_DNA: {
+            if (i == table->sentinel_pos) return 0;
+            uint64_t word = table->bits[2 * block + offset / 32];
+            return 1 + ((word >> (2 * (offset % 32))) & 3);
+        }
+        case OCC_WAVELET_MATRIX: {
+            uint32_t levels = occ_wavelet_levels_(table->alphabet_size);
+            const index_t *zeros = table->checkpoints + levels * table->no_blocks;
+            uint8_t a = 0;
+            for (uint32_t l = 0; l < levels; ++l) {
+                index_t idx = l * table->no_blocks + i / OCC_BLOCK_SIZE;
+                uint8_t bit = (table->bits[idx] >> (i % OCC_BLOCK_SIZE)) & 1;
+                index_t ones = occ_wavelet_rank1_(table, l, i);
+                i = bit ? zeros[l] + ones : i - ones;
+                a = (uint8_t)((a << 1) | bit);
+            }
+            return a;
+        }
+        case OCC_BIT_VECTORS:
+        default: {
+            const uint64_t *bits = table->bits + block * table->alphabet_size;
+            uint8_t a = 0;
+            while (!((bits[a] >> offset) & 1)) a++;
+            return a;
+        }
+    }
+}
+
+/**
+ Prefetch the memory that occ_rank(table, a, i) will read.
+
+ This does not change anything, but if you issue it well before
+ the rank query, the query will not have to wait for memory.
+ */
+static inline void occ_prefetch(
+    const struct occ_table *table,
+    uint8_t a,
+    index_t i
+) {
+    switch (table->layout) {
+        case OCC_INTERLEAVED_DNA:
+            __builtin_prefetch(table->blocks + i / OCC_INTERLEAVED_BLOCK_SIZE);
+            break;
+        case OCC_PACKED_DNA: {
+            index_t block = i / OCC_BLOCK_SIZE;
+            __builtin_prefetch(table->checkpoints + block * (table->alphabet_size - 1));
+            __builtin_prefetch(table->bits + 2 * block);
+            break;
+        }
+        case OCC_WAVELET_MATRIX: {
+            // We only know where the first level is; the
+            // others depend on what we find there.
+            __builtin_prefetch(table->checkpoints + i / OCC_BLOCK_SIZE);
+            __builtin_prefetch(table->bits + i / OCC_BLOCK_SIZE);
+            break;
+        }
+        case OCC_BIT_VECTORS:
+        default: {
+            index_t idx = (i / OCC_BLOCK_SIZE) * table->alphabet_size + a;
+            __builtin_prefetch(table->checkpoints + idx);
+            __builtin_prefetch(table->bits + idx);
+            break;
+        }
+    }
+}
+
+/**
+ The symbols that occur in bwt[L,R).
+
+ Puts the symbols, in increasing order, in symbols, and for each
+ of them the ranks occ_rank(table, a, L) and occ_rank(table, a, R)
+ in ranks_L and ranks_R. The arrays must have room for
+ alphabet_size entries. With the wavelet matrix we only look at
+ the symbols that are there; with the other layouts we try them all.
+
+ @return The number of symbols.
+ */
+uint32_t occ_interval_symbols(
+    const struct occ_table *table,
+    index_t L, index_t R,
+    uint8_t *symbols,
+    index_t *ranks_L,
+    index_t *ranks_R
+);
+
+// Serialisation -- FIXME: error handling!
+void write_occ_table(
+    FILE *f,
+    const struct occ_table *table
+);
+struct occ_table *read_occ_table(
+    FILE *f
+);
+
+// Mostly for debugging
+bool identical_occ_tables(
+    const struct occ_table *table1,
+    const struct occ_table *table2
+);
+
+#endif
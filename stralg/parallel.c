@@ -0,0 +1,66 @@
+#include "parallel.h"
+
+#include <pthread.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+
+static uint32_t no_threads_setting = 0;
+
+uint32_t stralg_threads(void)
+{
+    if (no_threads_setting > 0) return no_threads_setting;
+    long no_processors = sysconf(_SC_NPROCESSORS_ONLN);
+    return (no_processors > 0) ? (uint32_t)no_processors : 1;
+}
+
+void set_stralg_threads(uint32_t no_threads)
+{
+    no_threads_setting = no_threads;
+}
+
+struct thread_call {
+    void (*f)(void *data, uint32_t thread_no, uint32_t no_threads);
+    void *data;
+    uint32_t thread_no;
+    uint32_t no_threads;
+};
+
+static void *run_call(void *arg)
+{
+    struct thread_call *call = arg;
+    call->f(call->data, call->thread_no, call->no_threads);
+    return 0;
+}
+
+void run_in_parallel(
+    uint32_t no_threads,
+    void (*f)(void *data, uint32_t thread_no, uint32_t no_threads),
+    void *data
+) {
+    assert(no_threads > 0);
+    if (no_threads == 1) {
+        f(data, 0, 1);
+        return;
+    }
+
+    struct thread_call calls[no_threads];
+    pthread_t threads[no_threads];
+    bool started[no_threads];
+    for (uint32_t t = 0; t < no_threads; ++t) {
+        calls[t] = (struct thread_call){
+            .f = f, .data = data, .thread_no = t, .no_threads = no_threads
+        };
+    }
+    // If we cannot start a thread, we run its
+    // share of the work ourselves.
+    for (uint32_t t = 1; t < no_threads; ++t) {
+        started[t] = pthread_create(&threads[t], 0, run_call, &calls[t]) == 0;
+    }
+    run_call(&calls[0]);
+    for (uint32_t t = 1; t < no_threads; ++t) {
+        if (started[t]) pthread_join(threads[t], 0);
+        else run_call(&calls[t]);
+    }
+}
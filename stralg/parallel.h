@@ -0,0 +1,61 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <stdint.h>
+
+#include "index_type.h"
+
+/**
+ The number of threads construction algorithms may use.
+ 
+ It is the number set with set_stralg_threads(), or, if that
+ is zero (the default), the number of processors.
+ */
+uint32_t stralg_threads(void);
+
+/**
+ Set the number of threads construction algorithms may use.
+ 
+ @param no_threads The number of threads; zero means
+ one per processor.
+ */
+void set_stralg_threads(uint32_t no_threads);
+
+/**
+ Run a function in several threads and wait for them.
+ 
+ Calls f(data, t, no_threads) for each t from zero to
+ no_threads - 1, each call in its own thread, except for t == 0
+ that runs in the calling thread. The function returns when
+ all the calls have returned.
+ 
+ @param no_threads The number of calls.
+ @param f          The function to call.
+ @param data       The data to give the function.
+ */
+void run_in_parallel(
+    uint32_t no_threads,
+    void (*f)(void *data, uint32_t thread_no, uint32_t no_threads),
+    void *data
+);
+
+/**
+ Split [0,n) into chunks for parallel work.
+ 
+ Chunk t of no_chunks starts at the returned index; the chunks
+ are as equal in size as we can make them while starting at
+ multiples of align.
+ */
+static inline index_t chunk_start(
+    index_t n,
+    uint32_t t,
+    uint32_t no_chunks,
+    uint32_t align
+) {
+    if (t >= no_chunks) return n;
+    uint64_t start = ((uint64_t)n * t) / no_chunks;
+    start -= start % align;
+    return (index_t)start;
+}
+
+#endif
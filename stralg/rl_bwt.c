@@ -0,0 +1,555 @@
+#include "rl_bwt.h"
+#include "suffix_array_internal.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+// The run that contains row i: the last run that starts at or before it.
+static index_t find_run(
+    const struct rl_bwt_table *table,
+    index_t i
+) {
+    index_t lo = 0, hi = table->no_runs;
+    while (hi - lo > 1) {
+        index_t mid = lo + (hi - lo) / 2;
+        if (table->run_starts[mid] <= i) lo = mid;
+        else hi = mid;
+    }
+    return lo;
+}
+
+static inline index_t symbol_count(
+    const struct rl_bwt_table *table,
+    uint8_t a
+) {
+    uint32_t alphabet_size = table->remap_table->alphabet_size;
+    index_t end = (a + 1u < alphabet_size) ? table->c_table[a + 1] : table->length;
+    return end - table->c_table[a];
+}
+
+// The rank of a at i, and in *run the entry, among the runs of a,
+// of the last run of a that starts before i. If there is none,
+// the rank is zero and *run is symbol_first[a] - 1, which can wrap.
+static index_t rank_and_run(
+    const struct rl_bwt_table *table,
+    uint8_t a,
+    index_t i,
+    index_t *run
+) {
+    index_t first = table->symbol_first[a];
+    index_t lo = first, hi = table->symbol_first[a + 1];
+    const index_t *starts = table->symbol_run_starts;
+    while (lo < hi) {
+        index_t mid = lo + (hi - lo) / 2;
+        if (starts[mid] < i) lo = mid + 1;
+        else hi = mid;
+    }
+    *run = lo - 1;
+    if (lo == first) return 0;
+
+    // The run ends where the next run of a begins its count.
+    index_t p = lo - 1;
+    index_t rank = table->symbol_run_ranks[p];
+    index_t next_rank = (lo < table->symbol_first[a + 1]) ?
+        table->symbol_run_ranks[lo] : symbol_count(table, a);
+    index_t offset = i - starts[p];
+    index_t length = next_rank - rank;
+    return rank + ((offset < length) ? offset : length);
+}
+
+index_t rl_bwt_rank(
+    const struct rl_bwt_table *table,
+    uint8_t a,
+    index_t i
+) {
+    index_t run;
+    return rank_and_run(table, a, i, &run);
+}
+
+uint8_t rl_bwt_symbol(
+    const struct rl_bwt_table *table,
+    index_t i
+) {
+    return table->run_symbols[find_run(table, i)];
+}
+
+// Find the runs in the BWT string and build everything
+// but the suffix array samples.
+static void init_runs(
+    struct rl_bwt_table *table,
+    const uint8_t *bwt_string,
+    index_t length,
+    struct remap_table *remap_table
+) {
+    uint32_t alphabet_size = remap_table->alphabet_size;
+    table->remap_table = remap_table;
+    table->length = length;
+
+    index_t no_runs = 1;
+    for (index_t i = 1; i < length; ++i) {
+        no_runs += bwt_string[i] != bwt_string[i - 1];
+    }
+    table->no_runs = no_runs;
+    table->run_starts = malloc((no_runs + 1) * sizeof(*table->run_starts));
+    table->run_symbols = malloc(no_runs * sizeof(*table->run_symbols));
+
+    table->c_table = calloc(alphabet_size, sizeof(*table->c_table));
+    table->symbol_first = calloc(alphabet_size + 1, sizeof(*table->symbol_first));
+    index_t run = 0;
+    for (index_t i = 0; i < length; ++i) {
+        uint8_t a = bwt_string[i];
+        if (i == 0 || a != bwt_string[i - 1]) {
+            table->run_starts[run] = i;
+            table->run_symbols[run] = a;
+            table->symbol_first[a + 1]++;
+            run++;
+        }
+        if (a + 1u < alphabet_size) table->c_table[a + 1]++;
+    }
+    table->run_starts[no_runs] = length;
+    for (uint32_t a = 1; a < alphabet_size; ++a) {
+        table->c_table[a] += table->c_table[a - 1];
+    }
+    for (uint32_t a = 1; a <= alphabet_size; ++a) {
+        table->symbol_first[a] += table->symbol_first[a - 1];
+    }
+
+    // Distribute the runs on their symbols; we get them
+    // in BWT order within each symbol.
+    table->symbol_run_starts = malloc(no_runs * sizeof(*table->symbol_run_starts));
+    table->symbol_run_ranks = malloc(no_runs * sizeof(*table->symbol_run_ranks));
+    table->symbol_run_last_sa = malloc(no_runs * sizeof(*table->symbol_run_last_sa));
+    index_t next[alphabet_size];
+    index_t rank[alphabet_size];
+    for (uint32_t a = 0; a < alphabet_size; ++a) {
+        next[a] = table->symbol_first[a];
+        rank[a] = 0;
+    }
+    for (index_t k = 0; k < no_runs; ++k) {
+        uint8_t a = table->run_symbols[k];
+        index_t slot = next[a]++;
+        table->symbol_run_starts[slot] = table->run_starts[k];
+        table->symbol_run_ranks[slot] = rank[a];
+        rank[a] += table->run_starts[k + 1] - table->run_starts[k];
+    }
+
+    table->no_phi_samples = no_runs - 1;
+    table->phi_keys = malloc(no_runs * sizeof(*table->phi_keys));
+    table->phi_values = malloc(no_runs * sizeof(*table->phi_values));
+}
+
+// Collects the suffix array values at the run boundaries.
+struct sample_rows {
+    const struct rl_bwt_table *table;
+    const uint8_t *bwt_string;
+    index_t *first_sa; // for each run, the value at its first row
+    index_t *last_sa;  // and at its last
+};
+
+static void sample_row(
+    void *data,
+    index_t row,
+    index_t value
+) {
+    struct sample_rows *rows = data;
+    const uint8_t *bwt_string = rows->bwt_string;
+    index_t length = rows->table->length;
+    bool first = row == 0 || bwt_string[row] != bwt_string[row - 1];
+    bool last = row == length - 1 || bwt_string[row] != bwt_string[row + 1];
+    if (!first && !last) return;
+
+    index_t k = find_run(rows->table, row);
+    if (first) rows->first_sa[k] = value;
+    if (last) rows->last_sa[k] = value;
+}
+
+struct phi_sample {
+    index_t key, value;
+};
+
+static int compare_phi_samples(const void *a, const void *b)
+{
+    const struct phi_sample *x = a, *y = b;
+    return (x->key > y->key) - (x->key < y->key);
+}
+
+// Move the samples from run order to where the table needs them.
+static void finish_samples(
+    struct rl_bwt_table *table,
+    const struct sample_rows *rows
+) {
+    uint32_t alphabet_size = table->remap_table->alphabet_size;
+    index_t next[alphabet_size];
+    for (uint32_t a = 0; a < alphabet_size; ++a) {
+        next[a] = table->symbol_first[a];
+    }
+    for (index_t k = 0; k < table->no_runs; ++k) {
+        uint8_t a = table->run_symbols[k];
+        table->symbol_run_last_sa[next[a]++] = rows->last_sa[k];
+    }
+
+    // The row before the first row of run k is the
+    // last row of run k - 1.
+    index_t no_samples = table->no_phi_samples;
+    struct phi_sample *samples = malloc((no_samples + 1) * sizeof(*samples));
+    for (index_t k = 1; k < table->no_runs; ++k) {
+        samples[k - 1].key = rows->first_sa[k];
+        samples[k - 1].value = rows->last_sa[k - 1];
+    }
+    qsort(samples, no_samples, sizeof(*samples), compare_phi_samples);
+    for (index_t j = 0; j < no_samples; ++j) {
+        table->phi_keys[j] = samples[j].key;
+        table->phi_values[j] = samples[j].value;
+    }
+    free(samples);
+}
+
+void init_rl_bwt_table(
+    struct rl_bwt_table *table,
+    const struct suffix_array *sa,
+    struct remap_table *remap_table
+) {
+    index_t length = sa->length;
+    // Zeroed so an empty array doesn't hand init_runs() garbage.
+    uint8_t *bwt_string = calloc(length, sizeof(uint8_t));
+    for (index_t i = 0; i < length; ++i) {
+        index_t suf = sa->array[i];
+        bwt_string[i] = (suf == 0) ? 0 : sa->string[suf - 1];
+    }
+    init_runs(table, bwt_string, length, remap_table);
+
+    struct sample_rows rows = {
+        .table = table,
+        .bwt_string = bwt_string,
+        .first_sa = malloc(table->no_runs * sizeof(index_t)),
+        .last_sa = malloc(table->no_runs * sizeof(index_t))
+    };
+    for (index_t i = 0; i < length; ++i) {
+        sample_row(&rows, i, sa->array[i]);
+    }
+    finish_samples(table, &rows);
+
+    free(rows.first_sa);
+    free(rows.last_sa);
+    free(bwt_string);
+}
+
+struct rl_bwt_table *alloc_rl_bwt_table(
+    const struct suffix_array *sa,
+    struct remap_table *remap_table
+) {
+    struct rl_bwt_table *table = malloc(sizeof(struct rl_bwt_table));
+    init_rl_bwt_table(table, sa, remap_table);
+    return table;
+}
+
+void dealloc_rl_bwt_table(struct rl_bwt_table *table)
+{
+    free(table->c_table);
+    free(table->run_starts);
+    free(table->run_symbols);
+    free(table->symbol_first);
+    free(table->symbol_run_starts);
+    free(table->symbol_run_ranks);
+    free(table->symbol_run_last_sa);
+    free(table->phi_keys);
+    free(table->phi_values);
+}
+
+void free_rl_bwt_table(struct rl_bwt_table *table)
+{
+    dealloc_rl_bwt_table(table);
+    free(table);
+}
+
+struct bwt_string_rows {
+    const uint8_t *string;
+    uint8_t *bwt_string;
+    index_t no_rows; // how many rows SA-IS has reported
+};
+
+static void bwt_row(
+    void *data,
+    index_t row,
+    index_t value
+) {
+    struct bwt_string_rows *rows = data;
+    rows->bwt_string[row] = (value == 0) ? 0 : rows->string[value - 1];
+    rows->no_rows++;
+}
+
+struct rl_bwt_table *build_rl_bwt_table(const uint8_t *string)
+{
+    index_t n = (index_t)strlen((const char *)string);
+    struct remap_table *remap_table = alloc_remap_table(string);
+    uint8_t *remapped_str = malloc(n + 1);
+    if (!remapped_str) {
+        free_remap_table(remap_table);
+        return 0;
+    }
+    remap(remapped_str, string, remap_table);
+    uint32_t alphabet_size = remap_table->alphabet_size;
+
+    // The first pass gives us the BWT, so we know the runs...
+    struct bwt_string_rows bwt_rows = {
+        .string = remapped_str,
+        .bwt_string = malloc(n + 1),
+        .no_rows = 0
+    };
+    struct sa_row_output_ out = { .f = bwt_row, .data = &bwt_rows };
+    // We only have the BWT if SA-IS ran and reported every row.
+    uint8_t *bwt_string = 0;
+    if (bwt_rows.bwt_string &&
+        sa_is_mem_rows_(remapped_str, alphabet_size, &out) &&
+        bwt_rows.no_rows == n + 1) {
+        bwt_string = bwt_rows.bwt_string;
+    }
+    if (!bwt_string) {
+        free(bwt_rows.bwt_string);
+        free(remapped_str);
+        free_remap_table(remap_table);
+        return 0;
+    }
+
+    struct rl_bwt_table *table = malloc(sizeof(struct rl_bwt_table));
+    init_runs(table, bwt_string, n + 1, remap_table);
+
+    // ...and the second the samples at their boundaries.
+    struct sample_rows rows = {
+        .table = table,
+        .bwt_string = bwt_string,
+        .first_sa = malloc(table->no_runs * sizeof(index_t)),
+        .last_sa = malloc(table->no_runs * sizeof(index_t))
+    };
+    out.f = sample_row;
+    out.data = &rows;
+    bool sampled = rows.first_sa && rows.last_sa &&
+        sa_is_mem_rows_(remapped_str, alphabet_size, &out);
+    if (sampled) finish_samples(table, &rows);
+
+    free(rows.first_sa);
+    free(rows.last_sa);
+    free(bwt_string);
+    free(remapped_str);
+    if (!sampled) {
+        completely_free_rl_bwt_table(table);
+        return 0;
+    }
+    return table;
+}
+
+void completely_free_rl_bwt_table(struct rl_bwt_table *table)
+{
+    free_remap_table(table->remap_table);
+    free_rl_bwt_table(table);
+}
+
+size_t rl_bwt_table_size(const struct rl_bwt_table *table)
+{
+    size_t alphabet_size = table->remap_table->alphabet_size;
+    size_t no_runs = table->no_runs;
+    return sizeof(*table)
+        + alphabet_size * sizeof(*table->c_table)
+        + (no_runs + 1) * sizeof(*table->run_starts)
+        + no_runs * sizeof(*table->run_symbols)
+        + (alphabet_size + 1) * sizeof(*table->symbol_first)
+        + 3 * no_runs * sizeof(index_t)
+        + 2 * no_runs * sizeof(index_t);
+}
+
+// Backward search. If last_sa is not null, we keep the suffix array
+// value of the last row of the interval in it.
+static void backward_search(
+    const struct rl_bwt_table *table,
+    const uint8_t *remapped_pattern,
+    index_t *L, index_t *R,
+    index_t *last_sa
+) {
+    *L = 0;
+    *R = table->length;
+    if (last_sa) {
+        // The last row is in the last run, which
+        // is the last run of its symbol.
+        uint8_t a = table->run_symbols[table->no_runs - 1];
+        *last_sa = table->symbol_run_last_sa[table->symbol_first[a + 1] - 1];
+    }
+
+    index_t m = (index_t)strlen((const char *)remapped_pattern);
+    for (index_t i = m; i > 0 && *L < *R; --i) {
+        uint8_t a = remapped_pattern[i - 1];
+        index_t run;
+        index_t rank_L = rl_bwt_rank(table, a, *L);
+        index_t rank_R = rank_and_run(table, a, *R, &run);
+        if (last_sa && rank_L < rank_R) {
+            // If row R - 1 is in the run, it LF-maps to the new last
+            // row; otherwise the run ends inside the interval.
+            index_t next_rank = (run + 1 < table->symbol_first[a + 1]) ?
+                table->symbol_run_ranks[run + 1] : symbol_count(table, a);
+            index_t run_end = table->symbol_run_starts[run] +
+                (next_rank - table->symbol_run_ranks[run]);
+            *last_sa = ((run_end >= *R) ? *last_sa :
+                        table->symbol_run_last_sa[run]) - 1;
+        }
+        *L = table->c_table[a] + rank_L;
+        *R = table->c_table[a] + rank_R;
+    }
+}
+
+index_t rl_bwt_count(
+    const struct rl_bwt_table *table,
+    const uint8_t *remapped_pattern
+) {
+    index_t L, R;
+    backward_search(table, remapped_pattern, &L, &R, 0);
+    return (L < R) ? R - L : 0;
+}
+
+// phi(SA[i]) = SA[i - 1], for i > 0.
+static index_t phi(
+    const struct rl_bwt_table *table,
+    index_t pos
+) {
+    // The last sample with key <= pos. Position zero is the
+    // first row of the sentinel's run, and that is never the
+    // first run, so there is always one.
+    index_t lo = 0, hi = table->no_phi_samples;
+    while (hi - lo > 1) {
+        index_t mid = lo + (hi - lo) / 2;
+        if (table->phi_keys[mid] <= pos) lo = mid;
+        else hi = mid;
+    }
+    assert(table->phi_keys[lo] <= pos);
+    return table->phi_values[lo] + (pos - table->phi_keys[lo]);
+}
+
+void init_rl_bwt_exact_match_iter(
+    struct rl_bwt_exact_match_iter *iter,
+    const struct rl_bwt_table *table,
+    const uint8_t *remapped_pattern
+) {
+    iter->table = table;
+    backward_search(table, remapped_pattern, &iter->L, &iter->R, &iter->next_pos);
+}
+
+bool next_rl_bwt_exact_match_iter(
+    struct rl_bwt_exact_match_iter *iter,
+    struct bwt_exact_match *match
+) {
+    if (iter->L >= iter->R) return false;
+    match->pos = iter->next_pos;
+    iter->R--;
+    if (iter->L < iter->R) iter->next_pos = phi(iter->table, iter->next_pos);
+    return true;
+}
+
+void dealloc_rl_bwt_exact_match_iter(
+    struct rl_bwt_exact_match_iter *iter
+) {
+    // Nothing to free
+}
+
+void write_rl_bwt_table(
+    FILE *f,
+    const struct rl_bwt_table *table
+) {
+    uint32_t alphabet_size = table->remap_table->alphabet_size;
+    index_t no_runs = table->no_runs;
+    fwrite(&table->length, sizeof(table->length), 1, f);
+    fwrite(&table->no_runs, sizeof(table->no_runs), 1, f);
+    fwrite(&table->no_phi_samples, sizeof(table->no_phi_samples), 1, f);
+    fwrite(table->c_table, sizeof(*table->c_table), alphabet_size, f);
+    fwrite(table->run_starts, sizeof(*table->run_starts), no_runs + 1, f);
+    fwrite(table->run_symbols, sizeof(*table->run_symbols), no_runs, f);
+    fwrite(table->symbol_first, sizeof(*table->symbol_first), alphabet_size + 1, f);
+    fwrite(table->symbol_run_starts, sizeof(index_t), no_runs, f);
+    fwrite(table->symbol_run_ranks, sizeof(index_t), no_runs, f);
+    fwrite(table->symbol_run_last_sa, sizeof(index_t), no_runs, f);
+    fwrite(table->phi_keys, sizeof(index_t), table->no_phi_samples, f);
+    fwrite(table->phi_values, sizeof(index_t), table->no_phi_samples, f);
+}
+
+void write_rl_bwt_table_fname(
+    const char *fname,
+    const struct rl_bwt_table *table
+) {
+    FILE *f = fopen(fname, "wb");
+    write_rl_bwt_table(f, table);
+    fclose(f);
+}
+
+struct rl_bwt_table *read_rl_bwt_table(
+    FILE *f,
+    struct remap_table *remap_table
+) {
+    struct rl_bwt_table *table = malloc(sizeof(struct rl_bwt_table));
+    uint32_t alphabet_size = remap_table->alphabet_size;
+    table->remap_table = remap_table;
+    fread(&table->length, sizeof(table->length), 1, f);
+    fread(&table->no_runs, sizeof(table->no_runs), 1, f);
+    fread(&table->no_phi_samples, sizeof(table->no_phi_samples), 1, f);
+    index_t no_runs = table->no_runs;
+
+    table->c_table = malloc(alphabet_size * sizeof(index_t));
+    table->run_starts = malloc((no_runs + 1) * sizeof(index_t));
+    table->run_symbols = malloc(no_runs);
+    table->symbol_first = malloc((alphabet_size + 1) * sizeof(index_t));
+    table->symbol_run_starts = malloc(no_runs * sizeof(index_t));
+    table->symbol_run_ranks = malloc(no_runs * sizeof(index_t));
+    table->symbol_run_last_sa = malloc(no_runs * sizeof(index_t));
+    table->phi_keys = malloc(no_runs * sizeof(index_t));
+    table->phi_values = malloc(no_runs * sizeof(index_t));
+
+    fread(table->c_table, sizeof(index_t), alphabet_size, f);
+    fread(table->run_starts, sizeof(index_t), no_runs + 1, f);
+    fread(table->run_symbols, 1, no_runs, f);
+    fread(table->symbol_first, sizeof(index_t), alphabet_size + 1, f);
+    fread(table->symbol_run_starts, sizeof(index_t), no_runs, f);
+    fread(table->symbol_run_ranks, sizeof(index_t), no_runs, f);
+    fread(table->symbol_run_last_sa, sizeof(index_t), no_runs, f);
+    fread(table->phi_keys, sizeof(index_t), table->no_phi_samples, f);
+    fread(table->phi_values, sizeof(index_t), table->no_phi_samples, f);
+    return table;
+}
+
+struct rl_bwt_table *read_rl_bwt_table_fname(
+    const char *fname,
+    struct remap_table *remap_table
+) {
+    FILE *f = fopen(fname, "rb");
+    struct rl_bwt_table *table = read_rl_bwt_table(f, remap_table);
+    fclose(f);
+    return table;
+}
+
+static bool same_array(const void *x, const void *y, size_t size)
+{
+    return size == 0 || memcmp(x, y, size) == 0;
+}
+
+bool equivalent_rl_bwt_tables(
+    const struct rl_bwt_table *table1,
+    const struct rl_bwt_table *table2
+) {
+    uint32_t alphabet_size = table1->remap_table->alphabet_size;
+    if (alphabet_size != table2->remap_table->alphabet_size) return false;
+    if (table1->length != table2->length) return false;
+    if (table1->no_runs != table2->no_runs) return false;
+    if (table1->no_phi_samples != table2->no_phi_samples) return false;
+
+    size_t runs = table1->no_runs * sizeof(index_t);
+    size_t samples = table1->no_phi_samples * sizeof(index_t);
+    return same_array(table1->c_table, table2->c_table,
+                      alphabet_size * sizeof(index_t)) &&
+        same_array(table1->run_starts, table2->run_starts,
+                   runs + sizeof(index_t)) &&
+        same_array(table1->run_symbols, table2->run_symbols,
+                   table1->no_runs) &&
+        same_array(table1->symbol_first, table2->symbol_first,
+                   (alphabet_size + 1) * sizeof(index_t)) &&
+        same_array(table1->symbol_run_starts, table2->symbol_run_starts, runs) &&
+        same_array(table1->symbol_run_ranks, table2->symbol_run_ranks, runs) &&
+        same_array(table1->symbol_run_last_sa, table2->symbol_run_last_sa, runs) &&
+        same_array(table1->phi_keys, table2->phi_keys, samples) &&
+        same_array(table1->phi_values, table2->phi_values, samples);
+}
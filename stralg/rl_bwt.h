@@ -0,0 +1,194 @@
+#ifndef RL_BWT_H
+#define RL_BWT_H
+
+#include "remap.h"
+#include "suffix_array.h"
+#include "bwt.h"
+#include "index_type.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ Run-length compressed BWT with run-boundary suffix array
+ samples, i.e., an r-index.
+
+ The O table in struct bwt_table takes space proportional to the
+ length of the string. For a collection of near-identical
+ sequences, the BWT consists of few, long runs of the same symbol,
+ and this table only stores the runs, so it takes space
+ proportional to the number of runs, r, rather than to n.
+
+ For rank queries, we group the runs by symbol, and for each run
+ store where it starts in the BWT and how many occurrences of its
+ symbol come before it. The rank of a at i is then a binary
+ search among the runs of a. The C table is as in struct
+ bwt_table, so backward search works as there, and counting the
+ occurrences of a pattern never needs the suffix array.
+
+ To locate the matches without a suffix array, we sample the
+ suffix array at the first and the last row of each run. During
+ the backward search we keep the suffix array value of the last
+ row of the interval: if the symbol we extend with is the BWT
+ symbol of that row, LF maps it to the new last row and the value
+ goes down by one; otherwise the last occurrence of the symbol in
+ the interval is the end of a run, where we have a sample. From
+ the last row we get the others with the function
+ phi(SA[i]) = SA[i - 1]. If SA[i] = p is not at the start of a
+ run, then phi(p) = phi(q) + p - q, where q is the largest text
+ position that is the suffix array value at the start of a run,
+ so phi is a predecessor search in those samples.
+
+ The table does not hold the string; it only needs the remap
+ table to map patterns.
+ */
+struct rl_bwt_table {
+    struct remap_table *remap_table;
+    index_t length;  // The length of the BWT, including the sentinel
+    index_t no_runs;
+    index_t *c_table;
+
+    // The runs in BWT order; run k is rows [run_starts[k],
+    // run_starts[k + 1]) and run_starts[no_runs] is length.
+    index_t *run_starts;
+    uint8_t *run_symbols;
+
+    // The runs grouped by symbol, in BWT order within each
+    // symbol. The runs of symbol a are entries [symbol_first[a],
+    // symbol_first[a + 1]). For each we have its first row, the
+    // occurrences of the symbol before it, and the suffix array
+    // value at its last row.
+    index_t *symbol_first;
+    index_t *symbol_run_starts;
+    index_t *symbol_run_ranks;
+    index_t *symbol_run_last_sa;
+
+    // Suffix array values at the first row of each run except
+    // the first, sorted, and the values at the row before each.
+    index_t no_phi_samples;
+    index_t *phi_keys;
+    index_t *phi_values;
+};
+
+/**
+ Initialise a table from a suffix array over a remapped string.
+
+ The table keeps a reference to the remap table but not to the
+ suffix array, so you can free the suffix array afterwards.
+ Deallocate the table with dealloc_rl_bwt_table().
+ */
+void init_rl_bwt_table(
+    struct rl_bwt_table *table,
+    const struct suffix_array *sa,
+    struct remap_table *remap_table
+);
+struct rl_bwt_table *alloc_rl_bwt_table(
+    const struct suffix_array *sa,
+    struct remap_table *remap_table
+);
+void dealloc_rl_bwt_table(struct rl_bwt_table *table);
+void free_rl_bwt_table(struct rl_bwt_table *table);
+
+/**
+ Build a table from a string.
+
+ The string is remapped, and the table gets its own remap table.
+ We never hold the suffix array: the first SA-IS pass gives us the
+ BWT, from which we find the runs, and a second pass gives us the
+ samples at their boundaries. Apart from the runs, the memory is
+ the string, the BWT and the SA-IS workspace.
+
+ Returns null if we cannot allocate the memory for the construction.
+ Free the table with completely_free_rl_bwt_table().
+ */
+struct rl_bwt_table *build_rl_bwt_table(const uint8_t *string);
+/**
+ Free the table and its remap table.
+ */
+void completely_free_rl_bwt_table(struct rl_bwt_table *table);
+
+/**
+ The number of bytes the table uses, not counting the remap table.
+ */
+size_t rl_bwt_table_size(const struct rl_bwt_table *table);
+
+/**
+ The number of occurrences of a in the BWT before row i.
+ */
+index_t rl_bwt_rank(
+    const struct rl_bwt_table *table,
+    uint8_t a,
+    index_t i
+);
+/**
+ The symbol in row i of the BWT.
+ */
+uint8_t rl_bwt_symbol(
+    const struct rl_bwt_table *table,
+    index_t i
+);
+
+/**
+ Count the occurrences of a remapped pattern.
+ */
+index_t rl_bwt_count(
+    const struct rl_bwt_table *table,
+    const uint8_t *remapped_pattern
+);
+
+/**
+ Iterator for exact search in a run-length BWT.
+
+ Consider this an opaque structure; it is only in the header
+ so you can stack-allocate it. The matches are reported in
+ decreasing suffix array order, since we get each from the
+ one after it with phi.
+ */
+struct rl_bwt_exact_match_iter {
+    const struct rl_bwt_table *table;
+    index_t L, R;
+    index_t next_pos;  // The suffix array value of row R - 1
+};
+
+void init_rl_bwt_exact_match_iter(
+    struct rl_bwt_exact_match_iter *iter,
+    const struct rl_bwt_table *table,
+    const uint8_t *remapped_pattern
+);
+bool next_rl_bwt_exact_match_iter(
+    struct rl_bwt_exact_match_iter *iter,
+    struct bwt_exact_match *match
+);
+void dealloc_rl_bwt_exact_match_iter(
+    struct rl_bwt_exact_match_iter *iter
+);
+
+// Serialisation -- the remap table is not included; write it
+// yourself, or use the functions in serialise.h.
+void write_rl_bwt_table(
+    FILE *f,
+    const struct rl_bwt_table *table
+);
+void write_rl_bwt_table_fname(
+    const char *fname,
+    const struct rl_bwt_table *table
+);
+struct rl_bwt_table *read_rl_bwt_table(
+    FILE *f,
+    struct remap_table *remap_table
+);
+struct rl_bwt_table *read_rl_bwt_table_fname(
+    const char *fname,
+    struct remap_table *remap_table
+);
+
+/**
+ Check if two tables are the same.
+ */
+bool equivalent_rl_bwt_tables(
+    const struct rl_bwt_table *table1,
+    const struct rl_bwt_table *table2
+);
+
+#endif
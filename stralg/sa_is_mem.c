@@ -12,7 +12,7 @@
 #define L false
 // Stealing the largest number for
 // undefined. I don't exect to have
-// strings that exactly matches uint32_t
+// strings that exactly matches index_t
 #define UNDEFINED ~0
 
 static uint8_t mask[] = {
@@ -28,96 +28,98 @@ static uint8_t mask[] = {
 
 
 static inline void classify_SL(
-    const uint32_t *x,
+    const index_t *x,
     uint8_t *s_idx,
-    uint32_t n
+    index_t n
 );
 static bool is_LMS_index(
     uint8_t *s_idx,
-    uint32_t n,
-    uint32_t i
+    index_t n,
+    index_t i
 );
 
 static void compute_buckets(
-    uint32_t *x,
-    uint32_t n,
-    uint32_t alphabet_size,
-    uint32_t *buckets
+    index_t *x,
+    index_t n,
+    index_t alphabet_size,
+    index_t *buckets
 );
 
 
 static void find_buckets_beginnings(
-    uint32_t *x,
-    uint32_t n,
-    uint32_t alphabet_size,
-    uint32_t *buckets
+    index_t *x,
+    index_t n,
+    index_t alphabet_size,
+    index_t *buckets
 );
 static void find_buckets_ends(
-    uint32_t *x,
-    uint32_t n,
-    uint32_t alphabet_size,
-    uint32_t *buckets
+    index_t *x,
+    index_t n,
+    index_t alphabet_size,
+    index_t *buckets
 );
 
 static void place_LMS(
-    uint32_t *x,
-    uint32_t n,
-    uint32_t alphabet_size,
-    uint32_t *SA,
+    index_t *x,
+    index_t n,
+    index_t alphabet_size,
+    index_t *SA,
     uint8_t *s_idx,
-    uint32_t *buckets
+    index_t *buckets
 );
 
 static void induce_L(
-    uint32_t *x,
-    uint32_t n,
-    uint32_t alphabet_size,
-    uint32_t *SA,
+    index_t *x,
+    index_t n,
+    index_t alphabet_size,
+    index_t *SA,
     uint8_t *s_idx,
-    uint32_t *buckets
+    index_t *buckets
 );
 
 static void induce_S(
-    uint32_t *x,
-    uint32_t n,
-    uint32_t alphabet_size,
-    uint32_t *SA,
+    index_t *x,
+    index_t n,
+    index_t alphabet_size,
+    index_t *SA,
     uint8_t *s_idx,
-    uint32_t *buckets
+    index_t *buckets,
+    const struct sa_row_output_ *out
 );
 
 static bool equal_LMS(
-    uint32_t *x,
-    uint32_t n,
+    index_t *x,
+    index_t n,
     uint8_t *s_idx,
-    uint32_t i,
-    uint32_t j
+    index_t i,
+    index_t j
 );
 
 static void reduce_SA(
-    uint32_t *x,
-    uint32_t n,
-    uint32_t *SA,
+    index_t *x,
+    index_t n,
+    index_t *SA,
     uint8_t *s_idx,
-    uint32_t *new_alphabet_size,
-    uint32_t *new_string_length
+    index_t *new_alphabet_size,
+    index_t *new_string_length
 );
 
 static void remap_LMS(
-    uint32_t *x,
-    uint32_t n,
-    uint32_t *buckets,
-    uint32_t alphabet_size,
+    index_t *x,
+    index_t n,
+    index_t *buckets,
+    index_t alphabet_size,
     uint8_t *s_idx,
-    uint32_t reduced_length,
-    uint32_t *SA
+    index_t reduced_length,
+    index_t *SA
 );
 
 static void sort_SA(
-    uint32_t *x,
-    uint32_t n,
-    uint32_t *SA,
-    uint32_t alphabet_size
+    index_t *x,
+    index_t n,
+    index_t *SA,
+    index_t alphabet_size,
+    const struct sa_row_output_ *out
 );
 
 
@@ -126,16 +128,16 @@ static void sort_SA(
 // a < b they must both the small; if b > a they are
 // both large.
 static void classify_SL(
-    const uint32_t *x,
+    const index_t *x,
     uint8_t *s_idx,
-    uint32_t n
+    index_t n
 ) {
     sset(n, S);
     if (n == 0) // empty string
         return;
     sset(n - 1, L);
     
-    for (uint32_t i = n; i > 0; --i) {
+    for (index_t i = n; i > 0; --i) {
         if (x[i - 1] > x[i]) {
             sset(i - 1, L);
         } else if (x[i - 1] == x[i] && sget(i) == L) {
@@ -148,63 +150,63 @@ static void classify_SL(
 
 static bool is_LMS_index(
     uint8_t *s_idx,
-    uint32_t n,
-    uint32_t i
+    index_t n,
+    index_t i
 ) {
     if (i == 0) return false;
     else return sget(i) == S && sget(i - 1) == L;
 }
 
 static void compute_buckets(
-    uint32_t *x,
-    uint32_t n,
-    uint32_t alphabet_size,
-    uint32_t *buckets
+    index_t *x,
+    index_t n,
+    index_t alphabet_size,
+    index_t *buckets
 ) {
-    memset(buckets, 0, alphabet_size * sizeof(uint32_t));
-    for (uint32_t i = 0; i < n + 1; ++i) {
+    memset(buckets, 0, alphabet_size * sizeof(index_t));
+    for (index_t i = 0; i < n + 1; ++i) {
         buckets[x[i]]++;
     }
 }
 
 static void find_buckets_beginnings(
-    uint32_t *x,
-    uint32_t n,
-    uint32_t alphabet_size,
-    uint32_t *buckets
+    index_t *x,
+    index_t n,
+    index_t alphabet_size,
+    index_t *buckets
 ) {
     compute_buckets(x, n, alphabet_size, buckets);
-    uint32_t sum = 0;
-    for (uint32_t i = 0; i < alphabet_size; ++i) {
+    index_t sum = 0;
+    for (index_t i = 0; i < alphabet_size; ++i) {
         sum += buckets[i];
         buckets[i] = sum - buckets[i];
     }
 }
 
 static void find_buckets_ends(
-    uint32_t *x,
-    uint32_t n,
-    uint32_t alphabet_size,
-    uint32_t *buckets
+    index_t *x,
+    index_t n,
+    index_t alphabet_size,
+    index_t *buckets
 ) {
     compute_buckets(x, n, alphabet_size, buckets);
-    uint32_t sum = 0;
-    for (uint32_t i = 0; i < alphabet_size; ++i) {
+    index_t sum = 0;
+    for (index_t i = 0; i < alphabet_size; ++i) {
         sum += buckets[i];
         buckets[i] = sum;
     }
 }
 
 void place_LMS(
-    uint32_t *x,
-    uint32_t n,
-    uint32_t alphabet_size,
-    uint32_t *SA,
+    index_t *x,
+    index_t n,
+    index_t alphabet_size,
+    index_t *SA,
     uint8_t  *s_idx,
-    uint32_t *buckets
+    index_t *buckets
 ) {
     find_buckets_ends(x, n, alphabet_size, buckets);
-    for (uint32_t i = 0; i < n + 1; ++i) {
+    for (index_t i = 0; i < n + 1; ++i) {
         if (is_LMS_index(s_idx, n, i)) {
             SA[--(buckets[x[i]])] = i;
         }
@@ -212,23 +214,23 @@ void place_LMS(
 }
 
 static void induce_L(
-    uint32_t *x,
-    uint32_t n,
-    uint32_t alphabet_size,
-    uint32_t *SA,
+    index_t *x,
+    index_t n,
+    index_t alphabet_size,
+    index_t *SA,
     uint8_t *s_idx,
-    uint32_t *buckets
+    index_t *buckets
 ) {
     find_buckets_beginnings(x, n, alphabet_size, buckets);
     
-    for (uint32_t i = 0; i < n + 1; ++i) {
+    for (index_t i = 0; i < n + 1; ++i) {
         if (SA[i] == UNDEFINED) continue; // Not initialised yet
         
         // If SA[i] is zero then we do not have
         // a suffix to the left of it
         if (SA[i] == 0) continue;
         
-        uint32_t j = SA[i] - 1;
+        index_t j = SA[i] - 1;
         if (sget(j) == L) {
             SA[(buckets[x[j]])++] = j;
         }
@@ -236,19 +238,24 @@ static void induce_L(
 }
 
 
+// If out is not null, this is the last pass at the top level. When
+// we scan past an entry, right to left, it holds its final value,
+// so that is where we report the rows.
 static void induce_S(
-    uint32_t *x,
-    uint32_t n,
-    uint32_t alphabet_size,
-    uint32_t *SA,
+    index_t *x,
+    index_t n,
+    index_t alphabet_size,
+    index_t *SA,
     uint8_t  *s_idx,
-    uint32_t *buckets
+    index_t *buckets,
+    const struct sa_row_output_ *out
 ) {
     find_buckets_ends(x, n, alphabet_size, buckets);
-    for (uint32_t i = n + 1; i > 0; --i) {
+    for (index_t i = n + 1; i > 0; --i) {
+        if (out) out->f(out->data, i - 1, SA[i - 1]);
         // We do not have a string to the left of the first
         if (SA[i - 1] == 0) continue;
-        uint32_t j = SA[i - 1] - 1;
+        index_t j = SA[i - 1] - 1;
         if (sget(j) == S) {
             SA[--(buckets[x[j]])] = j;
         }
@@ -256,16 +263,16 @@ static void induce_S(
 }
 
 static bool equal_LMS(
-    uint32_t *x,
-    uint32_t n,
+    index_t *x,
+    index_t n,
     uint8_t *s_idx,
-    uint32_t i,
-    uint32_t j
+    index_t i,
+    index_t j
 ) {
     assert(i != j);
     // the sentinel string is unique
     if (i == n + 1 || j == n + 1) return false;
-    uint32_t k = 0;
+    index_t k = 0;
     while (true) {
         bool i_LMS = is_LMS_index(s_idx, n, i + k);
         bool j_LMS = is_LMS_index(s_idx, n, j + k);
@@ -286,19 +293,19 @@ static bool equal_LMS(
 
 
 static void reduce_SA(
-    uint32_t *x,
-    uint32_t n,
-    uint32_t *SA,
+    index_t *x,
+    index_t n,
+    index_t *SA,
     uint8_t *s_idx,
-    uint32_t *new_alphabet_size,
-    uint32_t *new_string_length
+    index_t *new_alphabet_size,
+    index_t *new_string_length
 ) {
     // Pack the LMS strings into the first half of the
     // SA buffer. After that we are free to use the
     // second half of the array
-    uint32_t *compacted = SA;
-    uint32_t n1 = 0;
-    for (uint32_t i = 0; i < n + 1; ++i) {
+    index_t *compacted = SA;
+    index_t n1 = 0;
+    for (index_t i = 0; i < n + 1; ++i) {
         if (is_LMS_index(s_idx, n, SA[i])) {
             compacted[n1++] = SA[i];
         }
@@ -306,14 +313,14 @@ static void reduce_SA(
 
     // Now collect the names in the upper half of the array
 #define half_pos(pos) (pos % 2 == 0) ? pos / 2 : (pos - 1) / 2
-    uint32_t *names = SA + n1;
-    memset(names, UNDEFINED, sizeof(uint32_t) * (n + 1 - n1));
-    uint32_t name = 0;
+    index_t *names = SA + n1;
+    memset(names, UNDEFINED, sizeof(index_t) * (n + 1 - n1));
+    index_t name = 0;
     names[half_pos(compacted[0])] = name;
-    uint32_t last_suffix = compacted[0];
+    index_t last_suffix = compacted[0];
 
-    for (uint32_t i = 1; i < n1; i++) {
-        uint32_t j = compacted[i];
+    for (index_t i = 1; i < n1; i++) {
+        index_t j = compacted[i];
         if (!equal_LMS(x, n, s_idx, last_suffix, j)) {
             name++;
         }
@@ -325,9 +332,9 @@ static void reduce_SA(
     // by shifting the names down. They are in order
     // now so we really only need the right number of
     // copies and we get them this way.
-    uint32_t *reduced = SA + n1;
-    uint32_t j = 0;
-    for (uint32_t i = 0; i < n + 1 - n1; ++i) {
+    index_t *reduced = SA + n1;
+    index_t j = 0;
+    for (index_t i = 0; i < n + 1 - n1; ++i) {
         if (names[i] != UNDEFINED) {
             reduced[j++] = names[i];
         }
@@ -341,28 +348,31 @@ static void reduce_SA(
 
 
 static void recursive_sorting(
-    uint32_t *x,
-    uint32_t n,
-    uint32_t *SA,
-    uint32_t alphabet_size
+    index_t *x,
+    index_t n,
+    index_t *SA,
+    index_t alphabet_size,
+    const struct sa_row_output_ *out
 ) {
-    uint8_t *s_idx = malloc(((n + 1)/8 + 1) * sizeof(uint8_t));
-    uint32_t *buckets = malloc(alphabet_size * sizeof(uint32_t));
+    // sset() reads the byte it writes into, so the bits
+    // must start out defined.
+    uint8_t *s_idx = calloc((n + 1)/8 + 1, sizeof(uint8_t));
+    index_t *buckets = malloc(alphabet_size * sizeof(index_t));
     classify_SL(x, s_idx, n);
 
-    memset(SA, UNDEFINED, (n + 1) * sizeof(uint32_t));
+    memset(SA, UNDEFINED, (n + 1) * sizeof(index_t));
     place_LMS(x, n, alphabet_size, SA, s_idx, buckets);
     induce_L(x, n, alphabet_size, SA, s_idx, buckets);
-    induce_S(x, n, alphabet_size, SA, s_idx, buckets);
+    induce_S(x, n, alphabet_size, SA, s_idx, buckets, 0);
     free(buckets);
     
-    uint32_t new_alphabet_size;
-    uint32_t new_string_length;
+    index_t new_alphabet_size;
+    index_t new_string_length;
     reduce_SA(x, n, SA,
               s_idx,
               &new_alphabet_size,
               &new_string_length);
-    uint32_t *reduced_string = SA + new_string_length + 1;
+    index_t *reduced_string = SA + new_string_length + 1;
     
     
     
@@ -372,12 +382,13 @@ static void recursive_sorting(
     sort_SA(reduced_string,
             new_string_length,
             SA,
-            new_alphabet_size);
+            new_alphabet_size,
+            0);
 
     // get arrays back
-    s_idx = malloc(((n + 1)/8 + 1) * sizeof(uint8_t));
+    s_idx = calloc((n + 1)/8 + 1, sizeof(uint8_t));
     classify_SL(x, s_idx, n);
-    buckets = malloc(alphabet_size * sizeof(uint32_t));
+    buckets = malloc(alphabet_size * sizeof(index_t));
 
     remap_LMS(x, n,
               buckets,
@@ -386,7 +397,7 @@ static void recursive_sorting(
               new_string_length,
               SA);
     induce_L(x, n, alphabet_size, SA, s_idx, buckets);
-    induce_S(x, n, alphabet_size, SA, s_idx, buckets);
+    induce_S(x, n, alphabet_size, SA, s_idx, buckets, out);
     
     
     free(buckets);
@@ -394,14 +405,16 @@ static void recursive_sorting(
 }
 
 void sort_SA(
-    uint32_t *x,
-    uint32_t n,
-    uint32_t *SA,
-    uint32_t alphabet_size
+    index_t *x,
+    index_t n,
+    index_t *SA,
+    index_t alphabet_size,
+    const struct sa_row_output_ *out
 ) {
     if (n == 0) {
         // Trivially sorted
         SA[0] = 0;
+        if (out) out->f(out->data, 0, 0);
         return;
     }
     
@@ -411,32 +424,38 @@ void sort_SA(
     // up to the alphabet size.
     if (alphabet_size == n + 1) {
         SA[0] = n;
-        for (uint32_t i = 0; i < n; ++i) {
-            uint32_t j = x[i];
+        for (index_t i = 0; i < n; ++i) {
+            index_t j = x[i];
             SA[j] = i;
         }
+        if (out) {
+            for (index_t i = 0; i < n + 1; ++i) {
+                out->f(out->data, i, SA[i]);
+            }
+        }
     } else {
         recursive_sorting(
             x, n, SA,
-            alphabet_size
+            alphabet_size,
+            out
         );
     }
 }
 
 void remap_LMS(
-    uint32_t *x,
-    uint32_t n,
-    uint32_t *buckets,
-    uint32_t alphabet_size,
+    index_t *x,
+    index_t n,
+    index_t *buckets,
+    index_t alphabet_size,
     uint8_t *s_idx,
-    uint32_t reduced_length,
-    uint32_t *SA
+    index_t reduced_length,
+    index_t *SA
 ) {
     // Compute the offsets we need to map
     // the reduced string to the original
-    uint32_t *offsets = SA + reduced_length + 1;
-    uint32_t j = 0;
-    for (uint32_t i = 1; i < n + 1; ++i) {
+    index_t *offsets = SA + reduced_length + 1;
+    index_t j = 0;
+    for (index_t i = 1; i < n + 1; ++i) {
         if (is_LMS_index(s_idx, n, i)) {
             offsets[j++] = i;
         }
@@ -444,7 +463,7 @@ void remap_LMS(
     
     // Move the offsets into the first part of SA, sorted
     // by the SA of the reduced problem, so we have them when we update SA
-    for (uint32_t i = 0; i < reduced_length + 1; ++i) {
+    for (index_t i = 0; i < reduced_length + 1; ++i) {
         SA[i] = offsets[SA[i]];
         
     }
@@ -452,15 +471,15 @@ void remap_LMS(
     // Reset the upper part of SA
     memset(SA + reduced_length + 1,
            UNDEFINED,
-           sizeof(uint32_t) * (n + 1 - (reduced_length + 1)));
+           sizeof(index_t) * (n + 1 - (reduced_length + 1)));
     
     // Now we can insert the LMS strings in their buckets.
     // Scanning right to left this way ensures that we see
     // an LMS after we have zeroed its position so we don't
     // risk removing one when we set a position to UNDEFINED
     find_buckets_ends(x, n, alphabet_size, buckets);
-    for (uint32_t i = reduced_length + 1; i > 0; --i) {
-        uint32_t j = SA[i - 1]; SA[i - 1] = UNDEFINED;
+    for (index_t i = reduced_length + 1; i > 0; --i) {
+        index_t j = SA[i - 1]; SA[i - 1] = UNDEFINED;
         SA[--(buckets[x[j]])] = j;
     }
 
@@ -476,19 +495,47 @@ sa_is_mem_construction(
     struct suffix_array *sa = allocate_sa_(remapped_string);
     // we work with the string length without the sentinel
     // in this algorithm
-    uint32_t n = sa->length - 1;
+    index_t n = sa->length - 1;
     
     // Create string of integers instead of bytes
-    uint32_t *s = malloc((n + 1) * sizeof(uint32_t));
-    for (uint32_t i = 0; i < n; ++i) {
+    index_t *s = malloc((n + 1) * sizeof(index_t));
+    for (index_t i = 0; i < n; ++i) {
         s[i] = remapped_string[i];
     }
     s[n] = 0;
     
     // Sort in buffer and then move the result to the suffix array
-    sort_SA(s, n, sa->array, alphabet_size);
+    sort_SA(s, n, sa->array, alphabet_size, 0);
     
     free(s);
     
     return sa;
 }
+
+bool sa_is_mem_rows_(
+    const uint8_t *remapped_string,
+    uint32_t alphabet_size,
+    const struct sa_row_output_ *out
+) {
+    index_t n = (index_t)strlen((const char *)remapped_string);
+    
+    index_t *s = malloc((n + 1) * sizeof(index_t));
+    // We still need the array while we sort, but
+    // not after we have reported the rows.
+    index_t *SA = malloc((n + 1) * sizeof(index_t));
+    if (!s || !SA) {
+        free(s);
+        free(SA);
+        return false;
+    }
+    for (index_t i = 0; i < n; ++i) {
+        s[i] = remapped_string[i];
+    }
+    s[n] = 0;
+    
+    sort_SA(s, n, SA, alphabet_size, out);
+    
+    free(SA);
+    free(s);
+    return true;
+}
@@ -0,0 +1,914 @@
+
+#include "suffix_array.h"
+#include "suffix_array_internal.h"
+#include "parallel.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+// Parallel SA-IS. The phases are those in sa_is.c, and the
+// induction passes make exactly the same writes in the same
+// order, so the result is the same array. What we parallelise
+// is the work around the sequential parts: classification,
+// bucket counts, the random look-ups in the induction scans,
+// naming the LMS substrings, and building the reduced string.
+
+#define S true
+#define L false
+#define UNDEFINED ((index_t)~(index_t)0)
+
+// Below this length a recursion level runs in one thread;
+// starting threads would cost more than the work.
+#define PARALLEL_LEVEL_THRESHOLD (1 << 12)
+// Block sizes for the induction scans. Small blocks keep the
+// look-ups close to the scan, so fewer of them go stale.
+#define MAX_INDUCE_BLOCK (1 << 16)
+#define MIN_INDUCE_BLOCK (1 << 10)
+
+// The induction scans read entries that another thread is
+// writing, so all accesses to them in a parallel pass are
+// atomic. Relaxed is enough: a stale value is detected and
+// recomputed, and the locks order everything else.
+static inline index_t load_entry(const index_t *SA, index_t i)
+{
+    return __atomic_load_n(&SA[i], __ATOMIC_RELAXED);
+}
+static inline void store_entry(index_t *SA, index_t i, index_t value)
+{
+    __atomic_store_n(&SA[i], value, __ATOMIC_RELAXED);
+}
+
+static bool is_LMS_index(
+    const bool *s_index,
+    index_t i
+) {
+    if (i == 0) return false;
+    else return s_index[i] == S && s_index[i - 1] == L;
+}
+
+// MARK: Filling and converting arrays
+
+struct fill_job {
+    index_t *array;
+    index_t length;
+    index_t value;
+};
+
+static void fill_chunk(
+    void *data,
+    uint32_t thread_no,
+    uint32_t no_threads
+) {
+    struct fill_job *job = data;
+    index_t start = chunk_start(job->length, thread_no, no_threads, 1);
+    index_t end = chunk_start(job->length, thread_no + 1, no_threads, 1);
+    for (index_t i = start; i < end; ++i) {
+        job->array[i] = job->value;
+    }
+}
+
+static void fill_parallel(
+    index_t *array,
+    index_t length,
+    index_t value,
+    uint32_t no_threads
+) {
+    struct fill_job job = {
+        .array = array, .length = length, .value = value
+    };
+    run_in_parallel(no_threads, fill_chunk, &job);
+}
+
+struct widen_job {
+    const uint8_t *string;
+    index_t *x;
+    index_t n;
+};
+
+static void widen_chunk(
+    void *data,
+    uint32_t thread_no,
+    uint32_t no_threads
+) {
+    struct widen_job *job = data;
+    index_t start = chunk_start(job->n, thread_no, no_threads, 1);
+    index_t end = chunk_start(job->n, thread_no + 1, no_threads, 1);
+    for (index_t i = start; i < end; ++i) {
+        job->x[i] = job->string[i];
+    }
+}
+
+// MARK: Classification
+
+// Each thread classifies its chunk from the right, but the
+// positions at the end of the chunk whose symbol equals the
+// first symbol after the chunk get their type from outside
+// the chunk. We leave them for later and record where they
+// start; once we know the type at each chunk boundary, we
+// fill them in.
+struct classify_job {
+    const index_t *x;
+    bool *s_index;
+    index_t n;
+    index_t *run_starts;
+    bool *run_types;
+};
+
+static void classify_chunk(
+    void *data,
+    uint32_t thread_no,
+    uint32_t no_threads
+) {
+    struct classify_job *job = data;
+    const index_t *x = job->x;
+    bool *s_index = job->s_index;
+    index_t start = chunk_start(job->n, thread_no, no_threads, 1);
+    index_t end = chunk_start(job->n, thread_no + 1, no_threads, 1);
+
+    index_t i = end;
+    while (i > start && x[i - 1] == x[end]) --i;
+    job->run_starts[thread_no] = i;
+    for (; i > start; --i) {
+        if (x[i - 1] > x[i]) {
+            s_index[i - 1] = L;
+        } else if (x[i - 1] == x[i] && s_index[i] == L) {
+            s_index[i - 1] = L;
+        } else {
+            s_index[i - 1] = S;
+        }
+    }
+}
+
+static void fill_chunk_run(
+    void *data,
+    uint32_t thread_no,
+    uint32_t no_threads
+) {
+    struct classify_job *job = data;
+    index_t end = chunk_start(job->n, thread_no + 1, no_threads, 1);
+    for (index_t i = job->run_starts[thread_no]; i < end; ++i) {
+        job->s_index[i] = job->run_types[thread_no];
+    }
+}
+
+static void classify_SL(
+    const index_t *x,
+    bool *s_index,
+    index_t n,
+    uint32_t no_threads
+) {
+    s_index[n] = S;
+    if (n == 0) // empty string
+        return;
+
+    index_t run_starts[no_threads];
+    bool run_types[no_threads];
+    struct classify_job job = {
+        .x = x, .s_index = s_index, .n = n,
+        .run_starts = run_starts, .run_types = run_types
+    };
+    run_in_parallel(no_threads, classify_chunk, &job);
+
+    // The run at the end of a chunk has the type of the first
+    // position after the chunk. That is either classified, or
+    // in a run that covers the whole next chunk.
+    bool type_after = s_index[n];
+    for (uint32_t t = no_threads; t > 0; --t) {
+        run_types[t - 1] = type_after;
+        index_t start = chunk_start(n, t - 1, no_threads, 1);
+        if (run_starts[t - 1] > start) type_after = s_index[start];
+    }
+    run_in_parallel(no_threads, fill_chunk_run, &job);
+}
+
+// MARK: Buckets
+
+struct bucket_job {
+    const index_t *x;
+    index_t n;
+    index_t alphabet_size;
+    index_t *counts; // no_threads rows of alphabet_size counts
+};
+
+static void count_chunk(
+    void *data,
+    uint32_t thread_no,
+    uint32_t no_threads
+) {
+    struct bucket_job *job = data;
+    index_t *counts = job->counts + thread_no * job->alphabet_size;
+    memset(counts, 0, job->alphabet_size * sizeof(index_t));
+    index_t start = chunk_start(job->n + 1, thread_no, no_threads, 1);
+    index_t end = chunk_start(job->n + 1, thread_no + 1, no_threads, 1);
+    for (index_t i = start; i < end; ++i) {
+        counts[job->x[i]]++;
+    }
+}
+
+static void compute_buckets(
+    const index_t *x,
+    index_t n,
+    index_t alphabet_size,
+    index_t *buckets,
+    uint32_t no_threads
+) {
+    // With a large alphabet, summing the per-thread counts
+    // costs more than counting.
+    if ((uint64_t)alphabet_size * no_threads * 8 > n) {
+        memset(buckets, 0, alphabet_size * sizeof(index_t));
+        for (index_t i = 0; i < n + 1; ++i) {
+            buckets[x[i]]++;
+        }
+        return;
+    }
+
+    struct bucket_job job = {
+        .x = x, .n = n, .alphabet_size = alphabet_size,
+        .counts = malloc(no_threads * alphabet_size * sizeof(index_t))
+    };
+    run_in_parallel(no_threads, count_chunk, &job);
+    memcpy(buckets, job.counts, alphabet_size * sizeof(index_t));
+    for (uint32_t t = 1; t < no_threads; ++t) {
+        const index_t *counts = job.counts + t * alphabet_size;
+        for (index_t a = 0; a < alphabet_size; ++a) {
+            buckets[a] += counts[a];
+        }
+    }
+    free(job.counts);
+}
+
+static void find_buckets_beginnings(
+    index_t alphabet_size,
+    const index_t *buckets,
+    index_t *beginnings
+) {
+    beginnings[0] = 0;
+    for (index_t i = 1; i < alphabet_size; ++i) {
+        beginnings[i] = beginnings[i - 1] + buckets[i - 1];
+    }
+}
+
+static void find_buckets_ends(
+    index_t alphabet_size,
+    const index_t *buckets,
+    index_t *ends
+) {
+    ends[0] = buckets[0];
+    for (index_t i = 1; i < alphabet_size; ++i) {
+        ends[i] = ends[i - 1] + buckets[i];
+    }
+}
+
+static void place_LMS(
+    const index_t *x,
+    index_t n,
+    index_t alphabet_size,
+    index_t *SA,
+    const bool *s_index,
+    const index_t *buckets,
+    index_t *bucket_ends
+) {
+    find_buckets_ends(alphabet_size, buckets, bucket_ends);
+    for (index_t i = 0; i < n + 1; ++i) {
+        if (is_LMS_index(s_index, i)) {
+            SA[--(bucket_ends[x[i]])] = i;
+        }
+    }
+}
+
+// MARK: Induction
+
+// One induction pass, L or S. A single thread scans the array
+// and makes the writes, exactly as the sequential pass does,
+// but the scan is split into blocks, and while it works on one
+// block, the other threads read the next and look up the type
+// and symbol of the suffix before each entry. Those look-ups
+// are the cache misses in the pass. An entry can change after
+// we have read it -- the scan writes ahead of itself -- so the
+// scanning thread checks that the entry still has the value we
+// looked up and otherwise does the look-up itself.
+//
+// The blocks are split into pieces that threads claim in order.
+// The scanning thread claims any piece of its current block that
+// nobody has taken yet, so it never waits for a thread that
+// has not started. There are two buffers, so the helpers can
+// only work one block ahead of the scan.
+struct induce_job {
+    const index_t *x;
+    index_t n;
+    index_t *SA;
+    const bool *s_index;
+    bool type;          // L scans left to right, S right to left
+    index_t *pointers;  // bucket beginnings for L, ends for S
+
+    index_t block_size;
+    index_t no_blocks;
+    uint32_t pieces_per_block;
+    index_t *values[2];  // the entries we read
+    index_t *symbols[2]; // the symbol to induce or UNDEFINED
+
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    index_t next_piece;
+    index_t blocks_done;
+    uint32_t pieces_done[2];
+};
+
+static inline index_t scan_position(
+    const struct induce_job *job,
+    index_t r
+) {
+    return (job->type == L) ? r : job->n - r;
+}
+
+static inline index_t induced_symbol(
+    const struct induce_job *job,
+    index_t value
+) {
+    if (value == UNDEFINED || value == 0) return UNDEFINED;
+    index_t j = value - 1;
+    return (job->s_index[j] == job->type) ? job->x[j] : UNDEFINED;
+}
+
+static inline index_t block_length(
+    const struct induce_job *job,
+    index_t block
+) {
+    index_t begin = block * job->block_size;
+    index_t left = job->n + 1 - begin;
+    return (left < job->block_size) ? left : job->block_size;
+}
+
+static void prepare_piece(
+    struct induce_job *job,
+    index_t piece
+) {
+    index_t block = piece / job->pieces_per_block;
+    uint32_t q = piece % job->pieces_per_block;
+    index_t begin = block * job->block_size;
+    index_t len = block_length(job, block);
+    index_t from = chunk_start(len, q, job->pieces_per_block, 1);
+    index_t to = chunk_start(len, q + 1, job->pieces_per_block, 1);
+    index_t *values = job->values[block % 2];
+    index_t *symbols = job->symbols[block % 2];
+    for (index_t k = from; k < to; ++k) {
+        index_t value = load_entry(job->SA, scan_position(job, begin + k));
+        values[k] = value;
+        symbols[k] = induced_symbol(job, value);
+    }
+}
+
+// Call these two with the lock held.
+static bool claim_piece(
+    struct induce_job *job,
+    index_t last_block,
+    index_t *piece
+) {
+    if (job->next_piece == job->no_blocks * job->pieces_per_block)
+        return false;
+    if (job->next_piece / job->pieces_per_block > last_block)
+        return false;
+    *piece = job->next_piece++;
+    return true;
+}
+
+static void prepare_claimed_piece(
+    struct induce_job *job,
+    index_t piece
+) {
+    pthread_mutex_unlock(&job->lock);
+    prepare_piece(job, piece);
+    pthread_mutex_lock(&job->lock);
+    uint32_t buffer = (piece / job->pieces_per_block) % 2;
+    if (++job->pieces_done[buffer] == job->pieces_per_block)
+        pthread_cond_broadcast(&job->changed);
+}
+
+static void induce_block(
+    struct induce_job *job,
+    index_t block
+) {
+    index_t begin = block * job->block_size;
+    index_t len = block_length(job, block);
+    const index_t *values = job->values[block % 2];
+    const index_t *symbols = job->symbols[block % 2];
+    for (index_t k = 0; k < len; ++k) {
+        index_t value = load_entry(job->SA, scan_position(job, begin + k));
+        index_t a = (value == values[k]) ?
+            symbols[k] : induced_symbol(job, value);
+        if (a == UNDEFINED) continue;
+        index_t idx = (job->type == L) ?
+            (job->pointers[a])++ : --(job->pointers[a]);
+        store_entry(job->SA, idx, value - 1);
+    }
+}
+
+// Thread 0 scans; the others prepare pieces. The pieces are
+// claimed as the threads get to them rather than split by thread
+// number, so the only use of the thread count is the number of
+// pieces per block, which induce() has put in the job.
+static void induce_thread(
+    void *data,
+    uint32_t thread_no,
+    uint32_t no_threads
+) {
+    struct induce_job *job = data;
+    assert(job->pieces_per_block == no_threads);
+    (void)no_threads; // only used in the assertion
+    index_t piece;
+    pthread_mutex_lock(&job->lock);
+    if (thread_no == 0) {
+        for (index_t block = 0; block < job->no_blocks; ++block) {
+            while (claim_piece(job, block, &piece)) {
+                prepare_claimed_piece(job, piece);
+            }
+            while (job->pieces_done[block % 2] < job->pieces_per_block) {
+                pthread_cond_wait(&job->changed, &job->lock);
+            }
+            pthread_mutex_unlock(&job->lock);
+            induce_block(job, block);
+            pthread_mutex_lock(&job->lock);
+            job->pieces_done[block % 2] = 0;
+            job->blocks_done = block + 1;
+            pthread_cond_broadcast(&job->changed);
+        }
+    } else {
+        index_t no_pieces = job->no_blocks * job->pieces_per_block;
+        while (job->next_piece < no_pieces) {
+            if (claim_piece(job, job->blocks_done + 1, &piece)) {
+                prepare_claimed_piece(job, piece);
+            } else {
+                pthread_cond_wait(&job->changed, &job->lock);
+            }
+        }
+    }
+    pthread_mutex_unlock(&job->lock);
+}
+
+static void induce(
+    const index_t *x,
+    index_t n,
+    index_t alphabet_size,
+    index_t *SA,
+    const bool *s_index,
+    const index_t *buckets,
+    index_t *bucket_pointers,
+    bool type,
+    uint32_t no_threads
+) {
+    if (type == L) {
+        find_buckets_beginnings(alphabet_size, buckets, bucket_pointers);
+    } else {
+        find_buckets_ends(alphabet_size, buckets, bucket_pointers);
+    }
+
+    if (no_threads == 1) {
+        // The passes from sa_is.c
+        if (type == L) {
+            for (index_t i = 0; i < n + 1; ++i) {
+                if (SA[i] == UNDEFINED || SA[i] == 0) continue;
+                index_t j = SA[i] - 1;
+                if (s_index[j] == L) {
+                    SA[(bucket_pointers[x[j]])++] = j;
+                }
+            }
+        } else {
+            for (index_t i = n + 1; i > 0; --i) {
+                if (SA[i - 1] == 0) continue;
+                index_t j = SA[i - 1] - 1;
+                if (s_index[j] == S) {
+                    SA[--(bucket_pointers[x[j]])] = j;
+                }
+            }
+        }
+        return;
+    }
+
+    index_t block_size = (n + 1) / (4 * no_threads);
+    if (block_size > MAX_INDUCE_BLOCK) block_size = MAX_INDUCE_BLOCK;
+    if (block_size < MIN_INDUCE_BLOCK) block_size = MIN_INDUCE_BLOCK;
+
+    struct induce_job job = {
+        .x = x, .n = n, .SA = SA, .s_index = s_index,
+        .type = type, .pointers = bucket_pointers,
+        .block_size = block_size,
+        .no_blocks = (n + block_size) / block_size,
+        .pieces_per_block = no_threads,
+        .next_piece = 0, .blocks_done = 0,
+        .pieces_done = { 0, 0 }
+    };
+    index_t *buffers = malloc(4 * block_size * sizeof(index_t));
+    for (int b = 0; b < 2; ++b) {
+        job.values[b] = buffers + (2 * b) * block_size;
+        job.symbols[b] = buffers + (2 * b + 1) * block_size;
+    }
+    pthread_mutex_init(&job.lock, 0);
+    pthread_cond_init(&job.changed, 0);
+
+    run_in_parallel(no_threads, induce_thread, &job);
+
+    pthread_cond_destroy(&job.changed);
+    pthread_mutex_destroy(&job.lock);
+    free(buffers);
+}
+
+// MARK: Naming LMS substrings
+
+static bool equal_LMS(
+    const index_t *x,
+    index_t n,
+    const bool *s_index,
+    index_t i,
+    index_t j
+) {
+    assert(i != j);
+    // the sentinel string is unique
+    if (i == n || j == n) return false;
+    index_t k = 0;
+    while (true) {
+        bool i_LMS = is_LMS_index(s_index, i + k);
+        bool j_LMS = is_LMS_index(s_index, j + k);
+        if (k > 0 && i_LMS && j_LMS) {
+            // we reached the end of the strings
+            return true;
+        }
+        // if one string ends before another or we
+        // have different characters the strings are
+        // different
+        if (i_LMS != j_LMS || x[i + k] != x[j + k]) {
+            return false;
+        }
+        k++;
+    }
+}
+
+// We name the LMS substrings in four parallel steps:
+// collect the LMS suffixes in suffix array order, compare
+// each with the one before it, give them names from the
+// running count of differences, and collect the names in
+// string order. The collecting steps count per chunk first
+// so each thread knows where its output starts.
+struct naming_job {
+    const index_t *x;
+    index_t n;
+    const index_t *SA;
+    const bool *s_index;
+    index_t *names_buf;
+    index_t *lms;        // the LMS suffixes in suffix array order
+    index_t no_lms;
+    index_t *differs;    // scratch; one flag per LMS suffix
+    index_t *summary_string;
+    index_t *summary_offsets;
+    index_t *chunk_counts; // one per thread
+};
+
+static void count_LMS_chunk(
+    void *data,
+    uint32_t thread_no,
+    uint32_t no_threads
+) {
+    struct naming_job *job = data;
+    index_t start = chunk_start(job->n + 1, thread_no, no_threads, 1);
+    index_t end = chunk_start(job->n + 1, thread_no + 1, no_threads, 1);
+    index_t count = 0;
+    for (index_t i = start; i < end; ++i) {
+        count += is_LMS_index(job->s_index, job->SA[i]);
+    }
+    job->chunk_counts[thread_no] = count;
+}
+
+static void collect_LMS_chunk(
+    void *data,
+    uint32_t thread_no,
+    uint32_t no_threads
+) {
+    struct naming_job *job = data;
+    index_t start = chunk_start(job->n + 1, thread_no, no_threads, 1);
+    index_t end = chunk_start(job->n + 1, thread_no + 1, no_threads, 1);
+    index_t k = job->chunk_counts[thread_no];
+    for (index_t i = start; i < end; ++i) {
+        if (is_LMS_index(job->s_index, job->SA[i])) {
+            job->lms[k++] = job->SA[i];
+        }
+    }
+}
+
+static void compare_LMS_chunk(
+    void *data,
+    uint32_t thread_no,
+    uint32_t no_threads
+) {
+    struct naming_job *job = data;
+    index_t start = chunk_start(job->no_lms, thread_no, no_threads, 1);
+    index_t end = chunk_start(job->no_lms, thread_no + 1, no_threads, 1);
+    index_t count = 0;
+    for (index_t k = start; k < end; ++k) {
+        bool differs = k > 0 &&
+            !equal_LMS(job->x, job->n, job->s_index,
+                       job->lms[k - 1], job->lms[k]);
+        job->differs[k] = differs;
+        count += differs;
+    }
+    job->chunk_counts[thread_no] = count;
+}
+
+static void name_LMS_chunk(
+    void *data,
+    uint32_t thread_no,
+    uint32_t no_threads
+) {
+    struct naming_job *job = data;
+    index_t start = chunk_start(job->no_lms, thread_no, no_threads, 1);
+    index_t end = chunk_start(job->no_lms, thread_no + 1, no_threads, 1);
+    index_t name = job->chunk_counts[thread_no];
+    for (index_t k = start; k < end; ++k) {
+        name += job->differs[k];
+        job->names_buf[job->lms[k]] = name;
+    }
+}
+
+static void count_names_chunk(
+    void *data,
+    uint32_t thread_no,
+    uint32_t no_threads
+) {
+    struct naming_job *job = data;
+    index_t start = chunk_start(job->n + 1, thread_no, no_threads, 1);
+    index_t end = chunk_start(job->n + 1, thread_no + 1, no_threads, 1);
+    index_t count = 0;
+    for (index_t i = start; i < end; ++i) {
+        count += job->names_buf[i] != UNDEFINED;
+    }
+    job->chunk_counts[thread_no] = count;
+}
+
+static void collect_names_chunk(
+    void *data,
+    uint32_t thread_no,
+    uint32_t no_threads
+) {
+    struct naming_job *job = data;
+    index_t start = chunk_start(job->n + 1, thread_no, no_threads, 1);
+    index_t end = chunk_start(job->n + 1, thread_no + 1, no_threads, 1);
+    index_t j = job->chunk_counts[thread_no];
+    for (index_t i = start; i < end; ++i) {
+        index_t name = job->names_buf[i];
+        if (name == UNDEFINED) continue;
+        job->summary_offsets[j] = i;
+        job->summary_string[j] = name;
+        j++;
+    }
+}
+
+// Turns the per-chunk counts into where each chunk starts
+// and returns the total.
+static index_t chunk_offsets(
+    index_t *counts,
+    uint32_t no_threads
+) {
+    index_t total = 0;
+    for (uint32_t t = 0; t < no_threads; ++t) {
+        index_t count = counts[t];
+        counts[t] = total;
+        total += count;
+    }
+    return total;
+}
+
+static void reduce_SA(
+    const index_t *x,
+    index_t n,
+    const index_t *SA,
+    index_t *names_buf,
+    index_t *lms_buf,
+    const bool *s_index,
+    index_t *new_alphabet_size,
+    index_t *summary_string,
+    index_t *summary_offsets,
+    index_t *new_string_length,
+    uint32_t no_threads
+) {
+    index_t chunk_counts[no_threads];
+    struct naming_job job = {
+        .x = x, .n = n, .SA = SA, .s_index = s_index,
+        .names_buf = names_buf, .lms = lms_buf,
+        .differs = summary_string,
+        .summary_string = summary_string,
+        .summary_offsets = summary_offsets,
+        .chunk_counts = chunk_counts
+    };
+
+    run_in_parallel(no_threads, count_LMS_chunk, &job);
+    job.no_lms = chunk_offsets(chunk_counts, no_threads);
+    run_in_parallel(no_threads, collect_LMS_chunk, &job);
+
+    run_in_parallel(no_threads, compare_LMS_chunk, &job);
+    // One larger than the largest name used
+    *new_alphabet_size = chunk_offsets(chunk_counts, no_threads) + 1;
+    fill_parallel(names_buf, n + 1, UNDEFINED, no_threads);
+    run_in_parallel(no_threads, name_LMS_chunk, &job);
+
+    run_in_parallel(no_threads, count_names_chunk, &job);
+    index_t j = chunk_offsets(chunk_counts, no_threads);
+    run_in_parallel(no_threads, collect_names_chunk, &job);
+    *new_string_length = j - 1; // we don't include sentinel in the length
+}
+
+static void remap_LMS(
+    const index_t *x,
+    index_t n,
+    const index_t *buckets,
+    index_t *bucket_ends,
+    index_t alphabet_size,
+    index_t reduced_length,
+    const index_t *reduced_SA,
+    const index_t *reduced_offsets,
+    index_t *SA
+) {
+    find_buckets_ends(alphabet_size, buckets, bucket_ends);
+
+    for (index_t i = reduced_length + 1; i > 0; --i) {
+        index_t idx = reduced_offsets[reduced_SA[i - 1]];
+        index_t bucket_idx = x[idx];
+        SA[--(bucket_ends[bucket_idx])] = idx;
+    }
+    SA[0] = n;
+}
+
+// MARK: Recursion
+
+static void sort_SA(
+    index_t *x,
+    index_t n,
+    index_t *SA,
+    index_t *names_buf,
+    index_t *summary_string,
+    index_t *summary_offsets,
+    index_t *buckets,
+    index_t *bucket_endpoints,
+    bool *s_index,
+    index_t alphabet_size,
+    uint32_t no_threads
+);
+
+static void recursive_sorting(
+    index_t *x,
+    index_t n,
+    index_t *SA,
+    index_t *names_buf,
+    bool *s_index,
+    index_t *buckets,
+    index_t *bucket_endpoints,
+    index_t *reduced_string,
+    index_t *reduced_offsets,
+    index_t alphabet_size,
+    uint32_t no_threads
+) {
+    classify_SL(x, s_index, n, no_threads);
+    compute_buckets(x, n, alphabet_size, buckets, no_threads);
+
+    fill_parallel(SA, n + 1, UNDEFINED, no_threads);
+    place_LMS(x, n, alphabet_size, SA, s_index, buckets, bucket_endpoints);
+    induce(x, n, alphabet_size, SA, s_index, buckets, bucket_endpoints,
+           L, no_threads);
+    induce(x, n, alphabet_size, SA, s_index, buckets, bucket_endpoints,
+           S, no_threads);
+
+    // Move to next position in the buffers
+    index_t *new_SA = SA + n + 1;
+    index_t *new_names_buf = names_buf + n + 1;
+    bool *new_s_index = s_index + n + 1;
+    index_t *new_summary_string = reduced_string + n + 1;
+    index_t *new_summary_offsets = reduced_offsets + n + 1;
+    index_t *new_buckets = buckets + alphabet_size;
+    index_t *new_bucket_endpoints = bucket_endpoints + alphabet_size;
+
+    // The sorted LMS suffixes go where the reduced suffix
+    // array will be; we are done with them before we sort.
+    index_t new_alphabet_size;
+    index_t new_string_length;
+    reduce_SA(x, n, SA,
+              names_buf,
+              new_SA,
+              s_index,
+              &new_alphabet_size,
+              reduced_string,
+              reduced_offsets,
+              &new_string_length,
+              no_threads);
+
+    sort_SA(reduced_string, new_string_length,
+            new_SA,
+            new_names_buf,
+            new_summary_string,
+            new_summary_offsets,
+            new_buckets,
+            new_bucket_endpoints,
+            new_s_index,
+            new_alphabet_size,
+            no_threads);
+
+    fill_parallel(SA, n + 1, UNDEFINED, no_threads);
+    remap_LMS(x, n,
+              buckets, bucket_endpoints,
+              alphabet_size,
+              new_string_length, new_SA, reduced_offsets,
+              SA);
+    induce(x, n, alphabet_size, SA, s_index, buckets, bucket_endpoints,
+           L, no_threads);
+    induce(x, n, alphabet_size, SA, s_index, buckets, bucket_endpoints,
+           S, no_threads);
+}
+
+static void sort_SA(
+    index_t *x,
+    index_t n,
+    index_t *SA,
+    index_t *names_buf,
+    index_t *summary_string,
+    index_t *summary_offsets,
+    index_t *buckets,
+    index_t *bucket_endpoints,
+    bool *s_index,
+    index_t alphabet_size,
+    uint32_t no_threads
+) {
+    if (n == 0) {
+        // Trivially sorted
+        SA[0] = 0;
+        return;
+    }
+
+    if (alphabet_size == n + 1) {
+        SA[0] = n;
+        for (index_t i = 0; i < n; ++i) {
+            index_t j = x[i];
+            SA[j] = i;
+        }
+        return;
+    }
+
+    if (n < PARALLEL_LEVEL_THRESHOLD) no_threads = 1;
+    recursive_sorting(
+        x, n, SA,
+        names_buf,
+        s_index,
+        buckets,
+        bucket_endpoints,
+        summary_string,
+        summary_offsets,
+        alphabet_size,
+        no_threads
+    );
+}
+
+struct suffix_array *
+sa_is_construction_parallel(
+    uint8_t *remapped_string,
+    uint32_t alphabet_size,
+    uint32_t no_threads
+) {
+    if (no_threads == 0) no_threads = 1;
+
+    struct suffix_array *sa = allocate_sa_(remapped_string);
+    // we work with the string length without the sentinel
+    // in this algorithm
+    index_t n = sa->length - 1;
+
+    // Create string of integers instead of bytes
+    index_t *s = malloc((n + 1) * sizeof(index_t));
+    struct widen_job widen = { .string = remapped_string, .x = s, .n = n };
+    run_in_parallel(no_threads, widen_chunk, &widen);
+    s[n] = 0;
+
+    // Allocate all buffers
+    index_t *SA = malloc(2 * (n + 1) * sizeof(index_t));
+    index_t *names_buf = malloc(2 * (n + 1) * sizeof(index_t));
+    index_t *summary_string = malloc(2 * (n + 1) * sizeof(index_t));
+    index_t *summary_offsets = malloc(2 * (n + 1) * sizeof(index_t));
+    bool *s_index = malloc(2 * (n + 1) * sizeof(bool));
+    index_t max_alphabet_size = (alphabet_size > n) ? alphabet_size : n + 1;
+    index_t *buckets = malloc(2 * max_alphabet_size * sizeof(index_t));
+    index_t *bucket_endpoints = malloc(2 * max_alphabet_size * sizeof(index_t));
+
+    // Sort in buffer and then move the result to the suffix array
+    sort_SA(s, n, SA, names_buf,
+            summary_string, summary_offsets,
+            buckets, bucket_endpoints, s_index, alphabet_size,
+            no_threads);
+    memcpy(sa->array, SA, (n + 1) * sizeof(index_t));
+
+    // Free all buffers
+    free(bucket_endpoints);
+    free(buckets);
+    free(s_index);
+    free(summary_offsets);
+    free(summary_string);
+    free(names_buf);
+    free(SA);
+    free(s);
+
+    return sa;
+}
@@ -1,8 +1,10 @@
 
 #include "serialise.h"
 #include "string_utils.h"
+#include "suffix_array_internal.h"
 
 #include <stdlib.h>
+#include <assert.h>
 
 void write_complete_bwt_info(
     FILE *f,
@@ -11,8 +13,19 @@ void write_complete_bwt_info(
     const struct suffix_array *sa = bwt_table->sa;
     const struct remap_table *remap_table = bwt_table->remap_table;
     
-    write_string_len(f, sa->string, sa->length - 1);
-    write_suffix_array(f, sa);
+    // A self-index has no string; then we only write its length.
+    bool has_string = sa->string;
+    fwrite(&has_string, sizeof(bool), 1, f);
+    if (has_string) {
+        write_string_len(f, sa->string, sa->length - 1);
+    } else {
+        fwrite(&sa->length, sizeof(sa->length), 1, f);
+    }
+    // With a sampled suffix array, we do not need the full
+    // suffix array to locate matches, so we leave it out.
+    bool has_sa = !bwt_table->sa_samples;
+    fwrite(&has_sa, sizeof(bool), 1, f);
+    if (has_sa) write_suffix_array(f, sa);
     write_remap_table(f, remap_table);
     write_bwt_table(f, bwt_table);
 }
@@ -30,9 +43,23 @@ struct bwt_table *
 read_complete_bwt_info(
     FILE *f
 ) {
-    uint32_t str_len;
-    uint8_t *str = read_string_len(f, &str_len);
-    struct suffix_array *sa = read_suffix_array(f, str);
+    bool has_string;
+    fread(&has_string, sizeof(bool), 1, f);
+    struct suffix_array *sa;
+    if (has_string) {
+        uint32_t str_len;
+        uint8_t *str = read_string_len(f, &str_len);
+        bool has_sa;
+        fread(&has_sa, sizeof(bool), 1, f);
+        sa = has_sa ? read_suffix_array(f, str) : allocate_sa_without_array_(str);
+    } else {
+        index_t length;
+        fread(&length, sizeof(length), 1, f);
+        bool has_sa;
+        fread(&has_sa, sizeof(bool), 1, f);
+        assert(!has_sa);
+        sa = allocate_sa_without_string_(length);
+    }
     struct remap_table *remap_table = read_remap_table(f);
     struct bwt_table *bwt_table = read_bwt_table(f, sa, remap_table);
     return bwt_table;
@@ -47,3 +74,38 @@ read_complete_bwt_info_fname(
     fclose(f);
     return res;
 }
+
+void write_complete_rl_bwt_info(
+    FILE *f,
+    const struct rl_bwt_table *table
+) {
+    write_remap_table(f, table->remap_table);
+    write_rl_bwt_table(f, table);
+}
+
+void write_complete_rl_bwt_info_fname(
+    const char *fname,
+    const struct rl_bwt_table *table
+) {
+    FILE *f = fopen(fname, "wb");
+    write_complete_rl_bwt_info(f, table);
+    fclose(f);
+}
+
+struct rl_bwt_table *
+read_complete_rl_bwt_info(
+    FILE *f
+) {
+    struct remap_table *remap_table = read_remap_table(f);
+    return read_rl_bwt_table(f, remap_table);
+}
+
+struct rl_bwt_table *
+read_complete_rl_bwt_info_fname(
+    const char *fname
+) {
+    FILE *f = fopen(fname, "rb");
+    struct rl_bwt_table *res = read_complete_rl_bwt_info(f);
+    fclose(f);
+    return res;
+}
@@ -5,6 +5,7 @@
 #include "remap.h"
 #include "suffix_array.h"
 #include "bwt.h"
+#include "rl_bwt.h"
 
 #include <stdio.h>
 
@@ -18,7 +19,8 @@
  * These serialisation functions will write all the data stored in the
  * table, including string, suffix array, remap table and the BWT
  * tables. It is everything you need for a BWT search when you load it
- * back in.
+ * back in. Reading copies all the data into memory; for large tables,
+ * the index files in bwt_index.h let you map them in place instead.
  **/
 void write_complete_bwt_info(FILE *f, const struct bwt_table *bwt_table);
 void write_complete_bwt_info_fname(const char *fname, const struct bwt_table *bwt_table);
@@ -32,4 +34,14 @@ void write_complete_bwt_info_fname(const char *fname, const struct bwt_table *bw
 struct bwt_table *read_complete_bwt_info(FILE *f);
 struct bwt_table *read_complete_bwt_info_fname(const char *fname);
 
+/**
+ * The same for a run-length BWT table: the remap table and the
+ * table. There is no string or suffix array to write. Free the
+ * table you read with completely_free_rl_bwt_table.
+ */
+void write_complete_rl_bwt_info(FILE *f, const struct rl_bwt_table *table);
+void write_complete_rl_bwt_info_fname(const char *fname, const struct rl_bwt_table *table);
+struct rl_bwt_table *read_complete_rl_bwt_info(FILE *f);
+struct rl_bwt_table *read_complete_rl_bwt_info_fname(const char *fname);
+
 #endif
@@ -3,12 +3,17 @@
 
 #include <aho_corasick.h>
 #include <bwt.h>
+#include <bwt_index.h>
 #include <cigar.h>
 #include <edit_distance_generator.h>
 #include <error.h>
+#include <index_type.h>
 #include <io.h>
 #include <match.h>
+#include <occ_table.h>
+#include <parallel.h>
 #include <remap.h>
+#include <rl_bwt.h>
 #include <serialise.h>
 #include <string_utils.h>
 #include <suffix_array.h>
@@ -4,15 +4,15 @@
 
 uint8_t *str_copy(const uint8_t *x)
 {
-    return str_copy_n(x, (uint32_t)strlen((char *)x));
+    return str_copy_n(x, strlen((char *)x));
 }
 
 void str_inplace_rev(uint8_t *x)
 {
-    str_inplace_rev_n(x, (uint32_t)strlen((char *)x));
+    str_inplace_rev_n(x, strlen((char *)x));
 }
 
-uint8_t *str_copy_n(const uint8_t *x, uint32_t n)
+uint8_t *str_copy_n(const uint8_t *x, size_t n)
 {
     uint8_t *copy = malloc(sizeof(uint8_t) * n + 1);
     strncpy((char *)copy, (char *)x, n);
@@ -20,7 +20,7 @@ uint8_t *str_copy_n(const uint8_t *x, uint32_t n)
     return copy;
 }
 
-void str_inplace_rev_n(uint8_t *x, uint32_t n)
+void str_inplace_rev_n(uint8_t *x, size_t n)
 {
     uint8_t *y = x + n - 1;
     while (x < y) {
@@ -31,7 +31,7 @@ void str_inplace_rev_n(uint8_t *x, uint32_t n)
     }
 }
 
-uint8_t *str_rev_n(const uint8_t *x, uint32_t n)
+uint8_t *str_rev_n(const uint8_t *x, size_t n)
 {
     uint8_t *x_copy = str_copy_n(x, n);
     str_inplace_rev_n(x_copy, n);
@@ -40,7 +40,7 @@ uint8_t *str_rev_n(const uint8_t *x, uint32_t n)
 
 uint8_t *str_rev(const uint8_t *x)
 {
-    return str_rev_n(x, (uint32_t)strlen((char *)x));
+    return str_rev_n(x, strlen((char *)x));
 }
 
 
@@ -12,19 +12,19 @@
  * of the string that is returned.
  **/
 uint8_t *str_copy(const uint8_t *x);
-uint8_t *str_copy_n(const uint8_t *x, uint32_t n);
+uint8_t *str_copy_n(const uint8_t *x, size_t n);
 
 /**
  * Reverses the string x inplace.
  **/
 void str_inplace_rev(uint8_t *x);
-void str_inplace_rev_n(uint8_t *x, uint32_t n);
+void str_inplace_rev_n(uint8_t *x, size_t n);
 
 /**
  * Return a reverse string
  **/
 uint8_t *str_rev(const uint8_t *x);
-uint8_t *str_rev_n(const uint8_t *x, uint32_t n);
+uint8_t *str_rev_n(const uint8_t *x, size_t n);
 
 /**
  * Serialisation: write a string to a file.
@@ -2,6 +2,7 @@
 #include "suffix_array.h"
 #include "suffix_array_internal.h"
 #include "vectors.h"
+#include "parallel.h"
 
 #include <stdlib.h>
 #include <string.h>
@@ -13,7 +14,15 @@ void free_suffix_array(struct suffix_array *sa)
 {
     free(sa->array);
     if (sa->inverse) free(sa->inverse);
-    if (sa->lcp)     free(sa->lcp);
+    if (sa->lcp.values) {
+        free(sa->lcp.values);
+        free(sa->lcp.overflow_rows);
+        free(sa->lcp.overflow_values);
+    }
+    if (sa->lcp_lr)  free(sa->lcp_lr);
+    if (sa->buckets.starts) free(sa->buckets.starts);
+    if (sa->search_tree.prefixes) free(sa->search_tree.prefixes);
+    if (sa->search_tree.rows) free(sa->search_tree.rows);
     free(sa);
 }
 
@@ -40,7 +49,7 @@ struct suffix_array *qsort_sa_construction(uint8_t *string)
     qsort(suffixes, sa->length, sizeof(char *), construction_cmpfunc);
     
     for (int i = 0; i < sa->length; i++)
-        sa->array[i] = (uint32_t)(suffixes[i] - string);
+        sa->array[i] = (index_t)(suffixes[i] - string);
     
     free(suffixes);
     
@@ -57,99 +66,565 @@ void compute_inverse(struct suffix_array *sa)
     if (sa->inverse) return; // only compute if it is needed
     
     sa->inverse = malloc(sa->length * sizeof(*sa->inverse));
-    for (uint32_t i = 0; i < sa->length; ++i)
+    for (index_t i = 0; i < sa->length; ++i)
         sa->inverse[sa->array[i]] = i;
 }
 
+// Below this length, the threads cost more than they save.
+#define PARALLEL_LCP_THRESHOLD (1 << 16)
+
+// We compute the LCP array in four passes, each split into one
+// chunk per thread. First we set plcp[SA[i]] = SA[i - 1], the
+// Phi array. Then we replace Phi, in text order, with the
+// permuted LCP array, PLCP[j] = LCP[ISA[j]]. Since
+// PLCP[j + 1] >= PLCP[j] - 1, we only compare from there, so
+// the comparisons are linear in total; a thread starts its part
+// of the string from zero, which only costs the longest prefix
+// at each boundary. Then we store LCP[i] = PLCP[SA[i]], counting
+// the values that do not fit in a byte, and finally, when we
+// know where each chunk's overflows go, we collect them.
+struct lcp_job {
+    const struct suffix_array *sa;
+    index_t *plcp;
+    index_t *no_overflows; // per chunk, and then where they start
+};
+
+static void lcp_phi(void *data, uint32_t t, uint32_t no_threads)
+{
+    struct lcp_job *job = data;
+    const index_t *array = job->sa->array;
+    index_t n = job->sa->length;
+    index_t start = chunk_start(n, t, no_threads, 1);
+    index_t end = chunk_start(n, t + 1, no_threads, 1);
+    // The sentinel suffix has nothing before it; we mark it
+    // with n.
+    if (start == 0) job->plcp[array[start++]] = n;
+    for (index_t i = start; i < end; ++i) {
+        job->plcp[array[i]] = array[i - 1];
+    }
+}
+
+static void lcp_plcp(void *data, uint32_t t, uint32_t no_threads)
+{
+    struct lcp_job *job = data;
+    const uint8_t *x = job->sa->string;
+    index_t n = job->sa->length;
+    index_t start = chunk_start(n, t, no_threads, 1);
+    index_t end = chunk_start(n, t + 1, no_threads, 1);
+    index_t l = 0;
+    for (index_t j = start; j < end; ++j) {
+        index_t k = job->plcp[j];
+        if (k == n) {
+            l = 0;
+        } else {
+            // The sentinel is unique, so we stop before it.
+            while (x[j + l] == x[k + l]) ++l;
+        }
+        job->plcp[j] = l;
+        l = l > 0 ? l - 1 : 0;
+    }
+}
+
+static void lcp_values(void *data, uint32_t t, uint32_t no_threads)
+{
+    struct lcp_job *job = data;
+    const struct suffix_array *sa = job->sa;
+    index_t start = chunk_start(sa->length, t, no_threads, 1);
+    index_t end = chunk_start(sa->length, t + 1, no_threads, 1);
+    index_t no_overflows = 0;
+    for (index_t i = start; i < end; ++i) {
+        index_t l = job->plcp[sa->array[i]];
+        if (l >= SA_LCP_OVERFLOW) {
+            sa->lcp.values[i] = SA_LCP_OVERFLOW;
+            no_overflows++;
+        } else {
+            sa->lcp.values[i] = (uint8_t)l;
+        }
+    }
+    job->no_overflows[t] = no_overflows;
+}
+
+static void lcp_overflows(void *data, uint32_t t, uint32_t no_threads)
+{
+    struct lcp_job *job = data;
+    const struct suffix_array *sa = job->sa;
+    index_t start = chunk_start(sa->length, t, no_threads, 1);
+    index_t end = chunk_start(sa->length, t + 1, no_threads, 1);
+    index_t k = job->no_overflows[t];
+    for (index_t i = start; i < end; ++i) {
+        if (sa->lcp.values[i] != SA_LCP_OVERFLOW) continue;
+        sa->lcp.overflow_rows[k] = i;
+        sa->lcp.overflow_values[k] = job->plcp[sa->array[i]];
+        k++;
+    }
+}
+
 void compute_lcp(struct suffix_array *sa)
 {
-    if (sa->lcp) return; // only compute if we have to
+    if (sa->lcp.values) return; // only compute if we have to
     
-    sa->lcp = malloc((sa->length) * sizeof(*sa->lcp));
+    uint32_t no_threads = stralg_threads();
+    if (no_threads == 0 || sa->length < PARALLEL_LCP_THRESHOLD)
+        no_threads = 1;
     
-    compute_inverse(sa);
-    sa->lcp[0] = 0;
-    uint32_t l = 0;
-    for (uint32_t i = 0; i < sa->length; ++i) {
-        uint32_t j = sa->inverse[i];
-        
-        // Don't handle index 0; lcp[0] is always zero.
-        if (j == 0) continue;
-        
-        uint32_t k = sa->array[j - 1];
-        while (sa->string[k + l] == sa->string[i + l])
-            ++l;
-        sa->lcp[j] = l;
-        l = l > 0 ? l - 1 : 0;
+    index_t no_overflows[no_threads];
+    struct lcp_job job = {
+        .sa = sa,
+        .plcp = malloc(sa->length * sizeof(*job.plcp)),
+        .no_overflows = no_overflows
+    };
+    sa->lcp.values = malloc(sa->length);
+    run_in_parallel(no_threads, lcp_phi, &job);
+    run_in_parallel(no_threads, lcp_plcp, &job);
+    run_in_parallel(no_threads, lcp_values, &job);
+    
+    index_t total = 0;
+    for (uint32_t t = 0; t < no_threads; ++t) {
+        index_t count = no_overflows[t];
+        no_overflows[t] = total;
+        total += count;
     }
+    sa->lcp.no_overflows = total;
+    // Never zero bytes, so free() always gets a pointer
+    // we allocated.
+    sa->lcp.overflow_rows = malloc((total + 1) * sizeof(index_t));
+    sa->lcp.overflow_values = malloc((total + 1) * sizeof(index_t));
+    if (total) run_in_parallel(no_threads, lcp_overflows, &job);
+    
+    free(job.plcp);
 }
 
-/// MARK: Searching
+index_t *lcp_array(struct suffix_array *sa)
+{
+    compute_lcp(sa);
+    index_t *lcp = malloc(sa->length * sizeof(*lcp));
+    for (index_t i = 0; i < sa->length; ++i) {
+        lcp[i] = sa->lcp.values[i];
+    }
+    for (index_t k = 0; k < sa->lcp.no_overflows; ++k) {
+        lcp[sa->lcp.overflow_rows[k]] = sa->lcp.overflow_values[k];
+    }
+    return lcp;
+}
 
+// The probes of the binary search in bound_search() form a
+// tree: the interval (L,R) probes mid = L + (R - L) / 2 and
+// continues in (L,mid) or (mid,R), so we probe each index from
+// exactly one interval. We store lcp(SA[L],SA[mid]) at 2 * mid
+// and lcp(SA[mid],SA[R]) at 2 * mid + 1. R can be one past the
+// end; it shares no prefix with anything.
+static index_t fill_lcp_lr(
+    struct suffix_array *sa,
+    index_t L, index_t R
+) {
+    if (R - L == 1)
+        return (R == sa->length) ? 0 : sa_lcp(sa, R);
+    index_t mid = L + (R - L) / 2;
+    index_t left = fill_lcp_lr(sa, L, mid);
+    index_t right = fill_lcp_lr(sa, mid, R);
+    sa->lcp_lr[2 * mid] = left;
+    sa->lcp_lr[2 * mid + 1] = right;
+    return (left < right) ? left : right;
+}
+
+void compute_lcp_lr(struct suffix_array *sa)
+{
+    if (sa->lcp_lr) return; // only compute if we have to
+    
+    compute_lcp(sa);
+    sa->lcp_lr = malloc(2 * sa->length * sizeof(*sa->lcp_lr));
+    sa->lcp_lr[0] = sa->lcp_lr[1] = 0; // we never probe SA[0]
+    if (sa->length > 1) fill_lcp_lr(sa, 0, sa->length);
+}
+
+/// MARK: Prefix buckets
 
-uint32_t lower_bound_search(
+static uint64_t no_bucket_codes(
+    uint32_t alphabet_size,
+    uint32_t q
+) {
+    uint64_t codes = 1;
+    for (uint32_t j = 0; j < q; ++j) codes *= alphabet_size;
+    return codes;
+}
+
+void compute_prefix_buckets(
     struct suffix_array *sa,
-    const uint8_t *key
+    uint32_t alphabet_size,
+    uint32_t q
 ) {
-    uint32_t L = 0, R = sa->length;
-    uint32_t key_len = (uint32_t)strlen((char*)key);
-    uint32_t mid;
-    while (L < R) {
-        mid = L + (R - L) / 2;
-        int cmp = strncmp(
-            (char *)key,
-            (char *)(sa->string + sa->array[mid]),
-            key_len
-        );
-        if (cmp <= 0) {
-            R = mid;
-        } else if (cmp > 0) {
-            L = mid + 1;
-        }
-        
+    if (sa->buckets.starts) return; // only compute if we have to
+    assert(sa->string);
+    assert(alphabet_size > 1);
+    
+    if (q == 0) {
+        q = 1;
+        uint64_t max_codes = sa->length / 4;
+        while (no_bucket_codes(alphabet_size, q + 1) <= max_codes) q++;
     }
-    return (L <= R) ? L : R;
+    uint64_t no_codes = no_bucket_codes(alphabet_size, q);
+    assert(no_codes < (index_t)~(index_t)0);
+    
+    // Count the q-grams in one scan of the string, with the
+    // code of the window starting at i rolling along. The
+    // codes are sorted like the suffixes, so the counts give
+    // us the intervals.
+    const uint8_t *x = sa->string;
+    index_t n = sa->length;
+    index_t *starts = calloc(no_codes + 1, sizeof(index_t));
+    uint64_t high = no_codes / alphabet_size; // weight of the first symbol
+    uint64_t code = 0;
+    for (index_t j = 0; j < q; ++j) {
+        code = code * alphabet_size + ((j < n) ? x[j] : 0);
+    }
+    for (index_t i = 0; i < n; ++i) {
+        assert(x[i] < alphabet_size);
+        starts[code]++;
+        uint8_t next = (i + q < n) ? x[i + q] : 0;
+        code = (code - x[i] * high) * alphabet_size + next;
+    }
+    
+    index_t total = 0;
+    for (uint64_t c = 0; c <= no_codes; ++c) {
+        index_t count = starts[c];
+        starts[c] = total;
+        total += count;
+    }
+    
+    sa->buckets.alphabet_size = alphabet_size;
+    sa->buckets.q = q;
+    sa->buckets.starts = starts;
 }
 
-uint32_t upper_bound_search(
+// The interval of the suffixes that share the key's first
+// q symbols -- or all of the key if it is shorter. Returns
+// false if we have no buckets or the key has a symbol that is
+// not in their alphabet.
+static bool bucket_interval(
+    const struct suffix_array *sa,
+    const uint8_t *key,
+    index_t m,
+    index_t *begin,
+    index_t *end
+) {
+    const struct sa_prefix_buckets *buckets = &sa->buckets;
+    if (!buckets->starts) return false;
+    
+    uint64_t code = 0;
+    for (uint32_t j = 0; j < buckets->q; ++j) {
+        uint8_t a = (j < m) ? key[j] : 0;
+        if (a >= buckets->alphabet_size) return false;
+        code = code * buckets->alphabet_size + a;
+    }
+    // A short key is a prefix of all the codes from the one
+    // where we pad it with zeros, to the next key.
+    uint64_t width = (m < buckets->q) ?
+        no_bucket_codes(buckets->alphabet_size, buckets->q - (uint32_t)m) : 1;
+    *begin = buckets->starts[code];
+    *end = buckets->starts[code + width];
+    return true;
+}
+
+/// MARK: Search tree
+
+#define DEFAULT_TREE_SAMPLE_RATE 16
+#define CACHE_LINE_SIZE 64
+
+// The first eight symbols of a suffix, big-endian and padded
+// with zeros after the sentinel.
+static uint64_t packed_prefix(const uint8_t *x)
+{
+    uint64_t word = 0;
+    int j = 0;
+    for (; j < 8 && x[j]; ++j) word = (word << 8) | x[j];
+    return word << (8 * (8 - j));
+}
+
+// Place the samples in Eytzinger order with an in-order
+// traversal of the tree, where node k has children 2k and 2k+1.
+static index_t fill_search_tree(
+    const struct suffix_array *sa,
+    struct sa_search_tree *tree,
+    index_t k,
+    index_t i
+) {
+    if (k > tree->no_samples) return i;
+    i = fill_search_tree(sa, tree, 2 * k, i);
+    index_t row = (i + 1) * tree->sample_rate;
+    tree->prefixes[k] = packed_prefix(sa->string + sa->array[row]);
+    tree->rows[k] = row;
+    return fill_search_tree(sa, tree, 2 * k + 1, i + 1);
+}
+
+void compute_search_tree(
     struct suffix_array *sa,
-    const uint8_t *key
+    index_t sample_rate
 ) {
-    uint32_t L = 0, R = sa->length;
-    uint32_t key_len = (uint32_t)strlen((char*)key);
-    uint32_t mid;
-    while (L < R) {
-        mid = L + (R - L) / 2;
-        int cmp = strncmp(
-            (char *)key,
-            (char *)(sa->string + sa->array[mid]),
-            key_len
-        );
-        if (cmp < 0) {
-            R = mid - 1;
-        } else if (cmp >= 0) {
-            L = mid + 1;
+    struct sa_search_tree *tree = &sa->search_tree;
+    if (tree->prefixes) return; // only compute if we have to
+    assert(sa->string);
+    
+    if (sample_rate == 0) sample_rate = DEFAULT_TREE_SAMPLE_RATE;
+    tree->sample_rate = sample_rate;
+    // Row zero is the empty suffix; we never need it.
+    tree->no_samples = (sa->length - 1) / sample_rate;
+    // Aligned so the eight grandchildren of a node's
+    // grandchildren share a cache line.
+    size_t size = (tree->no_samples + 1) * sizeof(*tree->prefixes);
+    size = (size + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+    tree->prefixes = aligned_alloc(CACHE_LINE_SIZE, size);
+    tree->rows = malloc((tree->no_samples + 1) * sizeof(*tree->rows));
+    tree->prefixes[0] = 0; tree->rows[0] = 0; // not used
+    fill_search_tree(sa, tree, 1, 0);
+}
+
+// The first sample whose first symbols (those in mask) are
+// greater than, or with or_equal, at least, x. It is zero if
+// there is none. The last sample before it goes into pred,
+// also zero if there is none. Going right at node k in the
+// in-order tree puts a one in k's bits, so the first sample
+// greater is the node where we last went left: we drop the
+// trailing ones and that zero.
+static index_t tree_search(
+    const struct sa_search_tree *tree,
+    uint64_t x,
+    uint64_t mask,
+    bool or_equal,
+    index_t *pred
+) {
+    const uint64_t *prefixes = tree->prefixes;
+    uint64_t k = 1, p = 0;
+    while (k <= tree->no_samples) {
+        __builtin_prefetch(prefixes + 8 * k);
+        uint64_t v = prefixes[k] & mask;
+        bool right = or_equal ? v <= x : v < x;
+        p = right ? k : p;
+        k = 2 * k + right;
+    }
+    *pred = (index_t)p;
+    return (index_t)(k >> __builtin_ffsll((long long)~k));
+}
+
+// The length of the prefix of the key, up to its first p
+// symbols, we know it shares with a sample.
+static index_t shared_with_sample(
+    uint64_t sample,
+    uint64_t x,
+    index_t p
+) {
+    uint64_t diff = sample ^ x;
+    index_t shared = diff ? (index_t)__builtin_clzll(diff) / 8 : 8;
+    return (shared < p) ? shared : p;
+}
+
+// The open interval of rows between two samples, or the
+// ends, that holds the bound, with lower bounds on the prefixes
+// the key shares with the two sample suffixes. We only compare
+// the first p = min(m,8) symbols. A sample less than the key
+// there is before the bound and a sample greater is after it.
+// If they are equal and the key is at most eight symbols, the
+// sample starts with the key, so it is at least the key for
+// the lower bound and at most it for the upper bound.
+static void tree_interval(
+    const struct suffix_array *sa,
+    const uint8_t *key,
+    index_t m,
+    bool upper,
+    index_t *L, index_t *l,
+    index_t *R, index_t *r
+) {
+    const struct sa_search_tree *tree = &sa->search_tree;
+    index_t p = (m < 8) ? m : 8;
+    uint64_t mask = ~(uint64_t)0 << (8 * (8 - p));
+    uint64_t x = 0;
+    for (index_t j = 0; j < p; ++j) x = (x << 8) | key[j];
+    x <<= 8 * (8 - p);
+    
+    index_t before, after;
+    if (m <= 8 && !upper) {
+        after = tree_search(tree, x, mask, false, &before);
+    } else if (m <= 8) {
+        after = tree_search(tree, x, mask, true, &before);
+    } else {
+        // We only need the second search if the first
+        // found samples equal to the key.
+        after = tree_search(tree, x, mask, false, &before);
+        if (after && (tree->prefixes[after] & mask) == x) {
+            index_t ignore;
+            after = tree_search(tree, x, mask, true, &ignore);
         }
     }
-    R = (R > L) ? R : L;
-    if (R == sa->length) return R;
+    *L = before ? tree->rows[before] : 0;
+    *l = before ? shared_with_sample(tree->prefixes[before] & mask, x, p) : 0;
+    *R = after ? tree->rows[after] : sa->length;
+    *r = after ? shared_with_sample(tree->prefixes[after] & mask, x, p) : 0;
+}
+
+static index_t shared_prefix(
+    const struct suffix_array *sa,
+    const uint8_t *key,
+    index_t m,
+    index_t i
+) {
+    // The empty suffix and past the end share nothing
+    if (i == 0 || i == sa->length) return 0;
+    const uint8_t *suffix = sa->string + sa->array[i];
+    index_t k = 0;
+    while (k < m && key[k] == suffix[k]) ++k;
+    return k;
+}
+
+/// MARK: Searching
+
+// We search in an open interval (L,R) of suffix array rows,
+// starting from (0,n). SA[0] is the empty suffix, so it is
+// before any key, and R = n is after all of them. We only
+// compare the first m characters of the suffixes; the key is
+// after SA[L] and, for the lower bound, at most SA[R], for the
+// upper bound less than SA[R]. l and r are the lengths of the
+// prefixes the key shares with SA[L] and SA[R], or lower bounds
+// on them; the suffixes between share at least min(l,r) with
+// the key, so we can start comparing there. With LCP-LR we can
+// often decide the probe without looking at the suffix, and
+// otherwise start from max(l,r), but then l and r must be exact.
+struct search_interval {
+    index_t L, l;
+    index_t R, r;
+};
+
+// Prefix buckets and the search tree narrow the interval
+// before we search. The suffixes in a bucket all share q
+// symbols with the key, so we can treat its ends as if they did
+// too. Returns true if the bucket is the answer, which is then
+// in R. The tree does not pay off if the bucket is already as
+// small as the rows between two samples.
+static bool narrow_search(
+    const struct suffix_array *sa,
+    const uint8_t *key,
+    index_t m,
+    bool upper,
+    struct search_interval *iv
+) {
+    *iv = (struct search_interval){ .L = 0, .l = 0, .R = sa->length, .r = 0 };
+    index_t begin, end;
+    if (bucket_interval(sa, key, m, &begin, &end)) {
+        if (m <= sa->buckets.q || begin == end) {
+            iv->R = upper ? end : begin;
+            return true;
+        }
+        // The empty suffix is never in a bucket with the key,
+        // so begin > 0.
+        iv->L = begin - 1; iv->R = end;
+        iv->l = iv->r = sa->buckets.q;
+    }
+    const struct sa_search_tree *tree = &sa->search_tree;
+    if (tree->prefixes && iv->R - iv->L > tree->sample_rate) {
+        struct search_interval t;
+        tree_interval(sa, key, m, upper, &t.L, &t.l, &t.R, &t.r);
+        if (t.L > iv->L) { iv->L = t.L; iv->l = t.l; }
+        if (t.R < iv->R) { iv->R = t.R; iv->r = t.r; }
+    }
+    return false;
+}
+
+// The binary search. It leaves the final interval, where
+// R = L + 1 is the bound, in iv. LCP-LR only works for the
+// intervals in its tree, and needs exact l and r, so if the
+// interval is narrowed we go down that tree until we probe
+// inside it; that needs no suffixes, only the prefixes the key
+// shares with the two ends where we stop. A bucket can cover
+// all rows but the first, so narrowing can leave (0,n) with
+// the bucket's l and r, which are only lower bounds there.
+static index_t binary_search(
+    const struct suffix_array *sa,
+    const uint8_t *key,
+    index_t m,
+    bool upper,
+    struct search_interval *iv
+) {
+    const index_t *lcp_lr = sa->lcp_lr;
+    index_t L = iv->L, R = iv->R;
+    index_t l = iv->l, r = iv->r;
+    if (lcp_lr && (L > 0 || R < sa->length || l > 0 || r > 0)) {
+        index_t narrow_L = L, narrow_R = R;
+        L = 0; R = sa->length;
+        while (R - L > 1) {
+            index_t mid = L + (R - L) / 2;
+            if (mid <= narrow_L) L = mid;
+            else if (mid >= narrow_R) R = mid;
+            else break;
+        }
+        l = shared_prefix(sa, key, m, L);
+        r = shared_prefix(sa, key, m, R);
+    }
     
-    int cmp = strncmp(
-        (char *)key,
-        (char *)(sa->string + sa->array[R]),
-        key_len
-    );
-    return (cmp >= 0) ? R + 1 : R;
+    while (R - L > 1) {
+        index_t mid = L + (R - L) / 2;
+        index_t k;
+        if (!lcp_lr) {
+            k = (l < r) ? l : r;
+        } else if (l >= r) {
+            // SA[mid] is after SA[L]; if it shares more with it
+            // than the key does, it is on the same side of the
+            // key, and if it shares less, it is after the key.
+            index_t shared = lcp_lr[2 * mid];
+            if (shared > l) { L = mid; continue; }
+            if (shared < l) { R = mid; r = shared; continue; }
+            k = l;
+        } else {
+            index_t shared = lcp_lr[2 * mid + 1];
+            if (shared > r) { R = mid; continue; }
+            if (shared < r) { L = mid; l = shared; continue; }
+            k = r;
+        }
+        
+        const uint8_t *suffix = sa->string + sa->array[mid];
+        while (k < m && key[k] == suffix[k]) ++k;
+        bool key_after = (k == m) ? upper : key[k] > suffix[k];
+        if (key_after) {
+            L = mid; l = k;
+        } else {
+            R = mid; r = k;
+        }
+    }
+    *iv = (struct search_interval){ .L = L, .l = l, .R = R, .r = r };
+    return R;
+}
+
+static index_t bound_search(
+    const struct suffix_array *sa,
+    const uint8_t *key,
+    bool upper
+) {
+    index_t m = (index_t)strlen((char *)key);
+    if (m == 0) return upper ? sa->length : 0;
+    struct search_interval iv;
+    if (narrow_search(sa, key, m, upper, &iv)) return iv.R;
+    return binary_search(sa, key, m, upper, &iv);
+}
+
+index_t lower_bound_search(
+    struct suffix_array *sa,
+    const uint8_t *key
+) {
+    return bound_search(sa, key, false);
 }
 
-uint32_t lower_bound_k(
+index_t upper_bound_search(
     struct suffix_array *sa,
-    uint32_t k, uint8_t a,
-    uint32_t L, uint32_t R
+    const uint8_t *key
+) {
+    return bound_search(sa, key, true);
+}
+
+index_t lower_bound_k(
+    struct suffix_array *sa,
+    index_t k, uint8_t a,
+    index_t L, index_t R
 ) {
     while (L < R) {
-        uint32_t mid = L + (R - L) / 2;
-        uint32_t b_idx = sa->array[mid] + k;
+        index_t mid = L + (R - L) / 2;
+        index_t b_idx = sa->array[mid] + k;
         if (b_idx >= sa->length) {
             // b is less if it is past the end
             L = mid + 1;
@@ -165,15 +640,15 @@ uint32_t lower_bound_k(
     return (L <= R) ? L : R;
 }
 
-uint32_t upper_bound_k(
+index_t upper_bound_k(
     struct suffix_array *sa,
-    uint32_t k, uint8_t a,
-    uint32_t L, uint32_t R
+    index_t k, uint8_t a,
+    index_t L, index_t R
 ) {
-    uint32_t orig_R = R;
+    index_t orig_R = R;
     while (L < R) {
-        uint32_t mid = L + (R - L) / 2;
-        uint32_t b_idx = sa->array[mid] + k;
+        index_t mid = L + (R - L) / 2;
+        index_t b_idx = sa->array[mid] + k;
         if (b_idx >= sa->length) {
             // b is less if it is past the end
             L = mid + 1;
@@ -201,17 +676,36 @@ void init_sa_match_iter(
 ) {
     iter->sa = sa;
 
-    uint32_t key_len = (uint32_t)strlen((char*)key);
-    uint32_t L = 0, R = sa->length;
-    
-    for (uint32_t i = 0; i < key_len; i++) {
-        L = lower_bound_k(sa, i, key[i], L, R);
-        R = upper_bound_k(sa, i, key[i], L, R);
-        if (L >= R) break;
-    }
-    if (L == R) {
-        iter->L = iter->R = 0;
-        iter->i = 1;
+    // The matches are the suffixes in [L,R); if there are
+    // none, L == R and the iterator is empty.
+    index_t L, R;
+    index_t m = (index_t)strlen((char *)key);
+    struct search_interval lower, upper;
+    if (m == 0) {
+        L = 0; R = sa->length;
+    } else if (narrow_search(sa, key, m, false, &lower)) {
+        L = lower.R;
+        R = upper_bound_search(sa, key);
+    } else {
+        // Past the key's first eight symbols, the tree narrows
+        // both bounds the same way; otherwise we narrow again.
+        // The upper bound is after the row before the lower
+        // bound, or after the lower bound itself if that starts
+        // with the key. LCP-LR needs its own intervals, so there
+        // we search from scratch.
+        bool same_narrowing = m > 8 || !sa->search_tree.prefixes;
+        upper = lower;
+        if (!same_narrowing) narrow_search(sa, key, m, true, &upper);
+        L = binary_search(sa, key, m, false, &lower);
+        if (!sa->lcp_lr) {
+            if (lower.r == m) {
+                lower.L = lower.R; lower.l = m;
+            }
+            if (lower.L > upper.L) {
+                upper.L = lower.L; upper.l = lower.l;
+            }
+        }
+        R = binary_search(sa, key, m, true, &upper);
     }
     iter->L = L;
     iter->R = R - 1;
@@ -235,9 +729,19 @@ void dealloc_sa_match_iter(struct sa_match_iter *iter)
 
 /// MARK: IO
 
+// After the array comes q for the prefix buckets, zero if
+// there are none, and then their alphabet size and table.
 void write_suffix_array(FILE *f, const struct suffix_array *sa)
 {
     fwrite(sa->array, sizeof(*sa->array), sa->length, f);
+    const struct sa_prefix_buckets *buckets = &sa->buckets;
+    uint32_t q = buckets->starts ? buckets->q : 0;
+    fwrite(&q, sizeof(q), 1, f);
+    if (q) {
+        fwrite(&buckets->alphabet_size, sizeof(buckets->alphabet_size), 1, f);
+        fwrite(buckets->starts, sizeof(*buckets->starts),
+               no_bucket_codes(buckets->alphabet_size, q) + 1, f);
+    }
 }
 void write_suffix_array_fname(const char *fname,
                               const struct suffix_array *sa)
@@ -253,6 +757,16 @@ struct suffix_array *read_suffix_array(
 ) {
     struct suffix_array *sa = allocate_sa_(string);
     fread(sa->array, sizeof(*sa->array), sa->length, f);
+    uint32_t q = 0;
+    fread(&q, sizeof(q), 1, f);
+    if (q) {
+        struct sa_prefix_buckets *buckets = &sa->buckets;
+        fread(&buckets->alphabet_size, sizeof(buckets->alphabet_size), 1, f);
+        uint64_t no_starts = no_bucket_codes(buckets->alphabet_size, q) + 1;
+        buckets->q = q;
+        buckets->starts = malloc(no_starts * sizeof(*buckets->starts));
+        fread(buckets->starts, sizeof(*buckets->starts), no_starts, f);
+    }
     return sa;
 }
 struct suffix_array *
@@ -266,17 +780,63 @@ read_suffix_array_fname(
     return sa;
 }
 
+// The bytes, one per row, then the number of overflows
+// and their rows and values.
+void write_lcp(FILE *f, const struct suffix_array *sa)
+{
+    const struct sa_lcp *lcp = &sa->lcp;
+    assert(lcp->values);
+    fwrite(lcp->values, 1, sa->length, f);
+    fwrite(&lcp->no_overflows, sizeof(lcp->no_overflows), 1, f);
+    fwrite(lcp->overflow_rows, sizeof(*lcp->overflow_rows),
+           lcp->no_overflows, f);
+    fwrite(lcp->overflow_values, sizeof(*lcp->overflow_values),
+           lcp->no_overflows, f);
+}
+void write_lcp_fname(const char *fname,
+                     const struct suffix_array *sa)
+{
+    FILE *f = fopen(fname, "wb");
+    write_lcp(f, sa);
+    fclose(f);
+}
+
+void read_lcp(FILE *f, struct suffix_array *sa)
+{
+    struct sa_lcp *lcp = &sa->lcp;
+    if (lcp->values) {
+        free(lcp->values);
+        free(lcp->overflow_rows);
+        free(lcp->overflow_values);
+    }
+    lcp->values = malloc(sa->length);
+    fread(lcp->values, 1, sa->length, f);
+    lcp->no_overflows = 0;
+    fread(&lcp->no_overflows, sizeof(lcp->no_overflows), 1, f);
+    index_t no_overflows = lcp->no_overflows;
+    lcp->overflow_rows = malloc((no_overflows + 1) * sizeof(index_t));
+    lcp->overflow_values = malloc((no_overflows + 1) * sizeof(index_t));
+    fread(lcp->overflow_rows, sizeof(index_t), no_overflows, f);
+    fread(lcp->overflow_values, sizeof(index_t), no_overflows, f);
+}
+void read_lcp_fname(const char *fname, struct suffix_array *sa)
+{
+    FILE *f = fopen(fname, "rb");
+    read_lcp(f, sa);
+    fclose(f);
+}
+
 void print_suffix_array(struct suffix_array *sa)
 {
-    for (uint32_t i = 0; i < sa->length; ++i) {
-        printf("SA[%3u] = %3u\t%s\n",
+    for (index_t i = 0; i < sa->length; ++i) {
+        printf("SA[%3" PRIindex "] = %3" PRIindex "\t%s\n",
                i, sa->array[i], sa->string + sa->array[i]);
     }
-    if (sa->lcp) {
+    if (sa->lcp.values) {
         printf("\n");
-        for (uint32_t i = 0; i < sa->length; ++i) {
-            printf("lcp[%3u] =%3uzu\t%s\n",
-                   i, sa->lcp[i], sa->string + sa->array[i]);
+        for (index_t i = 0; i < sa->length; ++i) {
+            printf("lcp[%3" PRIindex "] =%3" PRIindex "\t%s\n",
+                   i, sa_lcp(sa, i), sa->string + sa->array[i]);
         }
         
     }
@@ -290,17 +850,56 @@ bool identical_suffix_arrays(const struct suffix_array *sa1,
     if (sa1->length != sa2->length)
         return false;
     
-    if (strcmp((char *)sa1->string, (char *)sa2->string) != 0)
+    // The string is missing in a self-index.
+    if (!sa1->string || !sa2->string) {
+        if (sa1->string || sa2->string)
+            return false;
+    } else if (strcmp((char *)sa1->string, (char *)sa2->string) != 0) {
         return false;
+    }
+    
+    // The array is missing if we only keep a sampled
+    // suffix array in a BWT table.
+    if (!sa1->array || !sa2->array)
+        return !sa1->array && !sa2->array;
     
-    for (uint32_t i = 0; i < sa1->length; ++i) {
+    for (index_t i = 0; i < sa1->length; ++i) {
         if (sa1->array[i] != sa2->array[i])
             return false;
     }
     
-    assert(strlen((char *)sa1->string) + 1 == sa1->length);
-    if (strlen((char *)sa1->string) + 1 != sa1->length)
-        return false;
+    const struct sa_prefix_buckets *b1 = &sa1->buckets, *b2 = &sa2->buckets;
+    if (!b1->starts || !b2->starts) {
+        if (b1->starts || b2->starts)
+            return false;
+    } else {
+        if (b1->q != b2->q || b1->alphabet_size != b2->alphabet_size)
+            return false;
+        uint64_t no_starts = no_bucket_codes(b1->alphabet_size, b1->q) + 1;
+        if (memcmp(b1->starts, b2->starts,
+                   no_starts * sizeof(*b1->starts)) != 0)
+            return false;
+    }
+    
+    // The LCP array is not serialised with the suffix array,
+    // so we only compare it if both have it.
+    const struct sa_lcp *l1 = &sa1->lcp, *l2 = &sa2->lcp;
+    if (l1->values && l2->values) {
+        if (l1->no_overflows != l2->no_overflows)
+            return false;
+        if (memcmp(l1->values, l2->values, sa1->length) != 0)
+            return false;
+        size_t overflow_size = l1->no_overflows * sizeof(index_t);
+        if (memcmp(l1->overflow_rows, l2->overflow_rows, overflow_size) != 0 ||
+            memcmp(l1->overflow_values, l2->overflow_values, overflow_size) != 0)
+            return false;
+    }
+    
+    if (sa1->string) {
+        assert(strlen((char *)sa1->string) + 1 == sa1->length);
+        if (strlen((char *)sa1->string) + 1 != sa1->length)
+            return false;
+    }
     
     
     return true;
@@ -7,16 +7,75 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#include "index_type.h"
+
+/**
+ Prefix buckets: the suffix array interval of every string of
+ length q over the alphabet.
+
+ A q-gram a_0 a_1 ... a_{q-1} has the code
+ sum_j a_j * alphabet_size^(q - 1 - j), where a suffix shorter
+ than q counts as padded with zeros, i.e., with sentinels. The
+ suffixes with code c are SA[starts[c], starts[c + 1]).
+ */
+struct sa_prefix_buckets {
+    uint32_t alphabet_size;
+    uint32_t q;
+    index_t *starts; // null if we do not have the buckets
+};
+
+/**
+ A sample of the suffix array in Eytzinger order, for the first
+ levels of the binary searches.
+
+ We take every sample_rate'th row and store the first eight
+ symbols of its suffix, packed big-endian so comparing the words
+ compares the symbols. The samples are in the order of a
+ breadth-first traversal of a balanced search tree, starting at
+ index one, so the first levels of a search share a few cache
+ lines, and we never touch the suffix array or the string there.
+ */
+struct sa_search_tree {
+    index_t sample_rate;
+    index_t no_samples;
+    uint64_t *prefixes; // null if we do not have the tree
+    index_t *rows;      // the suffix array row of each sample
+};
+
+/**
+ The LCP array in one byte per row.
+
+ Most longest common prefixes are short, so we store each in a
+ byte, and the few that do not fit in a table on the side. Rows
+ whose byte is SA_LCP_OVERFLOW are in overflow_rows, in
+ increasing order, with their values in overflow_values. Use
+ sa_lcp() to get the values.
+ */
+#define SA_LCP_OVERFLOW UINT8_MAX
+struct sa_lcp {
+    uint8_t *values; // null if we do not have the array
+    index_t no_overflows;
+    index_t *overflow_rows;
+    index_t *overflow_values;
+};
+
 struct suffix_array {
     uint8_t *string;
-    uint32_t length;
-    uint32_t *array;
+    index_t length;
+    index_t *array;
 
     // These arrays are optional but used in extended suffix arrays.
     // They aren't all used at the same time, and we could get rid of some
     // after we have used them, but I just keep them for now
-    uint32_t *inverse;
-    uint32_t *lcp;
+    index_t *inverse;
+    // The LCP array; see compute_lcp() and sa_lcp().
+    struct sa_lcp lcp;
+    // LCP-LR for the binary searches; see compute_lcp_lr().
+    index_t *lcp_lr;
+    // Where the binary searches start; see compute_prefix_buckets().
+    struct sa_prefix_buckets buckets;
+    // The top of the binary searches; see compute_search_tree().
+    struct sa_search_tree search_tree;
 };
 
 struct suffix_array *
@@ -34,6 +93,26 @@ sa_is_construction(
     uint32_t alphabet_size
 );
 
+/**
+ SA-IS with several threads.
+
+ It gives the same suffix array as sa_is_construction(), which
+ calls it for long strings when stralg_threads() is more than one.
+ The induction passes still write in one thread, while the other
+ threads do the look-ups ahead of it, so expect the speed-up to
+ flatten out after a handful of threads.
+
+ @param remapped_string The string, remapped to [1,alphabet_size).
+ @param alphabet_size   The size of the alphabet, including the sentinel.
+ @param no_threads      The number of threads to use.
+ */
+struct suffix_array *
+sa_is_construction_parallel(
+    uint8_t *remapped_string,
+    uint32_t alphabet_size,
+    uint32_t no_threads
+);
+
 struct suffix_array *
 sa_is_mem_construction(
     uint8_t *remapped_string,
@@ -50,35 +129,46 @@ void free_complete_suffix_array(
     struct suffix_array *sa
 );
 
+/**
+ Binary search for the first suffix whose first strlen(key)
+ characters are at least key, and the first where they are
+ greater. The suffixes in between are the occurrences of key.
+
+ Each step continues comparing from the prefix the key shares
+ with both ends of the search interval. With the LCP-LR array
+ (compute_lcp_lr()) we also know how much the probed suffix
+ shares with the ends, so we never compare a character of the
+ key twice, and the search takes O(m + log n) time.
+ */
 // only use this when you know that the key is in sa
-uint32_t lower_bound_search(
+index_t lower_bound_search(
     struct suffix_array *sa,
     const uint8_t *key
 );
-uint32_t upper_bound_search(
+index_t upper_bound_search(
     struct suffix_array *sa,
     const uint8_t *key
 );
 
-uint32_t lower_bound_k(
+index_t lower_bound_k(
     struct suffix_array *sa,
-    uint32_t k, uint8_t a,
-    uint32_t L, uint32_t R
+    index_t k, uint8_t a,
+    index_t L, index_t R
 );
-uint32_t upper_bound_k(
+index_t upper_bound_k(
     struct suffix_array *sa,
-    uint32_t k, uint8_t a,
-    uint32_t L, uint32_t R
+    index_t k, uint8_t a,
+    index_t L, index_t R
 );
 
 struct sa_match_iter {
     struct suffix_array *sa;
-    uint32_t L;
-    uint32_t R;
-    uint32_t i;
+    index_t L;
+    index_t R;
+    index_t i;
 };
 struct sa_match {
-    uint32_t position;
+    index_t position;
 };
 void init_sa_match_iter(
     struct sa_match_iter *iter,
@@ -96,14 +186,108 @@ void dealloc_sa_match_iter(
 void compute_inverse(
     struct suffix_array *sa
 );
+/**
+ Compute the LCP array: the longest common prefix of each
+ suffix and the one before it in the suffix array, and zero
+ for the first.
+
+ We compute the lengths in text order, from the suffix before
+ each in the suffix array (the Phi array), so the comparisons
+ run along the string, and we never need the inverse suffix
+ array. With more than one thread (see stralg_threads()), the
+ threads each take a part of the string. The construction
+ needs a word per row on top of the result; we only keep the
+ compact array.
+ */
 void compute_lcp(
     struct suffix_array *sa
 );
+/**
+ The longest common prefix of SA[i] and SA[i - 1]; see
+ compute_lcp().
+ */
+static inline index_t sa_lcp(
+    const struct suffix_array *sa,
+    index_t i
+) {
+    const struct sa_lcp *lcp = &sa->lcp;
+    if (lcp->values[i] != SA_LCP_OVERFLOW) return lcp->values[i];
+    index_t lo = 0, hi = lcp->no_overflows;
+    while (hi - lo > 1) {
+        index_t mid = lo + (hi - lo) / 2;
+        if (lcp->overflow_rows[mid] <= i) lo = mid;
+        else hi = mid;
+    }
+    return lcp->overflow_values[lo];
+}
+/**
+ The LCP array as one word per row, for code that wants a plain
+ array, such as lcp_suffix_tree(). It computes the LCP array if
+ it is not there. Free the result with free().
+ */
+index_t *lcp_array(
+    struct suffix_array *sa
+);
+/**
+ Compute the LCP-LR array used by lower_bound_search(),
+ upper_bound_search() and init_sa_match_iter().
+
+ For each suffix the binary search can probe, it holds the
+ longest common prefix with the suffixes at the two ends of the
+ interval where we probe it. It takes 2n words and needs the LCP
+ array, which we compute if it is not there.
+ */
+void compute_lcp_lr(
+    struct suffix_array *sa
+);
+
+/**
+ Compute the prefix buckets used by lower_bound_search(),
+ upper_bound_search() and init_sa_match_iter().
+
+ With them, a search looks up the interval of the key's first q
+ symbols and only does the binary search inside it. Keys of at
+ most q symbols need no binary search at all. We build the table
+ from one scan of the string, so it does not touch the suffix
+ array.
+
+ @param sa            The suffix array; it must have its string.
+ @param alphabet_size All symbols in the string are less than
+                      this; use 256 if it is not remapped.
+ @param q             The prefix length, or zero to pick the
+                      largest where the table has at most a
+                      quarter as many entries as the suffix array.
+ */
+void compute_prefix_buckets(
+    struct suffix_array *sa,
+    uint32_t alphabet_size,
+    uint32_t q
+);
+
+/**
+ Compute the sampled search tree used by lower_bound_search(),
+ upper_bound_search() and init_sa_match_iter().
+
+ A search first goes down the tree, which narrows it to the rows
+ between two samples unless many samples share their first eight
+ symbols with the key, and then does the binary search there.
+ With prefix buckets, it searches where the bucket and the tree
+ interval overlap.
+
+ @param sa          The suffix array; it must have its string.
+ @param sample_rate The number of rows per sample, or zero for
+                    the default.
+ */
+void compute_search_tree(
+    struct suffix_array *sa,
+    index_t sample_rate
+);
 
 /**
  * The suffix array serialisation only serialise the
- * suffix array, not additional arrays. You need to
- * explicitly serialise those if you need them.
+ * suffix array and its prefix buckets, if it has them,
+ * not additional arrays. You need to explicitly
+ * serialise those if you need them.
  **/
 // Serialisation -- FIXME: error handling!
 void write_suffix_array(
@@ -125,7 +309,27 @@ read_suffix_array_fname(
     uint8_t *string
 );
 
-// FIXME: serialisation of lcp...
+/**
+ Serialisation of the LCP array, which must be computed when you
+ write it. Reading it adds it to a suffix array over the same
+ string, replacing any LCP array it has.
+ **/
+void write_lcp(
+    FILE *f,
+    const struct suffix_array *sa
+);
+void write_lcp_fname(
+    const char *fname,
+    const struct suffix_array *sa
+);
+void read_lcp(
+    FILE *f,
+    struct suffix_array *sa
+);
+void read_lcp_fname(
+    const char *fname,
+    struct suffix_array *sa
+);
 
 // This is mostly for debugging
 void print_suffix_array(
@@ -9,13 +9,53 @@ struct suffix_array *allocate_sa_(uint8_t *string)
     struct suffix_array *sa =
         malloc(sizeof(struct suffix_array));
     sa->string = string;
-    sa->length = (uint32_t)strlen((char *)string) + 1;
+    sa->length = (index_t)strlen((char *)string) + 1;
     sa->array = malloc(sa->length * sizeof(*sa->array));
     
     sa->inverse = 0;
-    sa->lcp = 0;
+    sa->lcp.values = 0;
+    sa->lcp_lr = 0;
+    sa->buckets.starts = 0;
+    sa->search_tree.prefixes = 0;
+    sa->search_tree.rows = 0;
     
     return sa;
 }
 
 
+
+struct suffix_array *allocate_sa_without_array_(uint8_t *string)
+{
+    struct suffix_array *sa =
+        malloc(sizeof(struct suffix_array));
+    sa->string = string;
+    sa->length = (index_t)strlen((char *)string) + 1;
+    sa->array = 0;
+    
+    sa->inverse = 0;
+    sa->lcp.values = 0;
+    sa->lcp_lr = 0;
+    sa->buckets.starts = 0;
+    sa->search_tree.prefixes = 0;
+    sa->search_tree.rows = 0;
+    
+    return sa;
+}
+
+struct suffix_array *allocate_sa_without_string_(index_t length)
+{
+    struct suffix_array *sa =
+        malloc(sizeof(struct suffix_array));
+    sa->string = 0;
+    sa->length = length;
+    sa->array = 0;
+    
+    sa->inverse = 0;
+    sa->lcp.values = 0;
+    sa->lcp_lr = 0;
+    sa->buckets.starts = 0;
+    sa->search_tree.prefixes = 0;
+    sa->search_tree.rows = 0;
+    
+    return sa;
+}
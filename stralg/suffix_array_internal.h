@@ -1,12 +1,41 @@
 #ifndef SUFFIX_ARRAY_INTERNAL_H
 #define SUFFIX_ARRAY_INTERNAL_H
 
+#include "index_type.h"
+
+#include <stdbool.h>
+
 // This is not a public interface. It might change
 // at any time, so don't use it. All the names
 // end in an underscore to minimise the risk
 // of name clashes with a user's code.
 
 struct suffix_array *allocate_sa_(uint8_t *x);
+// For when we only need the string and its length,
+// e.g. with a sampled suffix array in a BWT table.
+struct suffix_array *allocate_sa_without_array_(uint8_t *x);
+// For a self-index, where we only know the length
+// (including the sentinel).
+struct suffix_array *allocate_sa_without_string_(index_t length);
+
+// Where SA-IS reports the rows of the suffix array, when we
+// want something computed from them rather than the array.
+struct sa_row_output_ {
+    // Called once for each row, with its suffix array value.
+    // The rows do not come in order.
+    void (*f)(void *data, index_t row, index_t value);
+    void *data;
+};
+
+// Run the memory-lean SA-IS (sa_is_mem.c) and report the rows
+// from its final induction pass instead of keeping the array.
+// Returns false, without reporting any rows, if it cannot
+// allocate its arrays.
+bool sa_is_mem_rows_(
+    const uint8_t *remapped_string,
+    uint32_t alphabet_size,
+    const struct sa_row_output_ *out
+);
 
 
 
@@ -196,7 +196,7 @@ alloc_suffix_tree(
 ) {
     struct suffix_tree *st = malloc(sizeof(struct suffix_tree));
     st->string = string;
-    uint32_t slen = (uint32_t)strlen((char *)string);
+    index_t slen = (index_t)strlen((char *)string);
     st->length = slen + 1; // I am using '\0' as sentinel
     
     // this is the max number of nodes in a tree where all
@@ -204,7 +204,7 @@ alloc_suffix_tree(
     // when the string is empty -- it should really only happen
     // in testing, but never the less. In that case, there should be
     // two and not one node (the root and a single child.
-    uint32_t pool_size = st->length == 1 ? 2 : (2 * st->length - 1);
+    index_t pool_size = st->length == 1 ? 2 : (2 * st->length - 1);
     st->pool.nodes = malloc(pool_size * sizeof(struct suffix_tree_node));
     st->pool.next_node = st->pool.nodes;
 
@@ -231,7 +231,7 @@ struct suffix_tree *naive_suffix_tree(
     st->root->child = first;
     first->parent = st->root;
     const uint8_t *xend = st->string + st->length;
-    for (uint32_t i = 1; i < st->length; ++i) {
+    for (index_t i = 1; i < st->length; ++i) {
         struct suffix_tree_node *leaf =
             naive_insert(st, st->root, string + i, xend);
         leaf->leaf_label = i;
@@ -258,9 +258,9 @@ static void append_child(
 static struct suffix_tree_node *
 lcp_insert(
     struct suffix_tree *st,
-    uint32_t i,
-    uint32_t *sa,
-    uint32_t *lcp,
+    index_t i,
+    index_t *sa,
+    index_t *lcp,
     struct suffix_tree_node *v
 ) {
     struct suffix_tree_node *new_leaf =
@@ -269,8 +269,8 @@ lcp_insert(
                  st->string + st->length);
     
     new_leaf->leaf_label = sa[i];
-    uint32_t length_up = st->length - sa[i-1] - lcp[i];
-    uint32_t v_edge_len = edge_length(v);
+    index_t length_up = st->length - sa[i-1] - lcp[i];
+    index_t v_edge_len = edge_length(v);
     
     while ((length_up >= v_edge_len)
            && (length_up != 0)) {
@@ -295,12 +295,12 @@ lcp_insert(
 struct suffix_tree *
 lcp_suffix_tree(
     const uint8_t *string,
-    uint32_t *sa,
-    uint32_t *lcp
+    index_t *sa,
+    index_t *lcp
 ) {
     struct suffix_tree *st = alloc_suffix_tree(string);
     
-    uint32_t first_label = sa[0];
+    index_t first_label = sa[0];
     struct suffix_tree_node *v =
         new_node(st, st->string + sa[0],
                  st->string + st->length);
@@ -308,7 +308,7 @@ lcp_suffix_tree(
     st->root->child = v;
     v->parent = st->root;
     
-    for (uint32_t i = 1; i < st->length; ++i) {
+    for (index_t i = 1; i < st->length; ++i) {
         v = lcp_insert(st, i, sa, lcp, v);
     }
 
@@ -329,7 +329,7 @@ fast_scan(
     assert(w); // must be here when we search for a suffix
     
     // Jump down the edge
-    uint32_t n = edge_length(w);
+    index_t n = edge_length(w);
     const uint8_t *z = x + n;
     
     if (z == y) {
@@ -349,7 +349,7 @@ fast_scan(
         //           y
         //       |-k-|
         //
-        uint32_t k = (uint32_t)(y - x);
+        index_t k = (index_t)(y - x);
         assert(k > 0);
         const uint8_t *s = w->range.from;
         const uint8_t *split_point = s + k;
@@ -421,13 +421,13 @@ mccreight_suffix_tree(
     const uint8_t *x
 ) {
     struct suffix_tree *st = alloc_suffix_tree(x);
-    uint32_t n = st->length;
+    index_t n = st->length;
     
     struct suffix_tree_node *leaf = new_node(st, x, x + st->length);
     leaf->parent = st->root; st->root->child = leaf;
     leaf->leaf_label = 0;
     
-    for (uint32_t i = 1; i < st->length; ++i) {
+    for (index_t i = 1; i < st->length; ++i) {
         
         // Get the suffix of v
         struct suffix_tree_node *v = leaf->parent;
@@ -475,12 +475,12 @@ void get_edge_label(
     struct suffix_tree_node *node,
     uint8_t *buffer
 ) {
-    uint32_t n = range_length(node->range);
+    index_t n = range_length(node->range);
     strncpy((char *)buffer, (char *)node->range.from, n);
     buffer[n] = '\0';
 }
 
-uint32_t get_string_depth(struct suffix_tree *st, struct suffix_tree_node *v)
+index_t get_string_depth(struct suffix_tree *st, struct suffix_tree_node *v)
 {
     if (v->parent != v) { // not the root
         assert(v->range.from >= st->string);
@@ -490,7 +490,7 @@ uint32_t get_string_depth(struct suffix_tree *st, struct suffix_tree_node *v)
         assert(v->range.to > v->range.from);
     }
 
-    uint32_t depth = 0;
+    index_t depth = 0;
     while (v->parent != v) {
         depth += range_length(v->range);
         v = v->parent;
@@ -504,7 +504,7 @@ void get_path_string(
     struct suffix_tree_node *v,
     uint8_t *buffer
 ) {
-    uint32_t offset = get_string_depth(st, v);
+    index_t offset = get_string_depth(st, v);
 
     uint8_t edge_buffer[st->length + 1];
     uint8_t *s = buffer + offset; *s = 0;
@@ -514,7 +514,7 @@ void get_path_string(
     // that do not end in a leaf, we do.
     
     while (v->parent != v) {
-        uint32_t n = range_length(v->range);
+        index_t n = range_length(v->range);
         s -= n;
         strncpy((char *)s, (char *)v->range.from, n);
         get_edge_label(st, v, edge_buffer);
@@ -687,7 +687,7 @@ static void collect_approx_hits(
     const uint8_t *p,
     char *edits,
     int edits_left,
-    uint32_t match_depth
+    index_t match_depth
 );
 
 
@@ -695,7 +695,7 @@ static void recurse_children(
     struct collect_nodes_data *data,
     struct suffix_tree_node *v,
     bool at_beginning,
-    uint32_t match_depth,
+    index_t match_depth,
     char *edits,
     const uint8_t *p,
     int max_edits
@@ -718,7 +718,7 @@ static void collect_approx_hits(
     const uint8_t *p,
     char *edits,
     int edits_left,
-    uint32_t match_depth
+    index_t match_depth
 ) {
     struct suffix_tree *st = data->iter->st;
     // we need to know this one so we never move past the end
@@ -797,7 +797,7 @@ void init_st_approx_iter(
 ) {
     iter->st = st;
     
-    uint32_t n = (uint32_t)strlen((char *)pattern);
+    index_t n = (index_t)strlen((char *)pattern);
     struct collect_nodes_data data;
     data.iter = iter;
     data.edits_start = data.edits = malloc(2*n + 1);
@@ -844,7 +844,7 @@ bool next_st_approx_match(struct st_approx_match_iter *iter,
             iter->current_tree_index++;
             return next_st_approx_match(iter, match);
         } else {
-            uint32_t i = iter->current_tree_index;
+            index_t i = iter->current_tree_index;
             match->root = iter->nodes.data[i];
             match->match_depth = iter->match_depths.data[i];
             match->match_label = res.leaf->leaf_label;
@@ -859,7 +859,7 @@ void dealloc_st_approx_iter(
     struct st_approx_match_iter *iter
 ) {
     dealloc_pointer_vector(&iter->nodes);
-    for (uint32_t i = 0; i < iter->cigars.used; ++i) {
+    for (index_t i = 0; i < iter->cigars.used; ++i) {
         free(iter->cigars.data[i]);
     }
     dealloc_string_vector(&iter->cigars);
@@ -874,14 +874,14 @@ void dealloc_st_approx_iter(
 /// Build suffix array and LCP
 struct sa_lcp_frame {
     struct suffix_tree_node *v;
-    uint32_t left_depth;
-    uint32_t node_depth;
+    index_t left_depth;
+    index_t node_depth;
     struct sa_lcp_frame *next;
 };
 static struct sa_lcp_frame *new_lcp_frame(
     struct suffix_tree_node *v,
-    uint32_t left_depth,
-    uint32_t node_depth,
+    index_t left_depth,
+    index_t node_depth,
     struct sa_lcp_frame *next
 ) {
     struct sa_lcp_frame *new = malloc(sizeof(struct sa_lcp_frame));
@@ -895,8 +895,8 @@ static struct sa_lcp_frame *new_lcp_frame(
 static struct sa_lcp_frame *
 lcp_stack_push_reverse(
     struct suffix_tree_node *v,
-    uint32_t left_depth,
-    uint32_t node_depth,
+    index_t left_depth,
+    index_t node_depth,
     struct sa_lcp_frame *stack
 ) {
     if (v->sibling) {
@@ -907,11 +907,11 @@ lcp_stack_push_reverse(
 
 static void lcp_traverse(
     struct suffix_tree *st,
-    uint32_t *sa,
-    uint32_t *lcp
+    index_t *sa,
+    index_t *lcp
 ) {
     struct sa_lcp_frame *stack = new_lcp_frame(st->root, 0, 0, 0);
-    uint32_t idx = 0;
+    index_t idx = 0;
 
     while (stack) {
 
@@ -931,7 +931,7 @@ static void lcp_traverse(
             // the LCP is relative to the last node in the previous
             // leaf in v's previous sibling.
             
-            uint32_t this_depth = frame->node_depth + edge_length(frame->v);
+            index_t this_depth = frame->node_depth + edge_length(frame->v);
             
             assert(frame->v->child); // it must be an inner node
             if (frame->v->child->sibling) {
@@ -949,8 +949,8 @@ static void lcp_traverse(
 
 void st_compute_sa_and_lcp(
     struct suffix_tree *st,
-    uint32_t *sa,
-    uint32_t *lcp
+    index_t *sa,
+    index_t *lcp
 ) {
     lcp_traverse(st, sa, lcp);
 }
@@ -972,7 +972,7 @@ static void print_out_edges(
     
     if (!child) {
         // this is a leaf
-        fprintf(f, "\"%p\" [label=\"%u\"];\n", from, from->leaf_label);
+        fprintf(f, "\"%p\" [label=\"%" PRIindex "\"];\n", from, from->leaf_label);
         return;
     }
     
@@ -984,9 +984,9 @@ static void print_out_edges(
     
     while (child) {
         get_edge_label(st, child, (uint8_t *)label_buffer);
-        uint32_t from_idx = (uint32_t)(child->range.from - st->string);
-        uint32_t to_idx = (uint32_t)(child->range.to - st->string);
-        fprintf(f, "\"%p\" -> \"%p\" [label=\"%s (%u,%u)\"];\n",
+        index_t from_idx = (index_t)(child->range.from - st->string);
+        index_t to_idx = (index_t)(child->range.to - st->string);
+        fprintf(f, "\"%p\" -> \"%p\" [label=\"%s (%" PRIindex ",%" PRIindex ")\"];\n",
                 from, child, label_buffer, from_idx, to_idx);
         fprintf(f, "\"%p\" -> \"%p\" [style=\"dashed\"];\n",
                 child, child->parent);
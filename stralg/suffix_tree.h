@@ -4,6 +4,7 @@
 
 #include <vectors.h>
 #include <string_utils.h>
+#include <index_type.h>
 
 #include <stdlib.h>
 #include <stdbool.h>
@@ -15,19 +16,19 @@ struct range {
     const uint8_t *from;
     const uint8_t *to;
 };
-static inline uint32_t range_length(struct range r) {
-    return (uint32_t)(r.to - r.from);
+static inline index_t range_length(struct range r) {
+    return (index_t)(r.to - r.from);
 }
 
 struct suffix_tree_node {
-    uint32_t leaf_label;
+    index_t leaf_label;
     struct range range;
     struct suffix_tree_node *parent;
     struct suffix_tree_node *sibling;
     struct suffix_tree_node *child;
     struct suffix_tree_node *suffix_link;
 };
-static inline uint32_t edge_length(
+static inline index_t edge_length(
     struct suffix_tree_node *n
 ) {
     return range_length(n->range);
@@ -39,7 +40,7 @@ struct suffix_tree_node_pool {
 };
 struct suffix_tree {
     const uint8_t *string;
-    uint32_t length;
+    index_t length;
     struct suffix_tree_node *root;
     struct suffix_tree_node_pool pool;
 };
@@ -55,8 +56,8 @@ mccreight_suffix_tree(
 struct suffix_tree *
 lcp_suffix_tree(
     const uint8_t *string,
-    uint32_t *sa,
-    uint32_t *lcp
+    index_t *sa,
+    index_t *lcp
 );
 
 void annotate_suffix_links(
@@ -71,8 +72,8 @@ void free_suffix_tree(
 // Suffix array and LCP
 void st_compute_sa_and_lcp(
     struct suffix_tree *st,
-    uint32_t *sa,
-    uint32_t *lcp
+    index_t *sa,
+    index_t *lcp
 );
 
 // Iteration
@@ -108,7 +109,7 @@ struct st_search_iter {
     struct st_leaf_iter leaf_iter;
 };
 struct st_search_match {
-    uint32_t pos;
+    index_t pos;
 };
 void init_st_search_iter(
     struct st_search_iter *iter,
@@ -134,14 +135,14 @@ struct st_approx_match_iter {
     struct index_vector match_depths;
     
     bool processing_tree;
-    uint32_t current_tree_index;
+    index_t current_tree_index;
 };
 struct st_approx_match {
     struct suffix_tree_node *root;
-    uint32_t match_depth;
-    uint32_t match_length;
+    index_t match_depth;
+    index_t match_length;
     
-    uint32_t match_label;
+    index_t match_label;
     const char *cigar;
 };
 void init_st_approx_iter(
@@ -159,7 +160,7 @@ void dealloc_st_approx_iter(
 );
 
 
-uint32_t get_string_depth(
+index_t get_string_depth(
     struct suffix_tree *st,
     struct suffix_tree_node *v
 );
@@ -191,7 +191,7 @@ static void east_match(
     dealloc_ea_st_approx_iter(&iter);
 }
 
-static void bwt_match(
+static void bwt_match_params(
     struct suffix_array *sa,
     // the pattern and string are remapped
     const uint8_t *pattern,
@@ -199,6 +199,7 @@ static void bwt_match(
     struct remap_table *remap_table,
     struct bwt_table *bwt_table,
     int edits,
+    const struct bwt_approx_params *params,
     struct string_vector *bwt_results
 ) {
     
@@ -210,7 +211,7 @@ static void bwt_match(
     
     struct bwt_approx_iter iter;
     struct bwt_approx_match match;
-    init_bwt_approx_iter(&iter, bwt_table, pattern, edits);
+    init_bwt_approx_iter_params(&iter, bwt_table, pattern, edits, params);
     while (next_bwt_approx_match(&iter, &match)) {
         rev_remap_between0(rev_mapped_match,
                            string + match.position,
@@ -222,6 +223,21 @@ static void bwt_match(
     dealloc_bwt_approx_iter(&iter);
 }
 
+static void bwt_match(
+    struct suffix_array *sa,
+    // the pattern and string are remapped
+    const uint8_t *pattern,
+    const uint8_t *string,
+    struct remap_table *remap_table,
+    struct bwt_table *bwt_table,
+    int edits,
+    struct string_vector *bwt_results
+) {
+    struct bwt_approx_params params = { .algorithm = BWT_BACKTRACK };
+    bwt_match_params(sa, pattern, string, remap_table, bwt_table,
+                     edits, &params, bwt_results);
+}
+
 
 #pragma mark The testing functions
 
@@ -496,6 +512,51 @@ static void test_approx(
         
         free_strings(&bwt_results);
         dealloc_string_vector(&bwt_results);
+        
+        printf("Aho-Corasic vs bidirectional BWT.\t");
+        struct bwt_approx_params bidir_params = {
+            .algorithm = BWT_BIDIRECTIONAL
+        };
+        init_string_vector(&bwt_results, 10);
+        bwt_match_params(sa, remapped_pattern, remappe_string,
+                         &remap_table, &bwt_table, edits, &bidir_params,
+                         &bwt_results);
+        sort_string_vector(&bwt_results);
+        assert(string_vector_equal(&ac_results, &bwt_results));
+        printf("OK\n");
+        free_strings(&bwt_results);
+        dealloc_string_vector(&bwt_results);
+        
+        printf("Aho-Corasic vs seed-and-extend BWT.\t");
+        struct bwt_approx_params seed_params = {
+            .algorithm = BWT_SEED_EXTEND
+        };
+        init_string_vector(&bwt_results, 10);
+        bwt_match_params(sa, remapped_pattern, remappe_string,
+                         &remap_table, &bwt_table, edits, &seed_params,
+                         &bwt_results);
+        sort_string_vector(&bwt_results);
+        assert(string_vector_equal(&ac_results, &bwt_results));
+        printf("OK\n");
+        free_strings(&bwt_results);
+        dealloc_string_vector(&bwt_results);
+        
+        // The k-mer tables should not change the results, whether
+        // the pattern is longer than k or not.
+        for (uint32_t k = 1; k <= 4; ++k) {
+            printf("Aho-Corasic vs BWT-D with %u-mer table.\t", k);
+            build_bwt_kmer_table(&bwt_table, k);
+            init_string_vector(&bwt_results, 10);
+            bwt_match(sa, remapped_pattern, remappe_string,
+                      &remap_table, &bwt_table, edits, &bwt_results);
+            sort_string_vector(&bwt_results);
+            assert(string_vector_equal(&ac_results, &bwt_results));
+            printf("OK\n");
+            free_strings(&bwt_results);
+            dealloc_string_vector(&bwt_results);
+        }
+        dealloc_bwt_table(&bwt_table);
+        
         free_suffix_array(sa);
         free(reversed_remapped);
     }
@@ -505,6 +566,540 @@ static void test_approx(
 }
 
 
+// Compare the two BWT algorithms on longer, random, strings
+// where there are many more ways to place the edits.
+static void test_bidirectional_random(void)
+{
+    const char *alphabet = "acgt";
+    uint32_t n = 300;
+    uint8_t string[n + 1];
+    for (uint32_t i = 0; i < n; ++i) {
+        string[i] = alphabet[rand() % 4];
+    }
+    string[n] = '\0';
+    struct bwt_table *bwt_table = build_complete_table(string, true);
+    struct remap_table *remap_table = bwt_table->remap_table;
+    struct suffix_array *sa = bwt_table->sa;
+    
+    struct bwt_approx_params backtrack = { .algorithm = BWT_BACKTRACK };
+    struct bwt_approx_params others[] = {
+        { .algorithm = BWT_BIDIRECTIONAL },
+        { .algorithm = BWT_SEED_EXTEND }
+    };
+    for (uint32_t rep = 0; rep < 50; ++rep) {
+        uint32_t m = 4 + rand() % 12;
+        uint8_t pattern[m + 1];
+        memcpy(pattern, string + rand() % (n - m), m);
+        pattern[m] = '\0';
+        pattern[rand() % m] = alphabet[rand() % 4];
+        uint8_t remapped_pattern[m + 1];
+        remap(remapped_pattern, pattern, remap_table);
+        
+        for (int edits = 0; edits <= 3; ++edits) {
+            if (m <= edits) continue;
+            struct string_vector expected;
+            init_string_vector(&expected, 10);
+            bwt_match_params(sa, remapped_pattern, sa->string, remap_table,
+                             bwt_table, edits, &backtrack, &expected);
+            sort_string_vector(&expected);
+            for (uint32_t j = 0; j < 2; ++j) {
+                struct string_vector results;
+                init_string_vector(&results, 10);
+                bwt_match_params(sa, remapped_pattern, sa->string, remap_table,
+                                 bwt_table, edits, &others[j], &results);
+                sort_string_vector(&results);
+                assert(string_vector_equal(&expected, &results));
+                free_strings(&results);
+                dealloc_string_vector(&results);
+            }
+            free_strings(&expected);
+            dealloc_string_vector(&expected);
+        }
+    }
+    
+    completely_free_bwt_table(bwt_table);
+}
+
+static void test_shared_workspace(void)
+{
+    const char *alphabet = "acgt";
+    uint32_t n = 300;
+    uint8_t string[n + 1];
+    for (uint32_t i = 0; i < n; ++i) {
+        string[i] = alphabet[rand() % 4];
+    }
+    string[n] = '\0';
+    struct bwt_table *bwt_table = build_complete_table(string, true);
+    struct remap_table *remap_table = bwt_table->remap_table;
+    struct suffix_array *sa = bwt_table->sa;
+    
+    // The same workspace for all the searches, with patterns of
+    // different lengths, so the buffers must both grow and be
+    // reused with old data in them.
+    struct bwt_approx_workspace workspace;
+    init_bwt_approx_workspace(&workspace);
+    struct bwt_approx_params own = { .algorithm = BWT_BACKTRACK };
+    struct bwt_approx_params shared[] = {
+        { .algorithm = BWT_BACKTRACK, .workspace = &workspace },
+        { .algorithm = BWT_BIDIRECTIONAL, .workspace = &workspace },
+        { .algorithm = BWT_SEED_EXTEND, .workspace = &workspace }
+    };
+    for (uint32_t rep = 0; rep < 30; ++rep) {
+        uint32_t m = 1 + rand() % 40;
+        uint8_t pattern[m + 1];
+        memcpy(pattern, string + rand() % (n - m), m);
+        pattern[m] = '\0';
+        pattern[rand() % m] = alphabet[rand() % 4];
+        uint8_t remapped_pattern[m + 1];
+        remap(remapped_pattern, pattern, remap_table);
+        
+        int edits = rand() % 3;
+        struct string_vector expected;
+        init_string_vector(&expected, 10);
+        bwt_match_params(sa, remapped_pattern, sa->string, remap_table,
+                         bwt_table, edits, &own, &expected);
+        sort_string_vector(&expected);
+        for (uint32_t j = 0; j < 3; ++j) {
+            struct string_vector results;
+            init_string_vector(&results, 10);
+            bwt_match_params(sa, remapped_pattern, sa->string, remap_table,
+                             bwt_table, edits, &shared[j], &results);
+            sort_string_vector(&results);
+            assert(string_vector_equal(&expected, &results));
+            free_strings(&results);
+            dealloc_string_vector(&results);
+        }
+        free_strings(&expected);
+        dealloc_string_vector(&expected);
+    }
+    
+    dealloc_bwt_approx_workspace(&workspace);
+    completely_free_bwt_table(bwt_table);
+}
+
+struct filtered_match {
+    index_t position;
+    uint32_t match_length;
+    char cigar[64];
+};
+
+// The cigars must stay valid until we deallocate the iterator,
+// not just until the next match.
+static void test_kept_cigars(void)
+{
+    const char *alphabet = "acgt";
+    uint32_t n = 300;
+    uint8_t string[n + 1];
+    for (uint32_t i = 0; i < n; ++i) {
+        string[i] = alphabet[rand() % 4];
+    }
+    string[n] = '\0';
+    struct bwt_table *bwt_table = build_complete_table(string, true);
+    struct remap_table *remap_table = bwt_table->remap_table;
+    
+    struct bwt_approx_workspace workspace;
+    init_bwt_approx_workspace(&workspace);
+    struct bwt_approx_params params[] = {
+        { .algorithm = BWT_BACKTRACK },
+        { .algorithm = BWT_BACKTRACK, .workspace = &workspace },
+        { .algorithm = BWT_BIDIRECTIONAL, .workspace = &workspace }
+    };
+    for (uint32_t rep = 0; rep < 30; ++rep) {
+        uint32_t m = 3 + rand() % 20;
+        uint8_t pattern[m + 1];
+        memcpy(pattern, string + rand() % (n - m), m);
+        pattern[m] = '\0';
+        uint8_t remapped_pattern[m + 1];
+        remap(remapped_pattern, pattern, remap_table);
+        
+        for (uint32_t j = 0; j < 3; ++j) {
+            struct string_vector copies;
+            init_string_vector(&copies, 10);
+            const char **kept = 0;
+            uint32_t no_kept = 0;
+            
+            struct bwt_approx_iter iter;
+            struct bwt_approx_match match;
+            init_bwt_approx_iter_params(&iter, bwt_table, remapped_pattern,
+                                        2, &params[j]);
+            while (next_bwt_approx_match(&iter, &match)) {
+                kept = realloc(kept, (no_kept + 1) * sizeof(*kept));
+                kept[no_kept++] = match.cigar;
+                string_vector_append(&copies, str_copy((uint8_t *)match.cigar));
+            }
+            for (uint32_t k = 0; k < no_kept; ++k) {
+                assert(strcmp(kept[k], (char *)copies.data[k]) == 0);
+            }
+            dealloc_bwt_approx_iter(&iter);
+            
+            free(kept);
+            free_strings(&copies);
+            dealloc_string_vector(&copies);
+        }
+    }
+    
+    dealloc_bwt_approx_workspace(&workspace);
+    completely_free_bwt_table(bwt_table);
+}
+
+static int compare_filtered_matches(const void *a, const void *b)
+{
+    const struct filtered_match *x = a, *y = b;
+    if (x->position != y->position) return (x->position < y->position) ? -1 : 1;
+    if (x->match_length != y->match_length)
+        return (x->match_length < y->match_length) ? -1 : 1;
+    return strcmp(x->cigar, y->cigar);
+}
+
+static uint32_t filtered_matches(
+    struct bwt_table *bwt_table,
+    const uint8_t *pattern,
+    int edits,
+    const struct bwt_approx_params *params,
+    struct filtered_match *matches,
+    uint32_t max_matches
+) {
+    uint32_t no_matches = 0;
+    struct bwt_approx_iter iter;
+    struct bwt_approx_match match;
+    init_bwt_approx_iter_params(&iter, bwt_table, pattern, edits, params);
+    while (next_bwt_approx_match(&iter, &match)) {
+        assert(no_matches < max_matches);
+        struct filtered_match *m = &matches[no_matches++];
+        memset(m, 0, sizeof(*m));
+        m->position = match.position;
+        m->match_length = match.match_length;
+        strcpy(m->cigar, match.cigar);
+    }
+    dealloc_bwt_approx_iter(&iter);
+    qsort(matches, no_matches, sizeof(*matches), compare_filtered_matches);
+    return no_matches;
+}
+
+static bool same_key(
+    const struct filtered_match *x,
+    const struct filtered_match *y,
+    bool per_position
+) {
+    return x->position == y->position &&
+        (per_position || x->match_length == y->match_length);
+}
+
+// The number of edits in a match, with mismatches.
+static int cigar_edits(
+    const uint8_t *pattern,
+    const uint8_t *text,
+    const char *cigar
+) {
+    int edits = 0;
+    while (*cigar) {
+        int count = (int)strtol(cigar, (char **)&cigar, 10);
+        char op = *cigar++;
+        for (int k = 0; k < count; ++k) {
+            switch (op) {
+                case 'M': edits += *pattern++ != *text++; break;
+                case 'I': edits++; pattern++; break;
+                case 'D': edits++; text++; break;
+            }
+        }
+    }
+    return edits;
+}
+
+// Each match is the best of those we would otherwise report
+// for the same position (and length), and there is one for
+// each position (and length) we would otherwise report.
+static void check_best_matches(
+    const uint8_t *pattern,
+    const uint8_t *text,
+    bool per_position,
+    const struct filtered_match *filtered, uint32_t no_filtered,
+    const struct filtered_match *all, uint32_t no_all
+) {
+    uint32_t j = 0;
+    for (uint32_t i = 0; i < no_filtered; ++i) {
+        const struct filtered_match *best = &filtered[i];
+        if (i > 0) assert(!same_key(&filtered[i - 1], best, per_position));
+        int best_edits = cigar_edits(pattern, text + best->position, best->cigar);
+        bool found = false;
+        assert(j < no_all && same_key(&all[j], best, per_position));
+        for (; j < no_all && same_key(&all[j], best, per_position); ++j) {
+            int other_edits = cigar_edits(pattern, text + all[j].position,
+                                          all[j].cigar);
+            assert(best_edits <= other_edits);
+            found |= compare_filtered_matches(&all[j], best) == 0;
+        }
+        assert(found);
+    }
+    assert(j == no_all);
+}
+
+// The filters should keep the best of all the matches, and
+// all the algorithms should agree on which that is.
+static void test_filters(void)
+{
+    const char *alphabet = "acgt";
+    uint32_t n = 200;
+    uint8_t string[n + 1];
+    for (uint32_t i = 0; i < n; ++i) {
+        // A small alphabet in places, so there are repeats
+        string[i] = alphabet[rand() % ((i % 50 < 25) ? 2 : 4)];
+    }
+    string[n] = '\0';
+    struct bwt_table *bwt_table = build_complete_table(string, true);
+    const uint8_t *text = bwt_table->sa->string;
+
+    enum bwt_approx_algorithm algorithms[] = {
+        BWT_BACKTRACK, BWT_BIDIRECTIONAL, BWT_SEED_EXTEND
+    };
+    uint32_t max_matches = 100000;
+    struct filtered_match *all = malloc(max_matches * sizeof(*all));
+    struct filtered_match *first = malloc(max_matches * sizeof(*first));
+    struct filtered_match *filtered = malloc(max_matches * sizeof(*filtered));
+
+    for (uint32_t rep = 0; rep < 40; ++rep) {
+        uint32_t m = 4 + rand() % 8;
+        uint8_t pattern[m + 1];
+        memcpy(pattern, string + rand() % (n - m), m);
+        pattern[m] = '\0';
+        pattern[rand() % m] = alphabet[rand() % 4];
+        uint8_t remapped_pattern[m + 1];
+        remap(remapped_pattern, pattern, bwt_table->remap_table);
+
+        for (int edits = 1; edits <= 2; ++edits) {
+            struct bwt_approx_params params = { .algorithm = BWT_BACKTRACK };
+            uint32_t no_all = filtered_matches(bwt_table, remapped_pattern, edits,
+                                               &params, all, max_matches);
+
+            enum bwt_approx_filter filters[] = {
+                BWT_BEST_PER_MATCH, BWT_BEST_PER_POSITION
+            };
+            for (uint32_t f = 0; f < 2; ++f) {
+                bool per_position = filters[f] == BWT_BEST_PER_POSITION;
+                uint32_t no_first = 0;
+                for (uint32_t a = 0; a < 3; ++a) {
+                    params.algorithm = algorithms[a];
+                    params.filter = filters[f];
+                    uint32_t no_filtered =
+                        filtered_matches(bwt_table, remapped_pattern, edits,
+                                         &params, filtered, max_matches);
+                    if (a == 0) {
+                        memcpy(first, filtered, no_filtered * sizeof(*first));
+                        no_first = no_filtered;
+                    }
+                    assert(no_filtered == no_first);
+                    assert(memcmp(first, filtered, no_filtered * sizeof(*first)) == 0);
+                }
+
+                check_best_matches(remapped_pattern, text, per_position,
+                                   first, no_first, all, no_all);
+            }
+        }
+    }
+
+    free(all);
+    free(first);
+    free(filtered);
+    completely_free_bwt_table(bwt_table);
+}
+
+static bool spans_seqs(
+    const index_t *seq_starts,
+    uint32_t no_seqs,
+    const struct filtered_match *match
+) {
+    uint32_t seq = 0;
+    while (seq + 1 < no_seqs && seq_starts[seq + 1] <= match->position)
+        seq++;
+    return match->position + match->match_length > seq_starts[seq + 1];
+}
+
+// With several sequences in the text, the search should leave out
+// the matches that span two of them before it filters, so they
+// cannot hide the matches inside a sequence.
+static void test_sequence_boundaries(void)
+{
+    enum bwt_approx_algorithm algorithms[] = {
+        BWT_BACKTRACK, BWT_BIDIRECTIONAL, BWT_SEED_EXTEND
+    };
+    enum bwt_approx_filter filters[] = {
+        BWT_REPORT_ALL, BWT_BEST_PER_MATCH, BWT_BEST_PER_POSITION
+    };
+    uint32_t max_matches = 100000;
+    struct filtered_match *all = malloc(max_matches * sizeof(*all));
+    struct filtered_match *filtered = malloc(max_matches * sizeof(*filtered));
+
+    // The exact match at position 4 runs into the second sequence,
+    // and so does the one at 5; inside the first, there is a match
+    // at 4 with an insertion, but the exact match hides it unless
+    // we know where the sequences are.
+    const uint8_t *string = (const uint8_t *)"ggggacgttgggg";
+    index_t seq_starts[] = { 0, 8, 13 };
+    struct bwt_table *bwt_table = build_complete_table(string, true);
+    uint8_t pattern[6];
+    remap(pattern, (const uint8_t *)"acgtt", bwt_table->remap_table);
+    for (uint32_t a = 0; a < 3; ++a) {
+        struct bwt_approx_params params = {
+            .algorithm = algorithms[a], .filter = BWT_BEST_PER_POSITION
+        };
+        uint32_t no_matches = filtered_matches(bwt_table, pattern, 1, &params,
+                                               filtered, max_matches);
+        assert(no_matches == 2);
+        assert(filtered[0].position == 4 && filtered[0].match_length == 5);
+        assert(filtered[1].position == 5 && filtered[1].match_length == 4);
+
+        params.seq_starts = seq_starts;
+        params.no_seqs = 2;
+        no_matches = filtered_matches(bwt_table, pattern, 1, &params,
+                                      filtered, max_matches);
+        assert(no_matches == 1);
+        assert(filtered[0].position == 4 && filtered[0].match_length == 4);
+        assert(strcmp(filtered[0].cigar, "4M1I") == 0);
+        assert(bwt_approx_count(bwt_table, pattern, 1, &params) == 1);
+    }
+    completely_free_bwt_table(bwt_table);
+
+    // Random sequences, some of them empty, and we compare with all
+    // the matches minus those that span two sequences.
+    const char *alphabet = "acgt";
+    uint32_t n = 200;
+    uint8_t random_string[n + 1];
+    for (uint32_t i = 0; i < n; ++i) {
+        random_string[i] = alphabet[rand() % ((i % 50 < 25) ? 2 : 4)];
+    }
+    random_string[n] = '\0';
+    bwt_table = build_complete_table(random_string, true);
+    const uint8_t *text = bwt_table->sa->string;
+    index_t random_starts[] = { 0, 7, 7, 30, 31, 90, 150, 150, 181, n };
+    uint32_t no_seqs = sizeof(random_starts) / sizeof(index_t) - 1;
+
+    for (uint32_t rep = 0; rep < 30; ++rep) {
+        uint32_t m = 4 + rand() % 8;
+        uint8_t raw_pattern[m + 1];
+        memcpy(raw_pattern, random_string + rand() % (n - m), m);
+        raw_pattern[m] = '\0';
+        raw_pattern[rand() % m] = alphabet[rand() % 4];
+        uint8_t remapped_pattern[m + 1];
+        remap(remapped_pattern, raw_pattern, bwt_table->remap_table);
+
+        for (int edits = 1; edits <= 2; ++edits) {
+            struct bwt_approx_params params = { .algorithm = BWT_BACKTRACK };
+            uint32_t no_all = filtered_matches(bwt_table, remapped_pattern, edits,
+                                               &params, all, max_matches);
+            uint32_t no_inside = 0;
+            for (uint32_t i = 0; i < no_all; ++i) {
+                if (!spans_seqs(random_starts, no_seqs, &all[i]))
+                    all[no_inside++] = all[i];
+            }
+
+            params.seq_starts = random_starts;
+            params.no_seqs = no_seqs;
+            for (uint32_t f = 0; f < 3; ++f) {
+                for (uint32_t a = 0; a < 3; ++a) {
+                    params.algorithm = algorithms[a];
+                    params.filter = filters[f];
+                    uint32_t no_filtered =
+                        filtered_matches(bwt_table, remapped_pattern, edits,
+                                         &params, filtered, max_matches);
+                    assert(bwt_approx_count(bwt_table, remapped_pattern,
+                                            edits, &params) == no_filtered);
+                    if (filters[f] == BWT_REPORT_ALL) {
+                        assert(no_filtered == no_inside);
+                        assert(memcmp(all, filtered,
+                                      no_filtered * sizeof(*all)) == 0);
+                    } else {
+                        bool per_position = filters[f] == BWT_BEST_PER_POSITION;
+                        check_best_matches(remapped_pattern, text, per_position,
+                                           filtered, no_filtered,
+                                           all, no_inside);
+                    }
+                }
+            }
+        }
+    }
+
+    free(all);
+    free(filtered);
+    completely_free_bwt_table(bwt_table);
+}
+
+// With the Hamming distance, every algorithm should report each
+// position where the pattern matches with few enough mismatches,
+// exactly once and with a cigar that is all M.
+static void test_hamming(void)
+{
+    const char *alphabet = "acgt";
+    uint32_t n = 300;
+    uint8_t string[n + 1];
+    for (uint32_t i = 0; i < n; ++i) {
+        string[i] = alphabet[rand() % ((i % 60 < 30) ? 2 : 4)];
+    }
+    string[n] = '\0';
+    struct bwt_table *tables[] = {
+        build_complete_table(string, true),
+        build_complete_table(string, false),
+        build_complete_table(string, true)
+    };
+    build_bwt_kmer_table(tables[2], 3);
+    const uint8_t *text = tables[0]->sa->string;
+
+    enum bwt_approx_algorithm algorithms[] = {
+        BWT_BACKTRACK, BWT_BIDIRECTIONAL, BWT_SEED_EXTEND
+    };
+    uint32_t max_matches = 1000;
+    struct filtered_match *matches = malloc(max_matches * sizeof(*matches));
+
+    for (uint32_t rep = 0; rep < 30; ++rep) {
+        uint32_t m = 3 + rand() % 10;
+        uint8_t pattern[m + 1];
+        memcpy(pattern, string + rand() % (n - m), m);
+        pattern[m] = '\0';
+        pattern[rand() % m] = alphabet[rand() % 4];
+        uint8_t remapped_pattern[m + 1];
+        remap(remapped_pattern, pattern, tables[0]->remap_table);
+
+        for (int edits = 0; edits <= 3; ++edits) {
+            index_t expected[n];
+            uint32_t no_expected = 0;
+            for (index_t pos = 0; pos + m <= n; ++pos) {
+                int mismatches = 0;
+                for (uint32_t i = 0; i < m; ++i) {
+                    mismatches += text[pos + i] != remapped_pattern[i];
+                }
+                if (mismatches <= edits) expected[no_expected++] = pos;
+            }
+            char cigar[16];
+            sprintf(cigar, "%uM", m);
+
+            for (uint32_t t = 0; t < 3; ++t) {
+                for (uint32_t a = 0; a < 3; ++a) {
+                    struct bwt_approx_params params = {
+                        .algorithm = algorithms[a],
+                        .distance = BWT_HAMMING_DISTANCE
+                    };
+                    uint32_t no_matches =
+                        filtered_matches(tables[t], remapped_pattern, edits,
+                                         &params, matches, max_matches);
+                    assert(no_matches == no_expected);
+                    for (uint32_t i = 0; i < no_matches; ++i) {
+                        assert(matches[i].position == expected[i]);
+                        assert(matches[i].match_length == m);
+                        assert(strcmp(matches[i].cigar, cigar) == 0);
+                    }
+                    index_t count = bwt_approx_count(tables[t], remapped_pattern,
+                                                     edits, &params);
+                    assert(count == no_expected);
+                }
+            }
+        }
+    }
+
+    free(matches);
+    for (uint32_t t = 0; t < 3; ++t) {
+        completely_free_bwt_table(tables[t]);
+    }
+}
+
 int main(int argc, char **argv)
 {
     const char *alphabet = "acgt";
@@ -565,6 +1160,16 @@ int main(int argc, char **argv)
         }
         printf("DONE\n");
         printf("====================================================\n\n");
+        
+        printf("BIDIRECTIONAL VS BACKTRACKING...\n");
+        test_bidirectional_random();
+        test_shared_workspace();
+        test_kept_cigars();
+        test_filters();
+        test_sequence_boundaries();
+        test_hamming();
+        printf("DONE\n");
+        printf("====================================================\n\n");
     }
     
     return EXIT_SUCCESS;
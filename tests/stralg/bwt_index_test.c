@@ -0,0 +1,252 @@
+#include <bwt_index.h>
+#include <bwt.h>
+#include <remap.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+
+static void temp_fname(char *fname)
+{
+    strcpy(fname, "/tmp/temp.XXXXXX");
+    int fd = mkstemp(fname);
+    if (fd >= 0) close(fd);
+}
+
+static uint8_t *random_dna(uint32_t n)
+{
+    uint8_t *str = malloc(n + 1);
+    for (uint32_t i = 0; i < n; ++i) {
+        str[i] = "acgt"[rand() % 4];
+    }
+    str[n] = '\0';
+    return str;
+}
+
+// The mapped table should report the same approximative
+// matches, with the same edit scripts, as the one we built.
+static void compare_searches(
+    struct bwt_table *table,
+    struct bwt_table *mapped,
+    const uint8_t *pattern,
+    int edits
+) {
+    uint32_t m = (uint32_t)strlen((const char *)pattern);
+    uint8_t remapped[m + 1];
+    if (!remap(remapped, pattern, table->remap_table)) return;
+
+    struct bwt_approx_iter iter1, iter2;
+    struct bwt_approx_match match1, match2;
+    init_bwt_approx_iter(&iter1, table, remapped, edits);
+    init_bwt_approx_iter(&iter2, mapped, remapped, edits);
+    for (;;) {
+        bool more1 = next_bwt_approx_match(&iter1, &match1);
+        bool more2 = next_bwt_approx_match(&iter2, &match2);
+        assert(more1 == more2);
+        if (!more1) break;
+        assert(match1.position == match2.position);
+        assert(match1.match_length == match2.match_length);
+        assert(strcmp(match1.cigar, match2.cigar) == 0);
+    }
+    dealloc_bwt_approx_iter(&iter1);
+    dealloc_bwt_approx_iter(&iter2);
+}
+
+static void test_round_trip(int flags)
+{
+    // A table with the full suffix array, one with samples and
+    // k-mers, one with a larger alphabet, so we cover all the
+    // sections and both kinds of O table, and a self-index,
+    // which has no string.
+    uint8_t *dna = random_dna(5000);
+    uint8_t *text = (uint8_t *)"acgtadtadadfasdfing";
+    struct bwt_table *tables[] = {
+        build_complete_table(dna, true),
+        build_complete_table_sampled(dna, true, 4),
+        build_complete_table(text, false),
+        build_self_index_table(dna, true, 8)
+    };
+    build_bwt_kmer_table(tables[1], 5);
+    const char *names[] = { "full", "sampled", "text", "self" };
+    uint32_t no_records = sizeof(tables) / sizeof(*tables);
+
+    char fname[32];
+    temp_fname(fname);
+    enum error_codes err =
+        write_bwt_index_fname(fname, no_records, names, tables);
+    assert(err == NO_ERROR);
+
+    struct bwt_index *index = open_bwt_index(fname, flags, &err);
+    assert(index);
+    assert(err == NO_ERROR);
+    assert(index->no_records == no_records);
+    for (uint32_t i = 0; i < no_records; ++i) {
+        struct bwt_table *mapped = index->records[i].bwt_table;
+        assert(strcmp(index->records[i].name, names[i]) == 0);
+        assert(equivalent_bwt_tables(tables[i], mapped));
+        // The tables are used in place, so the cache-line
+        // blocks must be aligned in the file.
+        if (mapped->o_table->blocks)
+            assert((uintptr_t)mapped->o_table->blocks % 64 == 0);
+        for (uint32_t row = 0; row < mapped->sa->length; ++row) {
+            assert(bwt_locate(mapped, row) == bwt_locate(tables[i], row));
+        }
+    }
+    assert(!index->records[0].bwt_table->sa_samples);
+    assert(index->records[1].bwt_table->sa->array == 0);
+    assert(index->records[1].bwt_table->kmer_table->k == 5);
+    assert(!index->records[2].bwt_table->ro_table);
+    const struct bwt_table *self = index->records[3].bwt_table;
+    assert(!self->sa->string);
+    for (uint32_t i = 0; i < 10; ++i) {
+        uint8_t buffer[101];
+        uint32_t pos = rand() % 4900;
+        bwt_extract(self, pos, 100, buffer);
+        assert(memcmp(buffer, tables[0]->sa->string + pos, 100) == 0);
+    }
+
+    for (uint32_t i = 0; i < 10; ++i) {
+        uint8_t pattern[21];
+        uint32_t start = rand() % 4900;
+        memcpy(pattern, dna + start, 20);
+        pattern[20] = '\0';
+        for (int edits = 0; edits <= 2; ++edits) {
+            compare_searches(tables[0], index->records[0].bwt_table, pattern, edits);
+            compare_searches(tables[1], index->records[1].bwt_table, pattern, edits);
+            compare_searches(tables[3], index->records[3].bwt_table, pattern, edits);
+        }
+    }
+    for (int edits = 0; edits <= 2; ++edits) {
+        compare_searches(tables[2], index->records[2].bwt_table,
+                         (const uint8_t *)"ada", edits);
+    }
+
+    close_bwt_index(index);
+    remove(fname);
+    for (uint32_t i = 0; i < no_records; ++i) {
+        completely_free_bwt_table(tables[i]);
+    }
+    free(dna);
+}
+
+static void test_seqs(void)
+{
+    // Four sequences, one of them empty, concatenated.
+    uint8_t *str = (uint8_t *)"acgtacggtttacacgt";
+    const char *seq_names[] = { "first", "empty", "second", "third" };
+    index_t seq_starts[] = { 0, 6, 6, 11, 17 };
+    struct bwt_table *tables[] = {
+        build_complete_table_sampled(str, true, 2),
+        build_complete_table(str, true)
+    };
+
+    char fname[32];
+    temp_fname(fname);
+    struct bwt_index_writer writer;
+    enum error_codes err = init_bwt_index_writer(&writer, fname, 2);
+    assert(err == NO_ERROR);
+    add_bwt_index_record_seqs(&writer, "genome", tables[0], 4, seq_names, seq_starts);
+    add_bwt_index_record(&writer, "plain", tables[1]);
+    finish_bwt_index_writer(&writer);
+
+    struct bwt_index *index = open_bwt_index(fname, 0, &err);
+    assert(index);
+    assert(err == NO_ERROR);
+
+    const struct bwt_index_record *genome = &index->records[0];
+    assert(genome->no_seqs == 4);
+    for (uint32_t i = 0; i < 4; ++i) {
+        assert(strcmp(genome->seq_names[i], seq_names[i]) == 0);
+        assert(genome->seq_starts[i] == seq_starts[i]);
+    }
+    for (index_t pos = 0; pos < 17; ++pos) {
+        uint32_t expected = (pos < 6) ? 0 : (pos < 11) ? 2 : 3;
+        assert(find_bwt_index_seq(genome, pos) == expected);
+    }
+
+    // Without sequences, the record is its own only sequence.
+    const struct bwt_index_record *plain = &index->records[1];
+    assert(plain->no_seqs == 1);
+    assert(strcmp(plain->seq_names[0], "plain") == 0);
+    assert(plain->seq_starts[0] == 0 && plain->seq_starts[1] == 17);
+    for (index_t pos = 0; pos < 17; ++pos) {
+        assert(find_bwt_index_seq(plain, pos) == 0);
+    }
+
+    close_bwt_index(index);
+    remove(fname);
+    completely_free_bwt_table(tables[0]);
+    completely_free_bwt_table(tables[1]);
+}
+
+static void test_errors(void)
+{
+    enum error_codes err;
+    struct bwt_index *index = open_bwt_index("/this/file/does/not/exist", 0, &err);
+    assert(!index);
+    assert(err == CANNOT_OPEN_FILE);
+
+    uint8_t *str = (uint8_t *)"acgtacgtgtgca";
+    struct bwt_table *table = build_complete_table(str, true);
+    const char *names[] = { "seq" };
+    char fname[32];
+    temp_fname(fname);
+    err = write_bwt_index_fname(fname, 1, names, &table);
+    assert(err == NO_ERROR);
+
+    FILE *f = fopen(fname, "rb");
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t *data = malloc(size);
+    size_t read = fread(data, 1, size, f);
+    assert(read == (size_t)size);
+    fclose(f);
+
+    // Truncated files
+    long sizes[] = { 0, 8, 64, size / 2, size - 1 };
+    for (uint32_t i = 0; i < sizeof(sizes) / sizeof(*sizes); ++i) {
+        f = fopen(fname, "wb");
+        fwrite(data, 1, sizes[i], f);
+        fclose(f);
+        index = open_bwt_index(fname, 0, &err);
+        assert(!index);
+        assert(err == MALFORMED_FILE);
+    }
+
+    // Not an index file
+    data[0] = 'X';
+    f = fopen(fname, "wb");
+    fwrite(data, 1, size, f);
+    fclose(f);
+    index = open_bwt_index(fname, 0, &err);
+    assert(!index);
+    assert(err == MALFORMED_FILE);
+    data[0] = 'S';
+
+    // Another version; the version follows the eight byte magic.
+    uint32_t version = BWT_INDEX_VERSION + 1;
+    memcpy(data + 8, &version, sizeof(version));
+    f = fopen(fname, "wb");
+    fwrite(data, 1, size, f);
+    fclose(f);
+    index = open_bwt_index(fname, 0, &err);
+    assert(!index);
+    assert(err == UNSUPPORTED_VERSION);
+
+    remove(fname);
+    free(data);
+    completely_free_bwt_table(table);
+}
+
+int main(int argc, const char **argv)
+{
+    test_round_trip(0);
+    test_round_trip(BWT_INDEX_POPULATE);
+    test_round_trip(BWT_INDEX_POPULATE | BWT_INDEX_HUGEPAGES);
+    test_seqs();
+    test_errors();
+    return EXIT_SUCCESS;
+}
@@ -18,7 +18,7 @@ static void test_expected(const struct bwt_table *bwt_table)
        //  0, 0, 4, 5, 7
     };
     for (uint32_t i = 0; i < remap_table->alphabet_size; ++i) {
-        printf("C[%u] == %u\n", i, bwt_table->c_table[i]);
+        printf("C[%u] == %" PRIindex "\n", i, bwt_table->c_table[i]);
         assert(bwt_table->c_table[i] == expected_c[i]);
     }
     
@@ -108,6 +108,379 @@ static void forward_search(
     printf("\n");
 }
 
+static void test_sampled_locate(
+    struct bwt_table *bwt_table
+) {
+    const struct suffix_array *sa = bwt_table->sa;
+    for (uint32_t rate = 1; rate <= sa->length + 1; ++rate) {
+        sample_bwt_suffix_array(bwt_table, rate);
+        for (uint32_t i = 0; i < sa->length; ++i) {
+            assert(bwt_locate(bwt_table, i) == sa->array[i]);
+        }
+    }
+    
+    // Check that we can still search...
+    const uint8_t *pattern = (uint8_t *)"ssi";
+    uint8_t remapped_pattern[strlen((char *)pattern) + 1];
+    remap(remapped_pattern, pattern, bwt_table->remap_table);
+    
+    sample_bwt_suffix_array(bwt_table, 3);
+    struct bwt_exact_match_iter iter;
+    struct bwt_exact_match match;
+    uint32_t no_matches = 0;
+    init_bwt_exact_match_iter(&iter, bwt_table, remapped_pattern);
+    while (next_bwt_exact_match_iter(&iter, &match)) {
+        assert(match.pos == 2 || match.pos == 5);
+        no_matches++;
+    }
+    dealloc_bwt_exact_match_iter(&iter);
+    assert(no_matches == 2);
+}
+
+static void test_batch_search(void)
+{
+    // A string long enough that the batch has
+    // to refill its slots many times.
+    uint32_t n = 2000;
+    uint8_t string[n + 1];
+    for (uint32_t i = 0; i < n; ++i) {
+        string[i] = "acgt"[rand() % 4];
+    }
+    string[n] = '\0';
+    struct bwt_table *bwt_table = build_complete_table(string, false);
+    
+    // Half the patterns are from the string, so they match,
+    // the other half are random and mostly do not.
+    uint32_t no_patterns = 200;
+    uint8_t *patterns[no_patterns];
+    for (uint32_t j = 0; j < no_patterns; ++j) {
+        uint32_t m = 1 + rand() % 20;
+        uint8_t pattern[m + 1];
+        if (j % 2 == 0) {
+            memcpy(pattern, string + rand() % (n - m), m);
+        } else {
+            for (uint32_t i = 0; i < m; ++i) {
+                pattern[i] = "acgt"[rand() % 4];
+            }
+        }
+        pattern[m] = '\0';
+        patterns[j] = malloc(m + 1);
+        remap(patterns[j], pattern, bwt_table->remap_table);
+    }
+    
+    struct bwt_interval intervals[no_patterns];
+    bwt_exact_search_batch(bwt_table, (const uint8_t **)patterns,
+                           no_patterns, intervals);
+    for (uint32_t j = 0; j < no_patterns; ++j) {
+        struct bwt_exact_match_iter iter;
+        init_bwt_exact_match_iter(&iter, bwt_table, patterns[j]);
+        if (iter.L < iter.R) {
+            assert(intervals[j].L == iter.L);
+            assert(intervals[j].R == iter.R);
+        } else {
+            assert(intervals[j].L >= intervals[j].R);
+        }
+        dealloc_bwt_exact_match_iter(&iter);
+    }
+    
+    // With a k-mer table, both searches should give the same
+    // intervals as without; this includes patterns shorter than k.
+    for (uint32_t k = 1; k <= 8; ++k) {
+        build_bwt_kmer_table(bwt_table, k);
+        struct bwt_interval kmer_intervals[no_patterns];
+        bwt_exact_search_batch(bwt_table, (const uint8_t **)patterns,
+                               no_patterns, kmer_intervals);
+        for (uint32_t j = 0; j < no_patterns; ++j) {
+            struct bwt_exact_match_iter iter;
+            init_bwt_exact_match_iter(&iter, bwt_table, patterns[j]);
+            if (intervals[j].L < intervals[j].R) {
+                assert(iter.L == intervals[j].L && iter.R == intervals[j].R);
+                assert(kmer_intervals[j].L == intervals[j].L);
+                assert(kmer_intervals[j].R == intervals[j].R);
+            } else {
+                assert(iter.L >= iter.R);
+                assert(kmer_intervals[j].L >= kmer_intervals[j].R);
+            }
+            dealloc_bwt_exact_match_iter(&iter);
+        }
+    }
+    assert(default_bwt_kmer_length(bwt_table) == 5); // 4^5 <= 2001 < 4^6
+    
+    for (uint32_t j = 0; j < no_patterns; ++j) {
+        free(patterns[j]);
+    }
+    
+    // an empty batch should also work
+    bwt_exact_search_batch(bwt_table, 0, 0, intervals);
+    
+    completely_free_bwt_table(bwt_table);
+}
+
+// With twenty symbols, 20^12 does not fit in 32 bits, so the
+// table must use shorter k-mers, and still find the same intervals.
+static void test_protein_kmers(void)
+{
+    const char *amino_acids = "ACDEFGHIKLMNPQRSTVWY";
+    uint32_t n = 5000;
+    uint8_t string[n + 1];
+    for (uint32_t i = 0; i < n; ++i) {
+        string[i] = amino_acids[rand() % 20];
+    }
+    string[n] = '\0';
+    struct bwt_table *bwt_table = build_complete_table(string, false);
+    assert(bwt_table->remap_table->alphabet_size == 21);
+    assert(max_bwt_kmer_length(21) == 5); // 20^5 <= 2^24 < 20^6
+    assert(default_bwt_kmer_length(bwt_table) == 2); // 20^2 <= 5001 < 20^3
+    
+    uint32_t no_patterns = 100;
+    uint8_t *patterns[no_patterns];
+    struct bwt_interval intervals[no_patterns];
+    for (uint32_t j = 0; j < no_patterns; ++j) {
+        uint32_t m = 1 + rand() % 15;
+        uint8_t pattern[m + 1];
+        memcpy(pattern, string + rand() % (n - m), m);
+        pattern[m] = '\0';
+        if (j % 2) pattern[rand() % m] = amino_acids[rand() % 20];
+        patterns[j] = malloc(m + 1);
+        remap(patterns[j], pattern, bwt_table->remap_table);
+    }
+    bwt_exact_search_batch(bwt_table, (const uint8_t **)patterns,
+                           no_patterns, intervals);
+    
+    build_bwt_kmer_table(bwt_table, 12);
+    assert(bwt_table->kmer_table->k == 5);
+    assert(bwt_table->kmer_table->no_kmers == 20 * 20 * 20 * 20 * 20);
+    struct bwt_interval kmer_intervals[no_patterns];
+    bwt_exact_search_batch(bwt_table, (const uint8_t **)patterns,
+                           no_patterns, kmer_intervals);
+    for (uint32_t j = 0; j < no_patterns; ++j) {
+        if (intervals[j].L < intervals[j].R) {
+            assert(kmer_intervals[j].L == intervals[j].L);
+            assert(kmer_intervals[j].R == intervals[j].R);
+        } else {
+            assert(kmer_intervals[j].L >= kmer_intervals[j].R);
+        }
+        free(patterns[j]);
+    }
+    
+    completely_free_bwt_table(bwt_table);
+}
+
+static void test_counts(void)
+{
+    uint32_t n = 1000;
+    uint8_t string[n + 1];
+    for (uint32_t i = 0; i < n; ++i) {
+        string[i] = "acgt"[rand() % 4];
+    }
+    string[n] = '\0';
+    // Counting never looks up positions, so a sampled
+    // suffix array should do.
+    struct bwt_table *bwt_table = build_complete_table_sampled(string, true, 8);
+    
+    uint32_t no_patterns = 100;
+    uint8_t *patterns[no_patterns];
+    uint8_t *raw_patterns[no_patterns];
+    for (uint32_t j = 0; j < no_patterns; ++j) {
+        uint32_t m = 1 + rand() % 12;
+        raw_patterns[j] = malloc(m + 1);
+        memcpy(raw_patterns[j], string + rand() % (n - m), m);
+        raw_patterns[j][m] = '\0';
+        if (j % 2) raw_patterns[j][rand() % m] = "acgt"[rand() % 4];
+        patterns[j] = malloc(m + 1);
+        remap(patterns[j], raw_patterns[j], bwt_table->remap_table);
+    }
+    
+    index_t counts[no_patterns];
+    bwt_exact_count_batch(bwt_table, (const uint8_t **)patterns,
+                          no_patterns, counts);
+    for (uint32_t j = 0; j < no_patterns; ++j) {
+        index_t expected = 0;
+        uint32_t m = (uint32_t)strlen((char *)raw_patterns[j]);
+        for (uint32_t i = 0; i + m <= n; ++i) {
+            if (strncmp((char *)string + i, (char *)raw_patterns[j], m) == 0)
+                expected++;
+        }
+        assert(bwt_exact_count(bwt_table, patterns[j]) == expected);
+        assert(counts[j] == expected);
+    }
+    
+    // The approximative counts are the number of matches the
+    // iterator reports, whatever algorithm and filter we use.
+    enum bwt_approx_algorithm algorithms[] = {
+        BWT_BACKTRACK, BWT_BIDIRECTIONAL, BWT_SEED_EXTEND
+    };
+    enum bwt_approx_filter filters[] = {
+        BWT_REPORT_ALL, BWT_BEST_PER_MATCH, BWT_BEST_PER_POSITION
+    };
+    for (int edits = 0; edits <= 2; ++edits) {
+        for (uint32_t f = 0; f < 3; ++f) {
+            struct bwt_approx_params params = {
+                .algorithm = BWT_BACKTRACK, .filter = filters[f]
+            };
+            index_t expected[no_patterns];
+            for (uint32_t j = 0; j < no_patterns; ++j) {
+                expected[j] = 0;
+                struct bwt_approx_iter iter;
+                struct bwt_approx_match match;
+                init_bwt_approx_iter_params(&iter, bwt_table, patterns[j],
+                                            edits, &params);
+                while (next_bwt_approx_match(&iter, &match)) expected[j]++;
+                dealloc_bwt_approx_iter(&iter);
+            }
+            for (uint32_t a = 0; a < 3; ++a) {
+                params.algorithm = algorithms[a];
+                bwt_approx_count_batch(bwt_table, (const uint8_t **)patterns,
+                                       no_patterns, edits, &params, counts);
+                for (uint32_t j = 0; j < no_patterns; ++j) {
+                    assert(counts[j] == expected[j]);
+                    assert(bwt_approx_count(bwt_table, patterns[j],
+                                            edits, &params) == expected[j]);
+                }
+            }
+        }
+    }
+    
+    // Counting neither records edit scripts nor makes room for
+    // cigars, so a fresh workspace never gets those buffers.
+    for (uint32_t a = 0; a < 3; ++a) {
+        for (uint32_t f = 0; f < 3; ++f) {
+            struct bwt_approx_workspace workspace;
+            init_bwt_approx_workspace(&workspace);
+            struct bwt_approx_params params = {
+                .algorithm = algorithms[a], .filter = filters[f],
+                .workspace = &workspace
+            };
+            for (uint32_t j = 0; j < no_patterns; ++j) {
+                bwt_approx_count(bwt_table, patterns[j], 2, &params);
+                assert(workspace.no_script_ops == 0);
+            }
+            assert(workspace.scripts_size == 0);
+            assert(workspace.cigars_size == 0);
+            dealloc_bwt_approx_workspace(&workspace);
+        }
+    }
+    
+    for (uint32_t j = 0; j < no_patterns; ++j) {
+        free(patterns[j]);
+        free(raw_patterns[j]);
+    }
+    completely_free_bwt_table(bwt_table);
+}
+
+static void test_sampled_construction(void)
+{
+    // Building the table straight from SA-IS must give us the
+    // same tables as going through the full suffix arrays,
+    // including strings where the reduced problem is trivial.
+    const char *alphabet = "acgt";
+    uint32_t sizes[] = { 0, 1, 2, 3, 10, 100, 1000 };
+    uint32_t no_sizes = sizeof(sizes) / sizeof(uint32_t);
+    for (uint32_t s = 0; s < no_sizes; ++s) {
+        uint32_t n = sizes[s];
+        uint8_t string[n + 1];
+        for (uint32_t i = 0; i < n; ++i) {
+            string[i] = alphabet[rand() % 4];
+        }
+        string[n] = '\0';
+        
+        struct bwt_table *full = build_complete_table(string, true);
+        for (uint32_t rate = 1; rate <= 8; rate *= 2) {
+            struct bwt_table *sampled =
+                build_complete_table_sampled(string, true, rate);
+            assert(!sampled->sa->array);
+            uint32_t alphabet_size = full->remap_table->alphabet_size;
+            for (uint32_t a = 0; a < alphabet_size; ++a) {
+                assert(full->c_table[a] == sampled->c_table[a]);
+            }
+            assert(identical_occ_tables(full->o_table, sampled->o_table));
+            assert(identical_occ_tables(full->ro_table, sampled->ro_table));
+            for (uint32_t i = 0; i <= n; ++i) {
+                assert(bwt_locate(sampled, i) == full->sa->array[i]);
+            }
+            completely_free_bwt_table(sampled);
+        }
+        completely_free_bwt_table(full);
+    }
+}
+
+// Seed-and-extend on a self-index must verify against the
+// text it extracts exactly as it does against the string.
+static void compare_seed_search(
+    struct bwt_table *full,
+    struct bwt_table *self,
+    const uint8_t *pattern,
+    int edits
+) {
+    struct bwt_approx_params params = {
+        .algorithm = BWT_SEED_EXTEND, .filter = BWT_REPORT_ALL
+    };
+    struct bwt_approx_iter iter, self_iter;
+    struct bwt_approx_match match, self_match;
+    init_bwt_approx_iter_params(&iter, full, pattern, edits, &params);
+    init_bwt_approx_iter_params(&self_iter, self, pattern, edits, &params);
+    while (next_bwt_approx_match(&iter, &match)) {
+        bool found = next_bwt_approx_match(&self_iter, &self_match);
+        assert(found);
+        assert(match.position == self_match.position);
+        assert(match.match_length == self_match.match_length);
+        assert(strcmp(match.cigar, self_match.cigar) == 0);
+    }
+    assert(!next_bwt_approx_match(&self_iter, &self_match));
+    dealloc_bwt_approx_iter(&iter);
+    dealloc_bwt_approx_iter(&self_iter);
+}
+
+static void test_self_index(void)
+{
+    uint32_t sizes[] = { 0, 1, 2, 3, 10, 100, 1000 };
+    uint32_t no_sizes = sizeof(sizes) / sizeof(uint32_t);
+    for (uint32_t s = 0; s < no_sizes; ++s) {
+        uint32_t n = sizes[s];
+        uint8_t string[n + 1];
+        for (uint32_t i = 0; i < n; ++i) {
+            string[i] = "acgt"[rand() % 4];
+        }
+        string[n] = '\0';
+        
+        struct bwt_table *full = build_complete_table(string, true);
+        const uint8_t *remapped = full->sa->string;
+        uint8_t buffer[n + 1];
+        for (uint32_t rate = 1; rate <= 16; rate *= 2) {
+            struct bwt_table *self = build_self_index_table(string, true, rate);
+            assert(!self->sa->string && !self->sa->array);
+            assert(self->sa->length == n + 1);
+            
+            // All substrings of the short strings, and
+            // some of the long ones.
+            for (uint32_t k = 0; k < 200; ++k) {
+                uint32_t pos = (n <= 10) ? k / (n + 1) : rand() % (n + 1);
+                uint32_t len = (n <= 10) ? k % (n + 1) : rand() % (n + 1);
+                if (pos > n) break;
+                if (len > n - pos) continue;
+                bwt_extract(self, pos, len, buffer);
+                assert(memcmp(buffer, remapped + pos, len) == 0);
+                assert(buffer[len] == '\0');
+            }
+            for (uint32_t i = 0; i <= n; ++i) {
+                assert(bwt_locate(self, i) == full->sa->array[i]);
+            }
+            
+            for (uint32_t k = 0; n >= 100 && k < 20; ++k) {
+                uint32_t m = 20;
+                uint8_t pattern[m + 1];
+                memcpy(pattern, remapped + rand() % (n - m), m);
+                pattern[rand() % m] = 1 + rand() % 4;
+                pattern[m] = '\0';
+                compare_seed_search(full, self, pattern, 2);
+            }
+            
+            completely_free_bwt_table(self);
+        }
+        completely_free_bwt_table(full);
+    }
+}
+
 static void error_test(void)
 {
     // test that it is possible to
@@ -144,7 +517,7 @@ int main(int argc, char **argv)
     assert(sa->length == n + 1);
     
     for (uint32_t i = 0; i < sa->length; ++i) {
-        printf("sa[%2u] = %2u = ", i, sa->array[i]);
+        printf("sa[%2u] = %2" PRIindex " = ", i, sa->array[i]);
         for (uint32_t j = sa->array[i]; j < sa->length; ++j) {
             printf("%d", remapped[j]);
         }
@@ -183,9 +556,15 @@ int main(int argc, char **argv)
     
 
     error_test();
+    test_batch_search();
+    test_protein_kmers();
+    test_counts();
+    test_sampled_construction();
+    test_self_index();
     
     struct bwt_table *yet_another_table = build_complete_table(string, false);
     assert(equivalent_bwt_tables(&bwt_table, yet_another_table));
+    test_sampled_locate(yet_another_table);
     completely_free_bwt_table(yet_another_table);
     
     free_suffix_array(sa);
@@ -206,7 +585,7 @@ int main(int argc, char **argv)
     str_inplace_rev((uint8_t*)rev_string);
     
     for (uint32_t i = 0; i < rsa->length; ++i) {
-        printf("SA[%2u] = %2u : %s\n", i, rsa->array[i],
+        printf("SA[%2u] = %2" PRIindex " : %s\n", i, rsa->array[i],
                rev_string + rsa->array[i]);
     }
     
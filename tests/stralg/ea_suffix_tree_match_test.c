@@ -23,7 +23,7 @@ static void print_leaves(struct ea_suffix_tree_node *from)
     
     
     if (is_leaf(from)) {
-        printf("%u\n", from->leaf_label);
+        printf("%" PRIindex "\n", from->leaf_label);
         return;
     }
 
@@ -140,8 +140,8 @@ static void test_matching(const uint8_t *pattern, uint8_t *string) {
     struct ea_suffix_tree *st = naive_ea_suffix_tree(256, string);
     test_suffix_tree_match(naive_matches, pattern, st, string);
     
-    uint32_t sa[st->length];
-    uint32_t lcp[st->length];
+    index_t sa[st->length];
+    index_t lcp[st->length];
     ea_st_compute_sa_and_lcp(st, sa, lcp);
     
     free_ea_suffix_tree(st);
@@ -423,8 +423,8 @@ static void general_suffix_test(struct index_vector *naive,
     //st_print_dot_name(st, st->root, "tree.dot");
     test_suffix_tree_match(naive, pattern, st, string);
     
-    uint32_t sorted_suffixes[st->length];
-    uint32_t lcp[st->length];
+    index_t sorted_suffixes[st->length];
+    index_t lcp[st->length];
     st_compute_sa_and_lcp(st, sorted_suffixes, lcp);
     free_suffix_tree(st);
     
@@ -41,12 +41,12 @@ extern "C" {
  *static void test_lcp(struct suffix_array *sa) {
  *    compute_lcp(sa);
  *
- *    //assert(sa->lcp[0] == sa->lcp[sa->length]);
- *    assert(sa->lcp[0] == 0);
+ *    //assert(sa_lcp(sa, 0) == sa_lcp(sa, sa->length));
+ *    assert(sa_lcp(sa, 0) == 0);
  *
  *    for (uint32_t i = 1; i < sa->length; ++i) {
  *        uint32_t l = lcp(sa->string + sa->array[i-1], sa->string + sa->array[i]);
- *        assert(sa->lcp[i] == l);
+ *        assert(sa_lcp(sa, i) == l);
  *    }
  *}
  *
@@ -54,15 +54,15 @@ extern "C" {
 //print sa, isa (inverse), lcp
 static void print_arrays(struct suffix_array *sa, uint8_t *cad){
     for (uint32_t i = 0; i < sa->length; ++i)
-        printf("sa[%3d] == %3u\t%s\n", i, sa->array[i], cad + sa->array[i]);
+        printf("sa[%3d] == %3" PRIindex "\t%s\n", i, sa->array[i], cad + sa->array[i]);
     printf("\n");
 
     for (uint32_t i = 0; i < sa->length; ++i)
-        printf("isa[%3d] == %3u\t%s\n", i, sa->inverse[i], cad + i);
+        printf("isa[%3d] == %3" PRIindex "\t%s\n", i, sa->inverse[i], cad + i);
     printf("\n");
 
     for (uint32_t i = 0; i < sa->length; ++i)
-        printf("lcp[%3d] == %3u\t%s\n", i, sa->lcp[i], cad + sa->array[i]);
+        printf("lcp[%3d] == %3" PRIindex "\t%s\n", i, sa_lcp(sa, i), cad + sa->array[i]);
     printf("\n");
  }
 
@@ -84,8 +84,8 @@ static void save_arrays(struct suffix_array *sa, uint8_t *cad, std::string filen
 
 	std::ofstream output_lcp{filename + ".lcp"};
     for (uint32_t i = 0; i < sa->length; ++i)
-		output_lcp << sa->lcp[i] << std::endl;
-		//output_lcp << i << "," << sa->lcp[i] << "," << (cad + sa->array[i]) << std::endl;
+		output_lcp << sa_lcp(sa, i) << std::endl;
+		//output_lcp << i << "," << sa_lcp(sa, i) << "," << (cad + sa->array[i]) << std::endl;
 	output_lcp.close();
 }
 
@@ -101,6 +101,7 @@ static void my_tests(uint8_t* text, std::vector<std::string> patterns, std::stri
 
     struct suffix_array *sa;
     sa = skew_sa_construction(text);
+    compute_inverse(sa);
     compute_lcp(sa);
 	print_arrays(sa, text);
    
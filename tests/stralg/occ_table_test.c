@@ -0,0 +1,147 @@
+#include <occ_table.h>
+
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <stdio.h>
+
+static uint8_t *random_bwt(uint32_t n, uint32_t alphabet_size)
+{
+    // A BWT string has exactly one sentinel; the rest
+    // of the letters are from 1 to alphabet_size - 1.
+    uint8_t *bwt = malloc(n);
+    for (uint32_t i = 0; i < n; ++i) {
+        bwt[i] = 1 + rand() % (alphabet_size - 1);
+    }
+    bwt[rand() % n] = 0;
+    return bwt;
+}
+
+static void test_rank(
+    const struct occ_table *table,
+    const uint8_t *bwt,
+    uint32_t n,
+    uint32_t alphabet_size
+) {
+    uint32_t counts[alphabet_size];
+    memset(counts, 0, alphabet_size * sizeof(uint32_t));
+    for (uint32_t i = 0; i <= n; ++i) {
+        for (uint8_t a = 0; a < alphabet_size; ++a) {
+            assert(occ_rank(table, a, i) == counts[a]);
+        }
+        if (i < n) counts[bwt[i]]++;
+    }
+    for (uint32_t i = 0; i < n; ++i) {
+        assert(occ_symbol(table, i) == bwt[i]);
+    }
+}
+
+static void test_interval_symbols(
+    const struct occ_table *table,
+    uint32_t n,
+    uint32_t alphabet_size
+) {
+    uint8_t symbols[alphabet_size];
+    index_t ranks_L[alphabet_size], ranks_R[alphabet_size];
+    for (uint32_t k = 0; k < 100; ++k) {
+        index_t L = rand() % (n + 1);
+        index_t R = L + rand() % (n + 1 - L);
+        if (k % 2) R = L + (R - L) % 8; // mostly narrow intervals
+        uint32_t no_symbols = occ_interval_symbols(table, L, R, symbols,
+                                                   ranks_L, ranks_R);
+        uint32_t j = 0;
+        for (uint32_t a = 0; a < alphabet_size; ++a) {
+            index_t rank_L = occ_rank(table, (uint8_t)a, L);
+            index_t rank_R = occ_rank(table, (uint8_t)a, R);
+            if (rank_L == rank_R) continue;
+            assert(j < no_symbols);
+            assert(symbols[j] == a);
+            assert(ranks_L[j] == rank_L);
+            assert(ranks_R[j] == rank_R);
+            j++;
+        }
+        assert(j == no_symbols);
+    }
+}
+
+static void test_serialisation(const struct occ_table *table)
+{
+    // get a unique temporary file name...
+    const char *temp_template = "/tmp/temp.XXXXXX";
+    char fname[strlen(temp_template) + 1];
+    strcpy(fname, temp_template);
+    mkstemp(fname);
+
+    FILE *f = fopen(fname, "wb");
+    write_occ_table(f, table);
+    fclose(f);
+
+    f = fopen(fname, "rb");
+    struct occ_table *other_table = read_occ_table(f);
+    fclose(f);
+
+    assert(identical_occ_tables(table, other_table));
+    free_occ_table(other_table);
+}
+
+static void test_layout(
+    const uint8_t *bwt,
+    uint32_t n,
+    uint32_t alphabet_size,
+    enum occ_layout layout
+) {
+    struct occ_table table;
+    init_occ_table_layout(&table, bwt, n, alphabet_size, layout);
+    test_rank(&table, bwt, n, alphabet_size);
+    test_interval_symbols(&table, n, alphabet_size);
+    test_serialisation(&table);
+
+    // Building in parallel must give us the same table,
+    // also with more threads than blocks.
+    for (uint32_t no_threads = 1; no_threads <= 8; no_threads *= 2) {
+        struct occ_table parallel_table;
+        init_occ_table_parallel(&parallel_table, bwt, n, alphabet_size,
+                                layout, no_threads);
+        assert(identical_occ_tables(&table, &parallel_table));
+        dealloc_occ_table(&parallel_table);
+    }
+
+    dealloc_occ_table(&table);
+}
+
+static void test_table(uint32_t n, uint32_t alphabet_size)
+{
+    printf("Testing n == %u and alphabet size %u\n", n, alphabet_size);
+    uint8_t *bwt = random_bwt(n, alphabet_size);
+
+    test_layout(bwt, n, alphabet_size, OCC_BIT_VECTORS);
+    test_layout(bwt, n, alphabet_size, OCC_WAVELET_MATRIX);
+    if (alphabet_size <= 5) {
+        test_layout(bwt, n, alphabet_size, OCC_PACKED_DNA);
+        test_layout(bwt, n, alphabet_size, OCC_INTERLEAVED_DNA);
+    }
+
+    free(bwt);
+}
+
+int main(int argc, const char **argv)
+{
+    srand(42);
+
+    uint32_t sizes[] = {
+        1, 2, 63, 64, 65, 127, 128, 129, 191, 192, 193, 1000, 5000
+    };
+    uint32_t no_sizes = sizeof(sizes) / sizeof(uint32_t);
+    uint32_t alphabet_sizes[] = {
+        2, 3, 4, 5, 8, 9, 20, 127
+    };
+    uint32_t no_alphabet_sizes = sizeof(alphabet_sizes) / sizeof(uint32_t);
+
+    for (uint32_t i = 0; i < no_sizes; ++i) {
+        for (uint32_t j = 0; j < no_alphabet_sizes; ++j) {
+            test_table(sizes[i], alphabet_sizes[j]);
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
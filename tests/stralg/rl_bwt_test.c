@@ -0,0 +1,178 @@
+#include <rl_bwt.h>
+#include <bwt.h>
+#include <remap.h>
+#include <serialise.h>
+#include <suffix_array.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+
+// Copies of a random string with a few mutations, like
+// a collection of strains of the same genome.
+static uint8_t *repetitive_dna(uint32_t base_length, uint32_t copies)
+{
+    uint32_t n = base_length * copies;
+    uint8_t *str = malloc(n + 1);
+    for (uint32_t i = 0; i < base_length; ++i) {
+        str[i] = "acgt"[rand() % 4];
+    }
+    for (uint32_t c = 1; c < copies; ++c) {
+        memcpy(str + c * base_length, str, base_length);
+        for (uint32_t k = 0; k < 3; ++k) {
+            str[c * base_length + rand() % base_length] = "acgt"[rand() % 4];
+        }
+    }
+    str[n] = '\0';
+    return str;
+}
+
+static int compare_positions(const void *a, const void *b)
+{
+    index_t x = *(const index_t *)a, y = *(const index_t *)b;
+    return (x > y) - (x < y);
+}
+
+// The run-length table should find the same occurrences as
+// the BWT table with the full suffix array.
+static void compare_search(
+    const struct rl_bwt_table *table,
+    struct bwt_table *bwt_table,
+    const uint8_t *pattern
+) {
+    uint32_t m = (uint32_t)strlen((const char *)pattern);
+    uint8_t remapped[m + 1];
+    if (!remap(remapped, pattern, table->remap_table)) return;
+
+    index_t count = bwt_exact_count(bwt_table, remapped);
+    assert(rl_bwt_count(table, remapped) == count);
+
+    index_t *expected = malloc((count + 1) * sizeof(index_t));
+    index_t *found = malloc((count + 1) * sizeof(index_t));
+    index_t no_expected = 0, no_found = 0;
+
+    struct bwt_exact_match_iter iter;
+    struct bwt_exact_match match;
+    init_bwt_exact_match_iter(&iter, bwt_table, remapped);
+    while (next_bwt_exact_match_iter(&iter, &match)) {
+        expected[no_expected++] = match.pos;
+    }
+    dealloc_bwt_exact_match_iter(&iter);
+
+    struct rl_bwt_exact_match_iter rl_iter;
+    init_rl_bwt_exact_match_iter(&rl_iter, table, remapped);
+    while (next_rl_bwt_exact_match_iter(&rl_iter, &match)) {
+        assert(no_found < count);
+        found[no_found++] = match.pos;
+    }
+    dealloc_rl_bwt_exact_match_iter(&rl_iter);
+
+    assert(no_found == no_expected);
+    qsort(expected, no_expected, sizeof(index_t), compare_positions);
+    qsort(found, no_found, sizeof(index_t), compare_positions);
+    assert(memcmp(expected, found, no_found * sizeof(index_t)) == 0);
+
+    free(expected);
+    free(found);
+}
+
+static void test_string(const uint8_t *string)
+{
+    struct bwt_table *bwt_table = build_complete_table(string, false);
+    struct rl_bwt_table *table = build_rl_bwt_table(string);
+    const struct suffix_array *sa = bwt_table->sa;
+    index_t n = sa->length;
+
+    // Building from the suffix array gives the same table.
+    struct rl_bwt_table from_sa;
+    init_rl_bwt_table(&from_sa, sa, bwt_table->remap_table);
+    assert(equivalent_rl_bwt_tables(table, &from_sa));
+    dealloc_rl_bwt_table(&from_sa);
+
+    // Rank and access agree with the O table.
+    uint32_t alphabet_size = table->remap_table->alphabet_size;
+    index_t runs = 1;
+    for (index_t i = 0; i < n; ++i) {
+        uint8_t a = sa->array[i] ? sa->string[sa->array[i] - 1] : 0;
+        assert(rl_bwt_symbol(table, i) == a);
+        if (i > 0) runs += rl_bwt_symbol(table, i - 1) != a;
+    }
+    assert(table->no_runs == runs);
+    for (index_t i = 0; i <= n; ++i) {
+        for (uint8_t a = 0; a < alphabet_size; ++a) {
+            assert(rl_bwt_rank(table, a, i) ==
+                   occ_rank(bwt_table->o_table, a, i));
+        }
+    }
+
+    uint32_t len = (uint32_t)strlen((const char *)string);
+    for (uint32_t k = 0; k < 50 && len > 0; ++k) {
+        uint32_t m = 1 + rand() % 12;
+        if (m > len) m = len;
+        uint8_t pattern[m + 1];
+        memcpy(pattern, string + rand() % (len - m + 1), m);
+        pattern[m] = '\0';
+        compare_search(table, bwt_table, pattern);
+        // and one that is probably not there
+        pattern[rand() % m] = string[rand() % len];
+        compare_search(table, bwt_table, pattern);
+    }
+
+    completely_free_rl_bwt_table(table);
+    completely_free_bwt_table(bwt_table);
+}
+
+static void test_serialisation(void)
+{
+    uint8_t *dna = repetitive_dna(1000, 10);
+    struct rl_bwt_table *table = build_rl_bwt_table(dna);
+
+    char fname[] = "/tmp/temp.XXXXXX";
+    int fd = mkstemp(fname);
+    if (fd >= 0) close(fd);
+    write_complete_rl_bwt_info_fname(fname, table);
+    struct rl_bwt_table *other = read_complete_rl_bwt_info_fname(fname);
+    remove(fname);
+    assert(table->remap_table->alphabet_size == other->remap_table->alphabet_size);
+    assert(equivalent_rl_bwt_tables(table, other));
+
+    completely_free_rl_bwt_table(other);
+    completely_free_rl_bwt_table(table);
+    free(dna);
+}
+
+static void test_size(void)
+{
+    // Ten near-identical copies have far fewer runs than
+    // positions, and the table size follows the runs.
+    uint8_t *dna = repetitive_dna(10000, 10);
+    struct rl_bwt_table *table = build_rl_bwt_table(dna);
+    printf("n = %" PRIindex ", r = %" PRIindex ", %zu bytes\n",
+           table->length, table->no_runs, rl_bwt_table_size(table));
+    assert(table->no_runs < table->length / 4);
+    assert(rl_bwt_table_size(table) <
+           1024 + table->no_runs * (6 * sizeof(index_t) + 1));
+    completely_free_rl_bwt_table(table);
+    free(dna);
+}
+
+int main(int argc, const char **argv)
+{
+    const char *strings[] = {
+        "", "a", "aaaa", "abab", "mississippi",
+        "acgtacgtgtgca", "acgtadtadadfasdfing"
+    };
+    for (uint32_t i = 0; i < sizeof(strings) / sizeof(*strings); ++i) {
+        test_string((const uint8_t *)strings[i]);
+    }
+    for (uint32_t copies = 1; copies <= 8; copies *= 2) {
+        uint8_t *dna = repetitive_dna(500, copies);
+        test_string(dna);
+        free(dna);
+    }
+    test_serialisation();
+    test_size();
+    return EXIT_SUCCESS;
+}
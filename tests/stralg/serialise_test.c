@@ -42,9 +42,73 @@ static void test_complete_bwt(void)
     dealloc_remap_table(&remap_table);
 }
 
+static void test_sampled_bwt(void)
+{
+    uint8_t *str = (uint8_t *)"acgtadtadadfasdfing";
+    struct bwt_table *bwt_table = build_complete_table(str, true);
+    sample_bwt_suffix_array(bwt_table, 4);
+    build_bwt_kmer_table(bwt_table, 2);
+    
+    const char *temp_template = "/tmp/temp.XXXXXX";
+    char fname[strnlen(temp_template, MAX_STRLEN) + 1];
+    strcpy(fname, temp_template);
+    mkstemp(fname);
+    write_complete_bwt_info_fname(fname, bwt_table);
+    struct bwt_table *other_table = read_complete_bwt_info_fname(fname);
+    
+    // The full suffix array is not written when we have samples
+    assert(other_table->sa->array == 0);
+    assert(other_table->sa_samples);
+    for (uint32_t i = 0; i < bwt_table->sa->length; ++i) {
+        assert(bwt_locate(other_table, i) == bwt_table->sa->array[i]);
+    }
+    
+    // The k-mer table is serialised with the BWT table
+    assert(other_table->kmer_table);
+    assert(other_table->kmer_table->k == 2);
+    assert(other_table->kmer_table->no_kmers == bwt_table->kmer_table->no_kmers);
+    for (uint32_t i = 0; i < bwt_table->kmer_table->no_kmers; ++i) {
+        assert(other_table->kmer_table->intervals[i].L == bwt_table->kmer_table->intervals[i].L);
+        assert(other_table->kmer_table->intervals[i].R == bwt_table->kmer_table->intervals[i].R);
+    }
+    
+    completely_free_bwt_table(other_table);
+    completely_free_bwt_table(bwt_table);
+}
+
+static void test_self_index_bwt(void)
+{
+    uint8_t *str = (uint8_t *)"acgtadtadadfasdfing";
+    struct bwt_table *full = build_complete_table(str, false);
+    struct bwt_table *bwt_table = build_self_index_table(str, false, 4);
+    
+    const char *temp_template = "/tmp/temp.XXXXXX";
+    char fname[strnlen(temp_template, MAX_STRLEN) + 1];
+    strcpy(fname, temp_template);
+    mkstemp(fname);
+    write_complete_bwt_info_fname(fname, bwt_table);
+    struct bwt_table *other_table = read_complete_bwt_info_fname(fname);
+    
+    // Neither the string nor the suffix array is written,
+    // but we can get the string back.
+    assert(other_table->sa->string == 0);
+    assert(other_table->sa->length == full->sa->length);
+    assert(equivalent_bwt_tables(bwt_table, other_table));
+    index_t n = full->sa->length - 1;
+    uint8_t buffer[n + 1];
+    bwt_extract(other_table, 0, n, buffer);
+    assert(strcmp((char *)buffer, (char *)full->sa->string) == 0);
+    
+    completely_free_bwt_table(other_table);
+    completely_free_bwt_table(bwt_table);
+    completely_free_bwt_table(full);
+}
+
 int main(int argc, const char **argv)
 {
     test_complete_bwt();
+    test_sampled_bwt();
+    test_self_index_bwt();
     
     return EXIT_SUCCESS;
 }
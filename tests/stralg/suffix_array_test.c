@@ -1,12 +1,14 @@
 
 #include <suffix_array.h>
 #include <remap.h>
+#include <parallel.h>
 
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <assert.h>
+#include <unistd.h>
 
 static void test_order(struct suffix_array *sa)
 {
@@ -149,33 +151,36 @@ static void test_lcp(struct suffix_array *sa)
     compute_lcp(sa);
 
     //assert(sa->lcp[0] == sa->lcp[sa->length]);
-    assert(sa->lcp[0] == 0);
+    assert(sa_lcp(sa, 0) == 0);
 
     for (uint32_t i = 1; i < sa->length; ++i) {
         int l = lcp(sa->string + sa->array[i-1], sa->string + sa->array[i]);
-        assert(sa->lcp[i] == l);
+        assert(sa_lcp(sa, i) == l);
     }
 }
 
 
 static void test_sa(struct suffix_array *sa, uint8_t *string)
 {
+    compute_inverse(sa);
     compute_lcp(sa);
     
     for (int i = 0; i < sa->length; ++i)
-        printf("sa[%d] == %u\t%s\n", i, sa->array[i], string + sa->array[i]);
+        printf("sa[%d] == %" PRIindex "\t%s\n", i, sa->array[i], string + sa->array[i]);
     printf("\n");
     for (int i = 0; i < sa->length; ++i)
-        printf("isa[%d] == %u\t%s\n", i, sa->inverse[i], string + i);
+        printf("isa[%d] == %" PRIindex "\t%s\n", i, sa->inverse[i], string + i);
     printf("\n");
     for (int i = 0; i < sa->length; ++i)
-        printf("lcp[%2d] == %2u\t%s\n", i, sa->lcp[i], string + sa->array[i]);
+        printf("lcp[%2d] == %2" PRIindex "\t%s\n", i, sa_lcp(sa, i), string + sa->array[i]);
     printf("\n");
     
     test_order(sa);
     test_inverse(sa);
     test_lcp(sa);
     test_search(sa);
+    compute_lcp_lr(sa);
+    test_search(sa);
     
     print_suffix_array(sa);
     
@@ -198,6 +203,273 @@ static void test_sa(struct suffix_array *sa, uint8_t *string)
     assert(identical_suffix_arrays(sa, other_sa));
     
     free_suffix_array(other_sa);
+    
+    // The prefix buckets go with the array
+    compute_prefix_buckets(sa, 256, 2);
+    write_suffix_array_fname(fname, sa);
+    other_sa = read_suffix_array_fname(fname, string);
+    assert(other_sa->buckets.starts);
+    assert(identical_suffix_arrays(sa, other_sa));
+    test_search(other_sa);
+    free_suffix_array(other_sa);
+}
+
+// Check the bounds against a linear scan, with and without
+// the LCP-LR array.
+static void check_bounds(struct suffix_array *sa, const uint8_t *key)
+{
+    size_t m = strlen((const char *)key);
+    index_t lower = 0, upper = 0;
+    for (index_t i = 0; i < sa->length; ++i) {
+        int cmp = strncmp((const char *)key,
+                          (const char *)(sa->string + sa->array[i]), m);
+        if (cmp > 0) lower = i + 1;
+        if (cmp >= 0) upper = i + 1;
+    }
+    assert(lower_bound_search(sa, key) == lower);
+    assert(upper_bound_search(sa, key) == upper);
+
+    index_t count = 0;
+    struct sa_match_iter iter;
+    struct sa_match match;
+    init_sa_match_iter(&iter, key, sa);
+    while (next_sa_match(&iter, &match)) {
+        assert(strncmp((const char *)key,
+                       (const char *)(sa->string + match.position), m) == 0);
+        count++;
+    }
+    dealloc_sa_match_iter(&iter);
+    assert(count == upper - lower);
+}
+
+static void check_random_keys(
+    struct suffix_array *sa,
+    const uint8_t *alphabet
+) {
+    const uint8_t *string = sa->string;
+    uint32_t n = sa->length - 1;
+    uint32_t sigma = (uint32_t)strlen((const char *)alphabet);
+    check_bounds(sa, (const uint8_t *)"");
+    check_bounds(sa, (const uint8_t *)"x");
+    check_bounds(sa, (const uint8_t *)"0");
+    for (int k = 0; k < 500; ++k) {
+        uint8_t key[40];
+        uint32_t m = 1 + rand() % 39;
+        uint32_t pos = rand() % n;
+        if (pos + m > n) m = n - pos;
+        memcpy(key, string + pos, m);
+        key[m] = '\0';
+        check_bounds(sa, key);
+        key[rand() % m] = alphabet[rand() % sigma];
+        check_bounds(sa, key);
+    }
+}
+
+static void test_bound_search(void)
+{
+    uint32_t n = 2000;
+    uint8_t *string = malloc(n + 1);
+    for (uint32_t i = 0; i < n; ++i) {
+        // A few repeats so the keys share long prefixes
+        string[i] = (i >= n / 2 && rand() % 8) ?
+            string[i - n / 2] : "acgt"[rand() % 4];
+    }
+    string[n] = '\0';
+
+    // Every combination of prefix buckets, search tree,
+    // and LCP-LR, over the string and its remapped version.
+    uint8_t *remapped = malloc(n + 1);
+    uint32_t alphabet_size = remap_string(remapped, string);
+    for (int structures = 0; structures < 8; ++structures) {
+        struct suffix_array *sa = qsort_sa_construction(string);
+        if (structures & 1) compute_prefix_buckets(sa, 256, 2);
+        if (structures & 2) compute_search_tree(sa, 4);
+        if (structures & 4) compute_lcp_lr(sa);
+        check_random_keys(sa, (const uint8_t *)"acgt");
+        free_suffix_array(sa);
+
+        sa = sa_is_construction(remapped, alphabet_size);
+        if (structures & 1) {
+            // q = 3 for five symbols
+            compute_prefix_buckets(sa, alphabet_size, 0);
+            assert(sa->buckets.q == 3);
+        }
+        if (structures & 2) compute_search_tree(sa, 0);
+        if (structures & 4) compute_lcp_lr(sa);
+        check_random_keys(sa, (const uint8_t *)"\1\2\3\4");
+        free_suffix_array(sa);
+    }
+    free(remapped);
+
+    // With q = 1 on these, the key's bucket can cover every row
+    // but the first, so narrowing leaves the whole array.
+    const char *small_strings[] = {
+        "a", "aa", "aba",
+        "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa"
+    };
+    const char *small_keys[] = {
+        "a", "aa", "aaaa", "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa",
+        "ab", "aab", "ba", "b", "baa"
+    };
+    for (int structures = 0; structures < 8; ++structures) {
+        for (uint32_t i = 0; i < sizeof(small_strings) / sizeof(*small_strings); ++i) {
+            struct suffix_array *sa = qsort_sa_construction((uint8_t *)small_strings[i]);
+            if (structures & 1) compute_prefix_buckets(sa, 256, 1);
+            if (structures & 2) compute_search_tree(sa, 4);
+            if (structures & 4) compute_lcp_lr(sa);
+            for (uint32_t k = 0; k < sizeof(small_keys) / sizeof(*small_keys); ++k) {
+                check_bounds(sa, (const uint8_t *)small_keys[k]);
+            }
+            check_random_keys(sa, (const uint8_t *)"ab");
+            free_suffix_array(sa);
+        }
+    }
+
+    struct suffix_array *sa = qsort_sa_construction((uint8_t *)"");
+    compute_prefix_buckets(sa, 256, 0);
+    compute_search_tree(sa, 0);
+    compute_lcp_lr(sa);
+    check_bounds(sa, (const uint8_t *)"");
+    check_bounds(sa, (const uint8_t *)"a");
+    free_suffix_array(sa);
+
+    free(string);
+}
+
+// The parallel construction must give exactly the array
+// the sequential one does.
+static void compare_parallel_sa_is(uint8_t *string)
+{
+    uint32_t n = (uint32_t)strlen((const char *)string);
+    uint8_t *remapped = malloc(n + 1);
+    uint32_t alphabet_size = remap_string(remapped, string);
+
+    struct suffix_array *expected = sa_is_construction(remapped, alphabet_size);
+    for (uint32_t no_threads = 1; no_threads <= 8; no_threads *= 2) {
+        struct suffix_array *sa =
+            sa_is_construction_parallel(remapped, alphabet_size, no_threads);
+        assert(sa->length == expected->length);
+        assert(memcmp(sa->array, expected->array,
+                      sa->length * sizeof(index_t)) == 0);
+        free_suffix_array(sa);
+    }
+
+    free_suffix_array(expected);
+    free(remapped);
+}
+
+static void test_parallel_sa_is(void)
+{
+    const char *strings[] = {
+        "", "a", "aaaa", "ababacabac", "mississippi", "gacacacag"
+    };
+    for (uint32_t i = 0; i < sizeof(strings) / sizeof(*strings); ++i) {
+        compare_parallel_sa_is((uint8_t *)strings[i]);
+    }
+
+    // Long enough for several induction blocks and
+    // recursion levels that run in parallel.
+    uint32_t n = 50000;
+    uint8_t *string = malloc(n + 1);
+    string[n] = '\0';
+
+    memset(string, 'a', n);
+    compare_parallel_sa_is(string);
+
+    for (uint32_t i = 0; i < n; ++i) {
+        string[i] = "abc"[i % 3];
+    }
+    compare_parallel_sa_is(string);
+
+    for (uint32_t i = 0; i < n; ++i) {
+        string[i] = "acgt"[rand() % 4];
+    }
+    compare_parallel_sa_is(string);
+
+    // A few copies of the same random string
+    for (uint32_t i = n / 5; i < n; ++i) {
+        string[i] = string[i % (n / 5)];
+    }
+    compare_parallel_sa_is(string);
+
+    for (uint32_t i = 0; i < n; ++i) {
+        string[i] = 1 + rand() % 127;
+    }
+    compare_parallel_sa_is(string);
+
+    free(string);
+}
+
+// Long enough for the threads, with prefixes too long for a
+// byte. The threads must give the same array as one thread, and
+// the array must survive serialisation.
+static void compare_parallel_lcp(uint8_t *string)
+{
+    uint32_t n = (uint32_t)strlen((const char *)string);
+    uint8_t *remapped = malloc(n + 1);
+    uint32_t alphabet_size = remap_string(remapped, string);
+
+    struct suffix_array *expected = sa_is_construction(remapped, alphabet_size);
+    set_stralg_threads(1);
+    compute_lcp(expected);
+    index_t *lcp = lcp_array(expected);
+    for (index_t i = 0; i < expected->length; ++i) {
+        assert(lcp[i] == sa_lcp(expected, i));
+    }
+    free(lcp);
+
+    for (uint32_t no_threads = 2; no_threads <= 8; no_threads *= 2) {
+        struct suffix_array *sa = sa_is_construction(remapped, alphabet_size);
+        set_stralg_threads(no_threads);
+        compute_lcp(sa);
+        assert(identical_suffix_arrays(sa, expected));
+        free_suffix_array(sa);
+    }
+    set_stralg_threads(0);
+
+    char fname[] = "/tmp/temp.XXXXXX";
+    int fd = mkstemp(fname);
+    if (fd >= 0) close(fd);
+    write_lcp_fname(fname, expected);
+    struct suffix_array *other = sa_is_construction(remapped, alphabet_size);
+    read_lcp_fname(fname, other);
+    remove(fname);
+    assert(identical_suffix_arrays(other, expected));
+    free_suffix_array(other);
+
+    free_suffix_array(expected);
+    free(remapped);
+}
+
+static void test_lcp_construction(void)
+{
+    // Short enough that we can check against the definition.
+    uint32_t n = 2000;
+    uint8_t *string = malloc(n + 1);
+    string[n] = '\0';
+    memset(string, 'a', n);
+    struct suffix_array *sa = qsort_sa_construction(string);
+    test_lcp(sa);
+    assert(sa->lcp.no_overflows == n - SA_LCP_OVERFLOW);
+    free_suffix_array(sa);
+    free(string);
+
+    n = 100000;
+    string = malloc(n + 1);
+    string[n] = '\0';
+    for (uint32_t i = 0; i < n; ++i) {
+        string[i] = "acgt"[rand() % 4];
+    }
+    // A few copies of the same random string
+    for (uint32_t i = n / 5; i < n; ++i) {
+        string[i] = string[i % (n / 5)];
+    }
+    compare_parallel_lcp(string);
+    for (uint32_t i = 0; i < n; ++i) {
+        string[i] = "acgt"[rand() % 4];
+    }
+    compare_parallel_lcp(string);
+    free(string);
 }
 
 int main(int argc, char *argv[])
@@ -233,14 +505,18 @@ int main(int argc, char *argv[])
 
     free_suffix_array(sa);
 
+    test_parallel_sa_is();
+    test_lcp_construction();
+    test_bound_search();
+
     string = (uint8_t *)"gacacacag";
     sa = qsort_sa_construction(string);
     printf("\n");
     print_suffix_array(sa);
     printf("\n");
     
-    uint32_t hit = lower_bound_search(sa, (uint8_t *)"cag");
-    printf("hit: SA[%u]=%u\n", hit, sa->array[hit]);
+    index_t hit = lower_bound_search(sa, (uint8_t *)"cag");
+    printf("hit: SA[%" PRIindex "]=%" PRIindex "\n", hit, sa->array[hit]);
     printf("does cag match '%s'?\n", sa->string + sa->array[hit]);
     
     free_suffix_array(sa);
@@ -251,7 +527,7 @@ int main(int argc, char *argv[])
     printf("\n");
     
     hit = lower_bound_search(sa, (uint8_t *)(uint8_t *)"cag");
-    printf("hit: SA[%u]=%u\n", hit, sa->array[hit]);
+    printf("hit: SA[%" PRIindex "]=%" PRIindex "\n", hit, sa->array[hit]);
     printf("does cag match '%s'?\n", sa->string + sa->array[hit]);
     
     free_suffix_array(sa);
@@ -14,7 +14,7 @@ static void print_leaves(struct suffix_tree_node *from)
     
     if (!child) {
         // this is a leaf
-        printf("%u\n", from->leaf_label);
+        printf("%" PRIindex "\n", from->leaf_label);
         return;
     }
     
@@ -129,8 +129,8 @@ static void test_matching(const uint8_t *pattern, uint8_t *string) {
     struct suffix_tree *st = naive_suffix_tree(string);
     test_suffix_tree_match(naive_matches, pattern, st, string);
     
-    uint32_t sa[st->length];
-    uint32_t lcp[st->length];
+    index_t sa[st->length];
+    index_t lcp[st->length];
     st_compute_sa_and_lcp(st, sa, lcp);
     
     free_suffix_tree(st);
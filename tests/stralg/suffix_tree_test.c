@@ -81,7 +81,7 @@ static void check_suffix_tree(struct suffix_tree *st)
     init_st_leaf_iter(&iter, st, st->root);
     while (next_st_leaf(&iter, &res)) {
         index_vector_append(indices, res.leaf->leaf_label);
-        printf("suffix %2u: \"%s\"\n",
+        printf("suffix %2" PRIindex ": \"%s\"\n",
                res.leaf->leaf_label,
                st->string + res.leaf->leaf_label);
     }
@@ -101,11 +101,11 @@ static void check_suffix_tree(struct suffix_tree *st)
         printf("checking in iteration %d\n", xx);
         check_nodes(st, st->root);
         
-        printf("suffix %2u: \"%s\"\n",
+        printf("suffix %2" PRIindex ": \"%s\"\n",
                res.leaf->leaf_label,
                st->string + res.leaf->leaf_label);
         get_path_string(st, res.leaf, buffer);
-        printf("suffix path string: %2u: \"%s\"\n",
+        printf("suffix path string: %2" PRIindex ": \"%s\"\n",
                res.leaf->leaf_label,
                buffer);
         assert(strcmp((char *)buffer, (char *)st->string + res.leaf->leaf_label) == 0);
@@ -136,8 +136,8 @@ int main(int argc, const char **argv)
     check_suffix_tree(st);
     printf("made it through the naive test\n");
 
-    uint32_t sa[st->length];
-    uint32_t lcp[st->length];
+    index_t sa[st->length];
+    index_t lcp[st->length];
 
 #ifndef NDEBUG
     uint32_t no_indices = st->length;
@@ -152,7 +152,7 @@ int main(int argc, const char **argv)
     for (uint32_t i = 0; i < no_indices; ++i) {
         assert(sa[i] == expected[i]);
     }
-    uint32_t expected_lcp[] = {
+    index_t expected_lcp[] = {
         0, 0, 1, 1, 4, 0, 0, 1, 0, 2, 1, 3
     };
     for (uint32_t i = 0; i < no_indices; ++i) {
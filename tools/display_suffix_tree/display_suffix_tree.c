@@ -24,8 +24,8 @@ int main(int argc, const char** argv)
     printf("Building suffix tree.\n");
     struct suffix_tree* st = naive_suffix_tree(string);
     
-    uint32_t sa[st->length];
-    uint32_t lcp[st->length];
+    index_t sa[st->length];
+    index_t lcp[st->length];
     
     st_compute_sa_and_lcp(st, sa, lcp);
     
@@ -4,6 +4,7 @@
 #include "fastq.h"
 #include "sam.h"
 #include "bwt.h"
+#include "bwt_index.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -13,7 +14,11 @@
 
 static const char *suffix = "bwttables";
 
-static void preprocess(const char *fasta_fname)
+// The sample rate for a self-index if we are not given one
+#define DEFAULT_SELF_INDEX_SAMPLE_RATE 32
+
+static void preprocess(const char *fasta_fname, uint32_t sa_sample_rate,
+                       int kmer_length, bool self_index)
 {
     enum error_codes err;
     struct fasta_records *fasta_records =
@@ -39,135 +44,241 @@ static void preprocess(const char *fasta_fname)
     sprintf(preprocessed_fname, "%s.%s", fasta_fname, suffix);
     fprintf(stderr, "Preprocessed tables in %s\n", preprocessed_fname);
     
-    FILE *outfile = fopen(preprocessed_fname, "wb");
-    if (!outfile) {
-        perror("Could not open output file");
-        exit(EXIT_FAILURE);
-    }
-    
-    uint32_t no_records = number_of_fasta_records(fasta_records);
-    fwrite(&no_records, sizeof(no_records), 1, outfile);
+    // We index all the records as one string, so a read is
+    // a single search however many records the genome has.
+    uint32_t no_seqs = number_of_fasta_records(fasta_records);
+    const char **seq_names = malloc(no_seqs * sizeof(*seq_names));
+    index_t *seq_starts = malloc((no_seqs + 1) * sizeof(*seq_starts));
     
     struct fasta_iter iter;
     struct fasta_record rec;
+    uint32_t i = 0;
+    index_t n = 0;
+    init_fasta_iter(&iter, fasta_records);
+    while (next_fasta_record(&iter, &rec)) {
+        seq_names[i] = rec.name;
+        seq_starts[i++] = n;
+        n += rec.seq_len;
+    }
+    dealloc_fasta_iter(&iter);
+    seq_starts[no_seqs] = n;
+    
+    uint8_t *genome = malloc(n + 1);
+    i = 0;
     init_fasta_iter(&iter, fasta_records);
     while (next_fasta_record(&iter, &rec)) {
-        fprintf(stderr, "Serialising record %s\n", rec.name);
-        fprintf(stderr, "Length: %u\n", rec.seq_len);
-        write_string(outfile, (uint8_t*)rec.name);
-        struct bwt_table *table = build_complete_table(rec.seq, true);
-        write_complete_bwt_info(outfile, table);
-        completely_free_bwt_table(table);
-        fprintf(stderr, "Done\n");
+        memcpy(genome + seq_starts[i++], rec.seq, rec.seq_len);
     }
     dealloc_fasta_iter(&iter);
+    genome[n] = '\0';
     
-    fclose(outfile);
+    fprintf(stderr, "Serialising %u records\n", no_seqs);
+    fprintf(stderr, "Length: %" PRIindex "\n", n);
+    // With a sample rate, we never build the full suffix array,
+    // and a self-index does not keep the genome either.
+    struct bwt_table *table;
+    if (self_index) {
+        if (sa_sample_rate == 0) sa_sample_rate = DEFAULT_SELF_INDEX_SAMPLE_RATE;
+        table = build_self_index_table(genome, true, sa_sample_rate);
+    } else {
+        table = build_complete_table_sampled(genome, true, sa_sample_rate);
+    }
+    uint32_t k = (kmer_length < 0) ?
+        default_bwt_kmer_length(table) : (uint32_t)kmer_length;
+    uint32_t max_k = max_bwt_kmer_length(table->remap_table->alphabet_size);
+    if (k > max_k) {
+        fprintf(stderr, "Using k-mer length %u, the longest for this alphabet.\n",
+                max_k);
+        k = max_k;
+    }
+    build_bwt_kmer_table(table, k);
+    
+    struct bwt_index_writer writer;
+    if (init_bwt_index_writer(&writer, preprocessed_fname, 1) != NO_ERROR) {
+        perror("Could not open output file");
+        exit(EXIT_FAILURE);
+    }
+    add_bwt_index_record_seqs(&writer, fasta_fname, table,
+                              no_seqs, seq_names, seq_starts);
+    finish_bwt_index_writer(&writer);
+    fprintf(stderr, "Done\n");
+    
+    completely_free_bwt_table(table);
+    free(genome);
+    free(seq_starts);
+    free(seq_names);
     free_fasta_records(fasta_records);
 }
 
-struct string_table {
-    const char *name;
-    struct bwt_table *bwt_table;
-    struct string_table *next;
-};
-
-static struct string_table *new_string_table(const char *name,
-                                             struct bwt_table *bwt_table,
-                                             struct string_table *next)
-{
-    struct string_table *res = malloc(sizeof(struct string_table));
-    res->name = name;
-    res->bwt_table = bwt_table;
-    res->next = next;
-    return res;
-}
-
-
-
-static struct string_table *read_string_tables(const char *fasta_fname)
+// The tables point into the mapped index file, so they
+// are valid until we close the index.
+static struct bwt_index *read_index(const char *fasta_fname,
+                                    int map_flags)
 {
     
     char preprocessed_fname[strlen(fasta_fname) + 1 + strlen(suffix) + 1];
     sprintf(preprocessed_fname, "%s.%s", fasta_fname, suffix);
     fprintf(stderr, "Preprocessed tables in %s\n", preprocessed_fname);
     
-    FILE *infile = fopen(preprocessed_fname, "rb");
-    if (!infile) {
-        perror("Could not open output file");
-        exit(EXIT_FAILURE);
+    enum error_codes err;
+    struct bwt_index *index = open_bwt_index(preprocessed_fname, map_flags, &err);
+    // We write all the records as one.
+    if (index && index->no_records != 1) {
+        close_bwt_index(index);
+        index = 0;
+        err = MALFORMED_FILE;
     }
-
-    fprintf(stderr, "reading preprocessed data.\n");
-    
-    struct string_table *tables = 0;
-    uint32_t no_records;
-    fread(&no_records, sizeof(no_records), 1, infile);
-    for (uint32_t i = 0; i < no_records; ++i) {
-        char *name = (char *)read_string(infile);
-        fprintf(stderr, "%s\n", name);
-        struct bwt_table *bwt_table = read_complete_bwt_info(infile);
-        tables = new_string_table(name, bwt_table, tables);
+    switch (err) {
+        case NO_ERROR:
+            break;
+            
+        case CANNOT_OPEN_FILE:
+            perror("Could not open preprocessed tables");
+            exit(EXIT_FAILURE);
+            
+        case MALFORMED_FILE:
+        case UNSUPPORTED_VERSION:
+            printf("The preprocessed tables are malformed or from another "
+                   "version of the format: %s\n", preprocessed_fname);
+            printf("Preprocess the genome again with -p.\n");
+            exit(EXIT_FAILURE);
+            
+        default:
+            assert(false); // this is not an error the function should return
     }
-    fprintf(stderr, "done.\n");
     
-    return tables;
+    fprintf(stderr, "%u records\n", index->records[0].no_seqs);
+    
+    return index;
 }
 
-static void free_string_tables(struct string_table *tables)
+// Positions are in the concatenated records. We report them in
+// the record they are in, and leave out matches that run from the
+// end of one record into the next. The approximative search has
+// already left those out, before it filtered the matches, but the
+// exact batch search has not.
+static void print_match(FILE *samfile,
+                        const struct fastq_record *fastq_rec,
+                        const struct bwt_index_record *genome,
+                        index_t position,
+                        uint32_t match_length,
+                        const char *cigar)
 {
-    struct string_table *next;
-    while (tables) {
-        next = tables->next;
-        completely_free_bwt_table(tables->bwt_table);
-        free(tables);
-        tables = next;
-    }
+    uint32_t seq = find_bwt_index_seq(genome, position);
+    index_t start = genome->seq_starts[seq];
+    if (position + match_length > genome->seq_starts[seq + 1]) return;
+    print_sam_line(samfile,
+                   fastq_rec->name, genome->seq_names[seq],
+                   (uint32_t)(position - start) + 1,
+                   cigar,
+                   fastq_rec->sequence, fastq_rec->quality);
 }
 
 void map_read(struct fastq_record *fastq_rec,
-              struct string_table *records,
+              const struct bwt_index_record *genome,
               int d,
+              const struct bwt_approx_params *params,
               FILE *samfile)
 {
     uint8_t remap_buf[10000];
     
-    while (records) {
-        const uint8_t *remapped = remap(remap_buf,
-                                        (uint8_t *)fastq_rec->sequence,
-                                        records->bwt_table->remap_table);
-        if (!remapped) {
-            records = records->next;
-            continue;
-        }
-        
-        struct bwt_approx_iter  iter;
-        struct bwt_approx_match match;
-        
-        init_bwt_approx_iter(&iter, records->bwt_table, remap_buf, d);
-        while (next_bwt_approx_match(&iter, &match)) {
-            print_sam_line(samfile,
-                           fastq_rec->name, records->name,
-                           match.position + 1,
-                           match.cigar,
-                           fastq_rec->sequence, fastq_rec->quality);
+    const uint8_t *remapped = remap(remap_buf,
+                                    (uint8_t *)fastq_rec->sequence,
+                                    genome->bwt_table->remap_table);
+    if (!remapped) return;
+    
+    struct bwt_approx_iter  iter;
+    struct bwt_approx_match match;
+    
+    init_bwt_approx_iter_params(&iter, genome->bwt_table, remap_buf, d, params);
+    while (next_bwt_approx_match(&iter, &match)) {
+        print_match(samfile, fastq_rec, genome,
+                    match.position, match.match_length, match.cigar);
+    }
+    dealloc_bwt_approx_iter(&iter);
+}
+
+// Number of reads we search for together in exact mapping
+#define READ_BATCH_SIZE 256
 
+// Exact matching for a batch of reads. We search for all the
+// reads at once, so the searches can overlap their memory
+// accesses, see bwt_exact_search_batch(), but we report
+// the matches read by read as map_read() does.
+static void map_read_batch(struct fastq_record *fastq_recs,
+                           uint32_t no_reads,
+                           const struct bwt_index_record *genome,
+                           FILE *samfile)
+{
+    uint8_t *remap_bufs = malloc(no_reads * (MAX_STRING_LEN + 1));
+    const uint8_t **patterns = malloc(no_reads * sizeof(*patterns));
+    struct bwt_interval *intervals = malloc(no_reads * sizeof(*intervals));
+    
+    for (uint32_t j = 0; j < no_reads; ++j) {
+        uint8_t *buf = remap_bufs + j * (MAX_STRING_LEN + 1);
+        const uint8_t *remapped = remap(buf, fastq_recs[j].sequence,
+                                        genome->bwt_table->remap_table);
+        // A read we cannot remap cannot match; we search for
+        // an empty pattern and then ignore the result.
+        if (!remapped) buf[0] = '\0';
+        patterns[j] = buf;
+    }
+    bwt_exact_search_batch(genome->bwt_table, patterns, no_reads, intervals);
+    
+    for (uint32_t j = 0; j < no_reads; ++j) {
+        if (patterns[j][0] == '\0') continue;
+        struct fastq_record *fastq_rec = &fastq_recs[j];
+        uint32_t m = (uint32_t)strlen((char *)fastq_rec->sequence);
+        char cigar[32];
+        sprintf(cigar, "%uM", m);
+        struct bwt_interval interval = intervals[j];
+        for (index_t row = interval.L; row < interval.R; ++row) {
+            index_t position = bwt_locate(genome->bwt_table, row);
+            print_match(samfile, fastq_rec, genome, position, m, cigar);
         }
-        dealloc_bwt_approx_iter(&iter);
-            
-        records = records->next;
     }
     
+    free(intervals);
+    free(patterns);
+    free(remap_bufs);
 }
 
 static void print_help(const char *progname)
 {
-    printf("Usage: %s -p fasta-file\n", progname);
-    printf("Usage: %s -d dist fasta-file fastq-file\n\n", progname);
+    printf("Usage: %s [-s rate] [-k length] [-x] -p fasta-file\n", progname);
+    printf("Usage: %s [-a algorithm] [-f filter] [-m] [--populate] [--hugepages] -d dist fasta-file fastq-file\n\n", progname);
     printf("Options:\n");
     printf("\t-h | --help:\t\tShow this message.\n");
     printf("\t-p | --preprocess:\tPreprocess the genome.\n");
     printf("\t-d | --edits:\tThe maximum edit distance for a match.\n");
+    printf("\t-a | --algorithm:\tHow to search for approximative matches;\n"
+           "\t\t\t\tbidirectional (default), backtrack, or seed.\n"
+           "\t\t\t\tseed finds exact matches of d + 1 seeds and\n"
+           "\t\t\t\tverifies the genome around them; it is the\n"
+           "\t\t\t\tfastest for large d or long reads.\n");
+    printf("\t-m | --mismatches:\tOnly allow mismatches, no insertions or\n"
+           "\t\t\t\tdeletions, so -d is a Hamming distance.\n");
+    printf("\t-f | --filter:\t\tWhich matches to report; all, match (default),\n"
+           "\t\t\t\tor position. match reports each position and\n"
+           "\t\t\t\tmatch length once, with the fewest edits;\n"
+           "\t\t\t\tposition reports each position once.\n");
+    printf("\t-s | --sa-sample-rate:\tWhen preprocessing, only keep every\n"
+           "\t\t\t\trate'th suffix array entry. This saves memory\n"
+           "\t\t\t\tbut makes it slower to report matches.\n");
+    printf("\t-x | --self-index:\tWhen preprocessing, do not store the genome;\n"
+           "\t\t\t\tthe seed algorithm gets the text it needs\n"
+           "\t\t\t\tback from the tables. It implies a sampled\n"
+           "\t\t\t\tsuffix array, with rate %d if there is no -s.\n",
+           DEFAULT_SELF_INDEX_SAMPLE_RATE);
+    printf("\t-k | --kmer-length:\tWhen preprocessing, tabulate the intervals\n"
+           "\t\t\t\tof all k-mers of this length, so searches can\n"
+           "\t\t\t\tskip their first steps. Zero means no table;\n"
+           "\t\t\t\tthe default is picked from the genome size\n"
+           "\t\t\t\t(at most %d).\n", BWT_MAX_KMER_LENGTH);
+    printf("\t--populate:\t\tRead all the preprocessed tables into memory\n"
+           "\t\t\t\twhen mapping them, instead of when the\n"
+           "\t\t\t\tsearch first needs them.\n");
+    printf("\t--hugepages:\t\tAsk for huge pages for the preprocessed tables.\n");
     printf("\n\n");
 }
 
@@ -178,15 +289,31 @@ int main(int argc, char **argv)
     const char *fasta_fname = 0;
     const char *fastq_fname = 0;
     int edits = -1;
+    uint32_t sa_sample_rate = 0;
+    int kmer_length = -1;
+    bool self_index = false;
+    struct bwt_approx_params params = {
+        .algorithm = BWT_BIDIRECTIONAL,
+        .filter = BWT_BEST_PER_MATCH
+    };
+    int map_flags = 0;
     
     int opt;
     static struct option longopts[] = {
         { "help",       no_argument,       NULL, 'h' },
         { "preprocess", required_argument, NULL, 'p' },
         { "edits",      required_argument, NULL, 'd' },
+        { "sa-sample-rate", required_argument, NULL, 's' },
+        { "kmer-length", required_argument, NULL, 'k' },
+        { "self-index", no_argument,       NULL, 'x' },
+        { "algorithm",  required_argument, NULL, 'a' },
+        { "filter",     required_argument, NULL, 'f' },
+        { "mismatches", no_argument,       NULL, 'm' },
+        { "populate",   no_argument,       NULL, 'P' },
+        { "hugepages",  no_argument,       NULL, 'H' },
         { NULL,         0,                 NULL,  0  }
     };
-    while ((opt = getopt_long(argc, argv, "hp:d:", longopts, NULL)) != -1) {
+    while ((opt = getopt_long(argc, argv, "hp:d:s:k:xa:f:mPH", longopts, NULL)) != -1) {
         switch (opt) {
             case 'h':
                 print_help(progname);
@@ -201,6 +328,64 @@ int main(int argc, char **argv)
                 edits = atoi(optarg);
                 break;
                 
+            case 's':
+                sa_sample_rate = atoi(optarg);
+                break;
+                
+            case 'x':
+                self_index = true;
+                break;
+                
+            case 'a':
+                if (strcmp(optarg, "bidirectional") == 0) {
+                    params.algorithm = BWT_BIDIRECTIONAL;
+                } else if (strcmp(optarg, "backtrack") == 0) {
+                    params.algorithm = BWT_BACKTRACK;
+                } else if (strcmp(optarg, "seed") == 0) {
+                    params.algorithm = BWT_SEED_EXTEND;
+                } else {
+                    printf("Unknown algorithm: %s\n\n", optarg);
+                    print_help(progname);
+                    return EXIT_FAILURE;
+                }
+                break;
+                
+            case 'f':
+                if (strcmp(optarg, "all") == 0) {
+                    params.filter = BWT_REPORT_ALL;
+                } else if (strcmp(optarg, "match") == 0) {
+                    params.filter = BWT_BEST_PER_MATCH;
+                } else if (strcmp(optarg, "position") == 0) {
+                    params.filter = BWT_BEST_PER_POSITION;
+                } else {
+                    printf("Unknown filter: %s\n\n", optarg);
+                    print_help(progname);
+                    return EXIT_FAILURE;
+                }
+                break;
+                
+            case 'm':
+                params.distance = BWT_HAMMING_DISTANCE;
+                break;
+                
+            case 'P':
+                map_flags |= BWT_INDEX_POPULATE;
+                break;
+                
+            case 'H':
+                map_flags |= BWT_INDEX_HUGEPAGES;
+                break;
+                
+            case 'k':
+                kmer_length = atoi(optarg);
+                if (kmer_length < 0 || kmer_length > BWT_MAX_KMER_LENGTH) {
+                    printf("The k-mer length must be between 0 and %d.\n\n",
+                           BWT_MAX_KMER_LENGTH);
+                    print_help(progname);
+                    return EXIT_FAILURE;
+                }
+                break;
+                
             default:
                 printf("Invalid options.\n");
                 printf("Either an unknown option or a missing parameter to an option.\n\n");
@@ -214,7 +399,7 @@ int main(int argc, char **argv)
     
     if (should_preprocess) {
         //printf("preprocessing %s\n", fasta_fname);
-        preprocess(fasta_fname);
+        preprocess(fasta_fname, sa_sample_rate, kmer_length, self_index);
         
     } else {
         if (argc != 2) {
@@ -231,24 +416,46 @@ int main(int argc, char **argv)
         fasta_fname = argv[0];
         fastq_fname = argv[1];
         
-        struct string_table *tables = read_string_tables(fasta_fname);
+        struct bwt_index *index = read_index(fasta_fname, map_flags);
+        const struct bwt_index_record *genome = &index->records[0];
         
         FILE *samfile = stdout; // FIXME: option for writing to a file?
         FILE *fastq_file = fopen(fastq_fname, "r");
 
         struct fastq_iter fastq_iter;
-        struct fastq_record fastq_rec;
         init_fastq_iter(&fastq_iter, fastq_file);
-        while (next_fastq_record(&fastq_iter, &fastq_rec)) {
-            void map_read(struct fastq_record *fastq_rec,
-                          struct string_table *records,
-                          int d,
-                          FILE *samfile);
-
-            map_read(&fastq_rec, tables, edits, samfile);
+        if (edits == 0) {
+            // Exact matching; here we can search for many reads at once.
+            struct fastq_record *fastq_recs =
+                malloc(READ_BATCH_SIZE * sizeof(*fastq_recs));
+            uint32_t no_reads = 0;
+            while (next_fastq_record(&fastq_iter, &fastq_recs[no_reads])) {
+                if (++no_reads == READ_BATCH_SIZE) {
+                    map_read_batch(fastq_recs, no_reads, genome, samfile);
+                    no_reads = 0;
+                }
+            }
+            map_read_batch(fastq_recs, no_reads, genome, samfile);
+            free(fastq_recs);
+        } else {
+            // All the reads share one workspace, so once it has
+            // grown to size the search doesn't allocate memory.
+            struct bwt_approx_workspace workspace;
+            init_bwt_approx_workspace(&workspace);
+            params.workspace = &workspace;
+            // Otherwise, a match that spans two records could
+            // hide one inside a record when we filter.
+            params.seq_starts = genome->seq_starts;
+            params.no_seqs = genome->no_seqs;
+            
+            struct fastq_record fastq_rec;
+            while (next_fastq_record(&fastq_iter, &fastq_rec)) {
+                map_read(&fastq_rec, genome, edits, &params, samfile);
+            }
+            dealloc_bwt_approx_workspace(&workspace);
         }
         dealloc_fastq_iter(&fastq_iter);
-        free_string_tables(tables);
+        close_bwt_index(index);
 
     }
     
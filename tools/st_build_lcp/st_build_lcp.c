@@ -24,12 +24,12 @@ int main(int argc, const char** argv)
     struct suffix_tree* st = naive_suffix_tree((uint8_t *)string);
 
     printf("Traversing tree.\n");
-    uint32_t sa[st->length];
-    uint32_t lcp[st->length];
+    index_t sa[st->length];
+    index_t lcp[st->length];
     st_compute_sa_and_lcp(st, sa, lcp);
 
-    for (uint32_t i = 0; i < st->length; ++i) {
-        printf("%3u: %3u %3u %s\n",
+    for (index_t i = 0; i < st->length; ++i) {
+        printf("%3" PRIindex ": %3" PRIindex " %3" PRIindex " %s\n",
                i, sa[i], lcp[i], st->string + sa[i]);
     }
 